@@ -0,0 +1,277 @@
+#include "evdevGamepad.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+
+#define BITS_PER_LONG (sizeof(long) * 8)
+#define BIT_LONGS(bits) (((bits) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+struct ButtonCode {
+    uint16_t code;
+    uint16_t button;
+};
+
+static const ButtonCode button_codes[] = {
+    {BTN_SOUTH, A_BUTTON},
+    {BTN_EAST, B_BUTTON},
+    {BTN_NORTH, X_BUTTON}, //xpad reports the X button as BTN_X which is BTN_NORTH
+    {BTN_WEST, Y_BUTTON},
+    {BTN_TL, LB_BUTTON},
+    {BTN_TR, RB_BUTTON},
+    {BTN_SELECT, VIEW_BUTTON},
+    {BTN_START, MENU_BUTTON},
+    {BTN_THUMBL, L_BUTTON},
+    {BTN_THUMBR, R_BUTTON},
+    {BTN_DPAD_UP, UP_BUTTON}, //Pads that don't report the d-pad as a hat
+    {BTN_DPAD_DOWN, DOWN_BUTTON},
+    {BTN_DPAD_LEFT, LEFT_BUTTON},
+    {BTN_DPAD_RIGHT, RIGHT_BUTTON},
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool testBit(const unsigned long *bits, int bit){
+    return (bits[bit / BITS_PER_LONG] >> (bit % BITS_PER_LONG)) & 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool isGamepad(int fd){ //Has the sticks and a south button
+    unsigned long absBits[BIT_LONGS(ABS_CNT)] = {0};
+    unsigned long keyBits[BIT_LONGS(KEY_CNT)] = {0};
+    if(ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits) < 0 || ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) < 0){
+        return false;
+    }
+    return testBit(absBits, ABS_X) && testBit(absBits, ABS_Y) && testBit(keyBits, BTN_SOUTH);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+EvdevGamepad::EvdevGamepad(void) : _fd(-1), _pending(), _state(), _pendingUs(0), _eventUs(0), _unreportedUs(0), _dropping(false) {
+    _name[0] = '\0';
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+EvdevGamepad::~EvdevGamepad(void){
+    close();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool EvdevGamepad::open(const char *path){
+    close();
+    char found[32];
+    if(path == NULL){
+        for(int i = 0; i < 64 && path == NULL; i++){
+            snprintf(found, sizeof(found), "/dev/input/event%d", i);
+            int fd = ::open(found, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if(fd >= 0){
+                if(isGamepad(fd)){
+                    path = found;
+                }
+                ::close(fd);
+            }
+        }
+        if(path == NULL){
+            fprintf(stderr, "Error: no gamepad found in /dev/input. Is it connected and can this user read the event devices?\n");
+            return false;
+        }
+    }
+    struct stat info;
+    bool fifo = stat(path, &info) == 0 && S_ISFIFO(info.st_mode);
+    _fd = ::open(path, O_RDONLY | O_CLOEXEC | (fifo ? 0 : O_NONBLOCK)); //A FIFO is opened blocking so it waits for the writer
+    if(_fd < 0){
+        fprintf(stderr, "Error: unable to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+
+    for(int code = ABS_X; code <= ABS_RZ; code++){ //The virtual pad's ranges for anything that isn't an evdev device
+        bool trigger = (code == ABS_Z || code == ABS_RZ);
+        _ranges[code].minimum = trigger ? 0 : -32768;
+        _ranges[code].maximum = trigger ? 255 : 32767;
+    }
+    if(ioctl(_fd, EVIOCGNAME(sizeof(_name)), _name) < 0){
+        snprintf(_name, sizeof(_name), "input_event stream");
+        return true;
+    }
+    int clock = CLOCK_MONOTONIC; //Timestamps on the same clock as monotonicUs()
+    ioctl(_fd, EVIOCSCLOCKID, &clock);
+    for(int code = ABS_X; code <= ABS_RZ; code++){
+        struct input_absinfo absinfo;
+        if(ioctl(_fd, EVIOCGABS(code), &absinfo) == 0){
+            _ranges[code].minimum = absinfo.minimum;
+            _ranges[code].maximum = absinfo.maximum;
+            handleEvent(EV_ABS, code, absinfo.value, 0); //Start from where the sticks are now
+        }
+    }
+    _state = _pending;
+    _pendingUs = 0;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void EvdevGamepad::close(void){
+    if(_fd >= 0){
+        ::close(_fd);
+        _fd = -1;
+    }
+    _pending = GamepadState();
+    _state = GamepadState();
+    _pendingUs = 0;
+    _unreportedUs = 0;
+    _dropping = false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int EvdevGamepad::fd(void) const {
+    return _fd;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+const char *EvdevGamepad::name(void) const {
+    return _name;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+const GamepadState &EvdevGamepad::state(void) const {
+    return _state;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+uint64_t EvdevGamepad::eventUs(void) const {
+    return _eventUs;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int EvdevGamepad::read(void){
+    struct input_event events[EVDEV_MAX_EVENTS];
+    while(true){
+        ssize_t count = ::read(_fd, events, sizeof(events));
+        if(count < 0){
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR){
+                break;
+            }
+            return -1; //ENODEV when it is unplugged
+        }
+        if(count == 0){ //The FIFO's writer has gone. Report the last packet first
+            if(_unreportedUs == 0){
+                return -1;
+            }
+            break;
+        }
+        for(size_t i = 0; i < count / sizeof(struct input_event); i++){
+            uint64_t timeUs = (uint64_t)events[i].input_event_sec * 1000000 + events[i].input_event_usec;
+            handleEvent(events[i].type, events[i].code, events[i].value, timeUs);
+        }
+    }
+    if(_unreportedUs == 0){
+        return 0;
+    }
+    _eventUs = _unreportedUs; //The oldest event that has changed the state since the last call
+    _unreportedUs = 0;
+    return 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void EvdevGamepad::handleEvent(uint16_t type, uint16_t code, int32_t value, uint64_t timeUs){
+    if(type == EV_SYN){
+        if(code == SYN_DROPPED){ //The kernel's buffer overflowed. Ignore the rest of the packet and carry on from the next one
+            _dropping = true;
+        }
+        else if(code == SYN_REPORT){
+            if(!_dropping && _pendingUs != 0){
+                _state = _pending;
+                if(_unreportedUs == 0){
+                    _unreportedUs = _pendingUs;
+                }
+            }
+            _dropping = false;
+            _pendingUs = 0;
+        }
+        return;
+    }
+    if(_dropping){
+        return;
+    }
+    if(_pendingUs == 0){
+        _pendingUs = timeUs ? timeUs : 1;
+    }
+    if(type == EV_ABS){
+        switch(code){
+            case ABS_X: _pending.thumbLX = scaleStick(code, value); break;
+            case ABS_Y: _pending.thumbLY = scaleStick(code, value); break;
+            case ABS_RX: _pending.thumbRX = scaleStick(code, value); break;
+            case ABS_RY: _pending.thumbRY = scaleStick(code, value); break;
+            case ABS_Z: _pending.leftTrigger = scaleTrigger(code, value); break;
+            case ABS_RZ: _pending.rightTrigger = scaleTrigger(code, value); break;
+            case ABS_HAT0X:
+                setButton(LEFT_BUTTON, value < 0);
+                setButton(RIGHT_BUTTON, value > 0);
+                break;
+            case ABS_HAT0Y:
+                setButton(UP_BUTTON, value < 0);
+                setButton(DOWN_BUTTON, value > 0);
+                break;
+        }
+    }
+    else if(type == EV_KEY){
+        for(size_t i = 0; i < sizeof(button_codes) / sizeof(button_codes[0]); i++){
+            if(button_codes[i].code == code){
+                setButton(button_codes[i].button, value != 0);
+            }
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int16_t EvdevGamepad::scaleStick(int code, int32_t value) const {
+    long range = (long)_ranges[code].maximum - _ranges[code].minimum;
+    if(range <= 0){
+        return 0;
+    }
+    long scaled = ((long)value - _ranges[code].minimum) * 65535 / range - 32768;
+    if(code == ABS_Y || code == ABS_RY){ //evdev's Y axes are positive down
+        scaled = -scaled - 1;
+    }
+    return (int16_t)(scaled < -32768 ? -32768 : (scaled > 32767 ? 32767 : scaled));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+uint8_t EvdevGamepad::scaleTrigger(int code, int32_t value) const {
+    long range = (long)_ranges[code].maximum - _ranges[code].minimum;
+    if(range <= 0){
+        return 0;
+    }
+    long scaled = ((long)value - _ranges[code].minimum) * 255 / range;
+    return (uint8_t)(scaled < 0 ? 0 : (scaled > 255 ? 255 : scaled));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void EvdevGamepad::setButton(uint16_t button, bool pressed){
+    if(pressed){
+        _pending.buttons |= button;
+    }
+    else{
+        _pending.buttons &= ~button;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef EVDEVGAMEPAD_H
+#define EVDEVGAMEPAD_H
+
+#include "panTiltController.h"
+#include <stdint.h>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Linux gamepad input from an evdev device (/dev/input/eventN). The events are read as they arrive, so fd() can go straight into an epoll set, and
+//every SYN_REPORT gives a GamepadState with the kernel's timestamp for the first event of the packet on the same clock as monotonicUs().
+//
+//The xpad driver's layout is mapped onto XInput's: the sticks are scaled to -32768 to 32767 with up positive, the triggers to 0 to 255 and the
+//d-pad hat and buttons to the _BUTTON bits. A file that isn't an evdev device (such as the FIFO from pan_tilt_virtual_pad --fifo) is read as a
+//stream of input_events with the virtual pad's ranges.
+
+#define EVDEV_MAX_EVENTS 64 //Events read per call
+
+class EvdevGamepad {
+public:
+    EvdevGamepad(void);
+    ~EvdevGamepad(void);
+
+    bool open(const char *path); //NULL opens the first gamepad in /dev/input. Prints the reason to stderr and returns false if it fails
+    void close(void);
+    int fd(void) const;
+    const char *name(void) const;
+
+    int read(void); //Reads what is waiting without blocking. 1 if a packet has completed, 0 if not and -1 if the device has gone
+    const GamepadState &state(void) const; //State after the last completed packet
+    uint64_t eventUs(void) const; //When the first event of the last completed packet happened
+
+private:
+    struct AxisRange {
+        int minimum;
+        int maximum;
+    };
+
+    void handleEvent(uint16_t type, uint16_t code, int32_t value, uint64_t timeUs);
+    int16_t scaleStick(int code, int32_t value) const;
+    uint8_t scaleTrigger(int code, int32_t value) const;
+    void setButton(uint16_t button, bool pressed);
+
+    int _fd;
+    char _name[64];
+    AxisRange _ranges[6]; //ABS_X to ABS_RZ
+    GamepadState _pending; //Built up from the events of the current packet
+    GamepadState _state;
+    uint64_t _pendingUs; //0 until the first event of a packet
+    uint64_t _eventUs;
+    uint64_t _unreportedUs; //First event of the packets completed since read() last returned 1
+    bool _dropping; //Skipping to the next SYN_REPORT after a SYN_DROPPED
+};
+
+#endif
@@ -0,0 +1,407 @@
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------
+ *
+ * Throughput and round trip benchmark of the firmware's serial receive path. A mix of instructions is sent and the firmware acknowledges each one
+ * once serialData() has run it (INSTRUCTION_JOG_ACK 3: INSTRUCTION_ACK and the instruction character for ASCII, JOG_ACK for the binary jog). The
+ * report has the commands a second, the latency percentiles for each opcode and the commands that were dropped or acknowledged wrongly.
+ *
+ *   ./build/pan_tilt_bench --port /dev/ttyUSB0 --mix "p0,x0,>,jog" --count 500
+ *   ./build/pan_tilt_bench --port /dev/pts/N --mix "#*1,V*2,jog*4" --duration 10 --window 4 --json bench.json
+ *
+ * The mix is a comma separated list of instructions, each with an optional *WEIGHT. "jog" is a binary jog packet with zero speeds. Instructions
+ * run on the mount so "#" adds keyframes and "p"/"x" move it. --window is how many commands can be waiting for their acks: 1 measures the
+ * round trip, more measures the throughput. --rate sends at a fixed rate instead whatever the acks do. --gap-us below the firmware's 2ms read
+ * window lets frames run together, which shows up as dropped and garbled commands.
+ *
+ *--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#include "panTiltLatency.h"
+#include "panTiltLink.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define INSTRUCTION_ACK 0x11 //panTiltMount.h. Followed by the instruction character
+#define INSTRUCTION_NAK 0x12
+#define ACK_MODE_ALL 3 //Jog and instruction acks
+
+#define BENCH_DEFAULT_MIX "p0,x0,>,jog"
+#define BENCH_DEFAULT_COUNT 200
+#define BENCH_TIMEOUT_MS 1000 //A command not acknowledged by then is dropped
+#define BENCH_SETTLE_MS 300 //Time for the ack mode reply before starting
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+struct Opcode {
+    std::string instruction; //"jog" for the binary jog
+    int weight;
+    bool jog;
+    unsigned long sent;
+    unsigned long acked;
+    unsigned long naks;
+    unsigned long dropped;
+    unsigned long garbled;
+    std::vector<uint32_t> latencyUs;
+};
+
+struct Command {
+    uint64_t tag; //Sequence number the frame was sent with
+    size_t opcode;
+    uint64_t sentUs; //0 until the link has written it
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+class BenchObserver : public LinkObserver { //Matches the acks to the commands in the order they were sent
+public:
+    BenchObserver(std::vector<Opcode> &opcodes) : replyBytes(0), unexpected(0), _opcodes(opcodes), _ackPrefix(0), _sequence(0) {}
+
+    void frameSent(const uint8_t*, size_t, uint64_t tag, uint64_t, uint64_t sentUs){
+        if(tag == 0){
+            return; //Not a benchmark command
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < inFlight.size(); i++){
+            if(inFlight[i].tag == tag){
+                inFlight[i].sentUs = sentUs;
+                break;
+            }
+        }
+    }
+
+    void dataReceived(const char *data, size_t length, uint64_t receivedUs){
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < length; i++){
+            uint8_t byte = (uint8_t)data[i];
+            if(_ackPrefix != 0){
+                instructionAck(_ackPrefix == INSTRUCTION_ACK, (char)byte, receivedUs);
+                _ackPrefix = 0;
+            }
+            else if(byte == INSTRUCTION_ACK || byte == INSTRUCTION_NAK){
+                _ackPrefix = byte;
+            }
+            else if(byte == JOG_ACK || byte == JOG_NAK){
+                jogAck(byte == JOG_ACK, receivedUs);
+            }
+            else{
+                replyBytes++;
+            }
+        }
+        changed.notify_all();
+    }
+
+    uint64_t add(size_t opcode){ //Call with mutex held. Returns the tag to send the command with
+        Command command = {++_sequence, opcode, 0};
+        inFlight.push_back(command);
+        _opcodes[opcode].sent++;
+        return command.tag;
+    }
+
+    void expire(uint64_t nowUs){ //Call with mutex held
+        while(!inFlight.empty() && inFlight.front().sentUs != 0 && nowUs - inFlight.front().sentUs > BENCH_TIMEOUT_MS * 1000ULL){
+            _opcodes[inFlight.front().opcode].dropped++;
+            inFlight.pop_front();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Command> inFlight;
+    unsigned long replyBytes; //Everything that wasn't an ack, e.g. "Index: 2"
+    unsigned long unexpected; //Acks with nothing waiting for them
+
+private:
+    void complete(size_t index, bool ack, uint64_t receivedUs){ //Commands before index never got an ack
+        for(size_t i = 0; i < index; i++){
+            _opcodes[inFlight.front().opcode].dropped++;
+            inFlight.pop_front();
+        }
+        Command command = inFlight.front();
+        inFlight.pop_front();
+        Opcode &opcode = _opcodes[command.opcode];
+        if(!ack){
+            opcode.naks++;
+            return;
+        }
+        opcode.acked++;
+        if(command.sentUs != 0 && receivedUs >= command.sentUs){
+            opcode.latencyUs.push_back((uint32_t)(receivedUs - command.sentUs));
+        }
+    }
+
+    void instructionAck(bool ack, char instruction, uint64_t receivedUs){
+        for(size_t i = 0; i < inFlight.size(); i++){ //The oldest command it could be for
+            const Opcode &opcode = _opcodes[inFlight[i].opcode];
+            if(!opcode.jog && opcode.instruction[0] == instruction){
+                complete(i, ack, receivedUs);
+                return;
+            }
+        }
+        if(!inFlight.empty()){ //The instruction character was corrupted or two frames ran together
+            _opcodes[inFlight.front().opcode].garbled++;
+            inFlight.pop_front();
+        }
+        else{
+            unexpected++;
+        }
+    }
+
+    void jogAck(bool ack, uint64_t receivedUs){
+        for(size_t i = 0; i < inFlight.size(); i++){
+            if(_opcodes[inFlight[i].opcode].jog){
+                complete(i, ack, receivedUs);
+                return;
+            }
+        }
+        unexpected++;
+    }
+
+    std::vector<Opcode> &_opcodes;
+    uint8_t _ackPrefix; //INSTRUCTION_ACK or INSTRUCTION_NAK waiting for its instruction character
+    uint64_t _sequence;
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool parseMix(const char *mix, std::vector<Opcode> &opcodes){
+    std::string text(mix);
+    size_t start = 0;
+    while(start <= text.size()){
+        size_t end = text.find(',', start);
+        if(end == std::string::npos){
+            end = text.size();
+        }
+        std::string item = text.substr(start, end - start);
+        Opcode opcode = Opcode();
+        opcode.weight = 1;
+        size_t star = item.rfind('*');
+        if(star != std::string::npos && star > 0){
+            opcode.weight = atoi(item.c_str() + star + 1);
+            item.erase(star);
+        }
+        opcode.instruction = item;
+        opcode.jog = (item == "jog");
+        if(item.empty() || item.size() > PAN_TILT_MAX_FRAME || opcode.weight <= 0 || item[0] == INSTRUCTION_JOG_ACK){
+            fprintf(stderr, "Error: bad mix entry \"%s\"\n", text.substr(start, end - start).c_str());
+            return false;
+        }
+        opcodes.push_back(opcode);
+        start = end + 1;
+    }
+    return !opcodes.empty();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static double percentile(std::vector<uint32_t> &sorted, double fraction){
+    if(sorted.empty()){
+        return 0;
+    }
+    size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index] / 1000.0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void usage(void){
+    fprintf(stderr, "Usage: pan_tilt_bench --port PORT [options]\n"
+        "  --port PORT          Serial port of the mount\n"
+        "  --mix LIST           Instructions to send with optional weights, e.g. \"p0*2,x0,jog\" (default \"%s\")\n"
+        "  --count N            Commands to send (default %d)\n"
+        "  --duration SECONDS   Send for this long instead\n"
+        "  --window N           Commands waiting for their acks at once (default 1)\n"
+        "  --rate N             Send N commands a second however many are waiting\n"
+        "  --seed N             Seed of the random order (default 1)\n"
+        "  --baud N             Baud rate (default %d)\n"
+        "  --gap-us N           Silence after each frame (default %d)\n"
+        "  --json FILE          Also write the results to FILE as JSON\n", BENCH_DEFAULT_MIX, BENCH_DEFAULT_COUNT, PAN_TILT_BAUD_RATE,
+        PAN_TILT_FRAME_GAP_US);
+    exit(2);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main(int argc, char **argv){
+    const char *port = NULL;
+    const char *mix = BENCH_DEFAULT_MIX;
+    const char *jsonPath = NULL;
+    long count = BENCH_DEFAULT_COUNT;
+    double durationS = 0;
+    size_t window = 1;
+    double rate = 0;
+    unsigned int seed = 1;
+    long baud = PAN_TILT_BAUD_RATE;
+    long gapUs = PAN_TILT_FRAME_GAP_US;
+    for(int i = 1; i < argc; i++){
+        const char *option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(strcmp(option, "--port") == 0 && hasValue){
+            port = argv[++i];
+        }
+        else if(strcmp(option, "--mix") == 0 && hasValue){
+            mix = argv[++i];
+        }
+        else if(strcmp(option, "--count") == 0 && hasValue){
+            count = atol(argv[++i]);
+        }
+        else if(strcmp(option, "--duration") == 0 && hasValue){
+            durationS = atof(argv[++i]);
+        }
+        else if(strcmp(option, "--window") == 0 && hasValue){
+            window = (size_t)atol(argv[++i]);
+        }
+        else if(strcmp(option, "--rate") == 0 && hasValue){
+            rate = atof(argv[++i]);
+        }
+        else if(strcmp(option, "--seed") == 0 && hasValue){
+            seed = (unsigned int)atol(argv[++i]);
+        }
+        else if(strcmp(option, "--baud") == 0 && hasValue){
+            baud = atol(argv[++i]);
+        }
+        else if(strcmp(option, "--gap-us") == 0 && hasValue){
+            gapUs = atol(argv[++i]);
+        }
+        else if(strcmp(option, "--json") == 0 && hasValue){
+            jsonPath = argv[++i];
+        }
+        else{
+            usage();
+        }
+    }
+    std::vector<Opcode> opcodes;
+    if(port == NULL || window == 0 || !parseMix(mix, opcodes)){
+        usage();
+    }
+    std::vector<size_t> draw; //Each opcode weight times so a random element follows the mix
+    for(size_t i = 0; i < opcodes.size(); i++){
+        draw.insert(draw.end(), opcodes[i].weight, i);
+    }
+    srand(seed);
+
+    BenchObserver observer(opcodes);
+    PanTiltLink link;
+    link.setObserver(&observer);
+    if(!link.open(port, baud)){
+        return 1;
+    }
+    link.setFrameGapUs(gapUs);
+    char ackMode[4];
+    snprintf(ackMode, sizeof(ackMode), "%c%d", INSTRUCTION_JOG_ACK, ACK_MODE_ALL);
+    link.sendString(ackMode);
+    link.drain(1000);
+    link.waitReceive(BENCH_SETTLE_MS); //The firmware may still be starting up after the port opened and reset it
+    char discard[256];
+    while(link.receive(discard, sizeof(discard)) > 0){}
+    {
+        std::lock_guard<std::mutex> lock(observer.mutex);
+        observer.replyBytes = 0; //The ack mode's reply and its own ack
+        observer.unexpected = 0;
+    }
+
+    uint64_t startUs = monotonicUs();
+    uint64_t endUs = durationS > 0 ? startUs + (uint64_t)(durationS * 1000000) : 0;
+    uint64_t periodUs = rate > 0 ? (uint64_t)(1000000 / rate) : 0;
+    uint64_t nextSendUs = startUs;
+    long sent = 0;
+    while(endUs != 0 ? monotonicUs() < endUs : sent < count){
+        std::unique_lock<std::mutex> lock(observer.mutex);
+        uint64_t nowUs = monotonicUs();
+        observer.expire(nowUs);
+        bool ready = periodUs > 0 ? nowUs >= nextSendUs : observer.inFlight.size() < window;
+        if(!ready || link.queuedBytes() > 0){
+            while(link.receive(discard, sizeof(discard)) > 0){} //Only the observer needs the replies
+            uint64_t waitUs = (periodUs > 0 && nextSendUs > nowUs) ? nextSendUs - nowUs : 1000;
+            observer.changed.wait_for(lock, std::chrono::microseconds(waitUs < 1000 ? waitUs : 1000));
+            continue;
+        }
+        size_t index = draw[rand() % draw.size()];
+        uint64_t tag = observer.add(index);
+        lock.unlock();
+        bool queued;
+        if(opcodes[index].jog){
+            JogSpeeds zero = {0, 0, 0};
+            queued = link.sendJog(zero, tag);
+        }
+        else{
+            queued = link.sendString(opcodes[index].instruction.c_str(), tag);
+        }
+        if(!queued){
+            fprintf(stderr, "Error: the link refused a frame\n");
+            break;
+        }
+        sent++;
+        nextSendUs += periodUs;
+    }
+    uint64_t sendEndUs = monotonicUs();
+    uint64_t waitEndUs = sendEndUs + BENCH_TIMEOUT_MS * 1000ULL;
+    {
+        std::unique_lock<std::mutex> lock(observer.mutex);
+        while(!observer.inFlight.empty() && monotonicUs() < waitEndUs){
+            observer.changed.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        observer.expire(UINT64_MAX);
+        while(!observer.inFlight.empty()){ //Never written or never acknowledged
+            opcodes[observer.inFlight.front().opcode].dropped++;
+            observer.inFlight.pop_front();
+        }
+    }
+    snprintf(ackMode, sizeof(ackMode), "%c0", INSTRUCTION_JOG_ACK);
+    link.sendString(ackMode);
+    link.drain(1000);
+
+    std::lock_guard<std::mutex> lock(observer.mutex);
+    double seconds = (sendEndUs - startUs) / 1000000.0;
+    unsigned long acked = 0;
+    unsigned long failed = 0;
+    FILE *json = NULL;
+    if(jsonPath != NULL && (json = fopen(jsonPath, "w")) == NULL){
+        perror(jsonPath);
+    }
+    if(json != NULL){
+        fprintf(json, "{\n  \"opcodes\": [\n");
+    }
+    printf("Opcode\tsent\tacked\tnaks\tdropped\tgarbled\tp50\tp90\tp99\tmax (ms)\n");
+    for(size_t i = 0; i < opcodes.size(); i++){
+        Opcode &opcode = opcodes[i];
+        std::sort(opcode.latencyUs.begin(), opcode.latencyUs.end());
+        double p50 = percentile(opcode.latencyUs, 0.5);
+        double p90 = percentile(opcode.latencyUs, 0.9);
+        double p99 = percentile(opcode.latencyUs, 0.99);
+        double max = percentile(opcode.latencyUs, 1.0);
+        printf("%s\t%lu\t%lu\t%lu\t%lu\t%lu\t%.2f\t%.2f\t%.2f\t%.2f\n", opcode.instruction.c_str(), opcode.sent, opcode.acked, opcode.naks, opcode.dropped,
+            opcode.garbled, p50, p90, p99, max);
+        if(json != NULL){
+            std::string name = opcode.jog ? "jog" : opcode.instruction;
+            std::string escaped;
+            for(size_t c = 0; c < name.size(); c++){
+                if(name[c] == '"' || name[c] == '\\') escaped += '\\';
+                escaped += name[c];
+            }
+            fprintf(json, "    {\"opcode\": \"%s\", \"sent\": %lu, \"acked\": %lu, \"naks\": %lu, \"dropped\": %lu, \"garbled\": %lu, "
+                "\"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n", escaped.c_str(), opcode.sent, opcode.acked, opcode.naks,
+                opcode.dropped, opcode.garbled, p50, p90, p99, max, (i + 1 < opcodes.size()) ? "," : "");
+        }
+        acked += opcode.acked + opcode.naks;
+        failed += opcode.dropped + opcode.garbled;
+    }
+    LinkStats stats = link.stats();
+    printf("%ld commands in %.2fs: %.1f commands/s acknowledged\t%lu dropped or garbled\t%lu unexpected acks\t%lu reply bytes\n", sent, seconds,
+        seconds > 0 ? acked / seconds : 0, failed, observer.unexpected, observer.replyBytes);
+    printf("Link: %lu frames\t%lu bytes\t%.1f%% used\tQueue max: %luus\n", stats.framesSent, stats.bytesSent,
+        seconds > 0 ? 100.0 * stats.bytesSent * 10 / baud / seconds : 0, stats.queueMaxUs);
+    if(json != NULL){
+        fprintf(json, "  ],\n  \"commands\": %ld,\n  \"seconds\": %.3f,\n  \"commands_per_second\": %.2f,\n  \"failed\": %lu,\n  \"unexpected\": %lu,\n"
+            "  \"reply_bytes\": %lu,\n  \"window\": %lu,\n  \"rate\": %.1f,\n  \"gap_us\": %ld\n}\n", sent, seconds, seconds > 0 ? acked / seconds : 0,
+            failed, observer.unexpected, observer.replyBytes, (unsigned long)window, rate, gapUs);
+        fclose(json);
+    }
+    link.close();
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+#include "panTiltCapture.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define INSTRUCTION_ACK 0x11 //panTiltMount.h. These are followed by one byte that isn't part of the text
+#define INSTRUCTION_NAK 0x12
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+CaptureRecorder::CaptureRecorder(void) : _recording(false), _finished(false), _framesReported(0), _marker(0), _payloadLength(0), _payloadNeeded(0) {
+    _stream.periodMs = CAPTURE_PERIOD_MS;
+    _stream.stepMode = 0;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        _stream.startSteps[axis] = 0;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool CaptureRecorder::start(PanTiltLink &link, int periodMs){
+    char instruction[16];
+    snprintf(instruction, sizeof(instruction), "%c%d", INSTRUCTION_CAPTURE, periodMs);
+    _finished = false;
+    return link.sendString(instruction);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool CaptureRecorder::stop(PanTiltLink &link){
+    char instruction[16];
+    snprintf(instruction, sizeof(instruction), "%c0", INSTRUCTION_CAPTURE);
+    return link.sendString(instruction);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+size_t CaptureRecorder::feed(char *data, size_t length){
+    size_t kept = 0;
+    for(size_t i = 0; i < length; i++){
+        uint8_t c = (uint8_t)data[i];
+        if(_marker == INSTRUCTION_ACK || _marker == SEGMENT_CREDIT){ //The byte after one of these is passed on as it is
+            _marker = 0;
+            data[kept++] = c;
+            continue;
+        }
+        if(_marker != 0){
+            _payload[_payloadLength++] = c;
+            if(_payloadLength < _payloadNeeded){
+                continue;
+            }
+            if(_recording){
+                for(int axis = 0; axis < SEGMENT_AXES; axis++){
+                    _stream.steps.push_back(_marker == CAPTURE_FRAME_SHORT ? (int16_t)(int8_t)_payload[axis] :
+                        (int16_t)((_payload[axis * 2] << 8) | _payload[axis * 2 + 1]));
+                }
+            }
+            _marker = 0;
+            continue;
+        }
+        if(c == CAPTURE_FRAME_SHORT || c == CAPTURE_FRAME){
+            _marker = c;
+            _payloadLength = 0;
+            _payloadNeeded = (c == CAPTURE_FRAME_SHORT) ? SEGMENT_AXES : SEGMENT_AXES * 2;
+            continue;
+        }
+        data[kept++] = c;
+        if(c == INSTRUCTION_ACK || c == INSTRUCTION_NAK || c == SEGMENT_CREDIT){
+            _marker = INSTRUCTION_ACK;
+        }
+        else if(c == '\n'){
+            line(_line);
+            _line.clear();
+        }
+        else if(c >= ' ' || c == '\t'){
+            _line += (char)c;
+        }
+    }
+    return kept;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void CaptureRecorder::line(const std::string &text){ //"Capture: 20ms\tStep mode: 16\tStart: p t s" then the frames then "Capture frames: N"
+    int periodMs, stepMode;
+    long start[SEGMENT_AXES];
+    unsigned long frames;
+    if(sscanf(text.c_str(), "Capture: %dms\tStep mode: %d\tStart: %ld %ld %ld", &periodMs, &stepMode, &start[0], &start[1], &start[2]) == 5){
+        _stream.periodMs = periodMs;
+        _stream.stepMode = stepMode;
+        for(int axis = 0; axis < SEGMENT_AXES; axis++){
+            _stream.startSteps[axis] = start[axis];
+        }
+        _stream.steps.clear();
+        _recording = true;
+        _finished = false;
+    }
+    else if(_recording && sscanf(text.c_str(), "Capture frames: %lu", &frames) == 1){
+        _framesReported = frames;
+        _recording = false;
+        _finished = true;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void trimSegments(SegmentStream &stream){
+    size_t first = 0;
+    size_t last = stream.count();
+    const int16_t *steps = stream.steps.data();
+    while(first < last && steps[first * TRAJECTORY_AXES] == 0 && steps[first * TRAJECTORY_AXES + 1] == 0 && steps[first * TRAJECTORY_AXES + 2] == 0){
+        first++;
+    }
+    while(last > first && steps[(last - 1) * TRAJECTORY_AXES] == 0 && steps[(last - 1) * TRAJECTORY_AXES + 1] == 0 &&
+        steps[(last - 1) * TRAJECTORY_AXES + 2] == 0){
+        last--;
+    }
+    stream.steps.erase(stream.steps.begin() + last * TRAJECTORY_AXES, stream.steps.end());
+    stream.steps.erase(stream.steps.begin(), stream.steps.begin() + first * TRAJECTORY_AXES);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//The velocity of each segment and the acceleration over RETIME_ACCELERATION_WINDOW_MS, from the positions before they were rounded to steps. The
+//mount is stopped before and after the stream so a capture that starts or ends moving has to get up to speed or stop in its first or last window.
+
+static bool checkRetimeLimits(const std::vector<double> *positions, int periodMs, const double *stepsPerUnit, const RetimeOptions &options,
+    std::string &error){
+    const char *names[TRAJECTORY_AXES] = {"Pan", "Tilt", "Slider"};
+    const char *units[TRAJECTORY_AXES] = {"deg", "deg", "mm"};
+    double periodS = periodMs / 1000.0;
+    size_t window = std::max(1L, lround((double)RETIME_ACCELERATION_WINDOW_MS / periodMs));
+    double windowS = window * periodS;
+    char text[160];
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        const std::vector<double> &p = positions[axis];
+        double velocity = 0, acceleration = 0;
+        for(size_t k = 1; k < p.size(); k++){
+            velocity = std::max(velocity, fabs(p[k] - p[k - 1]) / periodS / stepsPerUnit[axis]);
+        }
+        for(long k = -2 * (long)window; k < (long)p.size(); k++){ //Held at the ends
+            double first = p[std::max(k, 0L)];
+            double middle = p[std::min(std::max(k + (long)window, 0L), (long)p.size() - 1)];
+            double end = p[std::min(k + 2 * (long)window, (long)p.size() - 1)];
+            acceleration = std::max(acceleration, fabs(end - 2 * middle + first) / (windowS * windowS) / stepsPerUnit[axis]);
+        }
+        if(velocity > options.limits[axis].velocity * RETIME_LIMIT_TOLERANCE){
+            snprintf(text, sizeof(text), "%s reaches %.3f %s/s, over the %.3f %s/s limit. Use a larger time scale", names[axis], velocity, units[axis],
+                options.limits[axis].velocity, units[axis]);
+            error = text;
+            return false;
+        }
+        if(acceleration > options.limits[axis].acceleration * RETIME_LIMIT_TOLERANCE * RETIME_LIMIT_TOLERANCE){
+            snprintf(text, sizeof(text), "%s reaches %.3f %s/s^2, over the %.3f %s/s^2 limit. Use more smoothing or a larger time scale", names[axis],
+                acceleration, units[axis], options.limits[axis].acceleration, units[axis]);
+            error = text;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//The capture is turned back into positions, smoothed with a centred moving average and then resampled at the new period with the time scaled. The
+//average holds the first and last positions for half a window beyond each end so the smoothed move starts and ends at rest where the capture did.
+
+bool retimeSegments(const SegmentStream &input, const RetimeOptions &options, SegmentStream &output, std::string &error){
+    if(options.timeScale <= 0 || options.smoothMs < 0 || options.periodMs < 0){
+        error = "The time scale must be above 0 and the smoothing and period can't be negative";
+        return false;
+    }
+    double stepsPerUnit[TRAJECTORY_AXES];
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        stepsPerUnit[axis] = axisStepsPerUnit(axis, input.stepMode, options.herringboneTilt);
+        if(!(stepsPerUnit[axis] > 0) || !(options.limits[axis].velocity > 0) || !(options.limits[axis].acceleration > 0)){
+            error = "The capture needs a step mode and the velocity and acceleration limits must be above zero";
+            return false;
+        }
+    }
+    size_t n = input.count();
+    int periodMs = (options.periodMs > 0) ? options.periodMs : input.periodMs;
+    long half = lround(options.smoothMs / (2.0 * input.periodMs)); //Samples either side of the centre of the average
+    size_t length = n + 2 * half + 1;
+    std::vector<double> smoothed[TRAJECTORY_AXES];
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        std::vector<long> position(n + 1);
+        position[0] = input.startSteps[axis];
+        for(size_t k = 0; k < n; k++){
+            position[k + 1] = position[k] + input.steps[k * TRAJECTORY_AXES + axis];
+        }
+        smoothed[axis].resize(length);
+        long sum = position[0] * (2 * half + 1); //Window centred on -half covers -2half to 0, all held at the start
+        for(size_t m = 0; m < length; m++){
+            smoothed[axis][m] = (double)sum / (2 * half + 1);
+            long leaving = (long)m - 2 * half; //Slides the window along one sample
+            long entering = (long)m + 1;
+            sum += position[std::min((size_t)std::max(entering, 0L), n)] - position[std::min((size_t)std::max(leaving, 0L), n)];
+        }
+    }
+
+    output.periodMs = periodMs;
+    output.stepMode = input.stepMode;
+    output.steps.clear();
+    long last[TRAJECTORY_AXES];
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        output.startSteps[axis] = last[axis] = lround(smoothed[axis][0]);
+    }
+    double durationMs = (length - 1) * (double)input.periodMs * options.timeScale;
+    long count = (long)ceil(durationMs / periodMs - 1e-9);
+    std::vector<double> resampled[TRAJECTORY_AXES]; //Positions in steps before the rounding, for checking the limits
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        resampled[axis].push_back(smoothed[axis][0]);
+    }
+    for(long k = 1; k <= count; k++){
+        double index = std::min(k * (double)periodMs, durationMs) / options.timeScale / input.periodMs;
+        size_t below = std::min((size_t)index, length - 1);
+        double fraction = index - below;
+        for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+            double value = smoothed[axis][below];
+            if(fraction > 0 && below + 1 < length){
+                value += (smoothed[axis][below + 1] - value) * fraction;
+            }
+            resampled[axis].push_back(value);
+            long steps = lround(value);
+            long delta = steps - last[axis];
+            if(delta < INT16_MIN || delta > INT16_MAX){
+                error = "A segment has too many steps. Use a shorter period or a larger time scale";
+                return false;
+            }
+            output.steps.push_back((int16_t)delta);
+            last[axis] = steps;
+        }
+    }
+    return checkRetimeLimits(resampled, periodMs, stepsPerUnit, options, error);
+}
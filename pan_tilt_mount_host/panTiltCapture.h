@@ -0,0 +1,64 @@
+#ifndef PANTILTCAPTURE_H
+#define PANTILTCAPTURE_H
+
+#include "panTiltLink.h"
+#include "panTiltTrajectory.h"
+#include <stdint.h>
+#include <string>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Records a live move, usually a joystick move, so it can be played again. ",20" starts the firmware sending the steps each axis moved every 20ms
+//(captureTask() in panTiltMount.cpp) whatever is moving the mount. The deltas are the ones a segment stream carries so a capture is saved as a
+//segment file and "pan_tilt_trajectory play" replays it to the step. retimeSegments() smooths and slows down or speeds up a capture for another
+//take or a timelapse. The firmware needs to be built with MOVE_CAPTURE (panTiltMount.h).
+//
+//The Nano hasn't the RAM to keep more than a couple of seconds of a move so the capture is streamed to the host rather than kept on the mount.
+
+#define CAPTURE_PERIOD_MS 20 //Default capture period
+#define CAPTURE_END_WAIT_MS 1000 //Time allowed for the last frame and the frame count after ",0"
+#define RETIME_ACCELERATION_WINDOW_MS 100 //The acceleration of a retimed move is measured over this long. A capture is whole steps every period so
+                                          //over one period it is mostly the rounding
+#define RETIME_LIMIT_TOLERANCE 1.01 //Same as the trajectory planner's
+
+class CaptureRecorder {
+public:
+    CaptureRecorder(void);
+
+    bool start(PanTiltLink &link, int periodMs = CAPTURE_PERIOD_MS); //Sends the instructions. The capture starts when the mount's reply is fed in
+    bool stop(PanTiltLink &link);
+    size_t feed(char *data, size_t length); //Takes the capture frames out of data received from the mount and returns how much of the rest is
+                                            //left at the start of data
+    bool recording(void) const { return _recording; }
+    bool finished(void) const { return _finished; } //The mount has sent the frame count after ",0"
+    bool complete(void) const { return _finished && _framesReported == stream().count(); } //No frame was lost
+    const SegmentStream &stream(void) const { return _stream; }
+
+private:
+    void line(const std::string &text);
+
+    SegmentStream _stream;
+    bool _recording;
+    bool _finished;
+    unsigned long _framesReported;
+    uint8_t _marker; //Binary frame being read. 0 if none
+    uint8_t _payload[SEGMENT_AXES * 2];
+    size_t _payloadLength;
+    size_t _payloadNeeded;
+    std::string _line;
+};
+
+struct RetimeOptions {
+    double timeScale; //Played this many times longer. 10 turns a 6s move into a minute for a timelapse
+    int smoothMs; //Moving average over this long. 0 = none. The move gets this much longer and eases in and out
+    int periodMs; //Segment period of the result. 0 = the capture's
+    AxisLimits limits[TRAJECTORY_AXES]; //The result must keep to the velocity and acceleration limits compile plans to. The jerk isn't checked
+    bool herringboneTilt;
+};
+
+void trimSegments(SegmentStream &stream); //Drops the segments where nothing moved before the move starts and after it ends
+
+//A capture with the same period, no smoothing and a time scale of 1 comes back step for step. It always starts and ends where the capture does.
+//Fails if the result goes over the limits, e.g. a fast capture played back quicker or with too little smoothing for a sudden stop
+bool retimeSegments(const SegmentStream &input, const RetimeOptions &options, SegmentStream &output, std::string &error);
+
+#endif
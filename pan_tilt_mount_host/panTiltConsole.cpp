@@ -0,0 +1,135 @@
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------
+ *
+ * Serial console for the mount built on PanTiltLink. Every line of standard input is sent as one instruction and everything the mount sends is
+ * printed. Works with a Nano on a USB serial port or the simulator's --pty:
+ *
+ *   ./build/pan_tilt_console /dev/ttyUSB0
+ *   printf 'm16\n#\nR\n' | ./build/pan_tilt_console --linger 500 /dev/pts/3
+ *
+ * Lines starting with "." are run by the console:
+ *
+ *  .jog SLIDER PAN TILT    Send a binary jog packet with the step speeds
+ *  .stats                  Print the link statistics
+ *
+ *--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#include "panTiltLink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+static std::atomic<bool> input_done(false);
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void printStats(PanTiltLink &link){
+    LinkStats stats = link.stats();
+    fprintf(stderr, "Frames sent: %lu\tBytes sent: %lu\tRejected: %lu\tBytes received: %lu\tOverflow: %lu\tQueue mean: %.0fus\tQueue max: %luus\n",
+        stats.framesSent, stats.bytesSent, stats.framesRejected, stats.bytesReceived, stats.rxOverflow,
+        stats.framesSent ? (double)stats.queueTotalUs / stats.framesSent : 0.0, stats.queueMaxUs);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void inputThread(PanTiltLink &link){ //Reads standard input in its own thread so printing what is received never waits for the keyboard
+    char line[128];
+    while(fgets(line, sizeof(line), stdin) != NULL){
+        size_t length = strcspn(line, "\r\n");
+        line[length] = '\0';
+        if(length == 0){
+            continue;
+        }
+        if(strncmp(line, ".jog", 4) == 0){
+            JogSpeeds speeds = {0, 0, 0};
+            int slider = 0, pan = 0, tilt = 0;
+            if(sscanf(line + 4, "%d %d %d", &slider, &pan, &tilt) != 3){
+                fprintf(stderr, "Usage: .jog SLIDER PAN TILT\n");
+                continue;
+            }
+            speeds.slider = slider;
+            speeds.pan = pan;
+            speeds.tilt = tilt;
+            link.sendJog(speeds);
+        }
+        else if(strcmp(line, ".stats") == 0){
+            printStats(link);
+        }
+        else if(!link.sendString(line)){
+            fprintf(stderr, "Error: unable to queue %s\n", line);
+        }
+    }
+    input_done = true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void usage(void){
+    fprintf(stderr, "Usage: pan_tilt_console [--baud N] [--gap-us N] [--linger MS] PORT\n"
+        "  --baud N       Baud rate (default %d)\n"
+        "  --gap-us N     Silence after each frame (default %d)\n"
+        "  --linger MS    Keep printing for MS milliseconds after the input ends (default 1000)\n", PAN_TILT_BAUD_RATE, PAN_TILT_FRAME_GAP_US);
+    exit(2);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main(int argc, char **argv){
+    long baud = PAN_TILT_BAUD_RATE;
+    long gapUs = PAN_TILT_FRAME_GAP_US;
+    int lingerMs = 1000;
+    const char *port = NULL;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--baud") == 0 && i + 1 < argc){
+            baud = atol(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--gap-us") == 0 && i + 1 < argc){
+            gapUs = atol(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--linger") == 0 && i + 1 < argc){
+            lingerMs = atoi(argv[++i]);
+        }
+        else if(argv[i][0] == '-' || port != NULL){
+            usage();
+        }
+        else{
+            port = argv[i];
+        }
+    }
+    if(port == NULL){
+        usage();
+    }
+
+    PanTiltLink link;
+    if(!link.open(port, baud)){
+        return 1;
+    }
+    link.setFrameGapUs(gapUs);
+    std::thread input(inputThread, std::ref(link));
+    input.detach(); //fgets() can't be interrupted so the thread is left to end with the process
+
+    char buffer[256];
+    uint64_t lingerEndUs = 0;
+    while(link.isOpen()){
+        if(link.waitReceive(50)){
+            size_t count = link.receive(buffer, sizeof(buffer));
+            fwrite(buffer, 1, count, stdout);
+            fflush(stdout);
+        }
+        if(input_done && link.drain(0)){
+            if(lingerEndUs == 0){
+                lingerEndUs = monotonicUs() + (uint64_t)lingerMs * 1000;
+            }
+            if(monotonicUs() >= lingerEndUs){
+                break;
+            }
+        }
+    }
+    if(!link.isOpen()){
+        fprintf(stderr, "Error: the serial port has closed\n");
+    }
+    printStats(link);
+    link.close();
+    return 0;
+}
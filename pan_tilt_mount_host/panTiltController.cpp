@@ -0,0 +1,123 @@
+#include "panTiltController.h"
+#include <math.h>
+#include <stdio.h>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+struct ButtonInstruction {
+    uint16_t button;
+    const char *name;
+    const char *instruction;
+};
+
+static const ButtonInstruction button_instructions[] = {
+    {UP_BUTTON, "Up", "@"}, //First element
+    {DOWN_BUTTON, "Down", "Z"}, //Last element
+    {LEFT_BUTTON, "Left", "<"}, //Step back
+    {RIGHT_BUTTON, "Right", ">"}, //Step forwards
+    {MENU_BUTTON, "Menu", "A"}, //Home
+    {VIEW_BUTTON, "View", ";1"}, //Execute
+    {L_BUTTON, "L", "m2"}, //Half step mode
+    {R_BUTTON, "R", "m16"}, //Sixteenth step mode
+    {LB_BUTTON, "LB", "D300"}, //Add delay of 300ms
+    {RB_BUTTON, "RB", "c"}, //Shutter
+    {A_BUTTON, "A", "#"}, //Save position
+    {B_BUTTON, "B", "C"}, //Clear array
+    {X_BUTTON, "X", "E"}, //Edit position
+    {Y_BUTTON, "Y", "R"}, //Status
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static float stickScale(float x, float y){ //Scales a stick's axes to -1 to 1 outside the dead zone. 0 inside it
+    float magnitude = sqrtf(x * x + y * y);
+    if(magnitude <= INPUT_DEADZONE){
+        return 0;
+    }
+    if(magnitude > 32767){ //Clip the magnitude at its expected maximum value
+        magnitude = 32767;
+    }
+    float normalizedMagnitude = magnitude / (32767 - INPUT_DEADZONE);
+    return normalizedMagnitude / magnitude;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+JogSpeeds stickJogSpeeds(const GamepadState &state){
+    float rightScale = stickScale(state.thumbRX, state.thumbRY);
+    float leftScale = stickScale(state.thumbLX, state.thumbLY);
+    float RX = state.thumbRX * rightScale;
+    float RY = state.thumbRY * rightScale;
+    float LX = state.thumbLX * leftScale;
+    JogSpeeds speeds;
+    speeds.slider = (int16_t)(LX * fabsf(LX) * MAXIMUM_SLIDER_STEP_SPEED);
+    speeds.pan = (int16_t)-(RX * fabsf(RX) * MAXIMUM_PAN_STEP_SPEED);
+    speeds.tilt = (int16_t)-(RY * fabsf(RY) * MAXIMUM_TILT_STEP_SPEED);
+    return speeds;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int triggerFeedOverride(const GamepadState &state){
+    int RT = (state.rightTrigger > TRIGGER_THRESHOLD) ? state.rightTrigger : 0;
+    int LT = (state.leftTrigger > TRIGGER_THRESHOLD) ? state.leftTrigger : 0;
+    int feedOverride = 100 + ((RT * 100) / 255) - ((LT * 90) / 255); //RT speeds playback up to 200%, LT slows it down to 10%
+    return (feedOverride / FEED_OVERRIDE_STEP) * FEED_OVERRIDE_STEP;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+PanTiltController::PanTiltController(PanTiltLink &link) : _link(link), _jogSender(NULL), _lastSpeeds(), _lastButtons(0), _lastFeedOverride(100),
+    _verbose(true) {}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void PanTiltController::setJogSender(JogSender *sender){
+    _jogSender = sender;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void PanTiltController::setVerbose(bool verbose){
+    _verbose = verbose;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltController::update(const GamepadState &state, uint64_t tag){
+    JogSpeeds speeds = stickJogSpeeds(state);
+    if(_verbose && speeds != _lastSpeeds){
+        printf("Jog slider: %d pan: %d tilt: %d\n", speeds.slider, speeds.pan, speeds.tilt);
+    }
+    _lastSpeeds = speeds;
+    bool queued = true;
+    if(_jogSender != NULL){
+        _jogSender->setSpeeds(speeds, tag);
+    }
+    else{
+        queued = _link.sendJog(speeds, tag);
+    }
+
+    int feedOverride = triggerFeedOverride(state);
+    if(feedOverride != _lastFeedOverride){
+        char data[10];
+        snprintf(data, sizeof(data), "%%%d", feedOverride);
+        if(_verbose){
+            printf("Feed override: %d%%\n", feedOverride);
+        }
+        _link.sendString(data);
+        _lastFeedOverride = feedOverride;
+    }
+
+    uint16_t pressed = state.buttons & ~_lastButtons;
+    for(size_t i = 0; i < sizeof(button_instructions) / sizeof(button_instructions[0]); i++){
+        if(pressed & button_instructions[i].button){
+            if(_verbose){
+                printf("%s: %s\n", button_instructions[i].name, button_instructions[i].instruction);
+            }
+            _link.sendString(button_instructions[i].instruction);
+        }
+    }
+    _lastButtons = state.buttons;
+    return queued;
+}
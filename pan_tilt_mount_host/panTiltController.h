@@ -0,0 +1,73 @@
+#ifndef PANTILTCONTROLLER_H
+#define PANTILTCONTROLLER_H
+
+#include "panTiltLink.h"
+#include "panTiltJogSender.h"
+#include <stdint.h>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Gamepad mapping shared by the controller apps. The input backends fill in a GamepadState with XInput's ranges and button bits and
+//PanTiltController turns the changes into instructions on the link:
+//
+//  Left stick X        Slider jog              Right stick         Pan and tilt jog
+//  RT / LT             Feed override up to 200% / down to 10%
+//  Up / Down           First / last keyframe   Left / Right        Step back / forwards
+//  Menu                Home                    View                Execute the keyframes once
+//  L / R stick click   Half / sixteenth step   LB                  Add a 300ms delay
+//  RB                  Shutter                 A                   Save position
+//  B                   Clear the keyframes     X                   Edit position
+//  Y                   Status
+
+#define UP_BUTTON 1
+#define DOWN_BUTTON 2
+#define LEFT_BUTTON 4
+#define RIGHT_BUTTON 8
+#define MENU_BUTTON 16
+#define VIEW_BUTTON 32
+#define L_BUTTON 64
+#define R_BUTTON 128
+#define LB_BUTTON 256
+#define RB_BUTTON 512
+#define A_BUTTON 4096
+#define B_BUTTON 8192
+#define X_BUTTON 16384
+#define Y_BUTTON 32768
+
+#define INPUT_DEADZONE 4000
+#define TRIGGER_THRESHOLD 30 //XINPUT_GAMEPAD_TRIGGER_THRESHOLD
+#define FEED_OVERRIDE_STEP 5 //The feed override is sent in 5% steps so it isn't sent for every small trigger movement
+
+struct GamepadState {
+    int16_t thumbLX; //-32768 to 32767, up and right are positive
+    int16_t thumbLY;
+    int16_t thumbRX;
+    int16_t thumbRY;
+    uint8_t leftTrigger; //0 to 255
+    uint8_t rightTrigger;
+    uint16_t buttons; //_BUTTON bits
+};
+
+JogSpeeds stickJogSpeeds(const GamepadState &state); //Step speeds for the sticks with a circular dead zone and a squared response
+int triggerFeedOverride(const GamepadState &state); //Feed override percentage for the triggers
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+class PanTiltController {
+public:
+    PanTiltController(PanTiltLink &link);
+
+    bool update(const GamepadState &state, uint64_t tag = 0); //Sends the jog speeds tagged with tag and whatever else has changed since the last
+                                                              //update. False if the jog speeds couldn't be queued
+    void setJogSender(JogSender *sender); //Hand the jog speeds to sender rather than sending a frame every update. NULL to send them directly
+    void setVerbose(bool verbose); //Print what is sent
+
+private:
+    PanTiltLink &_link;
+    JogSender *_jogSender;
+    JogSpeeds _lastSpeeds;
+    uint16_t _lastButtons;
+    int _lastFeedOverride;
+    bool _verbose;
+};
+
+#endif
@@ -0,0 +1,879 @@
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------
+ *
+ * Host daemon that owns the mount's serial port and shares it between local clients (a joystick, a shoot planner, a monitor...) over a Unix
+ * socket. Requests and replies are JSON-RPC 2.0, one object per line:
+ *
+ *   ./build/pan_tilt_daemon --port /dev/ttyUSB0 --socket /tmp/pan_tilt_mount.sock
+ *   echo '{"jsonrpc":"2.0","id":1,"method":"send","params":{"instruction":"p90"}}' | socat - UNIX-CONNECT:/tmp/pan_tilt_mount.sock
+ *
+ *  send {instruction, priority}        Queue an ASCII instruction. priority "normal" (default) or "bulk". Replied to once it is written to the link
+ *  upload {instructions}               Queue a list of instructions as bulk traffic, e.g. keyframes. Replied to after the last one
+ *                                      send and upload refuse the instructions that make the mount send binary (BINARY_INSTRUCTIONS) as
+ *                                      every client reads the mount's output as lines
+ *  jog {slider, pan, tilt}             Jog step speeds. Sent at a fixed rate with keepalives ahead of everything else and latest wins (see
+ *                                      panTiltJogSender.h). Set back to zero if the client that set them disconnects
+ *  stop                                Zero jog speeds and stop the job, ahead of everything else. Queued instructions are dropped and replied
+ *                                      to with an error
+ *  status {max_age_ms}                 Latest telemetry sample. Polls from every client are coalesced into one one-shot telemetry request
+ *  subscribe {output, telemetry_ms}    Notifications of every line the mount sends ("output") and of each telemetry sample ("telemetry"). The mount
+ *                                      sends telemetry at the shortest period any subscriber asks for. telemetry_ms 0 unsubscribes
+ *  stats                               Link, jog and queue counters
+ *
+ * Only one frame is handed to the link at a time so a jog or a stop never waits behind more than the frame being sent. Instructions are sent
+ * in priority order: stop, then normal instructions and status polls, then bulk.
+ *
+ *--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#include "panTiltJogSender.h"
+#include "panTiltJson.h"
+#include "panTiltLink.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#define DEFAULT_SOCKET_PATH "/tmp/pan_tilt_mount.sock"
+#define MOUNT_LINE_LENGTH 512 //Longer lines from the mount are split
+#define CLIENT_MAX_REQUEST 65536 //Longest request line
+#define CLIENT_MAX_BACKLOG 262144 //Notifications are dropped for a client that has this much unsent
+#define CLIENT_MAX_OUTPUT 4194304 //A client that has this much unsent is disconnected
+#define STATUS_MAX_AGE_MS 100 //A telemetry sample this recent answers a status poll without asking the mount
+#define STATUS_TIMEOUT_MS 1000
+#define TELEMETRY_MIN_MS 20
+
+#define INSTRUCTION_TELEMETRY_PERIOD '=' //panTiltMount.h. A negative period prints one line
+#define INSTRUCTION_JOB_STOP '!'
+#define BINARY_INSTRUCTIONS "$*,/&" //Log tokens, acks, capture, segments and trace dump. Their binary frames would be split as lines
+
+#define RPC_PARSE_ERROR -32700
+#define RPC_INVALID_REQUEST -32600
+#define RPC_METHOD_NOT_FOUND -32601
+#define RPC_INVALID_PARAMS -32602
+#define RPC_STOPPED -32000 //Dropped by a stop or by its client disconnecting
+#define RPC_TIMEOUT -32001
+
+enum Priority {
+    PRIORITY_URGENT,
+    PRIORITY_NORMAL,
+    PRIORITY_BULK,
+    PRIORITY_COUNT
+};
+
+struct Client {
+    int fd;
+    std::string in;
+    std::string out;
+    bool output; //Subscribed to the mount's output
+    int telemetryMs; //0 = not subscribed
+    unsigned long dropped; //Notifications dropped because it wasn't reading
+};
+
+struct QueuedInstruction {
+    std::string instruction;
+    unsigned long clientId; //0 = sent by the daemon
+    std::string replyId; //JSON id to reply to once sent. Empty for no reply
+};
+
+struct StatusWaiter {
+    unsigned long clientId;
+    std::string replyId;
+    uint64_t deadlineUs;
+};
+
+struct DaemonStats {
+    unsigned long requests;
+    unsigned long statusPolls; //status requests
+    unsigned long statusSent; //One-shot telemetry requests sent to the mount for them
+    unsigned long notifications;
+    unsigned long notificationsDropped;
+};
+
+static volatile sig_atomic_t stop_signal = 0;
+static int wake_fd = -1;
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+class WakeObserver : public LinkObserver { //Wakes the poll() when the link has sent a frame (room for the next one) or received data
+public:
+    void frameSent(const uint8_t*, size_t, uint64_t, uint64_t, uint64_t){
+        wake();
+    }
+
+    void dataReceived(const char*, size_t, uint64_t){
+        wake();
+    }
+
+    static void wake(void){
+        char byte = 0;
+        if(write(wake_fd, &byte, 1) < 0){} //A full pipe already wakes it
+    }
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void signalHandler(int){
+    stop_signal = 1;
+    WakeObserver::wake();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+class Daemon {
+public:
+    Daemon(PanTiltLink &link, JogSender &jogSender) : verbose(false), _link(link), _jogSender(jogSender), _nextClientId(1), _jogOwner(0), _telemetryMs(0),
+        _telemetryUs(0), _statusPending(false), _statusSentUs(0), _stats() {}
+
+    void accept(int listenFd);
+    void pollFds(std::vector<struct pollfd> &fds, std::vector<unsigned long> &ids);
+    void clientEvent(unsigned long id, short events);
+    void readMount(void);
+    void expireStatus(void);
+    void pump(void);
+    bool statusWaiting(void) const { return !_status.empty(); }
+    void shutdown(void);
+
+    bool verbose;
+
+private:
+    void disconnect(unsigned long id);
+    void request(unsigned long id, const char *line, size_t length);
+    void reply(unsigned long id, const std::string &replyId, const std::string &result);
+    void replyError(unsigned long id, const std::string &replyId, int code, const char *message);
+    void notify(Client &client, const char *method, const std::string &params);
+    void queue(Priority priority, const std::string &instruction, unsigned long id, const std::string &replyId);
+    void dropQueued(unsigned long id, bool all);
+    void setTelemetry(void);
+    void mountLine(const char *line, size_t length);
+    bool parseTelemetry(const char *line, size_t length);
+    std::string telemetryJson(void);
+    void stop(unsigned long id, const std::string &replyId);
+
+    void methodSend(unsigned long id, const std::string &replyId, const JsonValue *params);
+    void methodUpload(unsigned long id, const std::string &replyId, const JsonValue *params);
+    void methodJog(unsigned long id, const std::string &replyId, const JsonValue *params);
+    void methodStatus(unsigned long id, const std::string &replyId, const JsonValue *params);
+    void methodSubscribe(unsigned long id, const std::string &replyId, const JsonValue *params);
+    void methodStats(unsigned long id, const std::string &replyId);
+
+    PanTiltLink &_link;
+    JogSender &_jogSender;
+    std::map<unsigned long, Client> _clients;
+    unsigned long _nextClientId;
+    std::deque<QueuedInstruction> _queues[PRIORITY_COUNT];
+    unsigned long _jogOwner; //Client whose jog speeds are set. 0 when stopped
+    int _telemetryMs; //Period the mount has been asked for
+    std::vector<std::pair<std::string, double> > _telemetry; //Latest sample
+    uint64_t _telemetryUs;
+    std::vector<StatusWaiter> _status;
+    bool _statusPending; //A one-shot request has been queued and not answered
+    uint64_t _statusSentUs;
+    std::string _line; //Partial line from the mount
+    DaemonStats _stats;
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::accept(int listenFd){
+    int fd = ::accept(listenFd, NULL, NULL);
+    if(fd < 0){
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    Client client;
+    client.fd = fd;
+    client.output = false;
+    client.telemetryMs = 0;
+    client.dropped = 0;
+    unsigned long id = _nextClientId++;
+    _clients[id] = client;
+    if(verbose){
+        fprintf(stderr, "Client %lu connected\n", id);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::pollFds(std::vector<struct pollfd> &fds, std::vector<unsigned long> &ids){
+    for(std::map<unsigned long, Client>::iterator it = _clients.begin(); it != _clients.end(); ++it){
+        struct pollfd fd;
+        fd.fd = it->second.fd;
+        fd.events = POLLIN | (it->second.out.empty() ? 0 : POLLOUT);
+        fd.revents = 0;
+        fds.push_back(fd);
+        ids.push_back(it->first);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::clientEvent(unsigned long id, short events){
+    std::map<unsigned long, Client>::iterator it = _clients.find(id);
+    if(it == _clients.end()){
+        return;
+    }
+    Client &client = it->second;
+    if(events & POLLOUT){
+        ssize_t written = write(client.fd, client.out.data(), client.out.size());
+        if(written > 0){
+            client.out.erase(0, written);
+        }
+        else if(written < 0 && errno != EAGAIN && errno != EINTR){
+            disconnect(id);
+            return;
+        }
+    }
+    if(events & (POLLIN | POLLHUP | POLLERR)){
+        char buffer[4096];
+        ssize_t count = read(client.fd, buffer, sizeof(buffer));
+        if(count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)){
+            disconnect(id);
+            return;
+        }
+        if(count > 0){
+            client.in.append(buffer, count);
+        }
+        size_t start = 0;
+        size_t newline;
+        while((newline = client.in.find('\n', start)) != std::string::npos){
+            request(id, client.in.data() + start, newline - start); //Can't disconnect this client so client stays valid
+            start = newline + 1;
+        }
+        client.in.erase(0, start);
+        if(client.in.size() > CLIENT_MAX_REQUEST){
+            replyError(id, "null", RPC_INVALID_REQUEST, "Request too long");
+            client.in.clear();
+        }
+    }
+    if(client.out.size() > CLIENT_MAX_OUTPUT){
+        fprintf(stderr, "Client %lu isn't reading. Disconnecting it\n", id);
+        disconnect(id);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::disconnect(unsigned long id){
+    std::map<unsigned long, Client>::iterator it = _clients.find(id);
+    if(it == _clients.end()){
+        return;
+    }
+    close(it->second.fd);
+    bool subscribed = it->second.telemetryMs > 0;
+    _clients.erase(it);
+    if(_jogOwner == id){ //Don't leave the mount moving for a client that has gone
+        JogSpeeds zero = {0, 0, 0};
+        _jogSender.setSpeeds(zero);
+        _jogOwner = 0;
+    }
+    dropQueued(id, false);
+    if(subscribed){
+        setTelemetry();
+    }
+    if(verbose){
+        fprintf(stderr, "Client %lu disconnected\n", id);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::reply(unsigned long id, const std::string &replyId, const std::string &result){
+    std::map<unsigned long, Client>::iterator it = _clients.find(id);
+    if(it == _clients.end() || replyId.empty()){
+        return;
+    }
+    it->second.out += "{\"jsonrpc\":\"2.0\",\"id\":" + replyId + ",\"result\":" + result + "}\n";
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::replyError(unsigned long id, const std::string &replyId, int code, const char *message){
+    std::map<unsigned long, Client>::iterator it = _clients.find(id);
+    if(it == _clients.end() || replyId.empty()){
+        return;
+    }
+    std::string error = "{\"jsonrpc\":\"2.0\",\"id\":" + replyId + ",\"error\":{\"code\":";
+    writeJsonNumber(code, error);
+    error += ",\"message\":";
+    writeJsonString(message, strlen(message), error);
+    error += "}}\n";
+    it->second.out += error;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::notify(Client &client, const char *method, const std::string &params){
+    _stats.notifications++;
+    if(client.out.size() > CLIENT_MAX_BACKLOG){ //Newer notifications will replace it so it's better lost than queued
+        client.dropped++;
+        _stats.notificationsDropped++;
+        return;
+    }
+    client.out += "{\"jsonrpc\":\"2.0\",\"method\":\"";
+    client.out += method;
+    client.out += "\",\"params\":" + params + "}\n";
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::request(unsigned long id, const char *line, size_t length){
+    while(length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ')){
+        length--;
+    }
+    if(length == 0){
+        return;
+    }
+    _stats.requests++;
+    JsonValue message;
+    if(!parseJson(line, length, message)){
+        replyError(id, "null", RPC_PARSE_ERROR, "Parse error");
+        return;
+    }
+    const JsonValue *idValue = message.get("id");
+    std::string replyId; //Left empty for a notification, which gets no reply
+    if(idValue != NULL){
+        writeJson(*idValue, replyId);
+    }
+    const JsonValue *method = message.get("method");
+    if(method == NULL || !method->isString()){
+        replyError(id, replyId.empty() ? "null" : replyId, RPC_INVALID_REQUEST, "Invalid request");
+        return;
+    }
+    const JsonValue *params = message.get("params");
+    const std::string &name = method->string;
+    if(name == "send"){
+        methodSend(id, replyId, params);
+    }
+    else if(name == "upload"){
+        methodUpload(id, replyId, params);
+    }
+    else if(name == "jog"){
+        methodJog(id, replyId, params);
+    }
+    else if(name == "stop"){
+        stop(id, replyId);
+    }
+    else if(name == "status"){
+        methodStatus(id, replyId, params);
+    }
+    else if(name == "subscribe"){
+        methodSubscribe(id, replyId, params);
+    }
+    else if(name == "stats"){
+        methodStats(id, replyId);
+    }
+    else{
+        replyError(id, replyId, RPC_METHOD_NOT_FOUND, "Method not found");
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool validInstruction(const JsonValue *value){
+    if(value == NULL || !value->isString() || value->string.empty() || value->string.size() > PAN_TILT_MAX_FRAME ||
+        strchr(BINARY_INSTRUCTIONS, value->string[0]) != NULL){
+        return false;
+    }
+    for(size_t i = 0; i < value->string.size(); i++){
+        unsigned char c = value->string[i];
+        if(c < ' ' || c == 0x7F){ //Also keeps out the binary jog frame's marker and newlines
+            return false;
+        }
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::methodSend(unsigned long id, const std::string &replyId, const JsonValue *params){
+    const JsonValue *instruction = params != NULL ? params->get("instruction") : NULL;
+    const JsonValue *priority = params != NULL ? params->get("priority") : NULL;
+    if(!validInstruction(instruction) || (priority != NULL && (!priority->isString() || (priority->string != "normal" && priority->string != "bulk")))){
+        replyError(id, replyId, RPC_INVALID_PARAMS, "Expected a text instruction of 1 to 32 characters that isn't one of " BINARY_INSTRUCTIONS
+            " and a priority of normal or bulk");
+        return;
+    }
+    queue((priority != NULL && priority->string == "bulk") ? PRIORITY_BULK : PRIORITY_NORMAL, instruction->string, id, replyId);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::methodUpload(unsigned long id, const std::string &replyId, const JsonValue *params){
+    const JsonValue *instructions = params != NULL ? params->get("instructions") : NULL;
+    bool valid = instructions != NULL && instructions->type == JSON_ARRAY && !instructions->items.empty();
+    for(size_t i = 0; valid && i < instructions->items.size(); i++){
+        valid = validInstruction(&instructions->items[i]);
+    }
+    if(!valid){
+        replyError(id, replyId, RPC_INVALID_PARAMS, "Expected a list of text instructions of 1 to 32 characters that aren't one of "
+            BINARY_INSTRUCTIONS);
+        return;
+    }
+    for(size_t i = 0; i < instructions->items.size(); i++){
+        queue(PRIORITY_BULK, instructions->items[i].string, id, (i + 1 == instructions->items.size()) ? replyId : std::string());
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static int16_t jogParam(const JsonValue *params, const char *name, double maximum){
+    const JsonValue *value = params != NULL ? params->get(name) : NULL;
+    if(value == NULL || !value->isNumber()){
+        return 0;
+    }
+    double speed = value->number;
+    speed = speed > maximum ? maximum : (speed < -maximum ? -maximum : speed);
+    return (int16_t)speed;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::methodJog(unsigned long id, const std::string &replyId, const JsonValue *params){
+    JogSpeeds speeds;
+    speeds.slider = jogParam(params, "slider", MAXIMUM_SLIDER_STEP_SPEED);
+    speeds.pan = jogParam(params, "pan", MAXIMUM_PAN_STEP_SPEED);
+    speeds.tilt = jogParam(params, "tilt", MAXIMUM_TILT_STEP_SPEED);
+    _jogSender.setSpeeds(speeds, monotonicUs());
+    bool moving = speeds.slider != 0 || speeds.pan != 0 || speeds.tilt != 0;
+    _jogOwner = moving ? id : 0;
+    reply(id, replyId, "true");
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::stop(unsigned long id, const std::string &replyId){ //Replied to once the job stop has been written
+    JogSpeeds zero = {0, 0, 0};
+    _jogSender.setSpeeds(zero); //So a keepalive doesn't send the old speeds again
+    _link.postJog(zero); //Now rather than at the next tick
+    _jogOwner = 0;
+    dropQueued(0, true);
+    char instruction[2] = {INSTRUCTION_JOB_STOP, '\0'};
+    queue(PRIORITY_URGENT, instruction, id, replyId);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::methodStatus(unsigned long id, const std::string &replyId, const JsonValue *params){
+    _stats.statusPolls++;
+    const JsonValue *maxAge = params != NULL ? params->get("max_age_ms") : NULL;
+    double maxAgeMs = (maxAge != NULL && maxAge->isNumber()) ? maxAge->number : STATUS_MAX_AGE_MS;
+    uint64_t nowUs = monotonicUs();
+    if(!_telemetry.empty() && (nowUs - _telemetryUs) <= maxAgeMs * 1000){
+        reply(id, replyId, telemetryJson());
+        return;
+    }
+    StatusWaiter waiter = {id, replyId, nowUs + STATUS_TIMEOUT_MS * 1000ULL};
+    _status.push_back(waiter);
+    if(!_statusPending){ //Every poll waiting now is answered by the same line
+        char instruction[4];
+        snprintf(instruction, sizeof(instruction), "%c-1", INSTRUCTION_TELEMETRY_PERIOD);
+        queue(PRIORITY_NORMAL, instruction, 0, std::string());
+        _statusPending = true;
+        _statusSentUs = nowUs;
+        _stats.statusSent++;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::methodSubscribe(unsigned long id, const std::string &replyId, const JsonValue *params){
+    Client &client = _clients[id];
+    const JsonValue *output = params != NULL ? params->get("output") : NULL;
+    const JsonValue *telemetryMs = params != NULL ? params->get("telemetry_ms") : NULL;
+    if(output != NULL){
+        client.output = (output->type == JSON_BOOL && output->boolean);
+    }
+    if(telemetryMs != NULL && telemetryMs->isNumber()){
+        int period = (int)telemetryMs->number;
+        client.telemetryMs = (period <= 0) ? 0 : (period < TELEMETRY_MIN_MS ? TELEMETRY_MIN_MS : period);
+        setTelemetry();
+    }
+    std::string result = "{\"output\":";
+    result += client.output ? "true" : "false";
+    result += ",\"telemetry_ms\":";
+    writeJsonNumber(_telemetryMs, result);
+    result += "}";
+    reply(id, replyId, result);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::methodStats(unsigned long id, const std::string &replyId){
+    LinkStats link = _link.stats();
+    JogSenderStats jog = _jogSender.stats();
+    char result[768];
+    snprintf(result, sizeof(result), "{\"clients\":%lu,\"requests\":%lu,\"queued\":{\"urgent\":%lu,\"normal\":%lu,\"bulk\":%lu},"
+        "\"status_polls\":%lu,\"status_sent\":%lu,\"notifications\":%lu,\"notifications_dropped\":%lu,"
+        "\"frames_sent\":%lu,\"bytes_sent\":%lu,\"bytes_received\":%lu,\"queue_max_us\":%lu,"
+        "\"jog_inputs\":%lu,\"jog_coalesced\":%lu,\"jog_sent\":%lu,\"jog_keepalives\":%lu}",
+        (unsigned long)_clients.size(), _stats.requests, (unsigned long)_queues[PRIORITY_URGENT].size(), (unsigned long)_queues[PRIORITY_NORMAL].size(),
+        (unsigned long)_queues[PRIORITY_BULK].size(), _stats.statusPolls, _stats.statusSent, _stats.notifications, _stats.notificationsDropped,
+        link.framesSent, link.bytesSent, link.bytesReceived, link.queueMaxUs, jog.inputs, jog.coalesced, jog.sent, jog.keepalives);
+    reply(id, replyId, result);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::queue(Priority priority, const std::string &instruction, unsigned long id, const std::string &replyId){
+    QueuedInstruction queued = {instruction, id, replyId};
+    _queues[priority].push_back(queued);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::dropQueued(unsigned long id, bool all){ //Drops a client's queued instructions, or everyone's
+    for(int priority = PRIORITY_NORMAL; priority < PRIORITY_COUNT; priority++){
+        std::deque<QueuedInstruction> kept;
+        for(size_t i = 0; i < _queues[priority].size(); i++){
+            QueuedInstruction &queued = _queues[priority][i];
+            if(queued.clientId == 0 || (!all && queued.clientId != id)){ //The daemon's own instructions (status polls and telemetry) are kept
+                kept.push_back(queued);
+            }
+            else{
+                replyError(queued.clientId, queued.replyId, RPC_STOPPED, "Stopped");
+            }
+        }
+        _queues[priority].swap(kept);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::setTelemetry(void){ //Asks the mount for the shortest period any subscriber wants
+    int period = 0;
+    for(std::map<unsigned long, Client>::iterator it = _clients.begin(); it != _clients.end(); ++it){
+        int clientMs = it->second.telemetryMs;
+        if(clientMs > 0 && (period == 0 || clientMs < period)){
+            period = clientMs;
+        }
+    }
+    if(period == _telemetryMs){
+        return;
+    }
+    _telemetryMs = period;
+    char instruction[16];
+    snprintf(instruction, sizeof(instruction), "%c%d", INSTRUCTION_TELEMETRY_PERIOD, period);
+    queue(PRIORITY_NORMAL, instruction, 0, std::string());
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::pump(void){ //Hands the next instruction to the link once it has nothing queued
+    while(_link.queuedBytes() == 0){
+        int priority = 0;
+        while(priority < PRIORITY_COUNT && _queues[priority].empty()){
+            priority++;
+        }
+        if(priority == PRIORITY_COUNT){
+            return;
+        }
+        QueuedInstruction queued = _queues[priority].front();
+        _queues[priority].pop_front();
+        if(_link.sendString(queued.instruction.c_str())){
+            reply(queued.clientId, queued.replyId, "true");
+        }
+        else{
+            replyError(queued.clientId, queued.replyId, RPC_INVALID_PARAMS, "Rejected by the link");
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::readMount(void){
+    char buffer[512];
+    size_t count;
+    while((count = _link.receive(buffer, sizeof(buffer))) > 0){
+        for(size_t i = 0; i < count; i++){
+            char c = buffer[i];
+            if(c == '\n' || _line.size() >= MOUNT_LINE_LENGTH){
+                mountLine(_line.data(), _line.size());
+                _line.clear();
+            }
+            if(c != '\n' && c != '\r'){
+                _line += c;
+            }
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool Daemon::parseTelemetry(const char *line, size_t length){ //"Pan: 1.000º\tTilt: 2.000º\t...\tBattery: 12.000V"
+    std::string text(line, length);
+    if(text.compare(0, 5, "Pan: ") != 0 || text.find("Battery: ") == std::string::npos){
+        return false;
+    }
+    _telemetry.clear();
+    size_t start = 0;
+    while(start < text.size()){
+        size_t end = text.find('\t', start);
+        if(end == std::string::npos){
+            end = text.size();
+        }
+        size_t colon = text.find(": ", start);
+        if(colon != std::string::npos && colon < end){
+            std::string name = text.substr(start, colon - start);
+            for(size_t i = 0; i < name.size(); i++){
+                name[i] = (name[i] >= 'A' && name[i] <= 'Z') ? name[i] - 'A' + 'a' : name[i];
+            }
+            _telemetry.push_back(std::make_pair(name, strtod(text.c_str() + colon + 2, NULL)));
+        }
+        start = end + 1;
+    }
+    _telemetryUs = monotonicUs();
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+std::string Daemon::telemetryJson(void){
+    std::string json = "{\"age_ms\":";
+    writeJsonNumber((double)((monotonicUs() - _telemetryUs) / 1000), json);
+    for(size_t i = 0; i < _telemetry.size(); i++){
+        json += ',';
+        writeJsonString(_telemetry[i].first.data(), _telemetry[i].first.size(), json);
+        json += ':';
+        writeJsonNumber(_telemetry[i].second, json);
+    }
+    json += '}';
+    return json;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::mountLine(const char *line, size_t length){
+    if(parseTelemetry(line, length)){
+        _statusPending = false;
+        std::string sample = telemetryJson();
+        for(size_t i = 0; i < _status.size(); i++){
+            reply(_status[i].clientId, _status[i].replyId, sample);
+        }
+        _status.clear();
+        for(std::map<unsigned long, Client>::iterator it = _clients.begin(); it != _clients.end(); ++it){
+            if(it->second.telemetryMs > 0){
+                notify(it->second, "telemetry", sample);
+            }
+        }
+        return;
+    }
+    std::string params = "{\"text\":";
+    writeJsonString(line, length, params);
+    params += '}';
+    for(std::map<unsigned long, Client>::iterator it = _clients.begin(); it != _clients.end(); ++it){
+        if(it->second.output){
+            notify(it->second, "output", params);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::expireStatus(void){
+    uint64_t nowUs = monotonicUs();
+    if(_statusPending && nowUs - _statusSentUs > STATUS_TIMEOUT_MS * 1000ULL){
+        _statusPending = false; //Lost. The next poll asks again
+    }
+    std::vector<StatusWaiter> waiting;
+    for(size_t i = 0; i < _status.size(); i++){
+        if(nowUs >= _status[i].deadlineUs){
+            replyError(_status[i].clientId, _status[i].replyId, RPC_TIMEOUT, "No telemetry from the mount");
+        }
+        else{
+            waiting.push_back(_status[i]);
+        }
+    }
+    _status.swap(waiting);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Daemon::shutdown(void){
+    while(!_clients.empty()){
+        disconnect(_clients.begin()->first);
+    }
+    _jogSender.stop();
+    for(int priority = PRIORITY_URGENT; priority < PRIORITY_COUNT; priority++){
+        _queues[priority].clear();
+    }
+    if(_telemetryMs != 0){
+        char instruction[4];
+        snprintf(instruction, sizeof(instruction), "%c0", INSTRUCTION_TELEMETRY_PERIOD);
+        _link.sendString(instruction);
+    }
+    _link.drain(1000);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static int listenSocket(const char *path){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address.sun_path)){
+        fprintf(stderr, "Error: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0){
+        perror("socket");
+        return -1;
+    }
+    if(connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0){
+        fprintf(stderr, "Error: a daemon is already listening on %s\n", path);
+        close(fd);
+        return -1;
+    }
+    unlink(path); //Left behind by a daemon that didn't exit cleanly
+    if(bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 16) != 0){
+        fprintf(stderr, "Error: unable to listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void usage(void){
+    fprintf(stderr, "Usage: pan_tilt_daemon --port PORT [options]\n"
+        "  --port PORT          Serial port of the mount\n"
+        "  --socket PATH        Unix socket to listen on (default %s)\n"
+        "  --baud N             Baud rate (default %d)\n"
+        "  --gap-us N           Silence after each frame (default %d)\n"
+        "  --rate HZ            Jog frames a second (default %d)\n"
+        "  --keepalive MS       Resend the jog speeds this often while moving. 0 turns the keepalives and the firmware's timeout off (default %d)\n"
+        "  --verbose            Log the clients connecting\n", DEFAULT_SOCKET_PATH, PAN_TILT_BAUD_RATE, PAN_TILT_FRAME_GAP_US, JOG_SEND_RATE_HZ,
+        JOG_KEEPALIVE_MS);
+    exit(2);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main(int argc, char **argv){
+    const char *port = NULL;
+    const char *socketPath = DEFAULT_SOCKET_PATH;
+    long baud = PAN_TILT_BAUD_RATE;
+    long gapUs = PAN_TILT_FRAME_GAP_US;
+    int rateHz = JOG_SEND_RATE_HZ;
+    int keepaliveMs = JOG_KEEPALIVE_MS;
+    bool verbose = false;
+    for(int i = 1; i < argc; i++){
+        const char *option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(strcmp(option, "--port") == 0 && hasValue){
+            port = argv[++i];
+        }
+        else if(strcmp(option, "--socket") == 0 && hasValue){
+            socketPath = argv[++i];
+        }
+        else if(strcmp(option, "--baud") == 0 && hasValue){
+            baud = atol(argv[++i]);
+        }
+        else if(strcmp(option, "--gap-us") == 0 && hasValue){
+            gapUs = atol(argv[++i]);
+        }
+        else if(strcmp(option, "--rate") == 0 && hasValue){
+            rateHz = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--keepalive") == 0 && hasValue){
+            keepaliveMs = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--verbose") == 0){
+            verbose = true;
+        }
+        else{
+            usage();
+        }
+    }
+    if(port == NULL || rateHz <= 0){
+        usage();
+    }
+
+    int wakePipe[2];
+    if(pipe(wakePipe) != 0){
+        perror("pipe");
+        return 1;
+    }
+    for(int i = 0; i < 2; i++){
+        fcntl(wakePipe[i], F_SETFL, fcntl(wakePipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(wakePipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    wake_fd = wakePipe[1];
+    signal(SIGPIPE, SIG_IGN); //A client closing its socket shows up as a write error instead
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = signalHandler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    WakeObserver observer;
+    PanTiltLink link;
+    link.setObserver(&observer);
+    if(!link.open(port, baud)){
+        return 1;
+    }
+    link.setFrameGapUs(gapUs);
+    int listenFd = listenSocket(socketPath);
+    if(listenFd < 0){
+        return 1;
+    }
+    fprintf(stderr, "Listening on %s\n", socketPath);
+    JogSender jogSender(link);
+    jogSender.start(rateHz, keepaliveMs);
+    Daemon daemon(link, jogSender);
+    daemon.verbose = verbose;
+
+    while(!stop_signal && link.isOpen()){
+        std::vector<struct pollfd> fds(2);
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakePipe[0];
+        fds[1].events = POLLIN;
+        std::vector<unsigned long> ids(2, 0);
+        daemon.pollFds(fds, ids);
+        int timeoutMs = daemon.statusWaiting() ? 50 : -1;
+        if(poll(&fds[0], fds.size(), timeoutMs) < 0 && errno != EINTR){
+            perror("poll");
+            break;
+        }
+        if(fds[1].revents & POLLIN){
+            char drain[64];
+            while(read(wakePipe[0], drain, sizeof(drain)) > 0){}
+        }
+        daemon.readMount();
+        if(fds[0].revents & POLLIN){
+            daemon.accept(listenFd);
+        }
+        for(size_t i = 2; i < fds.size(); i++){
+            if(fds[i].revents != 0){
+                daemon.clientEvent(ids[i], fds[i].revents);
+            }
+        }
+        daemon.expireStatus();
+        daemon.pump();
+    }
+    if(!link.isOpen()){
+        fprintf(stderr, "Serial port closed\n");
+    }
+
+    daemon.shutdown();
+    jogSender.report(stderr);
+    close(listenFd);
+    unlink(socketPath);
+    link.close();
+    return 0;
+}
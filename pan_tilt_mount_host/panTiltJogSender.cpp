@@ -0,0 +1,136 @@
+#include "panTiltJogSender.h"
+#include <chrono>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool isMoving(const JogSpeeds &speeds){
+    return speeds.slider != 0 || speeds.pan != 0 || speeds.tilt != 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+JogSender::JogSender(PanTiltLink &link) : _link(link), _running(false), _periodUs(1000000 / JOG_SEND_RATE_HZ), _keepaliveUs(JOG_KEEPALIVE_MS * 1000),
+    _latest(), _latestTag(0), _changed(false), _stats(), _startUs(monotonicUs()), _startLink(link.stats()) {}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+JogSender::~JogSender(void){
+    stop();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void JogSender::start(int rateHz, int keepaliveMs){
+    stop();
+    _periodUs = 1000000 / (rateHz > 0 ? rateHz : JOG_SEND_RATE_HZ);
+    _keepaliveUs = keepaliveMs * 1000;
+    _stats = JogSenderStats();
+    _startUs = monotonicUs();
+    _startLink = _link.stats();
+    if(_keepaliveUs > 0){
+        char instruction[16];
+        snprintf(instruction, sizeof(instruction), "%c%d", INSTRUCTION_JOG_TIMEOUT, keepaliveMs * JOG_TIMEOUT_KEEPALIVES);
+        _link.sendString(instruction);
+    }
+    _running = true;
+    _thread = std::thread(&JogSender::run, this);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void JogSender::stop(void){
+    if(!_thread.joinable()){
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _stopped.notify_all();
+    _thread.join();
+    JogSpeeds zero = {0, 0, 0};
+    _link.postJog(zero); //Never leave the mount moving
+    if(_keepaliveUs > 0){
+        char instruction[4];
+        snprintf(instruction, sizeof(instruction), "%c0", INSTRUCTION_JOG_TIMEOUT);
+        _link.sendString(instruction);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void JogSender::setSpeeds(const JogSpeeds &speeds, uint64_t tag){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.inputs++;
+    if(_changed){
+        _stats.coalesced++;
+    }
+    else{
+        _latestTag = tag; //The latency is measured from the first input the tick sends
+    }
+    _latest = speeds;
+    _changed = true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+JogSenderStats JogSender::stats(void){
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void JogSender::report(FILE *out){
+    JogSenderStats jog = stats();
+    LinkStats link = _link.stats();
+    double seconds = (monotonicUs() - _startUs) / 1000000.0;
+    unsigned long bytes = link.bytesSent - _startLink.bytesSent;
+    double capacity = _link.baud() / 10.0 * seconds; //Bytes the link could have carried (8N1)
+    fprintf(out, "Jog: %lu inputs\t%lu coalesced\t%lu unchanged\t%lu sent\t%lu keepalives\t%lu replaced in the link\n", jog.inputs, jog.coalesced,
+        jog.unchanged, jog.sent, jog.keepalives, link.jogsReplaced - _startLink.jogsReplaced);
+    fprintf(out, "Link: %.1f frames/s\t%.0f bytes/s\t%.1f%% used\tQueue max: %luus\n", seconds > 0 ? (link.framesSent - _startLink.framesSent) / seconds : 0,
+        seconds > 0 ? bytes / seconds : 0, capacity > 0 ? 100.0 * bytes / capacity : 0, link.queueMaxUs);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void JogSender::run(void){
+    JogSpeeds lastSent = {0, 0, 0};
+    uint64_t lastSentUs = monotonicUs();
+    std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(_running){
+        nextTick += std::chrono::microseconds(_periodUs);
+        if(_stopped.wait_until(lock, nextTick, [this]{ return !_running; })){
+            break;
+        }
+        if(std::chrono::steady_clock::now() > nextTick + std::chrono::microseconds(_periodUs)){ //Fell behind. Don't send a burst to catch up
+            nextTick = std::chrono::steady_clock::now();
+        }
+        _stats.ticks++;
+        JogSpeeds speeds = _latest;
+        uint64_t tag = _latestTag;
+        bool changed = _changed;
+        _changed = false;
+        uint64_t nowUs = monotonicUs();
+        if(speeds != lastSent){
+            _stats.sent++;
+        }
+        else if(isMoving(speeds) && _keepaliveUs > 0 && nowUs - lastSentUs >= (uint64_t)_keepaliveUs){
+            _stats.keepalives++;
+            tag = 0; //Not an input so it isn't counted in the input latency
+        }
+        else{
+            if(changed){
+                _stats.unchanged++;
+            }
+            continue;
+        }
+        lock.unlock();
+        _link.postJog(speeds, tag);
+        lock.lock();
+        lastSent = speeds;
+        lastSentUs = nowUs;
+    }
+}
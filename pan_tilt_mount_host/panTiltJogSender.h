@@ -0,0 +1,62 @@
+#ifndef PANTILTJOGSENDER_H
+#define PANTILTJOGSENDER_H
+
+#include "panTiltLink.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Sends the jog speeds at a fixed rate however often the input changes. Every tick the latest speeds from setSpeeds() are posted to the link's
+//jog slot if they differ from the last ones sent. While the mount is moving the speeds are sent again every keepalive period so the firmware's
+//jog timeout (set with INSTRUCTION_JOG_TIMEOUT when keepalives are on) only stops it if the host has gone. The jog traffic is at most
+//rateHz * JOG_FRAME_LENGTH bytes a second.
+
+#define JOG_SEND_RATE_HZ 50
+#define JOG_KEEPALIVE_MS 250 //0 = no keepalives and no firmware timeout
+#define JOG_TIMEOUT_KEEPALIVES 4 //The firmware stops a jog after this many keepalive periods without one
+
+#define INSTRUCTION_JOG_TIMEOUT 'z' //panTiltMount.h
+
+struct JogSenderStats {
+    unsigned long ticks;
+    unsigned long inputs; //setSpeeds() calls
+    unsigned long coalesced; //Inputs replaced by a newer one before a tick
+    unsigned long unchanged; //Ticks with new input that gave the speeds already sent
+    unsigned long sent; //Changed speeds posted
+    unsigned long keepalives;
+};
+
+class JogSender {
+public:
+    JogSender(PanTiltLink &link);
+    ~JogSender(void);
+
+    void start(int rateHz = JOG_SEND_RATE_HZ, int keepaliveMs = JOG_KEEPALIVE_MS);
+    void stop(void); //Posts zero speeds, turns the firmware's jog timeout off and stops the thread
+
+    void setSpeeds(const JogSpeeds &speeds, uint64_t tag = 0); //Thread safe. Only the latest speeds before each tick are sent
+    JogSenderStats stats(void);
+    void report(FILE *out); //Jog and link traffic since start()
+
+private:
+    void run(void);
+
+    PanTiltLink &_link;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _stopped;
+    bool _running;
+    int _periodUs;
+    int _keepaliveUs;
+    JogSpeeds _latest;
+    uint64_t _latestTag; //Tag of the oldest input since the last tick
+    bool _changed;
+    JogSenderStats _stats;
+    uint64_t _startUs;
+    LinkStats _startLink;
+};
+
+#endif
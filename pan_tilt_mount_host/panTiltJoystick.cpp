@@ -0,0 +1,305 @@
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------
+ *
+ * Linux controller app. Reads a gamepad through evdev and drives the mount with the same mapping as the Xbox controller app. The gamepad, the
+ * data received from the mount and the signals are all waited on with one epoll so a stick event is handled as soon as the kernel has it.
+ *
+ *   ./build/pan_tilt_joystick --port /dev/ttyUSB0
+ *   ./build/pan_tilt_joystick --port /dev/ttyUSB0 --device /dev/input/event5 --latency --quiet
+ *
+ * --latency turns the firmware's jog acks on and prints the latency percentiles from stick event to acknowledged speed change on exit (see
+ * panTiltLatency.h). It can be tried without a gamepad or /dev/uinput against the simulator:
+ *
+ *   mkfifo /tmp/pad
+ *   ./build/pan_tilt_virtual_pad --fifo /tmp/pad < sweep.txt &
+ *   ./build/pan_tilt_joystick --port /dev/pts/N --device /tmp/pad --latency --quiet
+ *
+ * The jog speeds are sent by a JogSender at --rate a second (see panTiltJogSender.h) however fast the gamepad reports, with keepalives while the
+ * mount is moving so the firmware stops it if this app or the port goes away. --rate 0 sends a jog frame for every gamepad report instead.
+ *
+ * --record captures the move from start to exit (see panTiltCapture.h) and saves it as a segment file without the still time at either end. It
+ * plays back exactly with "pan_tilt_trajectory play" or smoothed and slowed down after "pan_tilt_trajectory retime". It needs the firmware built
+ * with MOVE_CAPTURE.
+ *
+ *--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#include "evdevGamepad.h"
+#include "panTiltCapture.h"
+#include "panTiltController.h"
+#include "panTiltJogSender.h"
+#include "panTiltLatency.h"
+#include "panTiltLink.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+#define EXIT_ACK_WAIT_MS 500 //Time left for the last acks to arrive before the report
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+class JoystickObserver : public LatencyRecorder { //Records the latency when it's turned on and wakes the epoll when data arrives
+public:
+    JoystickObserver(void) : latency(false), wakeFd(-1) {}
+
+    void frameSent(const uint8_t *frame, size_t length, uint64_t tag, uint64_t queuedUs, uint64_t sentUs){
+        if(latency){
+            LatencyRecorder::frameSent(frame, length, tag, queuedUs, sentUs);
+        }
+    }
+
+    void dataReceived(const char *data, size_t length, uint64_t receivedUs){
+        if(latency){
+            LatencyRecorder::dataReceived(data, length, receivedUs);
+        }
+        char byte = 0;
+        if(write(wakeFd, &byte, 1) < 0){} //A full pipe already wakes it
+    }
+
+    bool latency;
+    int wakeFd;
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void printReceived(PanTiltLink &link, CaptureRecorder &recorder){ //Prints what the mount has sent without the jog acks and capture frames
+    char buffer[256];
+    size_t count;
+    while((count = link.receive(buffer, sizeof(buffer))) > 0){
+        count = recorder.feed(buffer, count);
+        size_t kept = 0;
+        for(size_t i = 0; i < count; i++){
+            if(buffer[i] != JOG_ACK && buffer[i] != JOG_NAK){
+                buffer[kept++] = buffer[i];
+            }
+        }
+        fwrite(buffer, 1, kept, stdout);
+    }
+    fflush(stdout);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void usage(void){
+    fprintf(stderr, "Usage: pan_tilt_joystick --port PORT [options]\n"
+        "  --port PORT          Serial port of the mount\n"
+        "  --device PATH        evdev device or input_event FIFO (default the first gamepad in /dev/input)\n"
+        "  --baud N             Baud rate (default %d)\n"
+        "  --gap-us N           Silence after each frame (default %d)\n"
+        "  --rate HZ            Jog frames a second. 0 sends one for every gamepad report (default %d)\n"
+        "  --keepalive MS       Resend the jog speeds this often while moving. 0 turns the keepalives and the firmware's timeout off (default %d)\n"
+        "  --stats SECONDS      Print the jog and link traffic this often\n"
+        "  --latency            Turn the jog acks on and report the control latency on exit\n"
+        "  --latency-json FILE  Also write the latency report to FILE as JSON\n"
+        "  --record FILE        Capture the move and save it to FILE as segments\n"
+        "  --capture-period MS  Capture period (default %d)\n"
+        "  --quiet              Don't print what is sent\n", PAN_TILT_BAUD_RATE, PAN_TILT_FRAME_GAP_US,
+        JOG_SEND_RATE_HZ, JOG_KEEPALIVE_MS, CAPTURE_PERIOD_MS);
+    exit(2);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main(int argc, char **argv){
+    const char *port = NULL;
+    const char *device = NULL;
+    const char *jsonPath = NULL;
+    const char *recordPath = NULL;
+    int capturePeriodMs = CAPTURE_PERIOD_MS;
+    long baud = PAN_TILT_BAUD_RATE;
+    long gapUs = PAN_TILT_FRAME_GAP_US;
+    int rateHz = JOG_SEND_RATE_HZ;
+    int keepaliveMs = JOG_KEEPALIVE_MS;
+    int statsMs = -1;
+    bool quiet = false;
+    JoystickObserver observer;
+    for(int i = 1; i < argc; i++){
+        const char *option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(strcmp(option, "--port") == 0 && hasValue){
+            port = argv[++i];
+        }
+        else if(strcmp(option, "--device") == 0 && hasValue){
+            device = argv[++i];
+        }
+        else if(strcmp(option, "--baud") == 0 && hasValue){
+            baud = atol(argv[++i]);
+        }
+        else if(strcmp(option, "--gap-us") == 0 && hasValue){
+            gapUs = atol(argv[++i]);
+        }
+        else if(strcmp(option, "--rate") == 0 && hasValue){
+            rateHz = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--keepalive") == 0 && hasValue){
+            keepaliveMs = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--stats") == 0 && hasValue){
+            statsMs = (int)(atof(argv[++i]) * 1000);
+        }
+        else if(strcmp(option, "--latency") == 0){
+            observer.latency = true;
+        }
+        else if(strcmp(option, "--latency-json") == 0 && hasValue){
+            observer.latency = true;
+            jsonPath = argv[++i];
+        }
+        else if(strcmp(option, "--record") == 0 && hasValue){
+            recordPath = argv[++i];
+        }
+        else if(strcmp(option, "--capture-period") == 0 && hasValue){
+            capturePeriodMs = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--quiet") == 0){
+            quiet = true;
+        }
+        else{
+            usage();
+        }
+    }
+    if(port == NULL){
+        usage();
+    }
+
+    int wakePipe[2];
+    if(pipe2(wakePipe, O_NONBLOCK | O_CLOEXEC) != 0){
+        perror("pipe2");
+        return 1;
+    }
+    observer.wakeFd = wakePipe[1];
+    PanTiltLink link;
+    link.setObserver(&observer);
+    if(!link.open(port, baud)){
+        return 1;
+    }
+    link.setFrameGapUs(gapUs);
+    EvdevGamepad gamepad;
+    if(!gamepad.open(device)){
+        return 1;
+    }
+    fprintf(stderr, "Gamepad: %s\n", gamepad.name());
+    PanTiltController controller(link);
+    controller.setVerbose(!quiet);
+    if(observer.latency){
+        link.sendString("*1");
+    }
+    CaptureRecorder recorder;
+    if(recordPath != NULL){
+        recorder.start(link, capturePeriodMs);
+    }
+    JogSender jogSender(link);
+    if(rateHz > 0){
+        jogSender.start(rateHz, keepaliveMs);
+        controller.setJogSender(&jogSender);
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    int signalFd = signalfd(-1, &signals, SFD_CLOEXEC);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    int fds[] = {gamepad.fd(), wakePipe[0], signalFd};
+    for(int i = 0; i < 3; i++){
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fds[i];
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fds[i], &event);
+    }
+
+    bool running = true;
+    uint64_t nextStatsUs = monotonicUs() + statsMs * 1000ULL;
+    while(running && link.isOpen()){
+        int timeoutMs = -1;
+        if(statsMs > 0){
+            uint64_t nowUs = monotonicUs();
+            if(nowUs >= nextStatsUs){
+                jogSender.report(stderr);
+                nextStatsUs += statsMs * 1000ULL;
+            }
+            timeoutMs = (int)((nextStatsUs - nowUs + 999) / 1000);
+        }
+        struct epoll_event events[3];
+        int count = epoll_wait(epollFd, events, 3, timeoutMs);
+        for(int i = 0; i < count; i++){
+            int fd = events[i].data.fd;
+            if(fd == gamepad.fd()){
+                int result = gamepad.read();
+                if(result > 0){
+                    controller.update(gamepad.state(), gamepad.eventUs()); //The event time tags the jog frame for the latency
+                }
+                else if(result < 0){
+                    fprintf(stderr, "Gamepad disconnected\n");
+                    running = false;
+                }
+            }
+            else if(fd == wakePipe[0]){
+                char drain[64];
+                while(read(wakePipe[0], drain, sizeof(drain)) > 0){}
+                printReceived(link, recorder);
+            }
+            else if(fd == signalFd){
+                running = false;
+            }
+        }
+    }
+
+    if(rateHz > 0){
+        jogSender.stop(); //Sends zero speeds
+    }
+    else{
+        JogSpeeds stop = {0, 0, 0};
+        link.sendJog(stop); //Never leave the mount moving
+    }
+    if(observer.latency){
+        link.sendString("*0");
+    }
+    if(recordPath != NULL){
+        recorder.stop(link);
+    }
+    link.drain(1000);
+    uint64_t endUs = monotonicUs() + EXIT_ACK_WAIT_MS * 1000;
+    while(monotonicUs() < endUs && link.waitReceive(EXIT_ACK_WAIT_MS)){
+        printReceived(link, recorder);
+    }
+    endUs = monotonicUs() + CAPTURE_END_WAIT_MS * 1000;
+    while(recordPath != NULL && !recorder.finished() && monotonicUs() < endUs && link.waitReceive(CAPTURE_END_WAIT_MS)){
+        printReceived(link, recorder);
+    }
+    if(recordPath != NULL){
+        SegmentStream take = recorder.stream();
+        trimSegments(take);
+        if(!recorder.complete()){
+            fprintf(stderr, "Error: capture frames were lost. %s wasn't written\n", recordPath);
+        }
+        else if(!writeSegmentFile(recordPath, take)){
+            perror(recordPath);
+        }
+        else{
+            fprintf(stderr, "Captured %.2fs to %s\n", take.count() * take.periodMs / 1000.0, recordPath);
+        }
+    }
+    if(observer.latency){
+        observer.report(stderr);
+        if(jsonPath != NULL){
+            FILE *json = fopen(jsonPath, "w");
+            if(json == NULL){
+                perror(jsonPath);
+            }
+            else{
+                observer.writeJson(json);
+                fclose(json);
+            }
+        }
+    }
+    LinkStats stats = link.stats();
+    fprintf(stderr, "Frames sent: %lu\tBytes sent: %lu\tRejected: %lu\tQueue max: %luus\n", stats.framesSent, stats.bytesSent, stats.framesRejected,
+        stats.queueMaxUs);
+    jogSender.report(stderr);
+    link.close();
+    return 0;
+}
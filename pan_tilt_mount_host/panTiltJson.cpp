@@ -0,0 +1,345 @@
+#include "panTiltJson.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_MAX_DEPTH 32
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+const JsonValue *JsonValue::get(const char *name) const {
+    if(type != JSON_OBJECT){
+        return NULL;
+    }
+    for(size_t i = 0; i < members.size(); i++){
+        if(members[i].first == name){
+            return &members[i].second;
+        }
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+struct JsonParser {
+    const char *at;
+    const char *end;
+
+    void skipSpace(void){
+        while(at < end && (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n')){
+            at++;
+        }
+    }
+
+    bool literal(const char *word){
+        size_t length = strlen(word);
+        if((size_t)(end - at) < length || memcmp(at, word, length) != 0){
+            return false;
+        }
+        at += length;
+        return true;
+    }
+
+    static void appendUtf8(unsigned long code, std::string &out){
+        if(code < 0x80){
+            out += (char)code;
+        }
+        else if(code < 0x800){
+            out += (char)(0xC0 | (code >> 6));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+        else if(code < 0x10000){
+            out += (char)(0xE0 | (code >> 12));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+        else{
+            out += (char)(0xF0 | (code >> 18));
+            out += (char)(0x80 | ((code >> 12) & 0x3F));
+            out += (char)(0x80 | ((code >> 6) & 0x3F));
+            out += (char)(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool hex4(unsigned long &code){
+        if(end - at < 4){
+            return false;
+        }
+        code = 0;
+        for(int i = 0; i < 4; i++){
+            char c = *at++;
+            code <<= 4;
+            if(c >= '0' && c <= '9') code |= c - '0';
+            else if(c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool parseString(std::string &out){
+        at++; //Opening quote
+        while(at < end){
+            char c = *at++;
+            if(c == '"'){
+                return true;
+            }
+            if((unsigned char)c < 0x20){
+                return false;
+            }
+            if(c != '\\'){
+                out += c;
+                continue;
+            }
+            if(at >= end){
+                return false;
+            }
+            c = *at++;
+            switch(c){
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':{
+                    unsigned long code;
+                    if(!hex4(code)){
+                        return false;
+                    }
+                    if(code >= 0xD800 && code < 0xDC00 && end - at >= 6 && at[0] == '\\' && at[1] == 'u'){ //Surrogate pair
+                        const char *next = at;
+                        at += 2;
+                        unsigned long low;
+                        if(hex4(low) && low >= 0xDC00 && low <= 0xDFFF){
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        else{
+                            at = next; //Not a low surrogate so it is read as an escape of its own
+                        }
+                    }
+                    if(code >= 0xD800 && code <= 0xDFFF){
+                        code = 0xFFFD; //A lone surrogate can't be written as UTF-8
+                    }
+                    appendUtf8(code, out);
+                }
+                break;
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    bool parseNumber(JsonValue &value){
+        const char *start = at;
+        if(at < end && *at == '-') at++;
+        while(at < end && ((*at >= '0' && *at <= '9') || *at == '.' || *at == 'e' || *at == 'E' || *at == '+' || *at == '-')){
+            at++;
+        }
+        std::string text(start, at - start);
+        char *parsedEnd;
+        value.number = strtod(text.c_str(), &parsedEnd);
+        value.type = JSON_NUMBER;
+        return !text.empty() && *parsedEnd == '\0' && isfinite(value.number);
+    }
+
+    bool parseValue(JsonValue &value, int depth){
+        if(depth > JSON_MAX_DEPTH){
+            return false;
+        }
+        skipSpace();
+        if(at >= end){
+            return false;
+        }
+        switch(*at){
+            case '{':{
+                value.type = JSON_OBJECT;
+                at++;
+                skipSpace();
+                if(at < end && *at == '}'){
+                    at++;
+                    return true;
+                }
+                while(true){
+                    skipSpace();
+                    if(at >= end || *at != '"'){
+                        return false;
+                    }
+                    value.members.push_back(std::make_pair(std::string(), JsonValue()));
+                    if(!parseString(value.members.back().first)){
+                        return false;
+                    }
+                    skipSpace();
+                    if(at >= end || *at++ != ':' || !parseValue(value.members.back().second, depth + 1)){
+                        return false;
+                    }
+                    skipSpace();
+                    if(at < end && *at == ','){
+                        at++;
+                        continue;
+                    }
+                    return at < end && *at++ == '}';
+                }
+            }
+            case '[':{
+                value.type = JSON_ARRAY;
+                at++;
+                skipSpace();
+                if(at < end && *at == ']'){
+                    at++;
+                    return true;
+                }
+                while(true){
+                    value.items.push_back(JsonValue());
+                    if(!parseValue(value.items.back(), depth + 1)){
+                        return false;
+                    }
+                    skipSpace();
+                    if(at < end && *at == ','){
+                        at++;
+                        continue;
+                    }
+                    return at < end && *at++ == ']';
+                }
+            }
+            case '"':
+                value.type = JSON_STRING;
+                return parseString(value.string);
+            case 't':
+                value.type = JSON_BOOL;
+                value.boolean = true;
+                return literal("true");
+            case 'f':
+                value.type = JSON_BOOL;
+                return literal("false");
+            case 'n':
+                return literal("null");
+        }
+        return parseNumber(value);
+    }
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool parseJson(const char *text, size_t length, JsonValue &value){
+    JsonParser parser = {text, text + length};
+    value = JsonValue();
+    if(!parser.parseValue(value, 0)){
+        return false;
+    }
+    parser.skipSpace();
+    return parser.at == parser.end;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static size_t utf8Length(const unsigned char *text, size_t length){ //Length of the valid UTF-8 sequence at text. 0 if it isn't one
+    unsigned char c = text[0];
+    size_t count = (c >= 0xC2 && c <= 0xDF) ? 2 : (c >= 0xE0 && c <= 0xEF) ? 3 : (c >= 0xF0 && c <= 0xF4) ? 4 : 0;
+    if(count == 0 || count > length){
+        return 0;
+    }
+    for(size_t i = 1; i < count; i++){
+        if((text[i] & 0xC0) != 0x80){
+            return 0;
+        }
+    }
+    return count;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void writeJsonString(const char *text, size_t length, std::string &out){
+    const unsigned char *bytes = (const unsigned char*)text;
+    out += '"';
+    for(size_t i = 0; i < length; i++){
+        unsigned char c = bytes[i];
+        if(c == '"' || c == '\\'){
+            out += '\\';
+            out += (char)c;
+        }
+        else if(c == '\n'){
+            out += "\\n";
+        }
+        else if(c == '\t'){
+            out += "\\t";
+        }
+        else if(c < 0x20 || c == 0x7F){
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else if(c < 0x80){
+            out += (char)c;
+        }
+        else{
+            size_t sequence = utf8Length(bytes + i, length - i);
+            if(sequence == 0){
+                out += "\\ufffd"; //Line noise or a tokenised log frame
+            }
+            else{
+                out.append(text + i, sequence);
+                i += sequence - 1;
+            }
+        }
+    }
+    out += '"';
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void writeJsonNumber(double number, std::string &out){
+    char text[32];
+    if(!isfinite(number)){
+        out += "null";
+        return;
+    }
+    if(number == floor(number) && fabs(number) < 1e15){
+        snprintf(text, sizeof(text), "%.0f", number);
+    }
+    else{
+        snprintf(text, sizeof(text), "%.9g", number);
+    }
+    out += text;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void writeJson(const JsonValue &value, std::string &out){
+    switch(value.type){
+        case JSON_NULL:
+            out += "null";
+            break;
+        case JSON_BOOL:
+            out += value.boolean ? "true" : "false";
+            break;
+        case JSON_NUMBER:
+            writeJsonNumber(value.number, out);
+            break;
+        case JSON_STRING:
+            writeJsonString(value.string.data(), value.string.size(), out);
+            break;
+        case JSON_ARRAY:
+            out += '[';
+            for(size_t i = 0; i < value.items.size(); i++){
+                if(i > 0) out += ',';
+                writeJson(value.items[i], out);
+            }
+            out += ']';
+            break;
+        case JSON_OBJECT:
+            out += '{';
+            for(size_t i = 0; i < value.members.size(); i++){
+                if(i > 0) out += ',';
+                writeJsonString(value.members[i].first.data(), value.members[i].first.size(), out);
+                out += ':';
+                writeJson(value.members[i].second, out);
+            }
+            out += '}';
+            break;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef PANTILTJSON_H
+#define PANTILTJSON_H
+
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Just enough JSON for the daemon's JSON-RPC requests and replies. Numbers are doubles and objects keep their members in order.
+
+enum JsonType {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+struct JsonValue {
+    JsonValue(void) : type(JSON_NULL), boolean(false), number(0) {}
+
+    const JsonValue *get(const char *name) const; //Object member or NULL
+    bool isNumber(void) const { return type == JSON_NUMBER; }
+    bool isString(void) const { return type == JSON_STRING; }
+
+    JsonType type;
+    bool boolean;
+    double number;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue> > members;
+};
+
+bool parseJson(const char *text, size_t length, JsonValue &value); //False unless text is exactly one value
+void writeJson(const JsonValue &value, std::string &out);
+void writeJsonString(const char *text, size_t length, std::string &out); //Quoted and escaped. Invalid UTF-8 bytes become U+FFFD
+void writeJsonNumber(double number, std::string &out);
+
+#endif
@@ -0,0 +1,130 @@
+#include "panTiltLatency.h"
+#include <algorithm>
+
+static const char *const stage_names[LATENCY_STAGE_COUNT] = {"input", "queue", "ack", "total"};
+static const double report_fractions[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+static const char *const report_names[] = {"p50", "p90", "p99", "p99.9", "max"};
+#define REPORT_COUNT (int)(sizeof(report_fractions) / sizeof(report_fractions[0]))
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+LatencyRecorder::LatencyRecorder(void) : _inFlightHead(0), _inFlightCount(0), _acks(0), _naks(0), _lost(0), _unmatched(0) {
+    for(int i = 0; i < LATENCY_STAGE_COUNT; i++){
+        _samples[i].reserve(LATENCY_MAX_SAMPLES); //So recording never allocates
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void LatencyRecorder::frameSent(const uint8_t *frame, size_t length, uint64_t tag, uint64_t queuedUs, uint64_t sentUs){
+    if(length != JOG_FRAME_LENGTH || frame[0] != INSTRUCTION_BYTES_SLIDER_PAN_TILT_SPEED){
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(tag != 0){ //Sent for an input event rather than by the app itself
+        addSample(LATENCY_INPUT, queuedUs - tag);
+        addSample(LATENCY_QUEUE, sentUs - queuedUs);
+    }
+    if(_inFlightCount == LATENCY_MAX_IN_FLIGHT){ //The acks have stopped coming. Drop the oldest
+        _inFlightHead = (_inFlightHead + 1) % LATENCY_MAX_IN_FLIGHT;
+        _inFlightCount--;
+        _lost++;
+    }
+    InFlight &entry = _inFlight[(_inFlightHead + _inFlightCount) % LATENCY_MAX_IN_FLIGHT];
+    entry.inputUs = tag;
+    entry.sentUs = sentUs;
+    _inFlightCount++;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void LatencyRecorder::dataReceived(const char *data, size_t length, uint64_t receivedUs){
+    for(size_t i = 0; i < length; i++){
+        if(data[i] != JOG_ACK && data[i] != JOG_NAK){
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        while(_inFlightCount > 0 && receivedUs - _inFlight[_inFlightHead].sentUs > LATENCY_ACK_TIMEOUT_US){ //Its ack was lost
+            _inFlightHead = (_inFlightHead + 1) % LATENCY_MAX_IN_FLIGHT;
+            _inFlightCount--;
+            _lost++;
+        }
+        if(_inFlightCount == 0){
+            _unmatched++;
+            continue;
+        }
+        InFlight &entry = _inFlight[_inFlightHead];
+        _inFlightHead = (_inFlightHead + 1) % LATENCY_MAX_IN_FLIGHT;
+        _inFlightCount--;
+        if(data[i] == JOG_NAK){ //A job was running so the speeds weren't set
+            _naks++;
+            continue;
+        }
+        _acks++;
+        addSample(LATENCY_ACK, receivedUs - entry.sentUs);
+        if(entry.inputUs != 0){
+            addSample(LATENCY_TOTAL, receivedUs - entry.inputUs);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void LatencyRecorder::addSample(LatencyStage stage, uint64_t us){
+    if(_samples[stage].size() < LATENCY_MAX_SAMPLES){
+        _samples[stage].push_back(us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void LatencyRecorder::percentiles(LatencyStage stage, double *values, const double *fractions, int count){ //Nearest rank. Called with _mutex held
+    std::vector<uint32_t> sorted(_samples[stage]);
+    std::sort(sorted.begin(), sorted.end());
+    for(int i = 0; i < count; i++){
+        if(sorted.empty()){
+            values[i] = 0;
+            continue;
+        }
+        size_t rank = (size_t)(fractions[i] * sorted.size() + 0.999999);
+        values[i] = sorted[(rank == 0 ? 1 : rank) - 1];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void LatencyRecorder::report(FILE *out){
+    std::lock_guard<std::mutex> lock(_mutex);
+    fprintf(out, "Latency (ms)\tsamples");
+    for(int i = 0; i < REPORT_COUNT; i++){
+        fprintf(out, "\t%s", report_names[i]);
+    }
+    fprintf(out, "\n");
+    for(int stage = 0; stage < LATENCY_STAGE_COUNT; stage++){
+        double values[REPORT_COUNT];
+        percentiles((LatencyStage)stage, values, report_fractions, REPORT_COUNT);
+        fprintf(out, "%-12s\t%lu", stage_names[stage], (unsigned long)_samples[stage].size());
+        for(int i = 0; i < REPORT_COUNT; i++){
+            fprintf(out, "\t%.2f", values[i] / 1000.0);
+        }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "Acks: %lu\tNaks: %lu\tLost: %lu\tUnmatched: %lu\n", _acks, _naks, _lost, _unmatched);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void LatencyRecorder::writeJson(FILE *out){
+    std::lock_guard<std::mutex> lock(_mutex);
+    fprintf(out, "{\"acks\": %lu, \"naks\": %lu, \"lost\": %lu, \"unmatched\": %lu", _acks, _naks, _lost, _unmatched);
+    for(int stage = 0; stage < LATENCY_STAGE_COUNT; stage++){
+        double values[REPORT_COUNT];
+        percentiles((LatencyStage)stage, values, report_fractions, REPORT_COUNT);
+        fprintf(out, ", \"%s_us\": {\"samples\": %lu", stage_names[stage], (unsigned long)_samples[stage].size());
+        for(int i = 0; i < REPORT_COUNT; i++){
+            fprintf(out, ", \"%s\": %.0f", report_names[i], values[i]);
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "}\n");
+}
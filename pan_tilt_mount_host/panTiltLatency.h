@@ -0,0 +1,68 @@
+#ifndef PANTILTLATENCY_H
+#define PANTILTLATENCY_H
+
+#include "panTiltLink.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+#include <vector>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Control latency from a stick moving to the mount running at the new speed. Jog frames are sent with the input event's time as their tag and
+//the firmware replies to each one with JOG_ACK once the speeds are set (turned on with "*1"). The stages are:
+//
+//  input   Input event to the jog frame being queued (kernel, input backend and app)
+//  queue   Queued to written to the serial port (link queue and the gap after the previous frame)
+//  ack     Written to acknowledged (UART, the firmware's loop and read window, and the ack coming back)
+//  total   Input event to acknowledged
+//
+//The acks are matched to the jog frames in order so jogs sent without a tag are tracked too but only counted in the ack stage. A frame that
+//hasn't been acknowledged after LATENCY_ACK_TIMEOUT_US is counted as lost.
+
+#define JOG_ACK 0x06 //panTiltMount.h
+#define JOG_NAK 0x15
+#define INSTRUCTION_JOG_ACK '*'
+
+#define LATENCY_MAX_IN_FLIGHT 64 //Jog frames sent and waiting for their ack
+#define LATENCY_MAX_SAMPLES 100000 //Samples kept per stage
+#define LATENCY_ACK_TIMEOUT_US 1000000
+
+enum LatencyStage {
+    LATENCY_INPUT,
+    LATENCY_QUEUE,
+    LATENCY_ACK,
+    LATENCY_TOTAL,
+    LATENCY_STAGE_COUNT
+};
+
+class LatencyRecorder : public LinkObserver {
+public:
+    LatencyRecorder(void);
+
+    void frameSent(const uint8_t *frame, size_t length, uint64_t tag, uint64_t queuedUs, uint64_t sentUs);
+    void dataReceived(const char *data, size_t length, uint64_t receivedUs);
+
+    void report(FILE *out); //Percentiles of each stage
+    void writeJson(FILE *out);
+
+private:
+    struct InFlight {
+        uint64_t inputUs; //0 if the frame had no tag
+        uint64_t sentUs;
+    };
+
+    void addSample(LatencyStage stage, uint64_t us);
+    void percentiles(LatencyStage stage, double *values, const double *fractions, int count);
+
+    std::mutex _mutex; //The samples are written on the link's I/O thread and read by report()
+    std::vector<uint32_t> _samples[LATENCY_STAGE_COUNT];
+    InFlight _inFlight[LATENCY_MAX_IN_FLIGHT]; //Ring of frames waiting for their acks. Only used on the I/O thread
+    unsigned int _inFlightHead;
+    unsigned int _inFlightCount;
+    unsigned long _acks;
+    unsigned long _naks;
+    unsigned long _lost; //Timed out or pushed out of _inFlight
+    unsigned long _unmatched; //Acks with no frame waiting for them
+};
+
+#endif
@@ -0,0 +1,297 @@
+#include "panTiltLink.h"
+#include <string.h>
+#include <chrono>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+uint64_t monotonicUs(void){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+PanTiltLink::PanTiltLink(void) : _baud(PAN_TILT_BAUD_RATE), _gapUs(PAN_TILT_FRAME_GAP_US), _observer(NULL), _jogSpeeds(), _jogHeader(), _jogPending(false), _stats(), _running(false), _failed(false), _idle(true),
+    _frameLength(0), _frameOffset(0), _txDoneUs(0), _nextFrameUs(0) {}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+PanTiltLink::~PanTiltLink(void){
+    close();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::open(const char *port, long baud){
+    close();
+    if(!_port.open(port, baud)){
+        return false;
+    }
+    _baud = baud;
+    _tx.clear();
+    _rx.clear();
+    _jogPending = false;
+    _stats = LinkStats();
+    _frameLength = 0;
+    _frameOffset = 0;
+    _txDoneUs = 0;
+    _nextFrameUs = 0;
+    _failed = false;
+    _idle = true;
+    _running = true;
+    _thread = std::thread(&PanTiltLink::ioThread, this);
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void PanTiltLink::close(void){
+    if(_thread.joinable()){
+        _running = false;
+        _port.wake();
+        _thread.join();
+    }
+    _port.close();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::isOpen(void) const {
+    return _running && !_failed;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::send(const void *frame, size_t length, uint64_t tag){
+    if(length == 0 || length > PAN_TILT_MAX_FRAME || !isOpen()){
+        return false;
+    }
+    uint8_t entry[sizeof(FrameHeader) + PAN_TILT_MAX_FRAME]; //Written in one go so the I/O thread never sees half a frame
+    FrameHeader header = {(uint8_t)length, monotonicUs(), tag};
+    memcpy(entry, &header, sizeof(header));
+    memcpy(&entry[sizeof(header)], frame, length);
+    {
+        std::lock_guard<std::mutex> lock(_sendMutex);
+        if(_tx.space() < sizeof(header) + length){
+            std::lock_guard<std::mutex> statsLock(_statsMutex);
+            _stats.framesRejected++;
+            return false;
+        }
+        _tx.write(entry, sizeof(header) + length);
+        _idle = false; //After the write so the I/O thread can't mark it idle again before it sees the frame
+    }
+    _port.wake();
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::sendString(const char *instruction, uint64_t tag){
+    return send(instruction, strlen(instruction), tag);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::sendJog(const JogSpeeds &speeds, uint64_t tag){
+    uint8_t frame[JOG_FRAME_LENGTH];
+    return send(frame, encodeJog(speeds, frame), tag);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::postJog(const JogSpeeds &speeds, uint64_t tag){
+    if(!isOpen()){
+        return false;
+    }
+    bool replaced;
+    {
+        std::lock_guard<std::mutex> lock(_jogMutex);
+        replaced = _jogPending;
+        _jogSpeeds = speeds;
+        _jogHeader.length = JOG_FRAME_LENGTH;
+        _jogHeader.queuedUs = monotonicUs();
+        _jogHeader.tag = tag;
+        _jogPending = true;
+        _idle = false;
+    }
+    if(replaced){
+        std::lock_guard<std::mutex> lock(_statsMutex);
+        _stats.jogsReplaced++;
+    }
+    _port.wake();
+    return replaced;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::drain(int timeoutMs){
+    uint64_t endUs = monotonicUs() + (uint64_t)timeoutMs * 1000;
+    while(!_idle && isOpen()){
+        if(monotonicUs() >= endUs){
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return isOpen();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+size_t PanTiltLink::receive(char *data, size_t length){
+    return _rx.read(data, length);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::waitReceive(int timeoutMs){
+    std::unique_lock<std::mutex> lock(_receiveMutex);
+    return _received.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]{ return _rx.available() > 0 || !isOpen(); }) && _rx.available() > 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void PanTiltLink::setFrameGapUs(long gapUs){
+    _gapUs = gapUs;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void PanTiltLink::setObserver(LinkObserver *observer){
+    _observer = observer;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+size_t PanTiltLink::queuedBytes(void) const {
+    return _tx.available();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long PanTiltLink::baud(void) const {
+    return _baud;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+LinkStats PanTiltLink::stats(void){
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    return _stats;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::hasPending(void){ //Anything in the queue or the jog slot
+    std::lock_guard<std::mutex> lock(_jogMutex);
+    return _jogPending || _tx.available() > 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool PanTiltLink::loadFrame(uint64_t nowUs){ //Takes the next frame off the queue once the gap after the last one has passed
+    FrameHeader &header = _frameHeader;
+    if(nowUs < _nextFrameUs){
+        return false;
+    }
+    std::unique_lock<std::mutex> jogLock(_jogMutex);
+    if(_jogPending){ //The jog slot goes first
+        header = _jogHeader;
+        _frameLength = encodeJog(_jogSpeeds, _frame);
+        _jogPending = false;
+        jogLock.unlock();
+    }
+    else{
+        jogLock.unlock();
+        if(_tx.peek(&header, sizeof(header)) < sizeof(header)){
+            return false;
+        }
+        _tx.skip(sizeof(header));
+        _frameLength = _tx.read(_frame, header.length);
+    }
+    _frameOffset = 0;
+    unsigned long queuedUs = (unsigned long)(nowUs - header.queuedUs);
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    _stats.queueTotalUs += queuedUs;
+    if(queuedUs > _stats.queueMaxUs){
+        _stats.queueMaxUs = queuedUs;
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void PanTiltLink::readPort(void){
+    char buffer[256];
+    long count;
+    while((count = _port.read(buffer, sizeof(buffer))) > 0){
+        if(_observer != NULL){
+            _observer->dataReceived(buffer, count, monotonicUs());
+        }
+        size_t stored = _rx.write(buffer, count);
+        std::lock_guard<std::mutex> lock(_statsMutex);
+        _stats.bytesReceived += count;
+        _stats.rxOverflow += count - stored;
+    }
+    if(count < 0){
+        _failed = true;
+    }
+    std::lock_guard<std::mutex> lock(_receiveMutex); //Taken so a waitReceive() between its check and its wait isn't missed
+    _received.notify_all();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void PanTiltLink::ioThread(void){
+    while(_running && !_failed){
+        uint64_t nowUs = monotonicUs();
+        if(_frameOffset >= _frameLength){
+            _frameLength = _frameOffset = 0;
+            loadFrame(nowUs);
+        }
+        bool writing = _frameOffset < _frameLength;
+        int timeoutMs = -1;
+        if(!writing){
+            if(nowUs < _nextFrameUs){ //Wait out the gap, then send the next frame or mark the link idle
+                timeoutMs = (int)((_nextFrameUs - nowUs + 999) / 1000);
+            }
+            else if(hasPending()){ //Queued since loadFrame() looked
+                continue;
+            }
+            else{
+                _idle = true;
+                if(hasPending()){ //A frame was queued between the check above and marking the link idle
+                    _idle = false;
+                    continue;
+                }
+            }
+        }
+        int ready = _port.wait(writing, timeoutMs);
+        if(ready < 0){
+            _failed = true;
+            break;
+        }
+        if(ready & SERIAL_WAIT_READ){
+            readPort();
+        }
+        if(writing && (ready & SERIAL_WAIT_WRITE)){
+            long count = _port.write(&_frame[_frameOffset], _frameLength - _frameOffset);
+            if(count < 0){
+                _failed = true;
+                break;
+            }
+            _frameOffset += count;
+            if(_frameOffset >= _frameLength){
+                nowUs = monotonicUs();
+                _txDoneUs = ((_txDoneUs > nowUs) ? _txDoneUs : nowUs) + frameTimeUs(_frameLength, _baud);
+                _nextFrameUs = _txDoneUs + _gapUs;
+                if(_observer != NULL){
+                    _observer->frameSent(_frame, _frameLength, _frameHeader.tag, _frameHeader.queuedUs, nowUs);
+                }
+                std::lock_guard<std::mutex> lock(_statsMutex);
+                _stats.framesSent++;
+                _stats.bytesSent += _frameLength;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(_receiveMutex);
+    _received.notify_all();
+}
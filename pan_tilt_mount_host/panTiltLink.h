@@ -0,0 +1,108 @@
+#ifndef PANTILTLINK_H
+#define PANTILTLINK_H
+
+#include "panTiltProtocol.h"
+#include "ringBuffer.h"
+#include "serialPort.h"
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Connection to the mount with its own I/O thread. send() queues a frame and returns straight away; the thread writes the frames in order with
+//PAN_TILT_FRAME_GAP_US of silence after each one so the firmware reads them as separate instructions, and moves everything received into a
+//ring buffer that receive() reads from. Nothing is allocated while the link is open and the caller never sleeps for the firmware.
+//
+//Jog speeds can also be posted to a single slot with postJog(). The slot is sent before anything queued and a newer post replaces one that
+//hasn't been sent yet, so a stale jog never waits in the queue in front of a fresh one.
+
+#define LINK_TX_BUFFER 4096 //Queued frames with their headers
+#define LINK_RX_BUFFER 8192 //Received bytes not read yet. Older bytes are kept and newer ones counted as overflow when it's full
+
+uint64_t monotonicUs(void); //Steady clock in microseconds
+
+class LinkObserver { //Told about the traffic as it happens. Called on the I/O thread so it must be quick and mustn't call the link
+public:
+    virtual ~LinkObserver(void) {}
+    virtual void frameSent(const uint8_t *frame, size_t length, uint64_t tag, uint64_t queuedUs, uint64_t sentUs) {} //tag is the one given to send()
+    virtual void dataReceived(const char *data, size_t length, uint64_t receivedUs) {}
+};
+
+struct LinkStats {
+    unsigned long framesSent;
+    unsigned long bytesSent;
+    unsigned long framesRejected; //send() found the queue full
+    unsigned long jogsReplaced; //Posted jogs replaced by a newer one before they were sent
+    unsigned long bytesReceived;
+    unsigned long rxOverflow; //Received bytes lost because receive() wasn't called often enough
+    unsigned long queueMaxUs; //Longest a frame waited between send() and being written
+    unsigned long long queueTotalUs;
+};
+
+class PanTiltLink {
+public:
+    PanTiltLink(void);
+    ~PanTiltLink(void);
+
+    bool open(const char *port, long baud = PAN_TILT_BAUD_RATE);
+    void close(void); //Frames still queued are discarded. Call drain() first to send them
+    bool isOpen(void) const; //False once the port has failed or been unplugged
+
+    bool send(const void *frame, size_t length, uint64_t tag = 0); //Thread safe. Queues one frame. False if it's too long or the queue is full
+    bool sendString(const char *instruction, uint64_t tag = 0); //An ASCII instruction such as "m16"
+    bool sendJog(const JogSpeeds &speeds, uint64_t tag = 0);
+    bool postJog(const JogSpeeds &speeds, uint64_t tag = 0); //Thread safe. Latest wins. True if it replaced a jog that hadn't been sent
+    bool drain(int timeoutMs); //Waits until every queued frame has been sent and its gap has passed
+
+    size_t receive(char *data, size_t length); //Never blocks. Call from one thread only
+    bool waitReceive(int timeoutMs); //Waits until receive() has data
+
+    void setFrameGapUs(long gapUs);
+    void setObserver(LinkObserver *observer); //Call before open()
+    size_t queuedBytes(void) const;
+    long baud(void) const;
+    LinkStats stats(void);
+
+private:
+    struct FrameHeader {
+        uint8_t length;
+        uint64_t queuedUs;
+        uint64_t tag;
+    };
+
+    void ioThread(void);
+    bool loadFrame(uint64_t nowUs);
+    bool hasPending(void);
+    void readPort(void);
+
+    SerialPort _port;
+    long _baud;
+    std::atomic<long> _gapUs;
+    LinkObserver *_observer;
+    RingBuffer<LINK_TX_BUFFER> _tx;
+    RingBuffer<LINK_RX_BUFFER> _rx;
+    std::mutex _sendMutex; //Only one producer may write to _tx at a time
+    std::mutex _receiveMutex;
+    std::condition_variable _received;
+    std::mutex _jogMutex;
+    JogSpeeds _jogSpeeds; //The jog slot
+    FrameHeader _jogHeader;
+    bool _jogPending;
+    std::mutex _statsMutex;
+    LinkStats _stats;
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::atomic<bool> _failed;
+    std::atomic<bool> _idle; //Nothing queued or being written and the last gap has passed
+
+    uint8_t _frame[PAN_TILT_MAX_FRAME]; //Frame being written. Only used by the I/O thread
+    FrameHeader _frameHeader;
+    size_t _frameLength;
+    size_t _frameOffset;
+    uint64_t _txDoneUs; //When the UART will have sent the last byte written
+    uint64_t _nextFrameUs;
+};
+
+#endif
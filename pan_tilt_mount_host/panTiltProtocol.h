@@ -0,0 +1,80 @@
+#ifndef PANTILTPROTOCOL_H
+#define PANTILTPROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//The serial protocol of pan_tilt_mount_nano_code_tmc2208. An instruction is its character followed by the value as text ("m16", "#", ";1"). The firmware
+//reads everything that arrives within 2ms of the instruction character as its value and discards the rest so instructions have to be sent as
+//separate frames with a gap between them, which PanTiltLink does.
+
+#define PAN_TILT_BAUD_RATE 57600 //BAUD_RATE in panTiltMount.h
+#define PAN_TILT_FRAME_GAP_US 5000 //Silence after a frame before the next one. The firmware's 2ms read window plus a margin for its loop
+#define PAN_TILT_MAX_FRAME 32 //Longest frame that can be queued
+
+#define INSTRUCTION_BYTES_SLIDER_PAN_TILT_SPEED 4 //Binary jog: the instruction byte then the slider, pan and tilt step speeds as big endian int16
+#define JOG_FRAME_LENGTH 7
+#define INSTRUCTION_BYTES_SEGMENTS 5 //Binary segments: the instruction byte, a count then the pan, tilt and slider step deltas of each as big endian int16
+#define INSTRUCTION_SEGMENTS '/' //"/20" starts a segment stream with a 20ms period, "/0" marks its end
+#define SEGMENT_CREDIT 0x14 //Reply to each segment packet followed by the free slots in the firmware's buffer. A packet of 0 segments just asks for them
+#define SEGMENT_BUFFER_LENGTH 16 //panTiltMount.h
+#define SEGMENT_AXES 3
+#define SEGMENT_FRAME_MAX 4 //Segments in one packet
+#define SEGMENT_FRAME_LENGTH(count) (2 + (count) * SEGMENT_AXES * 2)
+#define INSTRUCTION_CAPTURE ',' //",20" sends a capture frame with the steps each axis moved every 20ms, ",0" stops
+#define CAPTURE_FRAME_SHORT 0x16 //Followed by the pan, tilt and slider steps as int8
+#define CAPTURE_FRAME 0x17 //Followed by them as big endian int16
+
+#define MAXIMUM_PAN_STEP_SPEED 1130.0 //steps per second
+#define MAXIMUM_TILT_STEP_SPEED 410.0
+#define MAXIMUM_SLIDER_STEP_SPEED 900.0
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+struct JogSpeeds {
+    int16_t slider;
+    int16_t pan;
+    int16_t tilt;
+};
+
+inline bool operator==(const JogSpeeds &a, const JogSpeeds &b){
+    return a.slider == b.slider && a.pan == b.pan && a.tilt == b.tilt;
+}
+
+inline bool operator!=(const JogSpeeds &a, const JogSpeeds &b){
+    return !(a == b);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+inline size_t encodeJog(const JogSpeeds &speeds, uint8_t *frame){ //frame must hold JOG_FRAME_LENGTH bytes
+    frame[0] = INSTRUCTION_BYTES_SLIDER_PAN_TILT_SPEED;
+    frame[1] = (speeds.slider >> 8) & 0xFF;
+    frame[2] = speeds.slider & 0xFF;
+    frame[3] = (speeds.pan >> 8) & 0xFF;
+    frame[4] = speeds.pan & 0xFF;
+    frame[5] = (speeds.tilt >> 8) & 0xFF;
+    frame[6] = speeds.tilt & 0xFF;
+    return JOG_FRAME_LENGTH;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+inline size_t encodeSegments(const int16_t *steps, size_t count, uint8_t *frame){ //count segments of SEGMENT_AXES steps. frame must hold SEGMENT_FRAME_LENGTH(count)
+    frame[0] = INSTRUCTION_BYTES_SEGMENTS;
+    frame[1] = (uint8_t)count;
+    for(size_t i = 0; i < count * SEGMENT_AXES; i++){
+        frame[2 + i * 2] = (steps[i] >> 8) & 0xFF;
+        frame[3 + i * 2] = steps[i] & 0xFF;
+    }
+    return SEGMENT_FRAME_LENGTH(count);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+inline long frameTimeUs(size_t length, long baud){ //Time to send a frame with a start and stop bit per byte
+    return (long)((length * 10 * 1000000LL) / baud);
+}
+
+#endif
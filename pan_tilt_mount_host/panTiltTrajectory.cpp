@@ -0,0 +1,749 @@
+#include "panTiltTrajectory.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define MVC_BISECTIONS 40
+#define MVC_BLOCK 1024 //Grid points per work item when the limit curve is worked out on the threads
+#define FILTER_STEP_S 0.001 //Time step of the filtered path speed
+#define LIMIT_TOLERANCE 1.01 //Speed above what the limits allow by this much after filtering counts as over them
+#define LIMIT_MIN_SCALE 0.5 //Largest single reduction of the velocity limit around a point that was over
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//One stop to stop part of the path. The path is a natural cubic spline for each axis through the keyframes against u, the distance along the
+//path in seconds at full speed. Its time optimal timing is worked out on a grid of n + 1 evenly spaced points in u as x = (du/dt)^2 at each
+//point. The path speed du/dt is then resampled every FILTER_STEP_S and put through a moving average as long as the slowest axis takes to ramp
+//to its full acceleration at its jerk limit. Averaging a speed whose rate of change is limited to A over a window T limits the rate of change
+//of the acceleration to 2A/T and stays on the path, at the cost of T more seconds. Where the filtered speed goes over a limit on a tight curve
+//the velocity limit around it is lowered and it's done again.
+
+struct TrajectoryRun {
+    std::vector<double> knots; //u of each keyframe
+    std::vector<double> points[TRAJECTORY_AXES];
+    std::vector<double> moments[TRAJECTORY_AXES]; //Second derivatives at the knots
+    double length;
+    const AxisLimits *limits;
+
+    int n;
+    double ds;
+    std::vector<double> dq[TRAJECTORY_AXES]; //dq/du at each grid point
+    std::vector<double> ddq[TRAJECTORY_AXES];
+    std::vector<double> velocityScale; //Lowers the velocity limit where the filtered speed was over a limit
+    std::vector<double> curveLimit; //Highest x at each point within the acceleration and velocity limits
+    std::vector<double> limit; //curveLimit with the velocity scale
+    std::vector<double> x;
+    std::vector<double> times; //Time at each grid point
+
+    double window; //Moving average length in seconds. 0 if the jerk isn't limited
+    std::vector<double> speed; //Filtered du/dt every FILTER_STEP_S
+    std::vector<double> distance; //u every FILTER_STEP_S
+    int iterations;
+    double maxVelocity[TRAJECTORY_AXES];
+    double maxAcceleration[TRAJECTORY_AXES];
+    double maxJerk[TRAJECTORY_AXES];
+
+    void fit(void);
+    void evaluate(double u, double *q, double *dqdu, double *d2qdu2) const;
+    void buildGrid(void);
+    bool accelerationRange(int i, double xi, double &lowest, double &highest) const;
+    double velocityLimit(int i) const;
+    void updateLimit(int i);
+    void time(void);
+    void filter(void);
+    bool checkLimits(void);
+    void optimise(void);
+    double duration(void) const;
+    void sample(double t, double *position, double *velocity, double *acceleration) const;
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void TrajectoryRun::fit(void){ //Natural spline: the second derivatives are zero at the ends and continuous at every knot
+    size_t count = knots.size();
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        std::vector<double> &m = moments[axis];
+        const std::vector<double> &p = points[axis];
+        m.assign(count, 0);
+        if(count < 3){
+            continue;
+        }
+        std::vector<double> diagonal(count, 0), right(count, 0);
+        for(size_t k = 1; k + 1 < count; k++){ //Tridiagonal system solved with the Thomas algorithm
+            double h0 = knots[k] - knots[k - 1];
+            double h1 = knots[k + 1] - knots[k];
+            diagonal[k] = 2 * (h0 + h1);
+            right[k] = 6 * ((p[k + 1] - p[k]) / h1 - (p[k] - p[k - 1]) / h0);
+            if(k > 1){
+                double factor = h0 / diagonal[k - 1];
+                diagonal[k] -= factor * h0;
+                right[k] -= factor * right[k - 1];
+            }
+        }
+        for(size_t k = count - 2; k >= 1; k--){
+            double h1 = knots[k + 1] - knots[k];
+            m[k] = (right[k] - h1 * m[k + 1]) / diagonal[k];
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void TrajectoryRun::evaluate(double u, double *q, double *dqdu, double *d2qdu2) const {
+    size_t k = std::upper_bound(knots.begin(), knots.end(), u) - knots.begin();
+    k = (k == 0) ? 0 : (k >= knots.size() ? knots.size() - 2 : k - 1);
+    double h = knots[k + 1] - knots[k];
+    double a = (knots[k + 1] - u) / h;
+    double b = (u - knots[k]) / h;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        const std::vector<double> &p = points[axis];
+        const std::vector<double> &m = moments[axis];
+        if(q != NULL){
+            q[axis] = a * p[k] + b * p[k + 1] + ((a * a * a - a) * m[k] + (b * b * b - b) * m[k + 1]) * h * h / 6;
+        }
+        if(dqdu != NULL){
+            dqdu[axis] = (p[k + 1] - p[k]) / h + ((3 * b * b - 1) * m[k + 1] - (3 * a * a - 1) * m[k]) * h / 6;
+        }
+        if(d2qdu2 != NULL){
+            d2qdu2[axis] = a * m[k] + b * m[k + 1];
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void TrajectoryRun::buildGrid(void){
+    n = (int)ceil(length / TRAJECTORY_GRID_S);
+    n = std::max(100, std::min(n, TRAJECTORY_MAX_GRID));
+    ds = length / n;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        dq[axis].resize(n + 1);
+        ddq[axis].resize(n + 1);
+    }
+    for(int i = 0; i <= n; i++){
+        double first[TRAJECTORY_AXES], second[TRAJECTORY_AXES];
+        evaluate(i * ds, NULL, first, second);
+        for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+            dq[axis][i] = first[axis];
+            ddq[axis][i] = second[axis];
+        }
+    }
+    velocityScale.assign(n + 1, 1);
+    curveLimit.assign(n + 1, 0);
+    limit.assign(n + 1, 0);
+    x.assign(n + 1, 0);
+    times.assign(n + 1, 0);
+    window = 0;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        if(limits[axis].jerk > 0){
+            window = std::max(window, 2 * limits[axis].acceleration / limits[axis].jerk);
+        }
+    }
+    iterations = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//The path accelerations d2u/dt2 that keep every axis within its acceleration limit at point i moving at x. Each axis's acceleration is
+//ddq * x + dq * d2u/dt2. False if there aren't any.
+bool TrajectoryRun::accelerationRange(int i, double xi, double &lowest, double &highest) const {
+    lowest = -HUGE_VAL;
+    highest = HUGE_VAL;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        double maximum = limits[axis].acceleration;
+        double curvature = ddq[axis][i] * xi;
+        double slope = dq[axis][i];
+        if(fabs(slope) < 1e-12){
+            if(fabs(curvature) > maximum){
+                return false;
+            }
+            continue;
+        }
+        double a = (-maximum - curvature) / slope;
+        double b = (maximum - curvature) / slope;
+        lowest = std::max(lowest, std::min(a, b));
+        highest = std::min(highest, std::max(a, b));
+    }
+    return lowest <= highest;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+double TrajectoryRun::velocityLimit(int i) const {
+    double highest = HUGE_VAL;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        double slope = fabs(dq[axis][i]);
+        if(slope > 1e-12){
+            double v = limits[axis].velocity * velocityScale[i] / slope;
+            highest = std::min(highest, v * v);
+        }
+    }
+    return highest;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void TrajectoryRun::updateLimit(int i){ //Highest x that is within the velocity limits and leaves a usable acceleration
+    double highest = velocityLimit(i);
+    double lowest, range;
+    if(!accelerationRange(i, highest, lowest, range)){
+        double feasible = 0;
+        for(int b = 0; b < MVC_BISECTIONS; b++){
+            double middle = (feasible + highest) / 2;
+            if(accelerationRange(i, middle, lowest, range)){
+                feasible = middle;
+            }
+            else{
+                highest = middle;
+            }
+        }
+        highest = feasible;
+    }
+    curveLimit[i] = limit[i] = std::max(highest, 1e-12); //Never quite stopped inside a run or it would take forever
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void TrajectoryRun::time(void){ //Accelerates as hard as possible forwards from the start then brakes as hard as possible back from the end
+    x[0] = 0;
+    for(int i = 0; i < n; i++){
+        double lowest, highest;
+        if(!accelerationRange(i, x[i], lowest, highest)){
+            highest = 0;
+        }
+        x[i + 1] = std::min(limit[i + 1], std::max(0.0, x[i] + 2 * ds * highest));
+    }
+    x[n] = 0;
+    for(int i = n - 1; i >= 0; i--){
+        double lowest, highest;
+        if(!accelerationRange(i + 1, x[i + 1], lowest, highest)){
+            lowest = 0;
+        }
+        x[i] = std::min(x[i], std::max(0.0, x[i + 1] - 2 * ds * lowest));
+    }
+    times[0] = 0;
+    for(int i = 0; i < n; i++){
+        times[i + 1] = times[i] + 2 * ds / (sqrt(x[i]) + sqrt(x[i + 1])); //Constant path acceleration across each interval
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void TrajectoryRun::filter(void){
+    int steps = (int)ceil(times[n] / FILTER_STEP_S);
+    int span = std::max(1, (int)lround(window / FILTER_STEP_S));
+    std::vector<double> sums(steps + 2, 0); //Running sums of the unfiltered speed
+    int i = 0;
+    for(int k = 0; k <= steps; k++){
+        double t = std::min(k * FILTER_STEP_S, times[n]);
+        while(i < n - 1 && times[i + 1] <= t){
+            i++;
+        }
+        double tau = std::min(t - times[i], times[i + 1] - times[i]);
+        double raw = (k == steps) ? 0 : sqrt(x[i]) + (x[i + 1] - x[i]) / (2 * ds) * tau;
+        sums[k + 1] = sums[k] + raw;
+    }
+    int total = steps + span;
+    speed.assign(total + 1, 0);
+    distance.assign(total + 1, 0);
+    for(int k = 0; k <= total; k++){
+        int last = std::min(k, steps);
+        int first = std::max(k - span + 1, 0);
+        speed[k] = (first <= last) ? (sums[last + 1] - sums[first]) / span : 0;
+        if(k > 0){
+            distance[k] = distance[k - 1] + (speed[k - 1] + speed[k]) / 2 * FILTER_STEP_S;
+        }
+    }
+    double scale = length / distance[total]; //Corrects the resampling so the run ends exactly on the last keyframe
+    for(int k = 0; k <= total; k++){
+        speed[k] *= scale;
+        distance[k] *= scale;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Works out the largest velocity, acceleration and jerk of each axis after filtering. Returns true if they're within the limits. If not the
+//velocity limit is lowered over a filter window either side of each point that was over.
+bool TrajectoryRun::checkLimits(void){
+    std::vector<double> over(n + 1, 0); //How far over the limits each grid point was
+    double lastAcceleration[TRAJECTORY_AXES] = {0, 0, 0};
+    bool anyOver = false;
+    int total = (int)speed.size() - 1;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        maxVelocity[axis] = maxAcceleration[axis] = maxJerk[axis] = 0;
+    }
+    for(int k = 0; k <= total; k++){
+        double first[TRAJECTORY_AXES], second[TRAJECTORY_AXES];
+        evaluate(distance[k], NULL, first, second);
+        double pathAcceleration = (k < total) ? (speed[k + 1] - speed[k]) / FILTER_STEP_S : 0;
+        double ratio = 0;
+        for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+            double velocity = first[axis] * speed[k];
+            double acceleration = second[axis] * speed[k] * speed[k] + first[axis] * pathAcceleration;
+            maxVelocity[axis] = std::max(maxVelocity[axis], fabs(velocity));
+            maxAcceleration[axis] = std::max(maxAcceleration[axis], fabs(acceleration));
+            double jerk = (k > 0) ? fabs(acceleration - lastAcceleration[axis]) / FILTER_STEP_S : 0;
+            maxJerk[axis] = std::max(maxJerk[axis], jerk);
+            lastAcceleration[axis] = acceleration;
+            //As a speed ratio. Following a curve the acceleration goes up with the square of the speed and the jerk with the cube
+            ratio = std::max(ratio, fabs(velocity) / limits[axis].velocity);
+            ratio = std::max(ratio, sqrt(fabs(acceleration) / limits[axis].acceleration));
+            if(limits[axis].jerk > 0){
+                ratio = std::max(ratio, cbrt(jerk / limits[axis].jerk));
+            }
+        }
+        if(ratio > LIMIT_TOLERANCE){
+            int i = std::min(n, (int)lround(distance[k] / ds));
+            over[i] = std::max(over[i], ratio);
+            anyOver = true;
+        }
+    }
+    if(!anyOver){
+        return true;
+    }
+    std::vector<double> scale(n + 1, 1);
+    for(int i = 0; i <= n; i++){
+        if(over[i] == 0){
+            continue;
+        }
+        int reach = (int)ceil(sqrt(x[i]) * window / ds) + 1;
+        double factor = std::max(LIMIT_MIN_SCALE, 0.98 / over[i]);
+        for(int p = std::max(0, i - reach); p <= std::min(n, i + reach); p++){
+            scale[p] = std::min(scale[p], factor);
+        }
+    }
+    for(int i = 0; i <= n; i++){
+        if(scale[i] < 1){
+            velocityScale[i] *= scale[i];
+            limit[i] = std::min(curveLimit[i], velocityLimit(i));
+        }
+    }
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void TrajectoryRun::optimise(void){ //The limit curve has already been worked out
+    time();
+    filter();
+    while(!checkLimits() && iterations < TRAJECTORY_LIMIT_ITERATIONS){
+        iterations++;
+        time();
+        filter();
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+double TrajectoryRun::duration(void) const {
+    return (speed.size() - 1) * FILTER_STEP_S;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void TrajectoryRun::sample(double t, double *position, double *velocity, double *acceleration) const {
+    int k = std::max(0, std::min((int)(t / FILTER_STEP_S), (int)speed.size() - 2));
+    double tau = std::max(0.0, std::min(t - k * FILTER_STEP_S, FILTER_STEP_S));
+    double pathAcceleration = (speed[k + 1] - speed[k]) / FILTER_STEP_S;
+    double u = std::min(distance[k] + speed[k] * tau + pathAcceleration * tau * tau / 2, length);
+    double pathSpeed = speed[k] + pathAcceleration * tau;
+    double first[TRAJECTORY_AXES], second[TRAJECTORY_AXES];
+    evaluate(u, position, first, second);
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        if(velocity != NULL){
+            velocity[axis] = first[axis] * pathSpeed;
+        }
+        if(acceleration != NULL){
+            acceleration[axis] = second[axis] * pathSpeed * pathSpeed + first[axis] * pathAcceleration;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+template<typename Work>
+static void parallelFor(size_t count, int threads, Work work){ //Calls work(i) for every i below count spread over the threads
+    std::atomic<size_t> next(0);
+    auto worker = [&](){
+        for(size_t i = next++; i < count; i = next++){
+            work(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int t = 1; t < threads && (size_t)t < count; t++){
+        pool.push_back(std::thread(worker));
+    }
+    worker();
+    for(size_t t = 0; t < pool.size(); t++){
+        pool[t].join();
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+TrajectoryOptions defaultTrajectoryOptions(void){
+    TrajectoryOptions options;
+    options.limits[TRAJECTORY_PAN].velocity = 18; //The firmware's default max speeds
+    options.limits[TRAJECTORY_PAN].acceleration = 20;
+    options.limits[TRAJECTORY_PAN].jerk = 60;
+    options.limits[TRAJECTORY_TILT].velocity = 10;
+    options.limits[TRAJECTORY_TILT].acceleration = 15;
+    options.limits[TRAJECTORY_TILT].jerk = 45;
+    options.limits[TRAJECTORY_SLIDER].velocity = 20;
+    options.limits[TRAJECTORY_SLIDER].acceleration = 25;
+    options.limits[TRAJECTORY_SLIDER].jerk = 75;
+    options.stepMode = 16;
+    options.herringboneTilt = false;
+    options.periodMs = TRAJECTORY_PERIOD_MS;
+    options.threads = 0;
+    options.stopAtKeyframes = false;
+    return options;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+double axisStepsPerUnit(int axis, int stepMode, bool herringboneTilt){
+    double stepsPerRev = TRAJECTORY_STEPS_PER_REV * stepMode;
+    switch(axis){
+        case TRAJECTORY_PAN: return stepsPerRev * TRAJECTORY_PAN_RATIO / 360;
+        case TRAJECTORY_TILT: return stepsPerRev * (herringboneTilt ? TRAJECTORY_TILT_HERRINGBONE_RATIO : TRAJECTORY_TILT_BELT_RATIO) / 360;
+        default: return stepsPerRev / TRAJECTORY_SLIDER_MM_PER_REV;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool findNumber(const std::string &line, const char *label, double &value){
+    size_t at = line.find(label);
+    if(at == std::string::npos){
+        return false;
+    }
+    const char *start = line.c_str() + at + strlen(label);
+    char *end;
+    value = strtod(start, &end);
+    return end != start;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool parseKeyframes(const std::string &text, std::vector<TrajectoryKeyframe> &keyframes){
+    keyframes.clear();
+    size_t start = 0;
+    while(start < text.size()){
+        size_t end = text.find('\n', start);
+        if(end == std::string::npos){
+            end = text.size();
+        }
+        std::string line = text.substr(start, end - start);
+        start = end + 1;
+        TrajectoryKeyframe keyframe;
+        double hold = 0;
+        if(line.find("| Pan: ") != std::string::npos){ //printKeyframeElements()
+            if(!findNumber(line, "Pan: ", keyframe.position[TRAJECTORY_PAN]) || !findNumber(line, "Tilt: ", keyframe.position[TRAJECTORY_TILT])
+                || !findNumber(line, "Slider: ", keyframe.position[TRAJECTORY_SLIDER])){
+                return false;
+            }
+            findNumber(line, "Delay: ", hold);
+        }
+        else{
+            line = line.substr(0, line.find('#'));
+            std::replace(line.begin(), line.end(), ',', ' ');
+            double values[4];
+            int count = 0;
+            const char *at = line.c_str();
+            char *next;
+            while(count < 4){
+                values[count] = strtod(at, &next);
+                if(next == at){
+                    break;
+                }
+                at = next;
+                count++;
+            }
+            while(*at == ' ' || *at == '\t' || *at == '\r'){
+                at++;
+            }
+            if(count == 0 && *at == '\0'){
+                continue; //Blank
+            }
+            if(count < 3 || *at != '\0'){
+                continue; //Something else the firmware printed
+            }
+            for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+                keyframe.position[axis] = values[axis];
+            }
+            hold = (count > 3) ? values[3] : 0;
+        }
+        keyframe.holdMs = (int)std::max(0.0, hold);
+        keyframes.push_back(keyframe);
+    }
+    return !keyframes.empty();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+Trajectory::Trajectory(void) : _options(defaultTrajectoryOptions()), _report() {}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+Trajectory::~Trajectory(void){
+    for(size_t i = 0; i < _runs.size(); i++){
+        delete _runs[i];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool Trajectory::plan(const std::vector<TrajectoryKeyframe> &keyframes, const TrajectoryOptions &options, std::string &error){
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < _runs.size(); i++){
+        delete _runs[i];
+    }
+    _runs.clear();
+    _spans.clear();
+    _report = TrajectoryReport();
+    _options = options;
+    if(keyframes.empty()){
+        error = "No keyframes";
+        return false;
+    }
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        if(!(options.limits[axis].velocity > 0) || !(options.limits[axis].acceleration > 0) || options.limits[axis].jerk < 0){
+            error = "The velocity and acceleration limits must be above zero";
+            return false;
+        }
+    }
+    if(options.periodMs <= 0){
+        error = "The period must be above zero";
+        return false;
+    }
+
+    TrajectoryRun *run = NULL;
+    double clock = 0;
+    for(size_t k = 0; k < keyframes.size(); k++){
+        const TrajectoryKeyframe &keyframe = keyframes[k];
+        bool stop = k == 0 || k + 1 == keyframes.size() || keyframe.holdMs > 0 || options.stopAtKeyframes;
+        if(run != NULL){
+            double distance = 0;
+            for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+                double d = (keyframe.position[axis] - run->points[axis].back()) / options.limits[axis].velocity;
+                distance += d * d;
+            }
+            distance = sqrt(distance);
+            if(distance > 1e-9){ //Repeated keyframes are the same point on the path
+                run->knots.push_back(run->knots.back() + distance);
+                for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+                    run->points[axis].push_back(keyframe.position[axis]);
+                }
+            }
+            if(stop){
+                if(run->knots.size() > 1){
+                    run->length = run->knots.back();
+                    run->fit();
+                    run->buildGrid();
+                    Span span = {clock, 0, (int)_runs.size(), {0, 0, 0}};
+                    _spans.push_back(span);
+                    _runs.push_back(run);
+                }
+                else{
+                    delete run;
+                }
+                run = NULL;
+            }
+        }
+        if(keyframe.holdMs > 0){
+            Span span = {clock, keyframe.holdMs / 1000.0, -1, {keyframe.position[0], keyframe.position[1], keyframe.position[2]}};
+            _spans.push_back(span);
+        }
+        if(run == NULL && k + 1 < keyframes.size()){
+            run = new TrajectoryRun();
+            run->limits = _options.limits;
+            run->knots.push_back(0);
+            for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+                run->points[axis].push_back(keyframe.position[axis]);
+            }
+        }
+    }
+    if(_spans.empty()){ //One keyframe or they're all the same point
+        Span span = {0, 0, -1, {keyframes[0].position[0], keyframes[0].position[1], keyframes[0].position[2]}};
+        _spans.push_back(span);
+    }
+
+    int threads = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::pair<size_t, int> > blocks; //The limit curve in blocks so a single long run still uses every thread
+    for(size_t r = 0; r < _runs.size(); r++){
+        for(int i = 0; i <= _runs[r]->n; i += MVC_BLOCK){
+            blocks.push_back(std::make_pair(r, i));
+        }
+    }
+    parallelFor(blocks.size(), threads, [&](size_t b){
+        TrajectoryRun *block = _runs[blocks[b].first];
+        int last = std::min(block->n, blocks[b].second + MVC_BLOCK - 1);
+        for(int i = blocks[b].second; i <= last; i++){
+            block->updateLimit(i);
+        }
+    });
+    parallelFor(_runs.size(), threads, [&](size_t r){
+        _runs[r]->optimise();
+    });
+
+    for(size_t s = 0; s < _spans.size(); s++){ //The runs' durations are known now
+        _spans[s].startS = clock;
+        if(_spans[s].run >= 0){
+            _spans[s].durationS = _runs[_spans[s].run]->duration();
+        }
+        clock += _spans[s].durationS;
+    }
+    _report.durationS = clock;
+    _report.runs = (int)_runs.size();
+    for(size_t r = 0; r < _runs.size(); r++){
+        const TrajectoryRun &done = *_runs[r];
+        _report.gridPoints += done.n + 1;
+        _report.limitIterations = std::max(_report.limitIterations, done.iterations);
+        for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+            _report.maxVelocity[axis] = std::max(_report.maxVelocity[axis], done.maxVelocity[axis]);
+            _report.maxAcceleration[axis] = std::max(_report.maxAcceleration[axis], done.maxAcceleration[axis]);
+            _report.maxJerk[axis] = std::max(_report.maxJerk[axis], done.maxJerk[axis]);
+        }
+    }
+    _report.optimiseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+double Trajectory::duration(void) const {
+    return _report.durationS;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void Trajectory::sample(double timeS, double *position, double *velocity, double *acceleration) const {
+    size_t s = 0;
+    while(s + 1 < _spans.size() && timeS >= _spans[s + 1].startS){
+        s++;
+    }
+    const Span &span = _spans[s];
+    if(span.run >= 0){
+        _runs[span.run]->sample(timeS - span.startS, position, velocity, acceleration);
+        return;
+    }
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        position[axis] = span.position[axis];
+        if(velocity != NULL) velocity[axis] = 0;
+        if(acceleration != NULL) acceleration[axis] = 0;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool Trajectory::compile(SegmentStream &stream, std::string &error) const {
+    double stepsPerUnit[TRAJECTORY_AXES];
+    double position[TRAJECTORY_AXES];
+    long last[TRAJECTORY_AXES];
+    stream.periodMs = _options.periodMs;
+    stream.stepMode = _options.stepMode;
+    stream.steps.clear();
+    sample(0, position);
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        stepsPerUnit[axis] = axisStepsPerUnit(axis, _options.stepMode, _options.herringboneTilt);
+        last[axis] = stream.startSteps[axis] = lround(position[axis] * stepsPerUnit[axis]);
+    }
+    double periodS = _options.periodMs / 1000.0;
+    long count = (long)ceil(duration() / periodS - 1e-9);
+    for(long k = 1; k <= count; k++){
+        sample(std::min(k * periodS, duration()), position);
+        for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+            long steps = lround(position[axis] * stepsPerUnit[axis]);
+            long delta = steps - last[axis];
+            if(delta < INT16_MIN || delta > INT16_MAX){
+                error = "A segment has too many steps. Use a shorter period";
+                return false;
+            }
+            stream.steps.push_back((int16_t)delta);
+            last[axis] = steps;
+        }
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Segment files are little endian: the magic, then uint16 version, period in ms, step mode and axis count, int32 start steps for each axis, a uint32
+//segment count and the int16 steps of every segment.
+
+static void putBytes(std::vector<uint8_t> &out, uint32_t value, int bytes){
+    for(int i = 0; i < bytes; i++){
+        out.push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static uint32_t getBytes(const uint8_t *in, int bytes){
+    uint32_t value = 0;
+    for(int i = bytes - 1; i >= 0; i--){
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool writeSegmentFile(const char *path, const SegmentStream &stream){
+    std::vector<uint8_t> data(TRAJECTORY_FILE_MAGIC, TRAJECTORY_FILE_MAGIC + 4);
+    putBytes(data, TRAJECTORY_FILE_VERSION, 2);
+    putBytes(data, stream.periodMs, 2);
+    putBytes(data, stream.stepMode, 2);
+    putBytes(data, TRAJECTORY_AXES, 2);
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        putBytes(data, (uint32_t)stream.startSteps[axis], 4);
+    }
+    putBytes(data, (uint32_t)stream.count(), 4);
+    for(size_t i = 0; i < stream.steps.size(); i++){
+        putBytes(data, (uint16_t)stream.steps[i], 2);
+    }
+    FILE *file = fopen(path, "wb");
+    if(file == NULL){
+        return false;
+    }
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool readSegmentFile(const char *path, SegmentStream &stream){
+    FILE *file = fopen(path, "rb");
+    if(file == NULL){
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t length;
+    while((length = fread(buffer, 1, sizeof(buffer), file)) > 0){
+        data.insert(data.end(), buffer, buffer + length);
+    }
+    fclose(file);
+    const size_t header = 4 + 4 * 2 + TRAJECTORY_AXES * 4 + 4;
+    if(data.size() < header || memcmp(data.data(), TRAJECTORY_FILE_MAGIC, 4) != 0 || getBytes(&data[4], 2) != TRAJECTORY_FILE_VERSION
+        || getBytes(&data[10], 2) != TRAJECTORY_AXES){
+        return false;
+    }
+    stream.periodMs = getBytes(&data[6], 2);
+    stream.stepMode = getBytes(&data[8], 2);
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        stream.startSteps[axis] = (int32_t)getBytes(&data[12 + axis * 4], 4);
+    }
+    size_t count = getBytes(&data[header - 4], 4);
+    if(stream.periodMs == 0 || data.size() != header + count * TRAJECTORY_AXES * 2){
+        return false;
+    }
+    stream.steps.resize(count * TRAJECTORY_AXES);
+    for(size_t i = 0; i < stream.steps.size(); i++){
+        stream.steps[i] = (int16_t)getBytes(&data[header + i * 2], 2);
+    }
+    return true;
+}
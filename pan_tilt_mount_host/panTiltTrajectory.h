@@ -0,0 +1,119 @@
+#ifndef PANTILTTRAJECTORY_H
+#define PANTILTTRAJECTORY_H
+
+#include "panTiltProtocol.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Keyframe trajectories planned on the host and compiled into a step segment stream the firmware plays back as it is (JOB_SEGMENTS).
+//
+//The keyframes are joined by a C2 cubic spline for each run between stops (the first and last keyframes and any keyframe with a hold). Each run is
+//timed to be as fast as the per-axis velocity and acceleration limits allow by a forward and backward pass over the path speed (the usual time
+//optimal path parameterisation). Jerk isn't part of that so the path speed is then smoothed with a moving average that limits the jerk, which
+//costs the length of the average on each run. That's close to the jerk limited optimum rather than exactly it. The limit curve is worked out on
+//every thread and the runs, which are independent, are optimised on separate threads.
+//
+//The trajectory is then sampled every period and each segment is the whole steps each axis moves in that period. The steps are worked out from
+//the absolute positions so the rounding never builds up.
+
+#define TRAJECTORY_AXES SEGMENT_AXES //Pan and tilt in degrees and the slider in millimetres, in the firmware's AXIS_ order
+#define TRAJECTORY_PAN 0
+#define TRAJECTORY_TILT 1
+#define TRAJECTORY_SLIDER 2
+
+#define TRAJECTORY_STEPS_PER_REV 200
+#define TRAJECTORY_PAN_RATIO (144.0 / 17.0) //Gear ratios of the axis types in panTiltAxis.h
+#define TRAJECTORY_TILT_BELT_RATIO (123.0 / 16.0)
+#define TRAJECTORY_TILT_HERRINGBONE_RATIO (64.0 / 21.0)
+#define TRAJECTORY_SLIDER_MM_PER_REV (36.0 * 2) //SLIDER_PULLEY_TEETH on a 2mm pitch belt
+
+#define TRAJECTORY_PERIOD_MS 20 //Default segment period
+#define TRAJECTORY_GRID_S 0.005 //Path spacing of the timing grid in seconds at full speed
+#define TRAJECTORY_MAX_GRID 200000 //Most grid points in one run
+#define TRAJECTORY_LIMIT_ITERATIONS 50 //Most times a run is timed again after the smoothing took it over a limit
+#define TRAJECTORY_FILE_MAGIC "PTSG"
+#define TRAJECTORY_FILE_VERSION 1
+
+struct TrajectoryKeyframe {
+    double position[TRAJECTORY_AXES];
+    int holdMs; //Time stopped at the keyframe before moving on
+};
+
+struct AxisLimits {
+    double velocity; //Units/s
+    double acceleration; //Units/s^2
+    double jerk; //Units/s^3. 0 = not limited
+};
+
+struct TrajectoryOptions {
+    AxisLimits limits[TRAJECTORY_AXES];
+    int stepMode;
+    bool herringboneTilt;
+    int periodMs;
+    int threads; //0 = one per core
+    bool stopAtKeyframes; //Stop at every keyframe and move in straight lines between them
+};
+
+struct TrajectoryReport {
+    double durationS;
+    int runs;
+    int gridPoints;
+    int limitIterations; //Most times any run was timed again
+    double maxVelocity[TRAJECTORY_AXES];
+    double maxAcceleration[TRAJECTORY_AXES];
+    double maxJerk[TRAJECTORY_AXES];
+    double optimiseMs;
+};
+
+struct SegmentStream {
+    int periodMs;
+    int stepMode;
+    long startSteps[TRAJECTORY_AXES]; //Position the first segment starts from
+    std::vector<int16_t> steps; //TRAJECTORY_AXES per segment
+
+    size_t count(void) const { return steps.size() / TRAJECTORY_AXES; }
+};
+
+struct TrajectoryRun;
+
+class Trajectory {
+public:
+    Trajectory(void);
+    ~Trajectory(void);
+
+    bool plan(const std::vector<TrajectoryKeyframe> &keyframes, const TrajectoryOptions &options, std::string &error);
+    double duration(void) const;
+    void sample(double timeS, double *position, double *velocity = NULL, double *acceleration = NULL) const; //At any time from 0 to duration()
+    bool compile(SegmentStream &stream, std::string &error) const;
+    const TrajectoryReport &report(void) const { return _report; }
+
+private:
+    Trajectory(const Trajectory&);
+    Trajectory &operator=(const Trajectory&);
+
+    struct Span { //A run or a hold in time order
+        double startS;
+        double durationS;
+        int run; //-1 for a hold
+        double position[TRAJECTORY_AXES]; //Where a hold is
+    };
+
+    TrajectoryOptions _options;
+    std::vector<TrajectoryRun*> _runs;
+    std::vector<Span> _spans;
+    TrajectoryReport _report;
+};
+
+TrajectoryOptions defaultTrajectoryOptions(void);
+double axisStepsPerUnit(int axis, int stepMode, bool herringboneTilt); //AxisStepper::stepsPerUnit()
+
+//Reads keyframes from the firmware's keyframe list (printKeyframeElements(), e.g. from "R") or from lines of "pan tilt slider [hold_ms]". Blank
+//lines, # comments and anything else the firmware prints are skipped
+bool parseKeyframes(const std::string &text, std::vector<TrajectoryKeyframe> &keyframes);
+
+bool writeSegmentFile(const char *path, const SegmentStream &stream);
+bool readSegmentFile(const char *path, SegmentStream &stream);
+
+#endif
@@ -0,0 +1,549 @@
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------
+ *
+ * Plans keyframe moves on the host and plays them on the mount as a step segment stream (see panTiltTrajectory.h).
+ *
+ *   ./build/pan_tilt_trajectory fetch --port /dev/ttyUSB0 -o keyframes.txt
+ *   ./build/pan_tilt_trajectory compile keyframes.txt -o move.pts --accel 30,20,40 --csv move.csv
+ *   ./build/pan_tilt_trajectory play move.pts --port /dev/ttyUSB0
+ *   ./build/pan_tilt_trajectory retime take.pts -o timelapse.pts --scale 20 --smooth 500
+ *
+ * fetch saves the mount's keyframes. compile plans the trajectory through a keyframe file (the mount's keyframe list or lines of
+ * "pan tilt slider [hold_ms]") and writes the segments. play moves the mount to the start of the segments from wherever it is with a planned
+ * lead-in, then streams them as fast as the firmware's buffer has room. The mount must already be in the step mode the segments were compiled
+ * for. Ctrl+C stops the mount. retime smooths and rescales a joystick move captured with pan_tilt_joystick --record (see panTiltCapture.h) and
+ * writes it as new segments. A capture plays back exactly as it was recorded without it. retime fails if the result goes over the --speed or
+ * --accel limits compile plans to. play needs the firmware built with SEGMENT_STREAM (panTiltMount.h).
+ *
+ *--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#include "panTiltCapture.h"
+#include "panTiltLink.h"
+#include "panTiltTrajectory.h"
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define INSTRUCTION_DEBUG_STATUS 'R' //panTiltMount.h
+#define INSTRUCTION_TELEMETRY_PERIOD '='
+#define INSTRUCTION_JOB_STOP '!'
+
+#define TOOL_REPLY_MS 1500 //Time allowed for a reply to an instruction
+#define TOOL_CREDIT_TIMEOUT_MS 2000 //A segment packet not answered by then means the firmware has lost the stream
+
+static volatile sig_atomic_t stop_signal = 0;
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void signalHandler(int){
+    stop_signal = 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void usage(void){
+    fprintf(stderr, "Usage: pan_tilt_trajectory fetch --port PORT -o KEYFRAMES\n"
+        "       pan_tilt_trajectory compile KEYFRAMES -o SEGMENTS [options]\n"
+        "       pan_tilt_trajectory play SEGMENTS --port PORT [options]\n"
+        "       pan_tilt_trajectory retime SEGMENTS -o SEGMENTS [--scale X] [--smooth MS] [--period MS] [--speed ...] [--accel ...] [--herringbone]\n"
+        "  --port PORT              Serial port of the mount\n"
+        "  -o FILE                  Output file\n"
+        "  --speed PAN,TILT,SLIDER  Velocity limits in degrees/s and mm/s\n"
+        "  --accel PAN,TILT,SLIDER  Acceleration limits in degrees/s^2 and mm/s^2\n"
+        "  --jerk PAN,TILT,SLIDER   Jerk limits in degrees/s^3 and mm/s^3. 0 = not limited\n"
+        "  --step-mode N            2, 4, 8 or 16 (default 16)\n"
+        "  --herringbone            The tilt axis has the herringbone gears\n"
+        "  --period MS              Segment period (default %d)\n"
+        "  --threads N              Optimiser threads (default one per core)\n"
+        "  --stop-at-keyframes      Stop at every keyframe and move in straight lines\n"
+        "  --csv FILE               Also write the trajectory at each segment to FILE\n"
+        "  --scale X                Play the segments X times longer, e.g. 10 for a timelapse (default 1)\n"
+        "  --smooth MS              Moving average over MS to smooth a captured move (default 0)\n"
+        "  --verbose                Print everything the mount sends while playing\n", TRAJECTORY_PERIOD_MS);
+    exit(2);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool parseTriple(const char *text, AxisLimits *limits, double AxisLimits::*field){
+    double values[TRAJECTORY_AXES];
+    if(sscanf(text, "%lf,%lf,%lf", &values[0], &values[1], &values[2]) != TRAJECTORY_AXES){
+        return false;
+    }
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        limits[axis].*field = values[axis];
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool readFile(const char *path, std::string &text){
+    FILE *file = fopen(path, "rb");
+    if(file == NULL){
+        return false;
+    }
+    char buffer[4096];
+    size_t length;
+    while((length = fread(buffer, 1, sizeof(buffer), file)) > 0){
+        text.append(buffer, length);
+    }
+    fclose(file);
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void printReport(const Trajectory &trajectory, const SegmentStream &stream){
+    const TrajectoryReport &report = trajectory.report();
+    const char *names[TRAJECTORY_AXES] = {"Pan", "Tilt", "Slider"};
+    const char *units[TRAJECTORY_AXES] = {"deg", "deg", "mm"};
+    printf("Duration: %.3fs\t%lu segments of %dms\t%d runs\t%d grid points\t%d limit iterations\tOptimised in %.1fms\n", report.durationS,
+        (unsigned long)stream.count(), stream.periodMs, report.runs, report.gridPoints, report.limitIterations, report.optimiseMs);
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        printf("%s max: %.3f %s/s\t%.3f %s/s^2\t%.3f %s/s^3\n", names[axis], report.maxVelocity[axis], units[axis], report.maxAcceleration[axis],
+            units[axis], report.maxJerk[axis], units[axis]);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool writeCsv(const char *path, const Trajectory &trajectory, int periodMs){
+    FILE *csv = fopen(path, "w");
+    if(csv == NULL){
+        return false;
+    }
+    fprintf(csv, "time_s,pan_deg,tilt_deg,slider_mm,pan_deg_s,tilt_deg_s,slider_mm_s,pan_deg_s2,tilt_deg_s2,slider_mm_s2\n");
+    long count = (long)ceil(trajectory.duration() * 1000 / periodMs);
+    for(long k = 0; k <= count; k++){
+        double t = std::min(k * periodMs / 1000.0, trajectory.duration());
+        double position[TRAJECTORY_AXES], velocity[TRAJECTORY_AXES], acceleration[TRAJECTORY_AXES];
+        trajectory.sample(t, position, velocity, acceleration);
+        fprintf(csv, "%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", t, position[0], position[1], position[2], velocity[0], velocity[1], velocity[2],
+            acceleration[0], acceleration[1], acceleration[2]);
+    }
+    return fclose(csv) == 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static int compile(const char *input, const char *output, const char *csvPath, const TrajectoryOptions &options){
+    std::string text;
+    std::vector<TrajectoryKeyframe> keyframes;
+    if(!readFile(input, text)){
+        perror(input);
+        return 1;
+    }
+    if(!parseKeyframes(text, keyframes)){
+        fprintf(stderr, "Error: no keyframes in %s\n", input);
+        return 1;
+    }
+    Trajectory trajectory;
+    SegmentStream stream;
+    std::string error;
+    if(!trajectory.plan(keyframes, options, error) || !trajectory.compile(stream, error)){
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return 1;
+    }
+    printf("%lu keyframes\n", (unsigned long)keyframes.size());
+    printReport(trajectory, stream);
+    if(!writeSegmentFile(output, stream)){
+        perror(output);
+        return 1;
+    }
+    if(csvPath != NULL && !writeCsv(csvPath, trajectory, options.periodMs)){
+        perror(csvPath);
+        return 1;
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static int retime(const char *input, const char *output, const RetimeOptions &retimeOptions){
+    SegmentStream capture, stream;
+    std::string error;
+    if(!readSegmentFile(input, capture)){
+        fprintf(stderr, "Error: %s isn't a segment file\n", input);
+        return 1;
+    }
+    if(!retimeSegments(capture, retimeOptions, stream, error)){
+        fprintf(stderr, "Error: %s\n", error.c_str());
+        return 1;
+    }
+    printf("Duration: %.3fs\tRetimed: %.3fs\t%lu segments of %dms\n", capture.count() * capture.periodMs / 1000.0,
+        stream.count() * stream.periodMs / 1000.0, (unsigned long)stream.count(), stream.periodMs);
+    const char *names[TRAJECTORY_AXES] = {"Pan", "Tilt", "Slider"};
+    const char *units[TRAJECTORY_AXES] = {"deg", "deg", "mm"};
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){ //The firmware caps each axis at its max speed so a move sped up past it falls behind
+        int peak = 0;
+        for(size_t k = 0; k < stream.count(); k++){
+            peak = std::max(peak, abs(stream.steps[k * TRAJECTORY_AXES + axis]));
+        }
+        printf("%s max: %.3f %s/s\n", names[axis], peak * 1000.0 / stream.periodMs / axisStepsPerUnit(axis, stream.stepMode, retimeOptions.herringboneTilt),
+            units[axis]);
+    }
+    if(!writeSegmentFile(output, stream)){
+        perror(output);
+        return 1;
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Lines from the mount with the segment credits taken out. A credit's value can be any byte, including '\n', so it is read as part of the credit.
+
+class MountReader {
+public:
+    MountReader(PanTiltLink &link, bool verbose) : _link(link), _verbose(verbose), _inCredit(false), _at(0) {}
+
+    bool next(int timeoutMs, std::string &line, int &credit){ //A line or a credit (-1 if it's a line). False on timeout
+        uint64_t endUs = monotonicUs() + timeoutMs * 1000ULL;
+        while(true){
+            while(_at < _data.size()){
+                unsigned char c = _data[_at++];
+                if(_inCredit){
+                    _inCredit = false;
+                    credit = c;
+                    return true;
+                }
+                if(c == SEGMENT_CREDIT){
+                    _inCredit = true;
+                }
+                else if(c == '\n'){
+                    line.swap(_line);
+                    _line.clear();
+                    credit = -1;
+                    if(_verbose){
+                        printf("%s\n", line.c_str());
+                    }
+                    return true;
+                }
+                else if(c != '\r'){
+                    _line += (char)c;
+                }
+            }
+            _data.clear();
+            _at = 0;
+            uint64_t nowUs = monotonicUs();
+            if(nowUs >= endUs || stop_signal){
+                return false;
+            }
+            _link.waitReceive((int)((endUs - nowUs) / 1000) + 1);
+            char buffer[256];
+            size_t length;
+            while((length = _link.receive(buffer, sizeof(buffer))) > 0){
+                _data.append(buffer, length);
+            }
+        }
+    }
+
+    bool waitFor(const char *prefix, int timeoutMs, std::string &line){ //Skips everything until a line starting with prefix
+        int credit;
+        uint64_t endUs = monotonicUs() + timeoutMs * 1000ULL;
+        while(monotonicUs() < endUs){
+            if(!next((int)((endUs - monotonicUs()) / 1000) + 1, line, credit)){
+                return false;
+            }
+            if(credit < 0 && line.compare(0, strlen(prefix), prefix) == 0){
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    PanTiltLink &_link;
+    bool _verbose;
+    bool _inCredit;
+    std::string _data;
+    size_t _at;
+    std::string _line;
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool openMount(PanTiltLink &link, const char *port){
+    if(!link.open(port)){
+        return false;
+    }
+    link.waitReceive(300); //The firmware may still be starting up after the port opened and reset it
+    char discard[256];
+    while(link.receive(discard, sizeof(discard)) > 0){}
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static int fetch(const char *port, const char *output){
+    PanTiltLink link;
+    if(!openMount(link, port)){
+        return 1;
+    }
+    char instruction[4];
+    snprintf(instruction, sizeof(instruction), "%c", INSTRUCTION_DEBUG_STATUS);
+    link.sendString(instruction);
+    MountReader reader(link, false);
+    std::string line, keyframes;
+    int credit;
+    int count = 0;
+    while(reader.next(TOOL_REPLY_MS, line, credit)){ //The keyframes are the last thing in the status report
+        if(credit < 0 && line.find("| Pan: ") != std::string::npos){
+            keyframes += line + "\n";
+            count++;
+        }
+    }
+    link.close();
+    FILE *file = fopen(output, "w");
+    if(file == NULL || fputs(keyframes.c_str(), file) < 0 || fclose(file) != 0){
+        perror(output);
+        return 1;
+    }
+    printf("%d keyframes\n", count);
+    return count > 0 ? 0 : 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Plans a move from where the mount is to the start of the stream and returns its segments. The last one is adjusted so the lead-in ends on
+//exactly the step the stream starts from.
+static bool planLeadIn(const double *from, const SegmentStream &stream, TrajectoryOptions options, std::vector<int16_t> &steps){
+    std::vector<TrajectoryKeyframe> keyframes(2);
+    options.stepMode = stream.stepMode;
+    options.periodMs = stream.periodMs;
+    long fromSteps[TRAJECTORY_AXES];
+    bool moving = false;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        double stepsPerUnit = axisStepsPerUnit(axis, stream.stepMode, options.herringboneTilt);
+        fromSteps[axis] = lround(from[axis] * stepsPerUnit);
+        keyframes[0].position[axis] = from[axis];
+        keyframes[1].position[axis] = stream.startSteps[axis] / stepsPerUnit;
+        moving = moving || fromSteps[axis] != stream.startSteps[axis];
+    }
+    keyframes[0].holdMs = keyframes[1].holdMs = 0;
+    steps.clear();
+    if(!moving){
+        return true;
+    }
+    Trajectory trajectory;
+    SegmentStream leadIn;
+    std::string error;
+    if(!trajectory.plan(keyframes, options, error) || !trajectory.compile(leadIn, error) || leadIn.count() == 0){
+        fprintf(stderr, "Error: can't plan the lead-in: %s\n", error.c_str());
+        return false;
+    }
+    steps = leadIn.steps;
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        long end = leadIn.startSteps[axis];
+        for(size_t k = 0; k < leadIn.count(); k++){
+            end += steps[k * TRAJECTORY_AXES + axis];
+        }
+        steps[steps.size() - TRAJECTORY_AXES + axis] += (int16_t)((stream.startSteps[axis] - end) - (leadIn.startSteps[axis] - fromSteps[axis]));
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static int play(const char *input, const char *port, const TrajectoryOptions &options, bool verbose){
+    SegmentStream stream;
+    if(!readSegmentFile(input, stream)){
+        fprintf(stderr, "Error: %s isn't a segment file\n", input);
+        return 1;
+    }
+    PanTiltLink link;
+    if(!openMount(link, port)){
+        return 1;
+    }
+    MountReader reader(link, verbose);
+    char instruction[16];
+    std::string line;
+    snprintf(instruction, sizeof(instruction), "%c-1", INSTRUCTION_TELEMETRY_PERIOD);
+    link.sendString(instruction);
+    double from[TRAJECTORY_AXES];
+    if(!reader.waitFor("Pan: ", TOOL_REPLY_MS, line) || sscanf(line.c_str(), "Pan: %lf%*[^T]Tilt: %lf%*[^S]Slider: %lf", &from[0], &from[1],
+        &from[2]) != TRAJECTORY_AXES){
+        fprintf(stderr, "Error: no position from the mount\n");
+        return 1;
+    }
+    std::vector<int16_t> steps;
+    if(!planLeadIn(from, stream, options, steps)){
+        return 1;
+    }
+    size_t leadIn = steps.size() / TRAJECTORY_AXES;
+    steps.insert(steps.end(), stream.steps.begin(), stream.steps.end());
+    size_t total = steps.size() / TRAJECTORY_AXES;
+    printf("Lead-in: %.2fs\tSegments: %.2fs\n", leadIn * stream.periodMs / 1000.0, stream.count() * stream.periodMs / 1000.0);
+
+    snprintf(instruction, sizeof(instruction), "%c%d", INSTRUCTION_SEGMENTS, stream.periodMs);
+    link.sendString(instruction);
+    if(!reader.waitFor("Segments: ", TOOL_REPLY_MS, line)){
+        fprintf(stderr, "Error: the mount didn't start the segments. Is a job running?\n");
+        return 1;
+    }
+    int stepMode = 0;
+    if(sscanf(line.c_str(), "Segments: %*dms\tStep mode: %d", &stepMode) != 1 || stepMode != stream.stepMode){ //Not set here as m also clears the keyframes
+        fprintf(stderr, "Error: the mount is in %d step mode and the segments are for %d. Send m%d first\n", stepMode, stream.stepMode, stream.stepMode);
+        snprintf(instruction, sizeof(instruction), "%c0", INSTRUCTION_SEGMENTS);
+        link.sendString(instruction);
+        link.drain(1000);
+        return 1;
+    }
+    std::deque<size_t> unacknowledged; //Segments in each packet waiting for its credit
+    size_t sent = 0;
+    int credit = SEGMENT_BUFFER_LENGTH;
+    uint64_t lastCreditUs = monotonicUs();
+    bool failed = false;
+    while(sent < total && !stop_signal){
+        size_t count = std::min(std::min((size_t)SEGMENT_FRAME_MAX, total - sent), (size_t)std::max(credit, 0));
+        if(count > 0 && unacknowledged.size() < 2){ //Two packets are enough to keep the buffer topped up and keep the link's queue short
+            uint8_t frame[SEGMENT_FRAME_LENGTH(SEGMENT_FRAME_MAX)];
+            size_t length = encodeSegments(&steps[sent * TRAJECTORY_AXES], count, frame);
+            link.send(frame, length);
+            if(unacknowledged.empty()){
+                lastCreditUs = monotonicUs();
+            }
+            unacknowledged.push_back(count);
+            sent += count;
+            credit -= (int)count;
+            continue;
+        }
+        int reply;
+        if(!reader.next(unacknowledged.empty() ? stream.periodMs : 10, line, reply)){
+            if(unacknowledged.empty()){ //The buffer was full. An empty packet asks how much room there is now a segment has played
+                uint8_t frame[SEGMENT_FRAME_LENGTH(0)];
+                link.send(frame, encodeSegments(NULL, 0, frame));
+                lastCreditUs = monotonicUs();
+                unacknowledged.push_back(0);
+            }
+            else if(monotonicUs() - lastCreditUs > TOOL_CREDIT_TIMEOUT_MS * 1000ULL){
+                fprintf(stderr, "Error: the mount stopped answering the segments\n");
+                failed = true;
+                break;
+            }
+            continue;
+        }
+        if(reply < 0){
+            if(line == "Finished" || line.compare(0, 17, "Segments played: ") == 0){
+                fprintf(stderr, "Error: the segments were stopped on the mount\n");
+                failed = true;
+                break;
+            }
+            continue;
+        }
+        if(!unacknowledged.empty()){
+            unacknowledged.pop_front();
+        }
+        lastCreditUs = monotonicUs();
+        credit = reply;
+        for(size_t i = 0; i < unacknowledged.size(); i++){
+            credit -= (int)unacknowledged[i];
+        }
+    }
+    if(stop_signal || failed){
+        snprintf(instruction, sizeof(instruction), "%c", INSTRUCTION_JOB_STOP);
+        link.sendString(instruction);
+        link.drain(1000);
+        return 1;
+    }
+    snprintf(instruction, sizeof(instruction), "%c0", INSTRUCTION_SEGMENTS);
+    link.sendString(instruction);
+    if(!reader.waitFor("Segments played: ", (SEGMENT_BUFFER_LENGTH + SEGMENT_FRAME_MAX * 2) * stream.periodMs + TOOL_REPLY_MS * 2, line)){
+        fprintf(stderr, "Error: the mount didn't finish the segments\n");
+        return 1;
+    }
+    printf("%s\n", line.c_str());
+    link.close();
+    return line.find("Underruns: 0\t") != std::string::npos ? 0 : 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        usage();
+    }
+    const char *command = argv[1];
+    const char *port = NULL;
+    const char *input = NULL;
+    const char *output = NULL;
+    const char *csvPath = NULL;
+    bool verbose = false;
+    TrajectoryOptions options = defaultTrajectoryOptions();
+    RetimeOptions retimeOptions = {1, 0, 0, {}, false};
+    for(int i = 2; i < argc; i++){
+        const char *option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(strcmp(option, "--port") == 0 && hasValue){
+            port = argv[++i];
+        }
+        else if(strcmp(option, "-o") == 0 && hasValue){
+            output = argv[++i];
+        }
+        else if(strcmp(option, "--speed") == 0 && hasValue){
+            if(!parseTriple(argv[++i], options.limits, &AxisLimits::velocity)) usage();
+        }
+        else if(strcmp(option, "--accel") == 0 && hasValue){
+            if(!parseTriple(argv[++i], options.limits, &AxisLimits::acceleration)) usage();
+        }
+        else if(strcmp(option, "--jerk") == 0 && hasValue){
+            if(!parseTriple(argv[++i], options.limits, &AxisLimits::jerk)) usage();
+        }
+        else if(strcmp(option, "--step-mode") == 0 && hasValue){
+            options.stepMode = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--herringbone") == 0){
+            options.herringboneTilt = true;
+        }
+        else if(strcmp(option, "--period") == 0 && hasValue){
+            options.periodMs = retimeOptions.periodMs = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--threads") == 0 && hasValue){
+            options.threads = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--stop-at-keyframes") == 0){
+            options.stopAtKeyframes = true;
+        }
+        else if(strcmp(option, "--csv") == 0 && hasValue){
+            csvPath = argv[++i];
+        }
+        else if(strcmp(option, "--scale") == 0 && hasValue){
+            retimeOptions.timeScale = atof(argv[++i]);
+        }
+        else if(strcmp(option, "--smooth") == 0 && hasValue){
+            retimeOptions.smoothMs = atoi(argv[++i]);
+        }
+        else if(strcmp(option, "--verbose") == 0){
+            verbose = true;
+        }
+        else if(option[0] != '-' && input == NULL){
+            input = option;
+        }
+        else{
+            usage();
+        }
+    }
+    if(options.stepMode != 2 && options.stepMode != 4 && options.stepMode != 8 && options.stepMode != 16){
+        usage();
+    }
+    if(strcmp(command, "compile") == 0 && input != NULL && output != NULL){
+        return compile(input, output, csvPath, options);
+    }
+    if(strcmp(command, "retime") == 0 && input != NULL && output != NULL){
+        memcpy(retimeOptions.limits, options.limits, sizeof(options.limits)); //The same limits as compile
+        retimeOptions.herringboneTilt = options.herringboneTilt;
+        return retime(input, output, retimeOptions);
+    }
+    if(strcmp(command, "fetch") == 0 && port != NULL && output != NULL){
+        return fetch(port, output);
+    }
+    if(strcmp(command, "play") == 0 && input != NULL && port != NULL){
+        signal(SIGINT, signalHandler);
+        return play(input, port, options, verbose);
+    }
+    usage();
+    return 2;
+}
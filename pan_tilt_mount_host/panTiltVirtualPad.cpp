@@ -0,0 +1,211 @@
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------
+ *
+ * Virtual gamepad for testing pan_tilt_joystick without a controller. It creates a uinput device laid out like the xpad driver's Xbox controller
+ * (or writes the same input_events to a FIFO with --fifo when /dev/uinput isn't available) and plays a script of moves from standard input:
+ *
+ *  axis NAME VALUE                         Move an axis (lx ly rx ry lt rt hatx haty) to a raw evdev value. The sticks are -32768 to 32767 with up
+ *                                          negative like xpad, the triggers 0 to 255 and the hat -1 to 1
+ *  press NAME / release NAME / tap NAME    Button a b x y lb rb view menu l r
+ *  wait MS                                 Pause
+ *  sweep NAME AMPLITUDE HZ SECONDS RATE    Move an axis in a sine wave, RATE updates a second
+ *
+ * Lines starting with "//" are comments.
+ *
+ *--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#define VIRTUAL_PAD_NAME "Pan Tilt Virtual Pad"
+#define UINPUT_SETTLE_MS 500 //Time for udev to create the event device before the first move
+
+struct NamedCode {
+    const char *name;
+    int code;
+};
+
+static const NamedCode axis_codes[] = {
+    {"lx", ABS_X}, {"ly", ABS_Y}, {"rx", ABS_RX}, {"ry", ABS_RY}, {"lt", ABS_Z}, {"rt", ABS_RZ}, {"hatx", ABS_HAT0X}, {"haty", ABS_HAT0Y},
+};
+
+static const NamedCode button_codes[] = {
+    {"a", BTN_SOUTH}, {"b", BTN_EAST}, {"x", BTN_NORTH}, {"y", BTN_WEST}, {"lb", BTN_TL}, {"rb", BTN_TR}, {"view", BTN_SELECT},
+    {"menu", BTN_START}, {"l", BTN_THUMBL}, {"r", BTN_THUMBR},
+};
+
+static int output_fd = -1;
+static bool fifo_output = false; //Events are timestamped here rather than by the kernel
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static int findCode(const NamedCode *codes, size_t count, const char *name){
+    for(size_t i = 0; i < count; i++){
+        if(strcmp(codes[i].name, name) == 0){
+            return codes[i].code;
+        }
+    }
+    return -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void emit(int type, int code, int value){
+    struct input_event event;
+    memset(&event, 0, sizeof(event));
+    if(fifo_output){ //On CLOCK_MONOTONIC like the kernel's events after EVIOCSCLOCKID
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        event.input_event_sec = now.tv_sec;
+        event.input_event_usec = now.tv_nsec / 1000;
+    }
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    if(write(output_fd, &event, sizeof(event)) != sizeof(event)){
+        perror("write");
+        exit(1);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void sendPacket(int type, int code, int value){
+    emit(type, code, value);
+    emit(EV_SYN, SYN_REPORT, 0);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void sleepMs(double ms){
+    struct timespec delay;
+    delay.tv_sec = (time_t)(ms / 1000);
+    delay.tv_nsec = (long)((ms - delay.tv_sec * 1000.0) * 1000000);
+    nanosleep(&delay, NULL);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool createUinput(void){
+    output_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if(output_fd < 0){
+        fprintf(stderr, "Error: unable to open /dev/uinput: %s. Load the uinput module or use --fifo\n", strerror(errno));
+        return false;
+    }
+    ioctl(output_fd, UI_SET_EVBIT, EV_KEY);
+    for(size_t i = 0; i < sizeof(button_codes) / sizeof(button_codes[0]); i++){
+        ioctl(output_fd, UI_SET_KEYBIT, button_codes[i].code);
+    }
+    ioctl(output_fd, UI_SET_EVBIT, EV_ABS);
+    struct uinput_user_dev device;
+    memset(&device, 0, sizeof(device));
+    snprintf(device.name, UINPUT_MAX_NAME_SIZE, VIRTUAL_PAD_NAME);
+    device.id.bustype = BUS_VIRTUAL;
+    device.id.vendor = 0x045e; //Microsoft
+    device.id.product = 0x02ea; //Xbox One S controller
+    for(size_t i = 0; i < sizeof(axis_codes) / sizeof(axis_codes[0]); i++){
+        int code = axis_codes[i].code;
+        ioctl(output_fd, UI_SET_ABSBIT, code);
+        bool trigger = (code == ABS_Z || code == ABS_RZ);
+        bool hat = (code == ABS_HAT0X || code == ABS_HAT0Y);
+        device.absmin[code] = hat ? -1 : (trigger ? 0 : -32768);
+        device.absmax[code] = hat ? 1 : (trigger ? 255 : 32767);
+    }
+    if(write(output_fd, &device, sizeof(device)) != sizeof(device) || ioctl(output_fd, UI_DEV_CREATE) < 0){
+        fprintf(stderr, "Error: unable to create the uinput device: %s\n", strerror(errno));
+        return false;
+    }
+    fprintf(stderr, "Created %s\n", VIRTUAL_PAD_NAME);
+    sleepMs(UINPUT_SETTLE_MS);
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool runLine(char *line){
+    char command[16];
+    char name[16];
+    double a = 0, b = 0, c = 0, d = 0;
+    int fields = sscanf(line, "%15s %15s %lf %lf %lf %lf", command, name, &a, &b, &c, &d);
+    if(fields < 1 || strncmp(command, "//", 2) == 0){
+        return true;
+    }
+    if(strcmp(command, "wait") == 0){
+        sleepMs(atof(name));
+        return true;
+    }
+    if(fields < 2){
+        return false;
+    }
+    if(strcmp(command, "axis") == 0 || strcmp(command, "sweep") == 0){
+        int code = findCode(axis_codes, sizeof(axis_codes) / sizeof(axis_codes[0]), name);
+        if(code < 0){
+            return false;
+        }
+        if(command[0] == 'a'){
+            sendPacket(EV_ABS, code, (int)a);
+            return true;
+        }
+        if(fields < 6 || d <= 0){ //sweep NAME AMPLITUDE HZ SECONDS RATE
+            return false;
+        }
+        int updates = (int)(c * d);
+        for(int i = 0; i <= updates; i++){
+            sendPacket(EV_ABS, code, i == updates ? 0 : (int)(a * sin(2 * M_PI * b * i / d)));
+            sleepMs(1000.0 / d);
+        }
+        return true;
+    }
+    int code = findCode(button_codes, sizeof(button_codes) / sizeof(button_codes[0]), name);
+    if(code < 0){
+        return false;
+    }
+    if(strcmp(command, "press") == 0 || strcmp(command, "tap") == 0){
+        sendPacket(EV_KEY, code, 1);
+    }
+    if(strcmp(command, "tap") == 0){
+        sleepMs(50);
+    }
+    if(strcmp(command, "release") == 0 || strcmp(command, "tap") == 0){
+        sendPacket(EV_KEY, code, 0);
+    }
+    return strcmp(command, "press") == 0 || strcmp(command, "release") == 0 || strcmp(command, "tap") == 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main(int argc, char **argv){
+    if(argc == 3 && strcmp(argv[1], "--fifo") == 0){
+        output_fd = open(argv[2], O_WRONLY); //Waits for pan_tilt_joystick to open the other end
+        if(output_fd < 0){
+            fprintf(stderr, "Error: unable to open %s: %s\n", argv[2], strerror(errno));
+            return 1;
+        }
+        fifo_output = true;
+    }
+    else if(argc != 1 || !createUinput()){
+        if(argc != 1){
+            fprintf(stderr, "Usage: pan_tilt_virtual_pad [--fifo PATH] < script\n");
+        }
+        return 1;
+    }
+    char line[128];
+    while(fgets(line, sizeof(line), stdin) != NULL){
+        if(!runLine(line)){
+            fprintf(stderr, "Unknown: %s", line);
+        }
+    }
+    if(!fifo_output){
+        sleepMs(100); //Let the reader see the last events before the device goes
+        ioctl(output_fd, UI_DEV_DESTROY);
+    }
+    close(output_fd);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Fixed size byte queue between one producer thread and one consumer thread. Nothing is allocated after construction and neither side takes a lock.
+//SIZE must be a power of 2. The indexes run freely and are masked on use so the whole buffer can be filled.
+
+template<size_t SIZE>
+class RingBuffer {
+    static_assert((SIZE & (SIZE - 1)) == 0, "RingBuffer size must be a power of 2");
+
+public:
+    RingBuffer(void) : _head(0), _tail(0) {}
+
+    size_t available(void) const { //Bytes waiting to be read
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+    }
+
+    size_t space(void) const { //Bytes that can be written
+        return SIZE - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+    }
+
+    size_t write(const void *data, size_t length){ //Producer only. Returns how many bytes fitted
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t count = SIZE - (head - _tail.load(std::memory_order_acquire));
+        if(length < count){
+            count = length;
+        }
+        copyIn(head, (const uint8_t*)data, count);
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t peek(void *data, size_t length) const { //Consumer only. Copies without removing
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t count = _head.load(std::memory_order_acquire) - tail;
+        if(length < count){
+            count = length;
+        }
+        copyOut(tail, (uint8_t*)data, count);
+        return count;
+    }
+
+    void skip(size_t length){ //Consumer only. Length must not be more than available()
+        _tail.store(_tail.load(std::memory_order_relaxed) + length, std::memory_order_release);
+    }
+
+    size_t read(void *data, size_t length){ //Consumer only
+        size_t count = peek(data, length);
+        skip(count);
+        return count;
+    }
+
+    void clear(void){ //Consumer only
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    void copyIn(size_t index, const uint8_t *data, size_t count){
+        size_t start = index & (SIZE - 1);
+        size_t first = (count < SIZE - start) ? count : SIZE - start;
+        memcpy(&_data[start], data, first);
+        memcpy(&_data[0], data + first, count - first);
+    }
+
+    void copyOut(size_t index, uint8_t *data, size_t count) const {
+        size_t start = index & (SIZE - 1);
+        size_t first = (count < SIZE - start) ? count : SIZE - start;
+        memcpy(data, &_data[start], first);
+        memcpy(data + first, &_data[0], count - first);
+    }
+
+    uint8_t _data[SIZE];
+    std::atomic<size_t> _head; //Written by the producer
+    std::atomic<size_t> _tail; //Written by the consumer
+};
+
+#endif
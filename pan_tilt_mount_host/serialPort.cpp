@@ -0,0 +1,279 @@
+#include "serialPort.h"
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static speed_t baudConstant(long baud){
+    switch(baud){
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        default: return 0;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+SerialPort::SerialPort(void) : _fd(-1) {
+    _wakePipe[0] = -1;
+    _wakePipe[1] = -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+SerialPort::~SerialPort(void){
+    close();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool SerialPort::open(const char *name, long baud){
+    close();
+    speed_t speed = baudConstant(baud);
+    if(speed == 0){
+        fprintf(stderr, "Error: unsupported baud rate %ld\n", baud);
+        return false;
+    }
+    _fd = ::open(name, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if(_fd < 0){
+        fprintf(stderr, "Error: unable to open %s: %s\n", name, strerror(errno));
+        return false;
+    }
+    struct termios tty;
+    if(tcgetattr(_fd, &tty) != 0){
+        fprintf(stderr, "Error: %s is not a serial port: %s\n", name, strerror(errno));
+        close();
+        return false;
+    }
+    cfmakeraw(&tty); //8 data bits, no parity, no echo or line editing
+    tty.c_cflag &= ~(CSTOPB | CRTSCTS | HUPCL); //1 stop bit, no flow control and leave DTR alone on close so the Nano doesn't reset
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    if(tcsetattr(_fd, TCSANOW, &tty) != 0){
+        fprintf(stderr, "Error: unable to configure %s: %s\n", name, strerror(errno));
+        close();
+        return false;
+    }
+    if(pipe(_wakePipe) != 0){
+        fprintf(stderr, "Error: pipe: %s\n", strerror(errno));
+        close();
+        return false;
+    }
+    for(int i = 0; i < 2; i++){
+        fcntl(_wakePipe[i], F_SETFL, fcntl(_wakePipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(_wakePipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void SerialPort::close(void){
+    if(_fd >= 0){
+        ::close(_fd);
+        _fd = -1;
+    }
+    for(int i = 0; i < 2; i++){
+        if(_wakePipe[i] >= 0){
+            ::close(_wakePipe[i]);
+            _wakePipe[i] = -1;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool SerialPort::isOpen(void) const {
+    return _fd >= 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long SerialPort::read(void *data, size_t length){
+    ssize_t count = ::read(_fd, data, length);
+    if(count < 0){
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    return count;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long SerialPort::write(const void *data, size_t length){
+    ssize_t count = ::write(_fd, data, length);
+    if(count < 0){
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    return count;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int SerialPort::wait(bool writing, int timeoutMs){
+    struct pollfd fds[2] = {{_fd, (short)(POLLIN | (writing ? POLLOUT : 0)), 0}, {_wakePipe[0], POLLIN, 0}};
+    int result = poll(fds, 2, timeoutMs);
+    if(result < 0){
+        return (errno == EINTR) ? 0 : -1;
+    }
+    int ready = 0;
+    if(fds[0].revents & (POLLERR | POLLNVAL)){
+        return -1;
+    }
+    if((fds[0].revents & POLLHUP) && !(fds[0].revents & POLLIN)){ //Unplugged or the simulator has exited
+        return -1;
+    }
+    if(fds[0].revents & POLLIN){
+        ready |= SERIAL_WAIT_READ;
+    }
+    if(fds[0].revents & POLLOUT){
+        ready |= SERIAL_WAIT_WRITE;
+    }
+    if(fds[1].revents & POLLIN){
+        char drain[16];
+        while(::read(_wakePipe[0], drain, sizeof(drain)) > 0){}
+        ready |= SERIAL_WAIT_WAKE;
+    }
+    return ready;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void SerialPort::wake(void){
+    if(_wakePipe[1] >= 0){
+        char byte = 0;
+        if(::write(_wakePipe[1], &byte, 1) < 0){} //A full pipe already wakes it
+    }
+}
+
+#else
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+SerialPort::SerialPort(void) : _handle(INVALID_HANDLE_VALUE), _wakeEvent(NULL) {}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+SerialPort::~SerialPort(void){
+    close();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool SerialPort::open(const char *name, long baud){
+    close();
+    _handle = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(_handle == INVALID_HANDLE_VALUE){
+        fprintf(stderr, "Error: invalid com port handle. Attempted to open: %s\n", name);
+        return false;
+    }
+    DCB dcbSerialParams = {0};
+    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+    if(GetCommState(_handle, &dcbSerialParams) == 0){
+        close();
+        return false;
+    }
+    dcbSerialParams.BaudRate = baud; //1 start bit, 1 stop bit, no parity
+    dcbSerialParams.ByteSize = 8;
+    dcbSerialParams.StopBits = ONESTOPBIT;
+    dcbSerialParams.Parity = NOPARITY;
+    dcbSerialParams.fDtrControl = DTR_CONTROL_DISABLE; //Stops the Arduino resetting after connecting
+    if(SetCommState(_handle, &dcbSerialParams) == 0){
+        close();
+        return false;
+    }
+    COMMTIMEOUTS timeouts = {0};
+    timeouts.ReadIntervalTimeout = MAXDWORD; //Reads return straight away with whatever has arrived
+    timeouts.WriteTotalTimeoutConstant = 1;
+    if(SetCommTimeouts(_handle, &timeouts) == 0){
+        close();
+        return false;
+    }
+    _wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void SerialPort::close(void){
+    if(_handle != INVALID_HANDLE_VALUE){
+        CloseHandle(_handle);
+        _handle = INVALID_HANDLE_VALUE;
+    }
+    if(_wakeEvent != NULL){
+        CloseHandle(_wakeEvent);
+        _wakeEvent = NULL;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool SerialPort::isOpen(void) const {
+    return _handle != INVALID_HANDLE_VALUE;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long SerialPort::read(void *data, size_t length){
+    DWORD bytesRead = 0;
+    if(!ReadFile(_handle, data, (DWORD)length, &bytesRead, NULL)){
+        return -1;
+    }
+    return bytesRead;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long SerialPort::write(const void *data, size_t length){
+    DWORD bytesWritten = 0;
+    if(!WriteFile(_handle, data, (DWORD)length, &bytesWritten, NULL) && GetLastError() != ERROR_TIMEOUT){
+        return -1;
+    }
+    return bytesWritten;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int SerialPort::wait(bool writing, int timeoutMs){ //The comm API has no readiness wait without overlapped I/O so the receive queue is checked every 1ms
+    for(int waited = 0; ; waited++){
+        COMSTAT status;
+        DWORD errors;
+        if(!ClearCommError(_handle, &errors, &status)){
+            return -1;
+        }
+        int ready = (status.cbInQue > 0 ? SERIAL_WAIT_READ : 0) | (writing ? SERIAL_WAIT_WRITE : 0);
+        if(ready != 0){
+            return ready;
+        }
+        if(timeoutMs >= 0 && waited >= timeoutMs){
+            return 0;
+        }
+        if(WaitForSingleObject(_wakeEvent, 1) == WAIT_OBJECT_0){
+            return SERIAL_WAIT_WAKE;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void SerialPort::wake(void){
+    if(_wakeEvent != NULL){
+        SetEvent(_wakeEvent);
+    }
+}
+
+#endif
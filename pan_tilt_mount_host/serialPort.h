@@ -0,0 +1,42 @@
+#ifndef SERIALPORT_H
+#define SERIALPORT_H
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Raw 8N1 serial port. termios on Linux and macOS (a pseudo terminal from the simulator's --pty works too), the Win32 comm API on Windows.
+//read() and write() never block. wait() blocks until the port can be read or written, wake() is called or the timeout runs out.
+
+#define SERIAL_WAIT_READ 1
+#define SERIAL_WAIT_WRITE 2
+#define SERIAL_WAIT_WAKE 4
+
+class SerialPort {
+public:
+    SerialPort(void);
+    ~SerialPort(void);
+
+    bool open(const char *name, long baud); //Prints the reason to stderr and returns false if it fails
+    void close(void);
+    bool isOpen(void) const;
+
+    long read(void *data, size_t length); //Bytes read, 0 if there are none or -1 if the port has failed
+    long write(const void *data, size_t length); //Bytes accepted by the driver or -1 if the port has failed
+    int wait(bool writing, int timeoutMs); //SERIAL_WAIT_ flags for what is ready, 0 on a timeout or -1 if the port has failed
+    void wake(void); //Thread safe. Makes a wait() in another thread return
+
+private:
+#ifdef _WIN32
+    HANDLE _handle;
+    HANDLE _wakeEvent;
+#else
+    int _fd;
+    int _wakePipe[2];
+#endif
+};
+
+#endif
@@ -0,0 +1,365 @@
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------
+ *
+ * Unit tests for the host side code that doesn't need a mount: the trajectory planner and segment compiler, retiming a capture, the daemon's
+ * JSON and the link's ring buffer. Run with "make test". Each failed check prints where it is and the test exits with 1 if any failed.
+ *
+ *--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#include "panTiltCapture.h"
+#include "panTiltJson.h"
+#include "panTiltTrajectory.h"
+#include "ringBuffer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static int checks_run = 0;
+static int checks_failed = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static bool check(bool passed, const char *text, const char *file, int line){
+    checks_run++;
+    if(!passed){
+        checks_failed++;
+        printf("%s:%d: Failed: %s\n", file, line, text);
+    }
+    return passed;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static TrajectoryKeyframe keyframe(double pan, double tilt, double slider, int holdMs = 0){
+    TrajectoryKeyframe frame = {{pan, tilt, slider}, holdMs};
+    return frame;
+}
+
+static std::vector<TrajectoryKeyframe> testKeyframes(void){ //A curved path with a hold part way so there are two runs
+    std::vector<TrajectoryKeyframe> keyframes;
+    keyframes.push_back(keyframe(0, 0, 0));
+    keyframes.push_back(keyframe(40, 10, 100));
+    keyframes.push_back(keyframe(-20, 25, 250, 500));
+    keyframes.push_back(keyframe(30, -15, 400));
+    keyframes.push_back(keyframe(90, 0, 300));
+    return keyframes;
+}
+
+static bool planAndCompile(const std::vector<TrajectoryKeyframe> &keyframes, const TrajectoryOptions &options, Trajectory &trajectory,
+    SegmentStream &stream){
+    std::string error;
+    bool planned = CHECK(trajectory.plan(keyframes, options, error));
+    return planned && CHECK(trajectory.compile(stream, error));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Sampled every millisecond. The planner allows 1% over the limits as a speed ratio so the acceleration can be 2% over.
+
+static void testTrajectoryLimits(void){
+    TrajectoryOptions options = defaultTrajectoryOptions();
+    options.threads = 1;
+    Trajectory trajectory;
+    SegmentStream stream;
+    if(!planAndCompile(testKeyframes(), options, trajectory, stream)){
+        return;
+    }
+    double worstVelocity[TRAJECTORY_AXES] = {0, 0, 0};
+    double worstAcceleration[TRAJECTORY_AXES] = {0, 0, 0};
+    for(double t = 0; t <= trajectory.duration(); t += 0.001){
+        double position[TRAJECTORY_AXES], velocity[TRAJECTORY_AXES], acceleration[TRAJECTORY_AXES];
+        trajectory.sample(t, position, velocity, acceleration);
+        for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+            worstVelocity[axis] = std::max(worstVelocity[axis], fabs(velocity[axis]) / options.limits[axis].velocity);
+            worstAcceleration[axis] = std::max(worstAcceleration[axis], fabs(acceleration[axis]) / options.limits[axis].acceleration);
+        }
+    }
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+        CHECK(worstVelocity[axis] <= 1.01);
+        CHECK(worstAcceleration[axis] <= 1.0201);
+        CHECK(trajectory.report().maxVelocity[axis] <= options.limits[axis].velocity * 1.01);
+    }
+
+    for(int axis = 0; axis < TRAJECTORY_AXES; axis++){ //No segment moves faster than the velocity limit allows, give or take the rounding
+        double stepsPerUnit = axisStepsPerUnit(axis, options.stepMode, options.herringboneTilt);
+        double most = options.limits[axis].velocity * 1.01 * stepsPerUnit * options.periodMs / 1000.0 + 1;
+        for(size_t k = 0; k < stream.count(); k++){
+            if(!CHECK(fabs(stream.steps[k * TRAJECTORY_AXES + axis]) <= most)){
+                break;
+            }
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//The segments carry whole steps worked out from the absolute positions so they must add up to the keyframes exactly. Stopping at every keyframe
+//means each one is passed through at some segment.
+
+static void testSegmentsSumToKeyframes(void){
+    std::vector<TrajectoryKeyframe> keyframes = testKeyframes();
+    for(int stop = 0; stop <= 1; stop++){
+        TrajectoryOptions options = defaultTrajectoryOptions();
+        options.threads = 1;
+        options.stopAtKeyframes = stop;
+        Trajectory trajectory;
+        SegmentStream stream;
+        if(!planAndCompile(keyframes, options, trajectory, stream)){
+            return;
+        }
+        size_t next = 1; //Keyframe looked for next
+        long position[TRAJECTORY_AXES];
+        for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+            double stepsPerUnit = axisStepsPerUnit(axis, options.stepMode, options.herringboneTilt);
+            position[axis] = stream.startSteps[axis];
+            CHECK(stream.startSteps[axis] == lround(keyframes.front().position[axis] * stepsPerUnit));
+        }
+        for(size_t k = 0; k < stream.count(); k++){
+            bool atKeyframe = next < keyframes.size();
+            for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+                position[axis] += stream.steps[k * TRAJECTORY_AXES + axis];
+                if(next < keyframes.size()){
+                    double stepsPerUnit = axisStepsPerUnit(axis, options.stepMode, options.herringboneTilt);
+                    atKeyframe = atKeyframe && position[axis] == lround(keyframes[next].position[axis] * stepsPerUnit);
+                }
+            }
+            if(atKeyframe){
+                next++;
+            }
+        }
+        for(int axis = 0; axis < TRAJECTORY_AXES; axis++){
+            double stepsPerUnit = axisStepsPerUnit(axis, options.stepMode, options.herringboneTilt);
+            CHECK(position[axis] == lround(keyframes.back().position[axis] * stepsPerUnit));
+        }
+        if(stop){
+            CHECK(next == keyframes.size());
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Each run and each block of the limit curve is worked out on its own so the thread count mustn't change a single step.
+
+static void testThreadsMatch(void){
+    TrajectoryOptions options = defaultTrajectoryOptions();
+    options.threads = 1;
+    Trajectory single;
+    SegmentStream singleStream;
+    if(!planAndCompile(testKeyframes(), options, single, singleStream)){
+        return;
+    }
+    for(int threads = 2; threads <= 8; threads *= 2){
+        options.threads = threads;
+        Trajectory threaded;
+        SegmentStream threadedStream;
+        if(!planAndCompile(testKeyframes(), options, threaded, threadedStream)){
+            return;
+        }
+        CHECK(threaded.duration() == single.duration());
+        CHECK(threadedStream.steps == singleStream.steps);
+        CHECK(memcmp(threadedStream.startSteps, singleStream.startSteps, sizeof(singleStream.startSteps)) == 0);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void testTrajectoryErrors(void){
+    std::string error;
+    Trajectory trajectory;
+    std::vector<TrajectoryKeyframe> keyframes;
+    CHECK(!trajectory.plan(keyframes, defaultTrajectoryOptions(), error));
+    keyframes.push_back(keyframe(0, 0, 0));
+    keyframes.push_back(keyframe(10, 0, 0));
+    TrajectoryOptions options = defaultTrajectoryOptions();
+    options.limits[TRAJECTORY_TILT].velocity = 0;
+    CHECK(!trajectory.plan(keyframes, options, error));
+    options = defaultTrajectoryOptions();
+    options.limits[TRAJECTORY_PAN].acceleration = NAN;
+    CHECK(!trajectory.plan(keyframes, options, error));
+    options = defaultTrajectoryOptions();
+    options.periodMs = 0;
+    CHECK(!trajectory.plan(keyframes, options, error));
+
+    keyframes.resize(1); //A single keyframe is a stream that doesn't move
+    SegmentStream stream;
+    CHECK(trajectory.plan(keyframes, defaultTrajectoryOptions(), error));
+    CHECK(trajectory.compile(stream, error));
+    CHECK(stream.count() == 0);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//A captured pan at speed degrees/s for 2s, reaching it over rampS (0 = straight away).
+
+static SegmentStream testCapture(double speed, double rampS){
+    SegmentStream capture;
+    capture.periodMs = CAPTURE_PERIOD_MS;
+    capture.stepMode = 16;
+    memset(capture.startSteps, 0, sizeof(capture.startSteps));
+    double stepsPerUnit = axisStepsPerUnit(TRAJECTORY_PAN, capture.stepMode, false);
+    double totalS = 2 + 2 * rampS;
+    long last = 0;
+    for(double t = capture.periodMs / 1000.0; t < totalS + 1e-9; t += capture.periodMs / 1000.0){
+        double position = speed * (t - rampS / 2); //Cruising
+        if(rampS > 0 && t < rampS){
+            position = speed * t * t / (2 * rampS);
+        }
+        else if(rampS > 0 && t > totalS - rampS){
+            position = speed * (totalS - rampS) - speed * (totalS - t) * (totalS - t) / (2 * rampS);
+        }
+        long steps = lround(position * stepsPerUnit);
+        capture.steps.push_back((int16_t)(steps - last));
+        capture.steps.push_back(0);
+        capture.steps.push_back(0);
+        last = steps;
+    }
+    return capture;
+}
+
+static void testRetimeLimits(void){
+    TrajectoryOptions limits = defaultTrajectoryOptions(); //18º/s and 20º/s^2 on pan
+    RetimeOptions options = {1, 0, 0, {}, false};
+    memcpy(options.limits, limits.limits, sizeof(options.limits));
+    SegmentStream capture = testCapture(10, 1), retimed;
+    std::string error;
+    CHECK(retimeSegments(capture, options, retimed, error)); //Within the limits as it was captured
+    CHECK(retimed.steps == capture.steps);
+
+    options.timeScale = 0.5; //20º/s
+    CHECK(!retimeSegments(capture, options, retimed, error) && error.find("Pan") == 0);
+    options.timeScale = 2;
+    CHECK(retimeSegments(capture, options, retimed, error));
+
+    capture = testCapture(10, 0); //Starts and stops at once
+    options.timeScale = 1;
+    CHECK(!retimeSegments(capture, options, retimed, error) && error.find("s^2") != std::string::npos);
+    options.smoothMs = 1000; //Ramps over a second so about 10º/s^2
+    CHECK(retimeSegments(capture, options, retimed, error));
+
+    options.limits[TRAJECTORY_TILT].acceleration = 0;
+    CHECK(!retimeSegments(capture, options, retimed, error));
+    capture.stepMode = 0;
+    memcpy(options.limits, limits.limits, sizeof(options.limits));
+    CHECK(!retimeSegments(capture, options, retimed, error));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool parses(const char *text){
+    JsonValue value;
+    return parseJson(text, strlen(text), value);
+}
+
+static bool parsesTo(const char *text, const char *expected){
+    JsonValue value;
+    return parseJson(text, strlen(text), value) && value.type == JSON_STRING && value.string == expected;
+}
+
+static std::string roundTrip(const char *text){
+    JsonValue value;
+    std::string out;
+    if(parseJson(text, strlen(text), value)){
+        writeJson(value, out);
+    }
+    return out;
+}
+
+static void testJson(void){
+    JsonValue value;
+    const char *request = " {\"jsonrpc\":\"2.0\",\"id\":7,\"method\":\"send\",\"params\":{\"instruction\":\"p90\",\"list\":[1,-2.5e3,true,false,null]}}\n";
+    if(CHECK(parseJson(request, strlen(request), value))){
+        CHECK(value.get("id") != NULL && value.get("id")->number == 7);
+        CHECK(value.get("missing") == NULL);
+        const JsonValue *params = value.get("params");
+        CHECK(params != NULL && params->get("instruction") != NULL && params->get("instruction")->string == "p90");
+        const JsonValue *list = params != NULL ? params->get("list") : NULL;
+        if(CHECK(list != NULL && list->type == JSON_ARRAY && list->items.size() == 5)){
+            CHECK(list->items[1].number == -2500);
+            CHECK(list->items[2].type == JSON_BOOL && list->items[2].boolean);
+            CHECK(list->items[3].type == JSON_BOOL && !list->items[3].boolean);
+            CHECK(list->items[4].type == JSON_NULL);
+        }
+    }
+
+    CHECK(parses("[]") && parses("{}") && parses("\"\"") && parses("0") && parses("-0.5"));
+    CHECK(!parses("") && !parses("   "));
+    CHECK(!parses("1 2")); //Exactly one value
+    CHECK(!parses("[1,]") && !parses("{\"a\":1,}") && !parses("[1") && !parses("{\"a\"}") && !parses("{a:1}"));
+    CHECK(!parses("nul") && !parses("tru") && !parses("nulls"));
+    CHECK(!parses("1e999") && !parses("NaN") && !parses("Infinity") && !parses("0x10") && !parses("1-2"));
+    CHECK(!parses("\"unterminated") && !parses("\"bad \\x escape\"") && !parses("\"\\u12\""));
+    CHECK(!parses("\"raw\nnewline\""));
+
+    std::string deep(100000, '['); //Refused without running out of stack
+    CHECK(!parseJson(deep.data(), deep.size(), value));
+    std::string nested = std::string(20, '[') + std::string(20, ']');
+    CHECK(parseJson(nested.data(), nested.size(), value));
+
+    CHECK(parsesTo("\"\\u00e9\\u20ac\\ud83d\\ude00\\n\\\"\\/\"", "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\n\"/"));
+    CHECK(parsesTo("\"\\ud83d\"", "\xef\xbf\xbd")); //A lone surrogate can't be encoded so it becomes U+FFFD
+    CHECK(parsesTo("\"\\ude00x\"", "\xef\xbf\xbd" "x"));
+    CHECK(parsesTo("\"\\ud83d\\u0041\"", "\xef\xbf\xbd" "A")); //A high surrogate followed by something that isn't a low one
+    CHECK(!parses("\"\\ud83d\\u00zz\""));
+
+    std::string out;
+    writeJsonString("a\"b\\c\n\t\x01\x7f", 9, out);
+    CHECK(out == "\"a\\\"b\\\\c\\n\\t\\u0001\\u007f\"");
+    out.clear();
+    writeJsonString("\xc3\xa9 \xff \xe2\x82", 7, out); //Valid UTF-8 is kept, anything else is replaced
+    CHECK(out == "\"\xc3\xa9 \\ufffd \\ufffd\\ufffd\"");
+
+    out.clear();
+    writeJsonNumber(NAN, out);
+    CHECK(out == "null");
+    CHECK(roundTrip("[1,2.5,-3,1e20,0.1]") == "[1,2.5,-3,1e+20,0.1]");
+    CHECK(roundTrip("{\"b\":1,\"a\":[true,null,\"x\"]}") == "{\"b\":1,\"a\":[true,null,\"x\"]}"); //Members stay in order
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void testRingBuffer(void){
+    RingBuffer<8> ring;
+    uint8_t in[16], out[16];
+    for(int i = 0; i < 16; i++){
+        in[i] = (uint8_t)(i + 1);
+    }
+    CHECK(ring.available() == 0 && ring.space() == 8);
+    CHECK(ring.write(in, 5) == 5);
+    CHECK(ring.read(out, 5) == 5 && memcmp(in, out, 5) == 0);
+
+    CHECK(ring.write(in, 12) == 8); //Wraps round the end and fills the whole buffer
+    CHECK(ring.available() == 8 && ring.space() == 0);
+    CHECK(ring.write(in, 1) == 0);
+    CHECK(ring.peek(out, 16) == 8 && memcmp(in, out, 8) == 0);
+    CHECK(ring.available() == 8); //peek() doesn't remove
+    ring.skip(3);
+    CHECK(ring.read(out, 2) == 2 && out[0] == 4 && out[1] == 5);
+    CHECK(ring.write(in + 8, 5) == 5);
+    CHECK(ring.read(out, 16) == 8 && memcmp(out, "\x06\x07\x08\x09\x0a\x0b\x0c\x0d", 8) == 0);
+    CHECK(ring.read(out, 1) == 0);
+
+    for(int pass = 0; pass < 1000; pass++){ //Every alignment of the indexes against the end of the buffer
+        size_t length = 1 + pass % 7;
+        for(size_t i = 0; i < length; i++){
+            in[i] = (uint8_t)(pass + i);
+        }
+        if(!CHECK(ring.write(in, length) == length && ring.read(out, length) == length && memcmp(in, out, length) == 0)){
+            break;
+        }
+    }
+    ring.write(in, 4);
+    ring.clear();
+    CHECK(ring.available() == 0 && ring.space() == 8);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main(void){
+    testTrajectoryLimits();
+    testSegmentsSumToKeyframes();
+    testThreadsMatch();
+    testTrajectoryErrors();
+    testRetimeLimits();
+    testJson();
+    testRingBuffer();
+    printf("%d checks, %d failed\n", checks_run, checks_failed);
+    return checks_failed ? 1 : 0;
+}
@@ -0,0 +1,476 @@
+#!/usr/bin/env python3
+"""Host side of the pan tilt mount's tokenised log messages.
+
+In token mode the firmware sends each printi() as a small binary frame holding the line number of the call and its values instead of the text
+(see panTiltLog.h). This script rebuilds the text from a table of the printi() calls in panTiltMount.cpp.
+
+    python3 pan_tilt_log.py table > log_table.json                    Generate the table from the firmware source
+    python3 pan_tilt_log.py header                                    Regenerate panTiltLogTable.h (the source hash the firmware sends)
+    python3 pan_tilt_log.py decode --port /dev/ttyUSB0 --tokens       Switch the mount to token mode ($1) and print the decoded messages
+    python3 pan_tilt_log.py decode --table log_table.json < capture   Decode a capture of the serial output
+    python3 pan_tilt_log.py trace --port /dev/ttyUSB0 --clear         Dump the step interval trace (&1) and print it
+
+The table must be generated from the same source the firmware was built from as the message IDs are line numbers. decode generates it from the
+source itself if no table is given. Both the table and panTiltLogTable.h hold a hash of the source. The firmware sends its hash when token mode is
+turned on ($1) and decode stops if it doesn't match the table's. The simulator build regenerates the header. Run the header command after changing
+panTiltMount.cpp before building it with the Arduino IDE. Text received outside of frames (e.g. from firmware built without token mode) is passed
+through unchanged.
+Trace frames (see panTiltTrace.h) are decoded wherever they appear in the stream.
+The serial port needs pyserial.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import struct
+import sys
+
+FIRMWARE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "pan_tilt_mount_nano_code_tmc2208")
+DEFAULT_SOURCE = os.path.join(FIRMWARE_DIR, "panTiltMount.cpp")
+DEFAULT_HEADER = os.path.join(FIRMWARE_DIR, "panTiltLogTable.h")
+DEFAULT_BAUD = 57600
+
+LOG_FRAME_START = 0x1E
+LOG_HASH_ID = 0 #Frame holding the source hash as a "L" value. No printi() is on line 0
+LOG_TYPES = { #Type character: (struct format, size). Matches the LOG_TYPE_ defines in panTiltLog.h
+    "c": ("c", 1),
+    "b": ("<B", 1),
+    "i": ("<h", 2),
+    "I": ("<H", 2),
+    "l": ("<i", 4),
+    "L": ("<I", 4),
+    "f": ("<f", 4),
+}
+INTEGER_TYPES = "biIlL"
+DEFAULT_FLOAT_DECIMALS = 2 #Same as Arduino's Serial.print(float)
+
+TRACE_FRAME_START = 0x1D
+TRACE_FRAME_VERSION = 1
+TRACE_TASK_NAMES = ["Step", "Serial", "Battery", "Capture", "Telemetry", "Job"] #TASK_ order in panTiltMount.h
+TRACE_AXIS_NAMES = ["Pan", "Tilt", "Slider"] #The lens axes after these depend on which are fitted
+
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "0": "\0", "\\": "\\", "\"": "\"", "'": "'"}
+
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+#Table generation
+
+def strip_comments(source):
+    """Blanks out the comments while keeping the strings and the line numbers."""
+    out = []
+    i = 0
+    state = "code"
+    while i < len(source):
+        c = source[i]
+        pair = source[i:i + 2]
+        if state == "code":
+            if pair == "//":
+                state = "line"
+                out.append("  ")
+                i += 2
+                continue
+            if pair == "/*":
+                state = "block"
+                out.append("  ")
+                i += 2
+                continue
+            if c in "\"'":
+                state = c
+        elif state == "line":
+            if c == "\n":
+                state = "code"
+            else:
+                c = " "
+        elif state == "block":
+            if pair == "*/":
+                state = "code"
+                out.append("  ")
+                i += 2
+                continue
+            if c != "\n":
+                c = " "
+        else: #Inside a string or character literal
+            if c == "\\":
+                out.append(pair)
+                i += 2
+                continue
+            if c == state:
+                state = "code"
+        out.append(c)
+        i += 1
+    return "".join(out)
+
+
+def split_arguments(source, start):
+    """Splits the arguments of the call whose opening bracket is at start. Returns the arguments and the index after the closing bracket."""
+    args = []
+    depth = 0
+    current = []
+    i = start
+    quote = None
+    while i < len(source):
+        c = source[i]
+        if quote:
+            current.append(c)
+            if c == "\\":
+                current.append(source[i + 1])
+                i += 2
+                continue
+            if c == quote:
+                quote = None
+        elif c in "\"'":
+            quote = c
+            current.append(c)
+        elif c in "([{":
+            depth += 1
+            if depth > 1:
+                current.append(c)
+        elif c in ")]}":
+            depth -= 1
+            if depth == 0:
+                args.append("".join(current).strip())
+                return args, i + 1
+            current.append(c)
+        elif c == "," and depth == 1:
+            args.append("".join(current).strip())
+            current = []
+        else:
+            current.append(c)
+        i += 1
+    raise ValueError("Unterminated call")
+
+
+def unescape(literal):
+    out = []
+    i = 0
+    while i < len(literal):
+        if literal[i] == "\\":
+            out.append(ESCAPES.get(literal[i + 1], literal[i + 1]))
+            i += 2
+        else:
+            out.append(literal[i])
+            i += 1
+    return "".join(out)
+
+
+def string_defines(directory):
+    """#define NAME "text" from the firmware headers so F(NAME) can be resolved."""
+    defines = {}
+    for name in os.listdir(directory):
+        if name.endswith(".h"):
+            with open(os.path.join(directory, name), encoding="utf-8") as header:
+                for match in re.finditer(r'^\s*#define\s+(\w+)\s+"((?:[^"\\]|\\.)*)"', header.read(), re.MULTILINE):
+                    defines[match.group(1)] = unescape(match.group(2))
+    return defines
+
+
+def classify_argument(arg, defines, line):
+    match = re.fullmatch(r'F\(\s*"((?:[^"\\]|\\.)*)"\s*\)', arg)
+    if match:
+        return {"text": unescape(match.group(1))}
+    match = re.fullmatch(r"F\(\s*(\w+)\s*\)", arg)
+    if match and match.group(1) in defines:
+        return {"text": defines[match.group(1)]}
+    if "F(" in arg:
+        raise ValueError("Line %d: F() strings must be passed directly to printi() so the decoder knows them: %s" % (line, arg))
+    return {"value": arg}
+
+
+def source_hash(source):
+    """First 32 bits of the SHA-1 of the source. The line endings are read as \\n so a CRLF checkout has the same hash."""
+    return int(hashlib.sha1(source.encode("utf-8")).hexdigest()[:8], 16)
+
+
+def build_table(source_path):
+    with open(source_path, encoding="utf-8") as source_file:
+        source = source_file.read()
+    code = strip_comments(source)
+    defines = string_defines(os.path.dirname(os.path.abspath(source_path)))
+    messages = {}
+    for match in re.finditer(r"\bprinti\s*\(", code):
+        line = code.count("\n", 0, match.start()) + 1
+        args, end = split_arguments(code, match.end() - 1)
+        if code.count("\n", match.start(), end):
+            raise ValueError("Line %d: printi() must be on one line as the line number is its ID" % line)
+        if str(line) in messages:
+            raise ValueError("Line %d: Only one printi() per line" % line)
+        messages[str(line)] = [classify_argument(arg, defines, line) for arg in args]
+    return {
+        "source": os.path.basename(source_path),
+        "sha1": hashlib.sha1(source.encode("utf-8")).hexdigest(),
+        "hash": source_hash(source),
+        "messages": messages,
+    }
+
+
+def build_header(source_path):
+    """panTiltLogTable.h for the firmware. Only holds the hash as the table itself stays on the host."""
+    with open(source_path, encoding="utf-8") as source_file:
+        source = source_file.read()
+    return ("#ifndef PANTILTLOGTABLE_H\n"
+            "#define PANTILTLOGTABLE_H\n"
+            "\n"
+            "//Generated by pan_tilt_mount_log_decoder/pan_tilt_log.py from %s. Don't edit. Run \"pan_tilt_log.py header\" after changing the source.\n"
+            "\n"
+            "#define LOG_TABLE_HASH 0x%08lXUL //Sent when token mode is turned on so the decoder can check its table was generated from the same source\n"
+            "\n"
+            "#endif\n" % (os.path.basename(source_path), source_hash(source)))
+
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+#Decoding
+
+def format_message(pieces, values):
+    """Rebuilds the text the same way printi() prints its arguments."""
+    out = []
+    value_index = 0
+    i = 0
+    while i < len(pieces):
+        piece = pieces[i]
+        if "text" in piece:
+            out.append(piece["text"])
+            i += 1
+            continue
+        value_type, value = values[value_index]
+        value_index += 1
+        i += 1
+        if value_type == "f":
+            decimals = DEFAULT_FLOAT_DECIMALS
+            if i < len(pieces) and "value" in pieces[i] and values[value_index][0] in INTEGER_TYPES: #printi(label, float, decimals, ...)
+                decimals = values[value_index][1]
+                value_index += 1
+                i += 1
+            out.append("%.*f" % (decimals, value))
+        else:
+            out.append(str(value))
+    if pieces and "value" in pieces[-1]: #printi() ends the line when there's no trailing string
+        out.append("\n")
+    return "".join(out)
+
+
+class LogTableMismatch(Exception):
+    pass
+
+
+class LogDecoder:
+    """Splits the serial stream into plain text and log frames. feed() returns the decoded text. Raises LogTableMismatch if the firmware's source hash
+    isn't the table's."""
+
+    def __init__(self, table):
+        self.messages = table["messages"]
+        self.hash = table.get("hash")
+        self.buffer = bytearray()
+        self.traces = [] #Every trace frame decoded so far
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        out = []
+        while self.buffer:
+            starts = [start for start in (self.buffer.find(LOG_FRAME_START), self.buffer.find(TRACE_FRAME_START)) if start >= 0]
+            start = min(starts) if starts else -1
+            if start != 0:
+                text = self.buffer if start < 0 else self.buffer[:start]
+                out.append(text.decode("utf-8", errors="replace"))
+                del self.buffer[:len(text)]
+                continue
+            if self.buffer[0] == TRACE_FRAME_START:
+                frame = parse_trace_frame(self.buffer)
+                if frame is None:
+                    break
+                length, trace = frame
+                if trace is None: #Drop the start byte and resynchronise on the next one
+                    out.append("[corrupt trace frame]\n")
+                else:
+                    self.traces.append(trace)
+                    out.append(format_trace(trace))
+                del self.buffer[:length]
+                continue
+            frame = self.parse_frame()
+            if frame is None: #Wait for the rest of the frame
+                break
+            length, text = frame
+            out.append(text)
+            del self.buffer[:length]
+        return "".join(out)
+
+    def parse_frame(self):
+        buffer = self.buffer
+        if len(buffer) < 4:
+            return None
+        message_id = buffer[1] | (buffer[2] << 8)
+        count = buffer[3]
+        index = 4
+        values = []
+        for _ in range(count):
+            if index >= len(buffer):
+                return None
+            value_type = chr(buffer[index])
+            index += 1
+            if value_type == "s":
+                end = buffer.find(0, index)
+                if end < 0:
+                    return None
+                values.append(("s", buffer[index:end].decode("utf-8", errors="replace")))
+                index = end + 1
+            elif value_type in LOG_TYPES:
+                value_format, size = LOG_TYPES[value_type]
+                if index + size > len(buffer):
+                    return None
+                value = struct.unpack(value_format, bytes(buffer[index:index + size]))[0]
+                values.append((value_type, value.decode("latin-1") if value_type == "c" else value))
+                index += size
+            else: #Corrupt frame. Drop the start byte and resynchronise on the next one.
+                return 1, "[corrupt log frame %d]\n" % message_id
+        if message_id == LOG_HASH_ID and count == 1 and values[0][0] == "L":
+            if values[0][1] != self.hash:
+                raise LogTableMismatch("The firmware was built from a different source (hash %08x) than the log table (%s). Regenerate the table and "
+                    "panTiltLogTable.h from the source the firmware was built from." % (values[0][1], "none" if self.hash is None else "%08x" % self.hash))
+            return index, ""
+        pieces = self.messages.get(str(message_id))
+        if pieces is None or sum("value" in piece for piece in pieces) != count:
+            return index, "[log %d: %s]\n" % (message_id, ", ".join(str(value) for _, value in values))
+        return index, format_message(pieces, values)
+
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+#Trace frames
+
+def parse_trace_payload(payload):
+    """Unpacks the payload of a trace frame into a dict of the counters with the step intervals in microseconds."""
+    tick_us, axis_count, task_count, trace_length = struct.unpack_from("<4B", payload, 0)
+    index = 4
+    names = ["passes", "total_us", "max_us", "serial_calls", "serial_total_us", "serial_max_us"]
+    values = struct.unpack_from("<6I", payload, index)
+    index += 24
+    trace = {"tick_us": tick_us, "trace_length": trace_length}
+    trace["loop"] = {name: value for name, value in zip(names[:3], values[:3])}
+    trace["serial"] = {name.replace("serial_", ""): value for name, value in zip(names[3:], values[3:])}
+    trace["tasks"] = {}
+    for i in range(task_count):
+        missed, overruns, max_us = struct.unpack_from("<HHI", payload, index)
+        index += 8
+        name = TRACE_TASK_NAMES[i] if i < len(TRACE_TASK_NAMES) else "Task %d" % i
+        trace["tasks"][name] = {"missed_deadlines": missed, "overruns": overruns, "max_us": max_us}
+    trace["axes"] = {}
+    for i in range(axis_count):
+        count = payload[index]
+        intervals = struct.unpack_from("<%dH" % count, payload, index + 1)
+        index += 1 + count * 2
+        name = TRACE_AXIS_NAMES[i] if i < len(TRACE_AXIS_NAMES) else "Lens %d" % i
+        trace["axes"][name] = [interval * tick_us for interval in intervals]
+    return trace
+
+
+def format_trace(trace):
+    loop = trace["loop"]
+    serial = trace["serial"]
+    lines = ["Trace"]
+    lines.append("Loop passes: %d\tMean: %.1fus\tMax: %dus" % (loop["passes"], loop["total_us"] / max(loop["passes"], 1), loop["max_us"]))
+    lines.append("Serial calls: %d\tTotal: %.1fms\tMax: %dus" % (serial["calls"], serial["total_us"] / 1000.0, serial["max_us"]))
+    for name, task in trace["tasks"].items():
+        lines.append("%s\tMissed: %d\tOverruns: %d\tMax: %dus" % (name, task["missed_deadlines"], task["overruns"], task["max_us"]))
+    for name, intervals in trace["axes"].items(): #Intervals over 65535 ticks have wrapped
+        lines.append("%s step intervals (us): %s" % (name, " ".join(str(interval) for interval in intervals) or "none"))
+    return "\n".join(lines) + "\n"
+
+
+def parse_trace_frame(buffer):
+    """Returns (frame length, trace dict or None if corrupt) or None if the frame isn't complete."""
+    if len(buffer) < 4:
+        return None
+    length = buffer[2] | (buffer[3] << 8)
+    if len(buffer) < 4 + length + 1:
+        return None
+    payload = bytes(buffer[4:4 + length])
+    if buffer[1] != TRACE_FRAME_VERSION or sum(payload) & 0xFF != buffer[4 + length]:
+        return 1, None
+    try:
+        return 4 + length + 1, parse_trace_payload(payload)
+    except struct.error:
+        return 1, None
+
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+def open_input(args):
+    if args.port:
+        import serial
+        port = serial.Serial(args.port, args.baud, timeout=0.1)
+        if args.tokens:
+            port.write(b"$1\n")
+        return lambda: port.read(256)
+    stream = open(args.input, "rb") if args.input else sys.stdin.buffer
+    return lambda: stream.read1(256)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+    table_parser = commands.add_parser("table", help="Generate the message table from the firmware source")
+    table_parser.add_argument("--source", default=DEFAULT_SOURCE)
+    table_parser.add_argument("--output", help="Defaults to stdout")
+    header_parser = commands.add_parser("header", help="Generate panTiltLogTable.h from the firmware source")
+    header_parser.add_argument("--source", default=DEFAULT_SOURCE)
+    header_parser.add_argument("--output", default=DEFAULT_HEADER)
+    decode_parser = commands.add_parser("decode", help="Decode the serial output")
+    decode_parser.add_argument("--table", help="Table from the table command. Generated from --source if not given.")
+    decode_parser.add_argument("--source", default=DEFAULT_SOURCE)
+    decode_parser.add_argument("--port", help="Serial port. Reads stdin or --input if not given.")
+    decode_parser.add_argument("--baud", type=int, default=DEFAULT_BAUD)
+    decode_parser.add_argument("--tokens", action="store_true", help="Send $1 to switch the mount to token mode")
+    decode_parser.add_argument("--input", help="Capture file to decode")
+    trace_parser = commands.add_parser("trace", help="Dump the step interval trace and print it")
+    trace_parser.add_argument("--port", required=True, help="Serial port")
+    trace_parser.add_argument("--baud", type=int, default=DEFAULT_BAUD)
+    trace_parser.add_argument("--clear", action="store_true", help="Clear the trace after dumping it (&1)")
+    trace_parser.add_argument("--json", action="store_true", help="Print the trace as JSON")
+    args = parser.parse_args()
+
+    if args.command == "table":
+        table = json.dumps(build_table(args.source), indent=1, ensure_ascii=False)
+        if args.output:
+            with open(args.output, "w", encoding="utf-8") as output:
+                output.write(table)
+        else:
+            print(table)
+        return
+
+    if args.command == "header":
+        with open(args.output, "w", encoding="utf-8", newline="\n") as output:
+            output.write(build_header(args.source))
+        return
+
+    if args.command == "trace":
+        import serial
+        import time
+        port = serial.Serial(args.port, args.baud, timeout=0.1)
+        port.write(b"&1" if args.clear else b"&")
+        decoder = LogDecoder({"messages": {}})
+        deadline = time.time() + 3
+        while not decoder.traces and time.time() < deadline:
+            decoder.feed(port.read(256))
+        if not decoder.traces:
+            sys.exit("No trace received. Is the firmware built with STEP_TRACE?")
+        print(json.dumps(decoder.traces[0], indent=1) if args.json else format_trace(decoder.traces[0]), end="" if not args.json else "\n")
+        return
+
+    if args.table:
+        with open(args.table, encoding="utf-8") as table_file:
+            table = json.load(table_file)
+    else:
+        table = build_table(args.source)
+    decoder = LogDecoder(table)
+    read = open_input(args)
+    try:
+        while True:
+            data = read()
+            if not data and not args.port:
+                break
+            sys.stdout.write(decoder.feed(data))
+            sys.stdout.flush()
+    except LogTableMismatch as error:
+        sys.exit(str(error))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
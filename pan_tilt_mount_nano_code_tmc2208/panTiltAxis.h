@@ -0,0 +1,154 @@
+#ifndef PANTILTAXIS_H
+#define PANTILTAXIS_H
+
+#include <Arduino.h>
+#include <AccelStepper.h> //Library to control the stepper motors http://www.airspayce.com/mikem/arduino/AccelStepper/index.html
+#include "panTiltMount.h"
+#include "panTiltTrace.h" //Step interval ring buffers
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Pin to port mapping for the ATmega328P (Arduino Nano) worked out at compile time. D0-D7 are on PORTD, D8-D13 on PORTB and A0-A5 (14-19) on PORTC.
+//The pin is a template parameter so every branch below folds away and each write compiles to a single sbi/cbi instruction.
+
+template<uint8_t Pin>
+struct FastPin {
+    static_assert(Pin < 20, "Pin must be a Nano digital pin (D0-D13 or A0-A5)");
+    static const uint8_t mask = 1 << ((Pin < 8) ? Pin : ((Pin < 14) ? Pin - 8 : Pin - 14));
+
+    static inline void high(void){
+        if(Pin < 8) PORTD |= mask;
+        else if(Pin < 14) PORTB |= mask;
+        else PORTC |= mask;
+    }
+
+    static inline void low(void){
+        if(Pin < 8) PORTD &= ~mask;
+        else if(Pin < 14) PORTB &= ~mask;
+        else PORTC &= ~mask;
+    }
+
+    static inline void write(bool value){
+        if(value) high();
+        else low();
+    }
+
+    static inline bool read(void){
+        if(Pin < 8) return PIND & mask;
+        if(Pin < 14) return PINB & mask;
+        return PINC & mask;
+    }
+};
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Holds the direction inversion so it can be set through a reference to any axis. AccelStepper keeps its own inversion flags private. Also holds the
+//axis's step interval trace, the driver's microstep phase and the step that fires the shutter during a continuous timelapse.
+
+class FastStepper : public AccelStepper {
+public:
+    FastStepper(uint8_t stepPin, uint8_t directionPin) : AccelStepper(1, stepPin, directionPin) {}
+
+    void setInverted(bool invert){
+        _inverted = invert;
+        setPinsInverted(invert, false, false); //Keeps AccelStepper's own step functions consistent
+    }
+
+    bool inverted(void){
+        return _inverted;
+    }
+
+    long phaseSteps(void){ //Steps from where the driver powered up on a full step. setCurrentPosition() doesn't change it so it still gives the
+        return _phaseSteps; //driver's microstep phase after homing has zeroed the position.
+    }
+
+    void scalePhaseSteps(float ratio){ //For a new step mode
+        _phaseSteps = round(_phaseSteps * ratio);
+    }
+
+    void armTrigger(long position){ //Raises the shutter pin from step() as the axis steps onto position so the picture is taken on that exact step
+        _triggerPosition = position;
+        _triggerArmed = true;
+        checkTrigger(currentPosition()); //Already there
+    }
+
+    void disarmTrigger(void){
+        _triggerArmed = false;
+        _triggered = false;
+    }
+
+    bool triggered(void){ //True once after the trigger has fired. The caller releases the shutter
+        bool fired = _triggered;
+        _triggered = false;
+        return fired;
+    }
+
+#ifdef STEP_TRACE
+    StepTrace &trace(void){
+        return _trace;
+    }
+#endif
+
+protected:
+    inline void checkTrigger(long position){
+        if(_triggerArmed && position == _triggerPosition){
+            FastPin<PIN_SHUTTER_TRIGGER>::high();
+            _triggerArmed = false;
+            _triggered = true;
+        }
+    }
+
+    bool _inverted = false;
+    long _phaseSteps = 0;
+    long _triggerPosition = 0;
+    bool _triggerArmed = false;
+    bool _triggered = false;
+#ifdef STEP_TRACE
+    StepTrace _trace = {};
+#endif
+};
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//An axis described at compile time. RatioNum/RatioDen is the gear ratio from the motor to the axis and UnitsPerRev is how far the motor moves the axis
+//in one revolution before the gearing (360 degrees for the rotary axes, belt pitch * pulley teeth millimetres for the slider).
+
+template<uint8_t StepPin, uint8_t DirPin, uint8_t HallPin, long RatioNum, long RatioDen, long UnitsPerRev>
+class AxisStepper : public FastStepper {
+public:
+    AxisStepper() : FastStepper(StepPin, DirPin) {}
+
+    static constexpr float stepsPerUnit(int stepMode){ //Stepper motor has 200 steps per revolution
+        return (200.0 * stepMode * RatioNum) / ((float)RatioDen * UnitsPerRev);
+    }
+
+    static inline bool onHall(void){ //The Hall sensors pull the pin low when over the magnet
+        return HallPin != PIN_NONE && !FastPin<((HallPin != PIN_NONE) ? HallPin : 0)>::read();
+    }
+
+protected:
+    void step(long step){ //Replaces AccelStepper::step1() which looks the pins up and calls digitalWrite() for every step. step is the new position
+        FastPin<DirPin>::write(_direction ^ _inverted); //Set the direction first to avoid rogue pulses
+        FastPin<StepPin>::high();
+        asm volatile("nop\n\tnop\n\tnop\n\tnop\n\t"); //Holds the step pulse high for longer than the TMC2208's 100ns minimum
+        FastPin<StepPin>::low();
+        _phaseSteps += _direction ? 1 : -1;
+        checkTrigger(step);
+#ifdef STEP_TRACE
+        traceStep(_trace);
+#endif
+    }
+};
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+typedef AxisStepper<PIN_STEP_PAN, PIN_DIRECTION_PAN, PIN_PAN_HALL, 144, 17, 360> PanStepper; //144/17 teeth
+
+typedef AxisStepper<PIN_STEP_TILT, PIN_DIRECTION_TILT, PIN_TILT_HALL, 123, 16, 360> TiltBeltStepper; //Belt driven tilt axis. 123/16 teeth
+typedef AxisStepper<PIN_STEP_TILT, PIN_DIRECTION_TILT, PIN_TILT_HALL, 64, 21, 360> TiltHerringboneStepper; //Herringbone gears. 64/21 teeth
+typedef TiltBeltStepper TiltStepper; //TODO: Change to TiltHerringboneStepper if your mount uses the herringbone gears
+
+typedef AxisStepper<PIN_STEP_SLIDER, PIN_DIRECTION_SLIDER, PIN_SLIDER_HALL, 1, 1, (long)(SLIDER_PULLEY_TEETH * 2)> SliderStepper; //2mm pitch belt
+
+//Lens axes are in degrees of the focus/zoom ring. TODO: Set the ratio between the motor gear and the lens gear ring for your lens.
+typedef AxisStepper<PIN_STEP_FOCUS, PIN_DIRECTION_FOCUS, PIN_NONE, 1, 1, 360> FocusStepper;
+typedef AxisStepper<PIN_STEP_ZOOM, PIN_DIRECTION_ZOOM, PIN_NONE, 1, 1, 360> ZoomStepper;
+
+#endif
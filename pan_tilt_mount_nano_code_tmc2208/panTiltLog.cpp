@@ -0,0 +1,47 @@
+#include "panTiltLog.h"
+#include "panTiltLogTable.h"
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#ifdef TOKENISED_LOG
+bool log_tokens = true; //The strings aren't in flash so there is no text mode
+#else
+bool log_tokens = false;
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void logFrameStart(unsigned int id, byte count){
+    Serial.write(LOG_FRAME_START);
+    Serial.write(lowByte(id));
+    Serial.write(highByte(id));
+    Serial.write(count);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void logValue(char type, const void *data, byte size){
+    Serial.write(type);
+    Serial.write((const uint8_t*)data, size);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void logString(const char *text, bool progmem){
+    Serial.write(LOG_TYPE_STRING);
+    char c;
+    while((c = progmem ? pgm_read_byte(text) : *text) != 0){
+        Serial.write(c);
+        text++;
+    }
+    Serial.write((uint8_t)0);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Lets the decoder check its table was generated from the source this was built from as the message IDs are line numbers.
+
+void logHash(void){
+    uint32_t hash = LOG_TABLE_HASH;
+    logFrameStart(LOG_HASH_ID, 1);
+    logValue(LOG_TYPE_ULONG, &hash, 4);
+}
@@ -0,0 +1,126 @@
+#ifndef PANTILTLOG_H
+#define PANTILTLOG_H
+
+#include <Arduino.h>
+#include <Iibrary.h>
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Tokenised log messages. Every printi() in panTiltMount.cpp goes through logPrint() with its line number as the message ID. In token mode the F() strings
+//are left out and a frame is sent instead:
+//
+//  LOG_FRAME_START, ID low byte, ID high byte, number of values, then for each value a type character followed by its bytes (little endian)
+//
+//The host decoder (pan_tilt_mount_log_decoder/pan_tilt_log.py) rebuilds the text from a table of the printi() calls generated from the same source.
+//With TOKENISED_LOG defined the F() strings are never referenced so the linker drops them from flash and token mode is the only mode. Without it the
+//strings are kept and token mode can be toggled with INSTRUCTION_LOG_MODE to cut the serial traffic.
+
+//#define TOKENISED_LOG
+
+#define LOG_FRAME_START 0x1E //ASCII record separator. Never sent in the text messages.
+#define LOG_HASH_ID 0 //Frame holding LOG_TABLE_HASH (panTiltLogTable.h) as a LOG_TYPE_ULONG. No printi() is on line 0
+
+#define LOG_TYPE_CHAR 'c' //1 byte
+#define LOG_TYPE_BYTE 'b' //uint8_t and bool
+#define LOG_TYPE_INT 'i' //int16_t
+#define LOG_TYPE_UINT 'I' //uint16_t
+#define LOG_TYPE_LONG 'l' //int32_t
+#define LOG_TYPE_ULONG 'L' //uint32_t
+#define LOG_TYPE_FLOAT 'f' //IEEE 754 single
+#define LOG_TYPE_STRING 's' //Zero terminated
+
+#ifdef TOKENISED_LOG
+    #define LOG_INLINE inline __attribute__((always_inline)) //Inlined into every call so the unused F() pointers can be dropped
+#else
+    #define LOG_INLINE inline
+#endif
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//A string in PROGMEM that isn't a literal at the call, e.g. from a name table. The decoder can't know it so it is always sent in token mode.
+
+struct ProgmemText {
+    const char *text;
+};
+
+inline ProgmemText progmemText(const char *text){
+    ProgmemText progmem = {text};
+    return progmem;
+}
+
+inline ProgmemText progmemText(const __FlashStringHelper *text){
+    return progmemText((const char*)text);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+extern bool log_tokens;
+
+void logFrameStart(unsigned int id, byte count);
+void logValue(char type, const void *data, byte size);
+void logString(const char *text, bool progmem);
+void logHash(void);
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Number of values in a frame. The F() literals are in the decoder's table so they aren't counted.
+
+template<class... Args>
+struct LogCount {
+    enum { value = 0 };
+};
+
+template<class T, class... Args>
+struct LogCount<T, Args...> {
+    enum { value = 1 + LogCount<Args...>::value };
+};
+
+template<class... Args>
+struct LogCount<const __FlashStringHelper*, Args...> {
+    enum { value = LogCount<Args...>::value };
+};
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+LOG_INLINE void logArg(const __FlashStringHelper *){} //Literal. The decoder has the text.
+LOG_INLINE void logArg(ProgmemText value){ logString(value.text, true); }
+LOG_INLINE void logArg(const char *value){ logString(value, false); }
+LOG_INLINE void logArg(char value){ logValue(LOG_TYPE_CHAR, &value, 1); }
+LOG_INLINE void logArg(bool value){ byte b = value; logValue(LOG_TYPE_BYTE, &b, 1); }
+LOG_INLINE void logArg(unsigned char value){ logValue(LOG_TYPE_BYTE, &value, 1); }
+LOG_INLINE void logArg(signed char value){ int16_t i = value; logValue(LOG_TYPE_INT, &i, 2); }
+LOG_INLINE void logArg(int value){ if(sizeof(int) == 2){ int16_t i = value; logValue(LOG_TYPE_INT, &i, 2); } else{ int32_t l = value; logValue(LOG_TYPE_LONG, &l, 4); } }
+LOG_INLINE void logArg(unsigned int value){ if(sizeof(int) == 2){ uint16_t i = value; logValue(LOG_TYPE_UINT, &i, 2); } else{ uint32_t l = value; logValue(LOG_TYPE_ULONG, &l, 4); } }
+LOG_INLINE void logArg(long value){ int32_t l = value; logValue(LOG_TYPE_LONG, &l, 4); }
+LOG_INLINE void logArg(unsigned long value){ uint32_t l = value; logValue(LOG_TYPE_ULONG, &l, 4); }
+LOG_INLINE void logArg(double value){ float f = value; logValue(LOG_TYPE_FLOAT, &f, 4); } //float is promoted to this. Both are 4 bytes on the AVR.
+
+LOG_INLINE void logArgs(void){}
+
+template<class T, class... Args>
+LOG_INLINE void logArgs(T value, Args... args){
+    logArg(value);
+    logArgs(args...);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+inline const __FlashStringHelper *logText(ProgmemText value){ return (const __FlashStringHelper*)value.text; }
+
+template<class T>
+inline T logText(T value){ return value; }
+
+template<class... Args>
+LOG_INLINE void logPrint(unsigned int id, Args... args){
+#ifndef TOKENISED_LOG
+    if(!log_tokens){
+        printi(logText(args)...); //Iibrary's printi(). The macro is defined below so it doesn't apply here
+        return;
+    }
+#endif
+    logFrameStart(id, LogCount<Args...>::value);
+    logArgs(args...);
+}
+
+#define printi(...) logPrint(__LINE__, __VA_ARGS__) //The line is the message ID so there must only be one printi() per line
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#endif
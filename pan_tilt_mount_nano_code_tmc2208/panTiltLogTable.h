@@ -0,0 +1,8 @@
+#ifndef PANTILTLOGTABLE_H
+#define PANTILTLOGTABLE_H
+
+//Generated by pan_tilt_mount_log_decoder/pan_tilt_log.py from panTiltMount.cpp. Don't edit. Run "pan_tilt_log.py header" after changing the source.
+
+#define LOG_TABLE_HASH 0xD389C671UL //Sent when token mode is turned on so the decoder can check its table was generated from the same source
+
+#endif
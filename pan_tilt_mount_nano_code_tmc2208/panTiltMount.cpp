@@ -1,15 +1,34 @@
-#include "PanTiltMount.h"
+#include "panTiltMount.h"
 #include <Iibrary.h> //A library I created for Arduino that contains some simple functions I commonly use. Library available at: https://github.com/isaac879/Iibrary
+#include "panTiltLog.h" //Routes printi() through the tokenised logger. Must be included after Iibrary.h
 #include <AccelStepper.h> //Library to control the stepper motors http://www.airspayce.com/mikem/arduino/AccelStepper/index.html
+#include "panTiltAxis.h" //Compile time descriptions of the axes
+#include "panTiltTrace.h" //Step interval and loop latency trace
 #include <MultiStepper.h> //Library to control multiple coordinated stepper motors http://www.airspayce.com/mikem/arduino/AccelStepper/classMultiStepper.html#details
 #include <EEPROM.h> //To be able to save values when powered off
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
 //Global scope
-AccelStepper stepper_pan = AccelStepper(1, PIN_STEP_PAN, PIN_DIRECTION_PAN);
-AccelStepper stepper_tilt = AccelStepper(1, PIN_STEP_TILT, PIN_DIRECTION_TILT);
-AccelStepper stepper_slider = AccelStepper(1, PIN_STEP_SLIDER, PIN_DIRECTION_SLIDER);
+PanStepper stepper_pan;
+TiltStepper stepper_tilt;
+SliderStepper stepper_slider;
+#ifdef FOCUS_AXIS
+FocusStepper stepper_focus;
+#endif
+#ifdef ZOOM_AXIS
+ZoomStepper stepper_zoom;
+#endif
+
+FastStepper *const axes[AXIS_COUNT] = { //Axis table in AXIS_ index order
+    &stepper_pan, &stepper_tilt, &stepper_slider
+#ifdef FOCUS_AXIS
+    , &stepper_focus
+#endif
+#ifdef ZOOM_AXIS
+    , &stepper_zoom
+#endif
+};
 
 MultiStepper multi_stepper;
 
@@ -18,9 +37,9 @@ KeyframeElement keyframe_array[KEYFRAME_ARRAY_LENGTH];
 int keyframe_elements = 0;
 int current_keyframe_index = -1;
 char stringText[MAX_STRING_LENGTH + 1];
-float pan_steps_per_degree = (200.0 * SIXTEENTH_STEP * PAN_GEAR_RATIO) / 360.0; //Stepper motor has 200 steps per 360 degrees
-float tilt_steps_per_degree = (200.0 * SIXTEENTH_STEP * TILT_GEAR_RATIO) / 360.0; //Stepper motor has 200 steps per 360 degrees
-float slider_steps_per_millimetre = (200.0 * SIXTEENTH_STEP) / (SLIDER_PULLEY_TEETH * 2); //Stepper motor has 200 steps per 360 degrees, the timing pully has 36 teeth and the belt has a pitch of 2mm
+float pan_steps_per_degree = PanStepper::stepsPerUnit(SIXTEENTH_STEP); //Constant for a given step mode. Set by setStepMode().
+float tilt_steps_per_degree = TiltStepper::stepsPerUnit(SIXTEENTH_STEP);
+float slider_steps_per_millimetre = SliderStepper::stepsPerUnit(SIXTEENTH_STEP);
 
 int step_mode = SIXTEENTH_STEP;
 bool enable_state = true; //Stepper motor driver enable state
@@ -33,7 +52,7 @@ byte homing_mode = 0; //Note: Gets set from the saved EEPROM value on startup
 float pan_max_speed = 18; //degrees/second. Note: Gets set from the saved EEPROM value on startup. 
 float tilt_max_speed = 10; //degrees/second.
 float slider_max_speed = 20; //mm/second
-long target_position[3]; //Array to store stepper motor step counts
+long target_position[AXIS_COUNT]; //Array to store stepper motor step counts
 float degrees_per_picture = 0.5; //Note: Gets set from the saved EEPROM value on startup. 
 unsigned long delay_ms_between_pictures = 1000; //Note: Gets set from the saved EEPROM value on startup. 
 int pan_accel_increment_us = 4000;
@@ -41,6 +60,77 @@ int tilt_accel_increment_us = 3000;
 int slider_accel_increment_us = 3500; 
 byte acceleration_enable_state = 0;
 FloatCoordinate intercept;
+float intercept_residual = 0; //RMS distance in mm from the calculated target to the keyframe rays
+int intercept_rays = 0; //Number of keyframe rays used to calculate the target
+float nodal_offset_mm = 0; //Distance from the tilt axis forward along the lens to its entrance pupil. Note: Gets set from the saved EEPROM value on startup.
+float tilt_axis_height_mm = 0; //Height of the tilt axis above the slider. Target coordinates are measured from the slider.
+volatile unsigned long battery_adc_filtered = 0; //IIR filtered ADC reading scaled by 2^BATTERY_FILTER_SHIFT. Updated by the ADC interrupt.
+bool battery_low = false;
+bool park_pending = false; //Park once the job that was running has stopped
+unsigned long battery_ok_ms = 0; //Last time the battery voltage was above the cut off
+unsigned long idle_disable_ms = 0; //Waits at least this long disable the drivers. 0 = never. Note: Gets set from the saved EEPROM value on startup.
+byte idle_hold_mask = HOLD_PAN | HOLD_TILT | HOLD_SLIDER; //Axes that need holding torque. All the drivers share PIN_ENABLE so they stay powered if any axis is set.
+unsigned long idle_total_ms = 0; //Total time the drivers have been idled for
+unsigned long telemetry_period_ms = 0; //0 = telemetry off
+float focus_max_speed = 90; //degrees/second of the lens ring. Note: Gets set from the saved EEPROM value on startup.
+float zoom_max_speed = 90;
+byte invert_focus = 0;
+byte invert_zoom = 0;
+
+const TaskTiming task_timings[TASK_COUNT] PROGMEM = { //Highest priority first
+    {stepTask, 100, 500},
+    {serialTask, 5000, 5000},
+    {batteryTask, 200, 50000},
+    {captureTask, 500, 2000},
+    {telemetryTask, 3000, 100000},
+    {jobTask, 500, 5000}
+};
+Task tasks[TASK_COUNT] = { //TASK_ order
+    {0, 0, 0, 0, 0},
+    {1000, 0, 0, 0, 0}, //Polled every 1ms. At 57600 baud the 64 byte receive buffer takes ~11ms to fill
+    {100000, 0, 0, 0, 0},
+    {1000000, 0, 0, 0, 0}, //The period is set when a capture starts
+    {1000000, 0, 0, 0, 0},
+    {0, 0, 0, 0, 0} //Runs on any pass where no other task is due
+};
+const char task_names[TASK_COUNT][10] PROGMEM = {"Step", "Serial", "Battery", "Capture", "Telemetry", "Job"};
+
+const unsigned int battery_cell_mv[] PROGMEM = {3270, 3610, 3700, 3750, 3790, 3850, 3920, 3990, 4060, 4130, 4200}; //LiPo resting cell voltage at 0%, 10%, ... 100% charge
+float lens_hfov_degrees = 40; //Horizontal field of view of the lens. Note: Gets set from the saved EEPROM value on startup.
+float lens_vfov_degrees = 27; //Vertical field of view of the lens.
+float panorama_overlap_percent = 30; //Overlap between neighbouring frames of a panorama grid.
+byte settle_profile = 0; //0 = fixed half delay before each picture, 1 to SETTLE_PROFILE_COUNT = payload profile. Note: Gets set from the saved EEPROM value on startup.
+SettleProfile settle_profiles[SETTLE_PROFILE_COUNT];
+float settle_speeds[SETTLE_PROFILE_COUNT]; //Pan/tilt rate in degrees/second of the fast calibration series of each profile. 0 = not calibrated
+float last_move_speed = 0; //Fastest pan/tilt rate of the last move in degrees/second. Used to work out how long the payload needs to settle.
+bool shutter_active = false; //Set while a non-blocking shutter pulse is being held high
+unsigned long shutter_start_ms = 0;
+Job job; //The long running job driven by jobTask()
+KeyframeMove keyframe_move;
+JobWait job_wait;
+static union { //State only one type of job uses. Only one job runs at a time so they share the RAM. Each is set up just before its job starts.
+    HomingState homing;
+    PanoramaPlan panorama_plan; //Grid panorama being shot
+    ContinuousTimelapse continuous;
+    OrbitState orbit;
+    unsigned int timelapse_segment_frames[KEYFRAME_ARRAY_LENGTH]; //Number of moving frames allocated to each keyframe segment by compileTimelapse()
+#ifdef SEGMENT_STREAM
+    SegmentStream segments; //Step segments from the host waiting to be played
+#endif
+};
+const char job_names[][16] PROGMEM = {"None", "Keyframes", "Panoramiclapse", "Timelapse", "Homing", "Orbit", "Segments", "Grid panorama", "Calibration",
+    "Continuous", "Parking"};
+#ifdef MOVE_CAPTURE
+Capture capture; //Live moves sent to the host as they happen
+#endif
+float feed_override = 1; //Live speed scale applied to keyframe moves and orbits. Eases towards feed_override_target.
+float feed_override_target = 1;
+unsigned long feed_override_ms = 0; //Last time feed_override was updated
+byte jog_ack = 0; //Reply to every binary jog packet with JOG_ACK or JOG_NAK so the host can measure its control latency
+byte instruction_ack = 0; //Reply to every ASCII instruction with INSTRUCTION_ACK or INSTRUCTION_NAK and its character for the host's benchmarks
+unsigned int jog_timeout_ms = 0; //Stop a jog if no jog packet arrives for this long. 0 = never. Set by hosts that send keepalives
+unsigned long last_jog_ms = 0;
+bool jog_active = false;
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
@@ -55,25 +145,39 @@ void initPanTilt(void){
     pinMode(PIN_STEP_TILT, OUTPUT);
     pinMode(PIN_DIRECTION_SLIDER, OUTPUT);
     pinMode(PIN_STEP_SLIDER, OUTPUT);
+#ifdef FOCUS_AXIS
+    pinMode(PIN_DIRECTION_FOCUS, OUTPUT);
+    pinMode(PIN_STEP_FOCUS, OUTPUT);
+#endif
+#ifdef ZOOM_AXIS
+    pinMode(PIN_DIRECTION_ZOOM, OUTPUT);
+    pinMode(PIN_STEP_ZOOM, OUTPUT);
+#endif
     pinMode(PIN_PAN_HALL, INPUT_PULLUP);
     pinMode(PIN_TILT_HALL, INPUT_PULLUP);
     pinMode(PIN_SLIDER_HALL, INPUT_PULLUP);
     pinMode(PIN_SHUTTER_TRIGGER, OUTPUT);
     digitalWrite(PIN_SHUTTER_TRIGGER, LOW);
+    initBatteryMonitor();
+    initTrace();
     setEEPROMVariables();
     setStepMode(step_mode); //steping mode
     stepper_pan.setMaxSpeed(panDegreesToSteps(pan_max_speed));
     stepper_tilt.setMaxSpeed(tiltDegreesToSteps(tilt_max_speed));
     stepper_slider.setMaxSpeed(sliderMillimetresToSteps(slider_max_speed));
-    stepper_pan.setAcceleration(5000);
-    stepper_tilt.setAcceleration(5000);
-    stepper_slider.setAcceleration(5000);
-    invertPanDirection(invert_pan);
-    invertTiltDirection(invert_tilt);
-    invertSliderDirection(invert_slider);
-    multi_stepper.addStepper(stepper_pan);
-    multi_stepper.addStepper(stepper_tilt);
-    multi_stepper.addStepper(stepper_slider);
+    for(int i = 0; i < AXIS_COUNT; i++){
+        axes[i]->setAcceleration(5000);
+        multi_stepper.addStepper(*axes[i]);
+    }
+    invertDirection(stepper_pan, invert_pan, F("Pan"), invert_pan);
+    invertDirection(stepper_tilt, invert_tilt, F("Tilt"), invert_tilt);
+    invertDirection(stepper_slider, invert_slider, F("Slider"), invert_slider);
+#ifdef FOCUS_AXIS
+    invertDirection(stepper_focus, invert_focus, F("Focus"), invert_focus);
+#endif
+#ifdef ZOOM_AXIS
+    invertDirection(stepper_zoom, invert_zoom, F("Zoom"), invert_zoom);
+#endif
     digitalWrite(PIN_ENABLE, LOW); //Enable the stepper drivers
 //    if(homing_mode == 1){
 //        printi(F("Homing\n"));
@@ -145,47 +249,214 @@ void setStepMode(int newMode){ //Step modes for the TMC2208
         printi(F("Invalid mode. Enter 2, 4, 8 or 16\n"));
         return;
     }
+#ifdef MOVE_CAPTURE
+    if(capture.periodMs > 0){ //The captured steps would change size part way through
+        endCapture();
+    }
+#endif
     //Scale current step to match the new step mode
-    stepper_pan.setCurrentPosition(stepper_pan.currentPosition() * stepRatio);
-    stepper_tilt.setCurrentPosition(stepper_tilt.currentPosition() * stepRatio);
-    stepper_slider.setCurrentPosition(stepper_slider.currentPosition() * stepRatio);
+    for(int i = 0; i < AXIS_COUNT; i++){
+        axes[i]->setCurrentPosition(axes[i]->currentPosition() * stepRatio);
+        axes[i]->scalePhaseSteps(stepRatio);
+    }
 
-    pan_steps_per_degree = (200.0 * (float)newMode * PAN_GEAR_RATIO) / 360.0; //Stepper motor has 200 steps per 360 degrees
-    tilt_steps_per_degree = (200.0 * (float)newMode * TILT_GEAR_RATIO) / 360.0; //Stepper motor has 200 steps per 360 degrees
-    slider_steps_per_millimetre = (200.0 * (float)newMode) / (SLIDER_PULLEY_TEETH * 2.0); //Stepper motor has 200 steps per 360 degrees, the timing pully has 36 teeth and the belt has a pitch of 2mm
+    pan_steps_per_degree = PanStepper::stepsPerUnit(newMode);
+    tilt_steps_per_degree = TiltStepper::stepsPerUnit(newMode);
+    slider_steps_per_millimetre = SliderStepper::stepsPerUnit(newMode);
 
     stepper_pan.setMaxSpeed(panDegreesToSteps(pan_max_speed));
     stepper_tilt.setMaxSpeed(tiltDegreesToSteps(tilt_max_speed));
     stepper_slider.setMaxSpeed(sliderMillimetresToSteps(slider_max_speed));
     step_mode = newMode;
+    for(int i = AXIS_SLIDER + 1; i < AXIS_COUNT; i++){
+        axes[i]->setMaxSpeed(axisMaxSpeed(i));
+    }
     printi(F("Set to "), step_mode, F(" step mode.\n"));
     clearKeyframes();
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void panDegrees(float angle){
-    target_position[0] = panDegreesToSteps(angle);
+void moveAxisTo(int axis, long steps){ //axis is the index in the axis table
+    target_position[axis] = steps;
     if(acceleration_enable_state == 0){
         multi_stepper.moveTo(target_position);
     }
     else{
-        stepper_pan.setCurrentPosition(stepper_pan.currentPosition());
-        stepper_pan.runToNewPosition(panDegreesToSteps(angle));
-    }    
+        axes[axis]->setCurrentPosition(axes[axis]->currentPosition());
+        axes[axis]->runToNewPosition(steps);
+    }
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void tiltDegrees(float angle){
-    target_position[1] = tiltDegreesToSteps(angle);
-    if(acceleration_enable_state == 0){
+float axisMaxSpeed(int axis){ //steps/second
+    switch(axis){
+        case AXIS_PAN: return panDegreesToSteps(pan_max_speed);
+        case AXIS_TILT: return tiltDegreesToSteps(tilt_max_speed);
+        case AXIS_SLIDER: return sliderMillimetresToSteps(slider_max_speed);
+#ifdef FOCUS_AXIS
+        case AXIS_FOCUS: return lensDegreesToSteps(AXIS_FOCUS, focus_max_speed);
+#endif
+#ifdef ZOOM_AXIS
+        case AXIS_ZOOM: return lensDegreesToSteps(AXIS_ZOOM, zoom_max_speed);
+#endif
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int axisAccelIncrement(int axis){ //Time between steps of the keyframe acceleration ramp
+    switch(axis){
+        case AXIS_PAN: return pan_accel_increment_us;
+        case AXIS_TILT: return tilt_accel_increment_us;
+        case AXIS_SLIDER: return slider_accel_increment_us;
+    }
+    return LENS_ACCEL_INCREMENT_US;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float lensDegreesToSteps(int axis, float angle){
+#ifdef FOCUS_AXIS
+    if(axis == AXIS_FOCUS) return FocusStepper::stepsPerUnit(step_mode) * angle;
+#endif
+#ifdef ZOOM_AXIS
+    if(axis == AXIS_ZOOM) return ZoomStepper::stepsPerUnit(step_mode) * angle;
+#endif
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float lensStepsToDegrees(int axis, long steps){
+    float stepsPerDegree = lensDegreesToSteps(axis, 1);
+    return (stepsPerDegree != 0) ? steps / stepsPerDegree : 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool isLensAxis(int axis){
+    if(axis >= AXIS_COUNT || axis <= AXIS_SLIDER){
+        printi(F("No lens axis\n"));
+        return false;
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void lensDegrees(int axis, float angle){ //Angle of the focus/zoom ring from where it was at power up
+    if(isLensAxis(axis)){
+        moveAxisTo(axis, lensDegreesToSteps(axis, angle));
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void setLensMaxSpeed(int axis, float speed){ //degrees/second of the lens ring
+    if(!isLensAxis(axis)){
+        return;
+    }
+#ifdef FOCUS_AXIS
+    if(axis == AXIS_FOCUS) focus_max_speed = speed;
+#endif
+#ifdef ZOOM_AXIS
+    if(axis == AXIS_ZOOM) zoom_max_speed = speed;
+#endif
+    axes[axis]->setMaxSpeed(axisMaxSpeed(axis));
+    printi(F("Lens max speed: "), speed, 3, F("º/s\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void invertLens(int axis, bool invert){
+    if(!isLensAxis(axis)){
+        return;
+    }
+#ifdef FOCUS_AXIS
+    if(axis == AXIS_FOCUS) invertDirection(stepper_focus, invert_focus, F("Focus"), invert);
+#endif
+#ifdef ZOOM_AXIS
+    if(axis == AXIS_ZOOM) invertDirection(stepper_zoom, invert_zoom, F("Zoom"), invert);
+#endif
+}
+
+#ifdef AXIS_BENCHMARK
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Measures how fast multi_stepper.run() can step 3 up to AXIS_COUNT axes at once. The drivers are disabled so nothing moves and every axis is stepped
+//back to where it started afterwards so the positions still match the motors.
+void benchmarkAxes(void){
+    long startPositions[AXIS_COUNT];
+    for(int i = 0; i < AXIS_COUNT; i++){
+        startPositions[i] = axes[i]->currentPosition();
+        axes[i]->setMaxSpeed(AXIS_BENCHMARK_STEP_RATE);
+    }
+    digitalWrite(PIN_ENABLE, HIGH); //Disable the stepper drivers
+    printi(F("Axis benchmark\n"));
+    for(int count = AXIS_SLIDER + 1; count <= AXIS_COUNT; count++){
+        for(int i = 0; i < AXIS_COUNT; i++){ //Only the first count axes have anywhere to go
+            target_position[i] = startPositions[i] + ((i < count) ? (long)AXIS_BENCHMARK_STEP_RATE * AXIS_BENCHMARK_MS / 1000 : 0);
+        }
         multi_stepper.moveTo(target_position);
+        unsigned long passes = 0;
+        unsigned long startUs = micros();
+        while(micros() - startUs < AXIS_BENCHMARK_MS * 1000UL){
+            multi_stepper.run();
+            passes++;
+        }
+        unsigned long elapsedUs = micros() - startUs;
+        long steps = 0;
+        for(int i = 0; i < count; i++){
+            steps += axes[i]->currentPosition() - startPositions[i];
+        }
+        printi(F("Axes: "), count, F("\t"));
+        printi(F("Passes/s: "), (float)passes * 1000000.0 / elapsedUs, 0, F("\t"));
+        printi(F("Steps/s: "), (float)steps * 1000000.0 / elapsedUs, 0, F("\t"));
+        printi(F("us/pass: "), (float)elapsedUs / passes, 2, F("\n"));
+        multi_stepper.moveTo(startPositions);
+        multi_stepper.runSpeedToPosition();
+    }
+    for(int i = 0; i < AXIS_COUNT; i++){
+        target_position[i] = startPositions[i];
+        axes[i]->setMaxSpeed(axisMaxSpeed(i));
+    }
+    if(enable_state){
+        digitalWrite(PIN_ENABLE, LOW); //Enable the stepper drivers
+    }
+}
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void setLogMode(int tokens){ //1 = tokenised messages for the host decoder, 0 = text
+#ifdef TOKENISED_LOG
+    (void)tokens;
+    logHash();
+    printi(F("Tokenised log only\n"));
+#else
+    log_tokens = tokens != 0;
+    if(log_tokens){
+        logHash();
+        printi(F("Log mode: tokens\n"));
     }
     else{
-        stepper_tilt.setCurrentPosition(stepper_tilt.currentPosition());
-        stepper_tilt.runToNewPosition(tiltDegreesToSteps(angle));
+        printi(F("Log mode: text\n"));
     }
+#endif
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void panDegrees(float angle){
+    moveAxisTo(AXIS_PAN, panDegreesToSteps(angle));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void tiltDegrees(float angle){
+    moveAxisTo(AXIS_TILT, tiltDegreesToSteps(angle));
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -215,14 +486,7 @@ float sliderStepsToMillimetres(long steps){
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
 void sliderMoveTo(float mm){
-    target_position[2] = sliderMillimetresToSteps(mm);
-    if(acceleration_enable_state == 0){ 
-        multi_stepper.moveTo(target_position);
-    }
-    else{
-        stepper_slider.setCurrentPosition(stepper_slider.currentPosition());
-        stepper_slider.runToNewPosition(sliderMillimetresToSteps(mm));
-    }    
+    moveAxisTo(AXIS_SLIDER, sliderMillimetresToSteps(mm));
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -231,13 +495,20 @@ void printKeyframeElements(void){
     printi(F("Keyframe index: "), current_keyframe_index, F("\n"));
     for(int row = 0; row < keyframe_elements; row++){
         printi(F(""), row, F("\t|"));
-        printi(F(" Pan: "), panStepsToDegrees(keyframe_array[row].panStepCount), 3, F("º\t"));
-        printi(F("Tilt: "), tiltStepsToDegrees(keyframe_array[row].tiltStepCount), 3, F("º\t"));
-        printi(F("Slider: "), sliderStepsToMillimetres(keyframe_array[row].sliderStepCount), 3, F("mm\t"));
-        printi(F("Pan Speed: "), panStepsToDegrees(keyframe_array[row].panSpeed), 3, F(" º/s\t"));
-        printi(F("Tilt Speed: "), tiltStepsToDegrees(keyframe_array[row].tiltSpeed), 3, F(" º/s\t"));  
-        printi(F("Slider Speed: "), sliderStepsToMillimetres(keyframe_array[row].sliderSpeed), 3, F(" mm/s\t"));      
-        printi(F("Delay: "), keyframe_array[row].msDelay, F("ms |\n"));    
+        printi(F(" Pan: "), panStepsToDegrees(keyframe_array[row].stepCount[AXIS_PAN]), 3, F("º\t"));
+        printi(F("Tilt: "), tiltStepsToDegrees(keyframe_array[row].stepCount[AXIS_TILT]), 3, F("º\t"));
+        printi(F("Slider: "), sliderStepsToMillimetres(keyframe_array[row].stepCount[AXIS_SLIDER]), 3, F("mm\t"));
+        printi(F("Pan Speed: "), panStepsToDegrees(keyframe_array[row].speed[AXIS_PAN]), 3, F(" º/s\t"));
+        printi(F("Tilt Speed: "), tiltStepsToDegrees(keyframe_array[row].speed[AXIS_TILT]), 3, F(" º/s\t"));  
+        printi(F("Slider Speed: "), sliderStepsToMillimetres(keyframe_array[row].speed[AXIS_SLIDER]), 3, F(" mm/s\t"));      
+#ifdef FOCUS_AXIS
+        printi(F("Focus: "), lensStepsToDegrees(AXIS_FOCUS, keyframe_array[row].stepCount[AXIS_FOCUS]), 3, F("º\t"));
+#endif
+#ifdef ZOOM_AXIS
+        printi(F("Zoom: "), lensStepsToDegrees(AXIS_ZOOM, keyframe_array[row].stepCount[AXIS_ZOOM]), 3, F("º\t"));
+#endif
+        printi(F("Delay: "), keyframe_array[row].msDelay, F("ms\t"));
+        printi(F("Ease: "), keyframe_array[row].easing, F(" |\n"));
     }
     printi(F("\n"));
 }
@@ -257,8 +528,11 @@ void debugReport(void){
     printi(F("Pan max speed: "), panStepsToDegrees(stepper_pan.maxSpeed()), 3, F("º/s\n"));
     printi(F("Tilt max speed: "), tiltStepsToDegrees(stepper_tilt.maxSpeed()), 3, F("º/s\n"));
     printi(F("Slider max speed: "), sliderStepsToMillimetres(stepper_slider.maxSpeed()), 3, F("mm/s\n"));        
-    //printi(F("Battery: "), getBatteryPercentage(), 3, F("%\n"));
-    printi(F("Battery: "), getBatteryVoltage(), 3, F("V\n"));
+    printBatteryStatus();
+#ifdef STEP_TRACE
+    printi(F("Loop max: "), loop_trace.maxUs, F("us\t"));
+    printi(F("Serial max: "), loop_trace.serialMaxUs, F("us\n"));
+#endif
 //    printi(F("Homing mode: "), homing_mode);    
     printi(F("Angle between pics: "), degrees_per_picture, 3, F("º\n"));
     printi(F("Panoramiclapse delay between pics: "), delay_ms_between_pictures, F("ms\n"));   
@@ -270,123 +544,294 @@ void debugReport(void){
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-int setTargetPositions(float panDeg, float tiltDeg, float sliderMillimetre){
+void setTargetPositions(float panDeg, float tiltDeg, float sliderMillimetre){
     target_position[0] = panDegreesToSteps(panDeg);
     target_position[1] = tiltDegreesToSteps(tiltDeg);
     target_position[2] = sliderMillimetresToSteps(sliderMillimetre);
+    for(int i = AXIS_SLIDER + 1; i < AXIS_COUNT; i++){ //The lens axes stay where they are
+        target_position[i] = axes[i]->currentPosition();
+    }
     multi_stepper.moveTo(target_position); 
+    last_move_speed = moveSpeed();
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-bool findHome(void){
-    bool panHomeFlag = false;
-    bool tiltHomeFlag = false;
-    bool sliderHomeFlag = false;
-    int panHomingDir = -1;
-    int tiltHomingDir = -1; 
+void findHome(void){ //Starts homing as a job. serviceHoming() does the work a step at a time from jobTask().
+    homing.panHomeFlag = false;
+    homing.tiltHomeFlag = false;
+    homing.sliderHomeFlag = false;
+    homing.panHomingDir = -1;
+    homing.tiltHomingDir = -1; 
       
     target_position[0] = stepper_pan.currentPosition();
     target_position[1] = stepper_tilt.currentPosition();
     target_position[2] = stepper_slider.currentPosition();
+    for(int i = AXIS_SLIDER + 1; i < AXIS_COUNT; i++){ //The lens axes have no Hall sensors and are left where they are
+        target_position[i] = axes[i]->currentPosition();
+    }
     
     if(homing_mode == 0){ //No homing
-        return false;  
+        finishHoming(false);
+        return;  
     }
-    
-    if(homing_mode == 1 || homing_mode == 3){ //Home the slider
-        while(digitalRead(PIN_SLIDER_HALL) == 0){ //Move off the hall
-            target_position[2] = target_position[2] + sliderMillimetresToSteps(0.1); 
-            multi_stepper.moveTo(target_position); 
-            multi_stepper.runSpeedToPosition();        
-        }
-        setTargetPositions(panStepsToDegrees(target_position[0]), tiltStepsToDegrees(target_position[1]), -1000);//1000 is about the length of the slider
-        while(multi_stepper.run()){
-            if(digitalRead(PIN_SLIDER_HALL) == 0){
+    homing.phase = (homing_mode == 1 || homing_mode == 3) ? HOMING_SLIDER_OFF_HALL : HOMING_OFF_HALL;
+    homing.sliderPos = sliderStepsToMillimetres(stepper_slider.currentPosition());
+    startJob(JOB_HOMING);
+    job.phase = PHASE_HOMING;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool serviceHoming(void){ //Returns true when homing has finished. The steps are taken by the step task so this only checks the Hall sensors and sets the next target.
+    switch(homing.phase){
+        case HOMING_SLIDER_OFF_HALL:{
+            if(multiStepperRunning()){
+                break;
+            }
+            if(stepper_slider.onHall()){ //Move off the hall
+                target_position[2] = target_position[2] + sliderMillimetresToSteps(0.1); 
+                multi_stepper.moveTo(target_position); 
+            }
+            else{
+                setTargetPositions(panStepsToDegrees(target_position[0]), tiltStepsToDegrees(target_position[1]), -1000);//1000 is about the length of the slider
+                homing.phase = HOMING_SLIDER_SEEK;
+            }
+        }
+        break;
+        case HOMING_SLIDER_SEEK:{
+            if(stepper_slider.onHall() && !homing.sliderHomeFlag){
                 stepper_slider.setCurrentPosition(0);//set step count to 0
                 setTargetPositions(panStepsToDegrees(target_position[0]), tiltStepsToDegrees(target_position[1]), 0);
-                sliderHomeFlag = true;
+                homing.sliderHomeFlag = true;
+            }
+            if(!multiStepperRunning()){
+                homing.sliderPos = sliderStepsToMillimetres(stepper_slider.currentPosition());
+                if(homing_mode == 1){
+                    finishHoming(homing.sliderHomeFlag);
+                    return true;
+                }
+                homing.phase = HOMING_OFF_HALL;
             }
         }
-    }
-
-    long sliderPos = sliderStepsToMillimetres(stepper_slider.currentPosition());
-    
-    if(homing_mode == 2 || homing_mode == 3){ //Home pan and tilt
-        while(digitalRead(PIN_PAN_HALL) == 0 || digitalRead(PIN_TILT_HALL) == 0){//If already on a Hall sensor move off
-            target_position[0] = target_position[0] + panDegreesToSteps(!digitalRead(PIN_PAN_HALL));//increment by 1 degree
-            target_position[1] = target_position[1] + tiltDegreesToSteps(!digitalRead(PIN_TILT_HALL));//increment by 1 degree
-            if(target_position[0] > panDegreesToSteps(360) && target_position[1] > tiltDegreesToSteps(360)){//If both axis have done more than a full rotation there must be an issue...
-                return false;
+        break;
+        case HOMING_OFF_HALL:{
+            if(multiStepperRunning()){
+                break;
+            }
+            if(stepper_pan.onHall() || stepper_tilt.onHall()){//If already on a Hall sensor move off
+                target_position[0] = target_position[0] + panDegreesToSteps(!stepper_pan.onHall());//increment by 1 degree
+                target_position[1] = target_position[1] + tiltDegreesToSteps(!stepper_tilt.onHall());//increment by 1 degree
+                if(target_position[0] > panDegreesToSteps(360) && target_position[1] > tiltDegreesToSteps(360)){//If both axis have done more than a full rotation there must be an issue...
+                    finishHoming(false);
+                    return true;
+                }
+                multi_stepper.moveTo(target_position); 
+            }
+            else{
+                stepper_pan.setCurrentPosition(0);//set step count to 0
+                stepper_tilt.setCurrentPosition(0);//set step count to 0
+                setTargetPositions(-45, -45, homing.sliderPos);
+                homing.phase = HOMING_SEEK_NEAR;
             }
-            multi_stepper.moveTo(target_position); 
-            multi_stepper.runSpeedToPosition();
         }
-        stepper_pan.setCurrentPosition(0);//set step count to 0
-        stepper_tilt.setCurrentPosition(0);//set step count to 0
-    
-        setTargetPositions(-45, -45, sliderPos);
-        while(multi_stepper.run()){
-            if(digitalRead(PIN_PAN_HALL) == 0){
+        break;
+        case HOMING_SEEK_NEAR:
+        case HOMING_SEEK_FULL:{
+            float searchAngle = (homing.phase == HOMING_SEEK_NEAR) ? -45 : 360;
+            if(stepper_pan.onHall() && !homing.panHomeFlag){
                 stepper_pan.setCurrentPosition(0);//set step count to 0
-                setTargetPositions(0, -45 * !tiltHomeFlag, sliderPos);
-                panHomeFlag = true;
-                panHomingDir = 1;
+                setTargetPositions(0, searchAngle * !homing.tiltHomeFlag, homing.sliderPos);
+                homing.panHomeFlag = true;
+                if(homing.phase == HOMING_SEEK_NEAR) homing.panHomingDir = 1;
             }
-            if(digitalRead(PIN_TILT_HALL) == 0){
+            if(stepper_tilt.onHall() && !homing.tiltHomeFlag){
                 stepper_tilt.setCurrentPosition(0);
-                setTargetPositions(-45 * !panHomeFlag, 0, sliderPos);
-                tiltHomeFlag = true;
-                tiltHomingDir = 1;
+                setTargetPositions(searchAngle * !homing.panHomeFlag, 0, homing.sliderPos);
+                homing.tiltHomeFlag = true;
+                if(homing.phase == HOMING_SEEK_NEAR) homing.tiltHomingDir = 1;
             }
-        }     
-        
-        setTargetPositions(360 * !panHomeFlag, 360 * !tiltHomeFlag, sliderPos);//full rotation on both axis so it must pass the home position
-        while(multi_stepper.run()){
-            if(digitalRead(PIN_PAN_HALL) == 0){
-                stepper_pan.setCurrentPosition(0);//set step count to 0
-                setTargetPositions(0, 360 * !tiltHomeFlag, sliderPos);
-                panHomeFlag = true;
+            if(multiStepperRunning()){
+                break;
             }
-            if(digitalRead(PIN_TILT_HALL)  == 0){
-                stepper_tilt.setCurrentPosition(0);
-                setTargetPositions(360 * !panHomeFlag, 0, sliderPos);
-                tiltHomeFlag = true;
+            if(homing.phase == HOMING_SEEK_NEAR){
+                setTargetPositions(360 * !homing.panHomeFlag, 360 * !homing.tiltHomeFlag, homing.sliderPos);//full rotation on both axis so it must pass the home position
+                homing.phase = HOMING_SEEK_FULL;
+            }
+            else if(homing.panHomeFlag && homing.tiltHomeFlag){
+                setTargetPositions(hall_pan_offset_degrees * homing.panHomingDir, hall_tilt_offset_degrees * homing.tiltHomingDir, homing.sliderPos);
+                homing.phase = HOMING_OFFSET;
+            }
+            else{
+                finishHoming(false);
+                return true;
             }
-        } 
-    }
-    
-    if(panHomeFlag && tiltHomeFlag && (homing_mode == 2 || homing_mode == 3)){
-        setTargetPositions(hall_pan_offset_degrees * panHomingDir, hall_tilt_offset_degrees * tiltHomingDir, sliderPos);
-        multi_stepper.runSpeedToPosition();
-        stepper_pan.setCurrentPosition(0);//set step count to 0
-        stepper_tilt.setCurrentPosition(0);//set step count to 0
-        setTargetPositions(0, 0, sliderPos);
-        if(homing_mode == 3 && sliderHomeFlag == false){
-            return false;
         }
-        else{
+        break;
+        case HOMING_OFFSET:{
+            if(multiStepperRunning()){
+                break;
+            }
+            stepper_pan.setCurrentPosition(0);//set step count to 0
+            stepper_tilt.setCurrentPosition(0);//set step count to 0
+            setTargetPositions(0, 0, homing.sliderPos);
+            finishHoming(homing_mode != 3 || homing.sliderHomeFlag);
             return true;
         }
     }
-    else if(sliderHomeFlag){
-        return true;
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void finishHoming(bool homed){
+    if(homed){
+        printi(F("Complete\n"));
+        return;
     }
-    else{
+    stepper_pan.setCurrentPosition(0);
+    stepper_tilt.setCurrentPosition(0);
+    stepper_slider.setCurrentPosition(0);
+    setTargetPositions(0, 0, 0);
+    printi(F("Error homing\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+//The battery voltage is sampled in the background so reading it never blocks stepping. The ADC converts PIN_INPUT_VOLTAGE every time Timer0 overflows
+//and the interrupt adds each sample into a first order IIR filter.
+void initBatteryMonitor(void){
+    ADMUX = _BV(REFS0) | (PIN_INPUT_VOLTAGE - A0); //AVcc reference
+    DIDR0 |= _BV(PIN_INPUT_VOLTAGE - A0); //Disable the digital input buffer on the pin
+    ADCSRB = _BV(ADTS2); //Auto trigger on Timer0 overflow
+    ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0); //Enable, auto trigger, interrupt and a clock prescaler of 128
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+ISR(ADC_vect){
+    unsigned int sample = ADC;
+    if(battery_adc_filtered == 0){ //Start the filter from the first sample so it doesn't have to ramp up from 0
+        battery_adc_filtered = (unsigned long)sample << BATTERY_FILTER_SHIFT;
+    }
+    battery_adc_filtered += sample - (battery_adc_filtered >> BATTERY_FILTER_SHIFT);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float getBatteryVoltage(void){
+    noInterrupts(); //The filter value is 4 bytes so it is copied with the interrupt disabled
+    unsigned long filtered = battery_adc_filtered;
+    interrupts();
+    return ((float)filtered / (1UL << BATTERY_FILTER_SHIFT)) * BATTERY_VOLTS_PER_COUNT;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float getBatteryCurrent(void){ //Estimated current draw in mA
+    return BATTERY_IDLE_CURRENT_MA + ((digitalRead(PIN_ENABLE) == LOW) ? BATTERY_ENABLED_CURRENT_MA : 0);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float getBatteryPercentage(void){ //State of charge from the resting voltage. The voltage drop across the internal resistance is added back on to compensate for the load.
+    float cellVoltage = (getBatteryVoltage() + (getBatteryCurrent() / 1000.0) * BATTERY_INTERNAL_RESISTANCE) / BATTERY_CELLS;
+    unsigned int cellMv = cellVoltage * 1000;
+    if(cellMv <= pgm_read_word(&battery_cell_mv[0])){
+        return 0;
+    }
+    for(int i = 1; i <= 10; i++){
+        unsigned int upperMv = pgm_read_word(&battery_cell_mv[i]);
+        if(cellMv < upperMv){
+            unsigned int lowerMv = pgm_read_word(&battery_cell_mv[i - 1]);
+            return ((i - 1) * 10) + (10.0 * (cellMv - lowerMv)) / (upperMv - lowerMv);
+        }
+    }
+    return 100;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float getBatteryRuntime(void){ //Estimated minutes left at the current load
+    return (BATTERY_CAPACITY_MAH * getBatteryPercentage() / 100.0) / getBatteryCurrent() * 60.0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void printBatteryStatus(void){
+    printi(F("Battery: "), getBatteryVoltage(), 3, F("V\t"));
+    printi(F(""), getBatteryPercentage(), 1, F("%\t"));
+    printi(F("Load: "), getBatteryCurrent(), 0, F("mA\t"));
+    printi(F("Runtime: "), getBatteryRuntime(), 1, F("min\n"));
+    printi(F("Drivers idled: "), idle_total_ms / 1000, F("s\t"));
+    printi(F("Saved: "), (idle_total_ms / 3600000.0) * BATTERY_ENABLED_CURRENT_MA, 1, F("mAh\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void checkBatteryRuntime(unsigned long jobMs){ //Reports the battery runtime at the start of a job and warns if the job is expected to take longer
+    if(getBatteryVoltage() < BATTERY_PRESENT_VOLTAGE){
+        return;
+    }
+    float runtime = getBatteryRuntime();
+    printi(F("Battery runtime: "), runtime, 1, F("min\t"));
+    printi(F("Job: "), jobMs / 60000.0, 1, F("min\n"));
+    if(runtime * 60000.0 < jobMs){
+        printi(F("Battery may run out\n"));
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Called between moves and frames by the long running jobs. Returns true once the voltage has stayed below the cut off for BATTERY_LOW_CONFIRM_MS so the job can
+//return. The mount is parked once the job has ended.
+bool batteryLowStop(void){
+    float voltage = getBatteryVoltage();
+    if(voltage < BATTERY_PRESENT_VOLTAGE || voltage >= BATTERY_CUTOFF_VOLTAGE){ //Powered over USB or the battery is above the cut off
+        battery_ok_ms = millis();
+        battery_low = false;
         return false;
     }
+    if(!battery_low && millis() - battery_ok_ms >= BATTERY_LOW_CONFIRM_MS){
+        battery_low = true;
+        printi(F("Battery low\n"));
+        parkSteppers();
+    }
+    return battery_low;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void parkSteppers(void){ //Levels the camera and disables the drivers. A running job is stopped first by batteryTask() and endJob() starts the park.
+    park_pending = true;
+    if(job.state == JOB_IDLE){
+        startParking();
+    }
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-float getBatteryVoltage(void){ //TODO: Calibrate the values for your battery
-    return mapNumber(analogRead(PIN_INPUT_VOLTAGE), 0, 1007, 0, 12.6);//1007 = 12.6V
+void startParking(void){ //The move is run by stepTask() and jobTask() disables the drivers once every axis has got there
+    park_pending = false;
+    startJob(JOB_PARKING);
+    job.phase = PHASE_PARKING;
+    setTargetPositions(0, 0, sliderStepsToMillimetres(stepper_slider.currentPosition()));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//When a driver is disabled the rotor falls into the nearest full step detent. Each axis is first moved onto a full step (a multiple of step_mode microsteps
+//from where the drivers powered up) so the position and the driver's microstep phase still match when it is enabled again. The phase is counted by the
+//axis as it steps because homing zeroes the position wherever the Hall sensor triggered.
+void fullStepPositions(long *positions){
+    for(int i = 0; i < AXIS_COUNT; i++){
+        long phase = axes[i]->phaseSteps();
+        positions[i] = axes[i]->currentPosition() + (long)round((float)phase / step_mode) * step_mode - phase;
+    }
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-float getBatteryPercentage(void){ //TODO: Calibrate the values for your battery
-    return boundFloat(mapNumber(getBatteryVoltage(), 9, 12.6, 0, 100), 0, 100); //780 = 9V = 0%, 1023 = 12.6V = 100%
+bool canIdleDrivers(unsigned long ms){ //Only long waits are worth idling for and only if no axis needs holding
+    return idle_disable_ms != 0 && ms >= idle_disable_ms && idle_hold_mask == 0 && enable_state;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -417,13 +862,12 @@ float tiltStepsToDegrees(float steps){
 
 int addPosition(void){
     if(keyframe_elements >= 0 && keyframe_elements < KEYFRAME_ARRAY_LENGTH){
-        keyframe_array[keyframe_elements].panStepCount = stepper_pan.currentPosition();
-        keyframe_array[keyframe_elements].tiltStepCount = stepper_tilt.currentPosition();    
-        keyframe_array[keyframe_elements].sliderStepCount = stepper_slider.currentPosition();    
-        keyframe_array[keyframe_elements].panSpeed = stepper_pan.maxSpeed();
-        keyframe_array[keyframe_elements].tiltSpeed = stepper_tilt.maxSpeed();    
-        keyframe_array[keyframe_elements].sliderSpeed = stepper_slider.maxSpeed();      
+        for(int i = 0; i < AXIS_COUNT; i++){
+            keyframe_array[keyframe_elements].stepCount[i] = axes[i]->currentPosition();
+            keyframe_array[keyframe_elements].speed[i] = axes[i]->maxSpeed();
+        }
         keyframe_array[keyframe_elements].msDelay = 0;      
+        keyframe_array[keyframe_elements].easing = EASING_LINEAR;
         current_keyframe_index = keyframe_elements;
         keyframe_elements++;//increment the index
         printi(F("Added at index: "), current_keyframe_index);
@@ -445,150 +889,164 @@ void clearKeyframes(void){
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void moveToIndex(int index){
-    if(index < keyframe_elements && index >= 0){
-        target_position[0] = keyframe_array[index].panStepCount;
-        target_position[1] = keyframe_array[index].tiltStepCount;
-        target_position[2] = keyframe_array[index].sliderStepCount;
-        stepper_pan.setMaxSpeed(keyframe_array[index].panSpeed);
-        stepper_tilt.setMaxSpeed(keyframe_array[index].tiltSpeed);
-        stepper_slider.setMaxSpeed(keyframe_array[index].sliderSpeed);
+void moveToIndex(int index){ //Blocking move used by the jump and step commands
+    if(!startKeyframeMove(index)){
+        return;
+    }
+    while(!serviceKeyframeMove()){
+        multi_stepper.run();
+    }
+}
 
-        if(acceleration_enable_state == 0){ //If accelerations are not enabled just move directly to the target position. 
-            multi_stepper.moveTo(target_position); //Sets new target positions
-            multi_stepper.runSpeedToPosition(); //Moves and blocks until complete
-            delay(keyframe_array[index].msDelay);
-            current_keyframe_index = index;
-            return;
-        }
-        
-        float panInitialSpeed = stepper_pan.speed();
-        float tiltInitialSpeed = stepper_tilt.speed();
-        float sliderInitialSpeed = stepper_slider.speed();
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Sets up the move to a keyframe and its acceleration ramp. The move is carried out by calling multi_stepper.run() and serviceKeyframeMove() until it
+//returns true so it can either be run from the job task or blocked on by moveToIndex().
+bool startKeyframeMove(int index){
+    if(index >= keyframe_elements || index < 0){
+        return false;
+    }
+    keyframe_move.index = index;
+    for(int i = 0; i < AXIS_COUNT; i++){
+        target_position[i] = keyframe_array[index].stepCount[i];
+    }
+    setKeyframeMaxSpeeds(index);
 
-        if(index >= 1){
-            if(keyframe_array[index - 1].msDelay != 0){
-                panInitialSpeed = 0;
-                tiltInitialSpeed = 0;
-                sliderInitialSpeed = 0;
-            }
+    if(acceleration_enable_state == 0){ //If accelerations are not enabled just move directly to the target position. 
+        multi_stepper.moveTo(target_position); //Sets new target positions
+        applyFeedOverride(true);
+        keyframe_move.phase = MOVE_CRUISE;
+        return true;
+    }
+    
+    for(int i = 0; i < AXIS_COUNT; i++){
+        keyframe_move.initialSpeed[i] = axes[i]->speed() / keyframe_move.feedScale; //The ramp works with the speeds before the feed override
+        if(index >= 1 && keyframe_array[index - 1].msDelay != 0){
+            keyframe_move.initialSpeed[i] = 0;
         }
-        
-        multi_stepper.moveTo(target_position); //Sets new target positions //sets speeds
-
-        float panDeltaSpeed = stepper_pan.speed() - panInitialSpeed;
-        float tiltDeltaSpeed = stepper_tilt.speed() - tiltInitialSpeed;
-        float sliderDeltaSpeed = stepper_slider.speed() - sliderInitialSpeed;
-        
-        float panAccel = stepper_pan.speed() / (pan_accel_increment_us * 0.0001); //Equation is arbitrary and was deterined through empirical testing. The acceleration value does NOT correspond to mm/s/s
-        float tiltAccel = stepper_tilt.speed() / (tilt_accel_increment_us * 0.0001);
-        float sliderAccel = stepper_slider.speed() / (slider_accel_increment_us * 0.0001);   
+    }
+    
+    multi_stepper.moveTo(target_position); //Sets new target positions //sets speeds
 
-        long panDist = 0;
-        long tiltDist = 0;
-        long sliderDist = 0;
+    for(int i = 0; i < AXIS_COUNT; i++){
+        float axisSpeed = axes[i]->speed();
+        keyframe_move.deltaSpeed[i] = axisSpeed - keyframe_move.initialSpeed[i];
         
-        if(panAccel != 0){
-            panDist = pow(stepper_pan.speed(), 2) / (5 * panAccel); //Equation is arbitrary and was deterined through empirical testing.
-        }
-        if(tiltAccel != 0){
-            tiltDist = pow(stepper_tilt.speed(), 2) / (5 * tiltAccel); //Equation is arbitrary and was deterined through empirical testing.
-        }
-        if(sliderAccel != 0){
-            sliderDist = pow(stepper_slider.speed(), 2) / (5 * sliderAccel); //Equation is arbitrary and was deterined through empirical testing.
+        float accel = axisSpeed / (axisAccelIncrement(i) * 0.0001); //Equation is arbitrary and was deterined through empirical testing. The acceleration value does NOT correspond to mm/s/s
+        long dist = 0;
+        if(accel != 0){
+            dist = pow(axisSpeed, 2) / (5 * accel); //Equation is arbitrary and was deterined through empirical testing.
         }
 
-        if(index + 1 < keyframe_elements){//makes sure there is a valid next keyframe
-            if(keyframe_array[index].msDelay == 0){
-                long panStepDiff = keyframe_array[index + 1].panStepCount - keyframe_array[index].panStepCount; //Change in position from current target position to the next.
-                long tiltStepDiff = keyframe_array[index + 1].tiltStepCount - keyframe_array[index].tiltStepCount;
-                long sliderStepDiff = keyframe_array[index + 1].sliderStepCount - keyframe_array[index].sliderStepCount;
-                if((panStepDiff == 0 && stepper_pan.speed() != 0) || (panStepDiff > 0 && stepper_pan.speed() < 0) || (panStepDiff < 0 && stepper_pan.speed() > 0)){ //if stopping or changing direction
-                    target_position[0] = keyframe_array[index].panStepCount - panDist; //Set the target position slightly before the actual target to allow for the distance traveled while decelerating.
-                }
-                if((tiltStepDiff == 0 && stepper_tilt.speed() != 0) || (tiltStepDiff > 0 && stepper_tilt.speed() < 0) || (tiltStepDiff < 0 && stepper_tilt.speed() > 0)){ //if stopping or changing direction
-                    target_position[1] = keyframe_array[index].tiltStepCount - tiltDist;
-                }
-                if((sliderStepDiff == 0 && stepper_slider.speed() != 0) || (sliderStepDiff > 0 && stepper_slider.speed() < 0) || (sliderStepDiff < 0 && stepper_slider.speed() > 0)){ //if stopping or changing direction
-                    target_position[2] = keyframe_array[index].sliderStepCount - sliderDist;//If changing dir
-                }
+        if(index + 1 < keyframe_elements && keyframe_array[index].msDelay == 0){//makes sure there is a valid next keyframe
+            long stepDiff = keyframe_array[index + 1].stepCount[i] - keyframe_array[index].stepCount[i]; //Change in position from current target position to the next.
+            if((stepDiff == 0 && axisSpeed != 0) || (stepDiff > 0 && axisSpeed < 0) || (stepDiff < 0 && axisSpeed > 0)){ //if stopping or changing direction
+                target_position[i] = keyframe_array[index].stepCount[i] - dist; //Set the target position slightly before the actual target to allow for the distance traveled while decelerating.
             }
         }
 
         if(index > 0){
-            long panStepDiffPrev = keyframe_array[index].panStepCount - keyframe_array[index - 1].panStepCount; //Change in position from the privious target to the current target position.
-            long tiltStepDiffPrev = keyframe_array[index].tiltStepCount - keyframe_array[index - 1].tiltStepCount;
-            long sliderStepDiffPrev = keyframe_array[index].sliderStepCount - keyframe_array[index - 1].sliderStepCount;
-            if(panStepDiffPrev == 0 && panDeltaSpeed == 0){ //Movement stopping
-                panDeltaSpeed = -(2 * stepper_pan.speed()); //Making it negative ramps the speed down in the acceleration portion of the movement. The multiplication factor is arbitrary and was deterined through empirical testing.
-            }
-            if(tiltStepDiffPrev == 0 && tiltDeltaSpeed == 0){ //Movement stopping
-                tiltDeltaSpeed = -(2 * stepper_tilt.speed());
-            }
-            if(sliderStepDiffPrev == 0 && sliderDeltaSpeed == 0){ //Movement stopping
-                sliderDeltaSpeed = -(2 * stepper_slider.speed());
+            long stepDiffPrev = keyframe_array[index].stepCount[i] - keyframe_array[index - 1].stepCount[i]; //Change in position from the privious target to the current target position.
+            if(stepDiffPrev == 0 && keyframe_move.deltaSpeed[i] == 0){ //Movement stopping
+                keyframe_move.deltaSpeed[i] = -(2 * axisSpeed); //Making it negative ramps the speed down in the acceleration portion of the movement. The multiplication factor is arbitrary and was deterined through empirical testing.
             }
         }
-        
-        multi_stepper.moveTo(target_position); //Sets new target positions and calculates new speeds.
-        
-        if(stepper_pan.currentPosition() != target_position[0] || stepper_tilt.currentPosition() != target_position[1] || stepper_slider.currentPosition() != target_position[2]){ //Prevents issues caused when the motor target positions and speeds not being updated becuase they have not changed.
+    }
+    
+    multi_stepper.moveTo(target_position); //Sets new target positions and calculates new speeds.
+    for(int i = 0; i < AXIS_COUNT; i++){
+        keyframe_move.speed[i] = axes[i]->speed(); //Used to limit the feed override during the ramp
+        keyframe_move.inc[i] = 0;
+        keyframe_move.lastUs[i] = 0;
+    }
+    keyframe_move.phase = MOVE_RAMP;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool keyframeRampDone(void){
+    for(int i = 0; i < AXIS_COUNT; i++){
+        if(keyframe_move.inc[i] < 1){
+            return false;
+        }
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool serviceKeyframeMove(void){ //Returns true once the keyframe has been reached and its delay has been held
+    switch(keyframe_move.phase){
+        case MOVE_RAMP:{
             //Impliments the acceleration/deceleration. This implimentation feels pretty bad and should probably be updated but it works well enough so I'm not going to...
-            float panInc = 0;
-            float tiltInc = 0;
-            float sliderInc = 0;
-            unsigned long pan_last_us = 0;
-            unsigned long tilt_last_us = 0;
-            unsigned long slider_last_us = 0;
-            
-            while(((panInc < 1) || (tiltInc < 1) || (sliderInc < 1)) && multi_stepper.run()){
+            if(!keyframeRampDone() && multiStepperRunning()){
                 unsigned long usTime = micros();
+                updateFeedOverride();
+                keyframe_move.feedScale = feedScale();
                 
-                if(usTime - pan_accel_increment_us >= pan_last_us){
-                    panInc = (panInc < 1) ? (panInc + 0.01) : 1;
-                    pan_last_us = micros();
-                    stepper_pan.setSpeed(panInitialSpeed + (panDeltaSpeed * panInc));
-                }
-                
-                if(usTime - tilt_accel_increment_us >= tilt_last_us){
-                    tiltInc = (tiltInc < 1) ? (tiltInc + 0.01) : 1;
-                    tilt_last_us = micros();
-                    stepper_tilt.setSpeed(tiltInitialSpeed + (tiltDeltaSpeed * tiltInc));
-                }
-                
-                if(usTime - slider_accel_increment_us >= slider_last_us){
-                    sliderInc = (sliderInc < 1) ? (sliderInc + 0.01) : 1;
-                    slider_last_us = micros();
-                    stepper_slider.setSpeed(sliderInitialSpeed + (sliderDeltaSpeed * sliderInc));
+                for(int i = 0; i < AXIS_COUNT; i++){
+                    if(usTime - axisAccelIncrement(i) >= keyframe_move.lastUs[i]){
+                        keyframe_move.inc[i] = (keyframe_move.inc[i] < 1) ? (keyframe_move.inc[i] + 0.01) : 1;
+                        keyframe_move.lastUs[i] = micros();
+                        setFeedSpeed(*axes[i], (keyframe_move.initialSpeed[i] + (keyframe_move.deltaSpeed[i] * keyframe_move.inc[i])) * keyframe_move.feedScale);
+                    }
                 }
+                break;
             }
-
+            setKeyframeMaxSpeeds(keyframe_move.index); //The feed override may have raised them
             multi_stepper.moveTo(target_position); //Sets all speeds to reach the target
-            multi_stepper.runSpeedToPosition(); //Moves and blocks until complete
+            applyFeedOverride(true);
+            keyframe_move.phase = MOVE_CRUISE;
+        }
+        break;
+        case MOVE_CRUISE:{
+            if(updateFeedOverride()){
+                applyFeedOverride(false);
+            }
+            if(!multiStepperRunning()){
+                startJobWait(keyframe_array[keyframe_move.index].msDelay, true);
+                keyframe_move.phase = MOVE_HOLD;
+            }
         }
-        delay(keyframe_array[index].msDelay);
-        current_keyframe_index = index;
+        break;
+        case MOVE_HOLD:{
+            if(jobWaitDone()){
+                current_keyframe_index = keyframe_move.index;
+                keyframe_move.phase = MOVE_DONE;
+            }
+        }
+        break;
     }
+    return keyframe_move.phase == MOVE_DONE;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
 void executeMoves(int repeat){
-    stepper_pan.setSpeed(0);
-    stepper_tilt.setSpeed(0);
-    stepper_slider.setSpeed(0);
-    for(int i = 0; i < repeat; i++){
-        for(int row = 0; row < keyframe_elements; row++){
-            moveToIndex(row);
-        }
-//        if(getBatteryVoltage() < 9.5){//9.5V is used as the cut off to allow for inaccuracies and be on the safe side.
-//            delay(200);
-//            if(getBatteryVoltage() < 9.5){//Check voltage is still low and the first wasn't a miscellaneous reading
-//                printi(F("Battery low"));
-//                while(1){}//loop and do nothing
-//            }
-//        }
+    if(keyframe_elements < 1 || repeat < 1){
+        return;
+    }
+    for(int i = 0; i < AXIS_COUNT; i++){
+        axes[i]->setSpeed(0);
+    }
+    startJob(JOB_EXECUTE_MOVES);
+    job.repeat = repeat;
+    job.keyframeIndex = -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void nextExecuteMove(void){
+    job.keyframeIndex++;
+    if(job.keyframeIndex >= keyframe_elements){
+        job.keyframeIndex = 0;
+        job.repeatIndex++;
+    }
+    if(job.repeatIndex >= job.repeat || !startKeyframeMove(job.keyframeIndex)){
+        endJob();
+        return;
     }
+    job.phase = PHASE_KEYFRAME_MOVE;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -606,12 +1064,10 @@ void gotoLastKeyframe(void){
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
 void editKeyframe(void){
-    keyframe_array[current_keyframe_index].panStepCount = stepper_pan.currentPosition();
-    keyframe_array[current_keyframe_index].tiltStepCount = stepper_tilt.currentPosition(); 
-    keyframe_array[current_keyframe_index].sliderStepCount = stepper_slider.currentPosition(); 
-    keyframe_array[current_keyframe_index].panSpeed = stepper_pan.maxSpeed();
-    keyframe_array[current_keyframe_index].tiltSpeed = stepper_tilt.maxSpeed();
-    keyframe_array[current_keyframe_index].sliderSpeed = stepper_slider.maxSpeed();
+    for(int i = 0; i < AXIS_COUNT; i++){
+        keyframe_array[current_keyframe_index].stepCount[i] = axes[i]->currentPosition();
+        keyframe_array[current_keyframe_index].speed[i] = axes[i]->maxSpeed();
+    }
     
     printi(F("Edited index: "), current_keyframe_index);
 }
@@ -635,26 +1091,11 @@ void addDelay(unsigned int ms){
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void invertPanDirection(bool invert){
-    printi(F("Pan inversion: "), invert);
-    invert_pan = invert;
-    stepper_pan.setPinsInverted(invert, false, false);
-}
-
-/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
-
-void invertTiltDirection(bool invert){
-    printi(F("Tilt inversion: "), invert);
-    invert_tilt = invert;
-    stepper_tilt.setPinsInverted(invert, false, false);
-}
-
-/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
-
-void invertSliderDirection(bool invert){
-    printi(F("Slider inversion: "), invert);
-    invert_slider = invert;
-    stepper_slider.setPinsInverted(invert, false, false);
+void invertDirection(FastStepper &stepper, byte &setting, const __FlashStringHelper *name, bool invert){ //setting is the saved invert_ variable for the axis
+    printi(progmemText(name), F(" inversion: "));
+    printi(F(""), invert);
+    setting = invert;
+    stepper.setInverted(invert);
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -676,6 +1117,20 @@ void saveEEPROM(void){
     EEPROM.put(EEPROM_ADDRESS_PAN_ACCEL_INCREMENT_DELAY, pan_accel_increment_us);
     EEPROM.put(EEPROM_ADDRESS_TILT_ACCEL_INCREMENT_DELAY, tilt_accel_increment_us);
     EEPROM.put(EEPROM_ADDRESS_SLIDER_ACCEL_INCREMENT_DELAY, slider_accel_increment_us);
+    EEPROM.put(EEPROM_ADDRESS_LENS_HFOV, lens_hfov_degrees);
+    EEPROM.put(EEPROM_ADDRESS_LENS_VFOV, lens_vfov_degrees);
+    EEPROM.put(EEPROM_ADDRESS_PANORAMA_OVERLAP, panorama_overlap_percent);
+    EEPROM.put(EEPROM_ADDRESS_SETTLE_PROFILE, settle_profile);
+    EEPROM.put(EEPROM_ADDRESS_SETTLE_PROFILES, settle_profiles);
+    EEPROM.put(EEPROM_ADDRESS_SETTLE_SPEEDS, settle_speeds);
+    EEPROM.put(EEPROM_ADDRESS_NODAL_OFFSET, nodal_offset_mm);
+    EEPROM.put(EEPROM_ADDRESS_TILT_AXIS_HEIGHT, tilt_axis_height_mm);
+    EEPROM.put(EEPROM_ADDRESS_IDLE_DISABLE_DELAY, idle_disable_ms);
+    EEPROM.put(EEPROM_ADDRESS_IDLE_HOLD_MASK, idle_hold_mask);
+    EEPROM.put(EEPROM_ADDRESS_FOCUS_MAX_SPEED, focus_max_speed);
+    EEPROM.put(EEPROM_ADDRESS_INVERT_FOCUS, invert_focus);
+    EEPROM.put(EEPROM_ADDRESS_ZOOM_MAX_SPEED, zoom_max_speed);
+    EEPROM.put(EEPROM_ADDRESS_INVERT_ZOOM, invert_zoom);
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -712,6 +1167,30 @@ void printEEPROM(void){
     printi(F("Tilt accel delay: "), itemp, F("us\n"));
     EEPROM.get(EEPROM_ADDRESS_SLIDER_ACCEL_INCREMENT_DELAY, itemp);
     printi(F("Slider accel delay: "), itemp, F("us\n"));
+    EEPROM.get(EEPROM_ADDRESS_LENS_HFOV, ftemp);
+    printi(F("Lens HFOV: "), ftemp, 3, F("º\n"));
+    EEPROM.get(EEPROM_ADDRESS_LENS_VFOV, ftemp);
+    printi(F("Lens VFOV: "), ftemp, 3, F("º\n"));
+    EEPROM.get(EEPROM_ADDRESS_PANORAMA_OVERLAP, ftemp);
+    printi(F("Pano overlap: "), ftemp, 3, F("%\n"));
+    printi(F("Settle profile: "), EEPROM.read(EEPROM_ADDRESS_SETTLE_PROFILE));
+    EEPROM.get(EEPROM_ADDRESS_NODAL_OFFSET, ftemp);
+    printi(F("Nodal offset: "), ftemp, 3, F("mm\n"));
+    EEPROM.get(EEPROM_ADDRESS_TILT_AXIS_HEIGHT, ftemp);
+    printi(F("Tilt axis height: "), ftemp, 3, F("mm\n"));
+    EEPROM.get(EEPROM_ADDRESS_IDLE_DISABLE_DELAY, ltemp);
+    printi(F("Idle disable delay: "), ltemp, F("ms\n"));
+    printi(F("Idle hold mask: "), EEPROM.read(EEPROM_ADDRESS_IDLE_HOLD_MASK));
+#ifdef FOCUS_AXIS
+    EEPROM.get(EEPROM_ADDRESS_FOCUS_MAX_SPEED, ftemp);
+    printi(F("Focus max speed: "), ftemp, 3, F("º/s\n"));
+    printi(F("Focus invert: "), EEPROM.read(EEPROM_ADDRESS_INVERT_FOCUS));
+#endif
+#ifdef ZOOM_AXIS
+    EEPROM.get(EEPROM_ADDRESS_ZOOM_MAX_SPEED, ftemp);
+    printi(F("Zoom max speed: "), ftemp, 3, F("º/s\n"));
+    printi(F("Zoom invert: "), EEPROM.read(EEPROM_ADDRESS_INVERT_ZOOM));
+#endif
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -733,6 +1212,51 @@ void setEEPROMVariables(void){
     invert_slider = EEPROM.read(EEPROM_ADDRESS_INVERT_SLIDER);
     homing_mode = EEPROM.read(EEPROM_ADDRESS_HOMING_MODE);
     acceleration_enable_state = EEPROM.read(EEPROM_ADDRESS_ACCELERATION_ENABLE);
+
+    //Settings added after the first release. An EEPROM saved by older firmware has 0xFF in these addresses, which reads back as NaN for the floats
+    //and as the largest value for the integers, so anything out of range keeps the default the variable was initialised with.
+    loadEEPROMFloat(EEPROM_ADDRESS_LENS_HFOV, lens_hfov_degrees, 1, 179);
+    loadEEPROMFloat(EEPROM_ADDRESS_LENS_VFOV, lens_vfov_degrees, 1, 179);
+    loadEEPROMFloat(EEPROM_ADDRESS_PANORAMA_OVERLAP, panorama_overlap_percent, 0, 90);
+    byte savedByte = EEPROM.read(EEPROM_ADDRESS_SETTLE_PROFILE);
+    if(savedByte <= SETTLE_PROFILE_COUNT){
+        settle_profile = savedByte;
+    }
+    SettleProfile savedProfiles[SETTLE_PROFILE_COUNT];
+    EEPROM.get(EEPROM_ADDRESS_SETTLE_PROFILES, savedProfiles);
+    for(int i = 0; i < SETTLE_PROFILE_COUNT; i++){
+        if(savedProfiles[i].slowMs <= SETTLE_CALIBRATION_MAX_MS && savedProfiles[i].fastMs <= SETTLE_CALIBRATION_MAX_MS){
+            settle_profiles[i] = savedProfiles[i];
+        }
+        loadEEPROMFloat(EEPROM_ADDRESS_SETTLE_SPEEDS + i * sizeof(float), settle_speeds[i], 0, SETTLE_SPEED_LIMIT);
+    }
+    unsigned long savedMs;
+    EEPROM.get(EEPROM_ADDRESS_IDLE_DISABLE_DELAY, savedMs);
+    if(savedMs != 0xFFFFFFFF){
+        idle_disable_ms = savedMs;
+    }
+    savedByte = EEPROM.read(EEPROM_ADDRESS_IDLE_HOLD_MASK);
+    if(savedByte != 0xFF){
+        idle_hold_mask = savedByte & HOLD_ALL;
+    }
+    loadEEPROMFloat(EEPROM_ADDRESS_NODAL_OFFSET, nodal_offset_mm, -NODAL_LIMIT_MM, NODAL_LIMIT_MM);
+    loadEEPROMFloat(EEPROM_ADDRESS_TILT_AXIS_HEIGHT, tilt_axis_height_mm, -NODAL_LIMIT_MM, NODAL_LIMIT_MM);
+    loadEEPROMFloat(EEPROM_ADDRESS_FOCUS_MAX_SPEED, focus_max_speed, 0.1, LENS_MAX_SPEED);
+    loadEEPROMFloat(EEPROM_ADDRESS_ZOOM_MAX_SPEED, zoom_max_speed, 0.1, LENS_MAX_SPEED);
+    savedByte = EEPROM.read(EEPROM_ADDRESS_INVERT_FOCUS);
+    invert_focus = (savedByte <= 1) ? savedByte : 0;
+    savedByte = EEPROM.read(EEPROM_ADDRESS_INVERT_ZOOM);
+    invert_zoom = (savedByte <= 1) ? savedByte : 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void loadEEPROMFloat(int address, float &value, float lower, float upper){ //Leaves value as it is if the saved one is NaN or out of range
+    float saved;
+    EEPROM.get(address, saved);
+    if(saved >= lower && saved <= upper){
+        value = saved;
+    }
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -757,28 +1281,160 @@ void triggerCameraShutter(void){
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void panoramiclapseInterpolation(float panStartAngle, float tiltStartAngle, float sliderStartPos, float panStopAngle, float tiltStopAngle, float sliderStopPos, float degPerPic, unsigned long msDelay){
-    if(degPerPic == 0) return;
-    if(msDelay > SHUTTER_DELAY){
-        msDelay = msDelay - SHUTTER_DELAY;
+void startCameraShutter(void){ //Non-blocking version of triggerCameraShutter(). updateCameraShutter() must be called to release the shutter.
+    digitalWrite(PIN_SHUTTER_TRIGGER, HIGH);
+    shutter_start_ms = millis();
+    shutter_active = true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void updateCameraShutter(void){
+    if(shutter_active && millis() - shutter_start_ms >= SHUTTER_DELAY){
+        digitalWrite(PIN_SHUTTER_TRIGGER, LOW);
+        shutter_active = false;
     }
-    float panAngle = panStopAngle - panStartAngle;
-    float tiltAngle = tiltStopAngle - tiltStartAngle;
-    float sliderDistance = sliderStopPos - sliderStartPos;
-    float largestAngle = (abs(panAngle) > abs(tiltAngle)) ? panAngle : tiltAngle;
-    unsigned int numberOfIncrements = abs(largestAngle) / degPerPic;
-    if(numberOfIncrements == 0) return;
-    float panInc = panAngle / numberOfIncrements;
-    float tiltInc = tiltAngle / numberOfIncrements;
-    float sliderInc = sliderDistance / numberOfIncrements;
-    
-    for(int i = 0; i <= numberOfIncrements; i++){
-        setTargetPositions(panStartAngle + (panInc * i), tiltStartAngle + (tiltInc * i), sliderStartPos + (sliderInc * i));
-        multi_stepper.runSpeedToPosition();//blocking move to the next position
-        delay(msDelay / 2);
-        triggerCameraShutter();//capture the picture
-        delay(msDelay / 2);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float moveSpeed(void){ //Fastest pan or tilt rate in degrees/second. Called straight after multi_stepper.moveTo() which sets the speeds held for the whole move.
+    float speed = 0;
+    if(stepper_pan.distanceToGo() != 0){
+        speed = abs(stepper_pan.speed()) / pan_steps_per_degree;
+    }
+    if(stepper_tilt.distanceToGo() != 0){
+        speed = max(speed, abs(stepper_tilt.speed()) / tilt_steps_per_degree);
+    }
+    return speed;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//The payload rings for longer the faster it was moving when it stopped. The settle time is interpolated between the pan/tilt rates the two calibration
+//series of the selected profile stopped from, so changing the max speeds afterwards doesn't change the settle time of a move at a given rate. A move
+//slower than the slow series still gets its settle time.
+unsigned long settleTime(void){
+    if(settle_profile == 0 || settle_profile > SETTLE_PROFILE_COUNT){
+        return 0;
+    }
+    SettleProfile &profile = settle_profiles[settle_profile - 1];
+    float fastSpeed = settle_speeds[settle_profile - 1];
+    if(!(fastSpeed > 0)){ //Calibrated before the speeds were recorded
+        return profile.fastMs;
+    }
+    float slowSpeed = fastSpeed * SETTLE_CALIBRATION_SLOW_FRACTION;
+    float scale = max((last_move_speed - slowSpeed) / (fastSpeed - slowSpeed), 0.0);
+    float ms = profile.slowMs + (((float)profile.fastMs - (float)profile.slowMs) * scale);
+    return (ms > 0) ? ms : 0;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void setSettleProfile(int profile){
+    if(profile < 0 || profile > SETTLE_PROFILE_COUNT){
+        printi(F("Invalid profile\n"));
+        return;
+    }
+    settle_profile = profile;
+    if(settle_profile == 0){
+        printi(F("Fixed settle time\n"));
+        return;
+    }
+    printi(F("Settle profile "), settle_profile, F("\t"));
+    printi(F("Slow: "), settle_profiles[settle_profile - 1].slowMs, F("ms\t"));
+    printi(F("Fast: "), settle_profiles[settle_profile - 1].fastMs, F("ms\t"));
+    printi(F("Speed: "), settle_speeds[settle_profile - 1], 3, F("º/s\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Shoots two series of test pictures, one after stopping from a slow move and one after stopping from a full speed move. The settle time increases by
+//SETTLE_CALIBRATION_STEP_MS for each frame. Look through the pictures and enter the number of the first sharp frame of each series with k and K.
+void calibrateSettleTime(void){
+    if(settle_profile == 0){
+        printi(F("Select a settle profile\n"));
+        return;
+    }
+    printi(F("Settle calibration\n"));
+    settle_speeds[settle_profile - 1] = 0;
+    startJob(JOB_SETTLE_CALIBRATION);
+    job.totalFrames = 2 * SETTLE_CALIBRATION_FRAMES;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Each frame moves away and back again so every frame is taken from the same position after stopping from the same speed. job.keyframeIndex is the
+//step of the frame being worked on.
+void nextSettleCalibrationFrame(void){
+    if(job.frameIndex >= job.totalFrames){
+        printi(F("Enter the first sharp frame of each series with k and K\n"));
+        endJob();
+        return;
+    }
+    int series = job.frameIndex / SETTLE_CALIBRATION_FRAMES;
+    int i = job.frameIndex % SETTLE_CALIBRATION_FRAMES;
+    switch(job.keyframeIndex){
+        case 0:{ //Move away
+            if(i == 0){
+                float speedFraction = (series == 0) ? SETTLE_CALIBRATION_SLOW_FRACTION : 1.0;
+                stepper_pan.setMaxSpeed(panDegreesToSteps(pan_max_speed * speedFraction));
+                stepper_tilt.setMaxSpeed(tiltDegreesToSteps(tilt_max_speed * speedFraction));
+            }
+            settleCalibrationMove(1);
+            job.keyframeIndex = 1;
+            job.phase = PHASE_REPOSITION;
+        }
+        break;
+        case 1:{ //And back
+            settleCalibrationMove(-1);
+            if(series == 1){
+                settle_speeds[settle_profile - 1] = last_move_speed; //Rate the fast series stops from
+            }
+            job.keyframeIndex = 2;
+            job.phase = PHASE_REPOSITION;
+        }
+        break;
+        default:{
+            job.frameIndex++;
+            job.keyframeIndex = 0;
+            job.settleMs = (unsigned long)i * SETTLE_CALIBRATION_STEP_MS;
+            job.msDelay = job.settleMs + SETTLE_CALIBRATION_GAP_MS;
+            printi(F("Frame "), job.frameIndex, F("\t"));
+            printi(F("Settle: "), job.settleMs, F("ms\n"));
+            startJobWait(job.settleMs, false);
+            job.phase = PHASE_SETTLE;
+        }
+        break;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void settleCalibrationMove(int direction){ //Whole step offsets so the mount always comes back to exactly the same position
+    for(int i = 0; i < AXIS_COUNT; i++){
+        target_position[i] = axes[i]->currentPosition();
+    }
+    target_position[AXIS_PAN] += direction * (long)panDegreesToSteps(SETTLE_CALIBRATION_PAN_DEGREES);
+    target_position[AXIS_TILT] += direction * (long)tiltDegreesToSteps(SETTLE_CALIBRATION_TILT_DEGREES);
+    multi_stepper.moveTo(target_position);
+    last_move_speed = moveSpeed();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void setSettleCalibrationFrame(int frame, bool fastSeries){
+    int firstFrame = fastSeries ? SETTLE_CALIBRATION_FRAMES + 1 : 1;
+    if(settle_profile == 0 || frame < firstFrame || frame >= firstFrame + SETTLE_CALIBRATION_FRAMES){
+        printi(F("Invalid frame\n"));
+        return;
+    }
+    unsigned int ms = (frame - firstFrame) * SETTLE_CALIBRATION_STEP_MS;
+    if(fastSeries){
+        settle_profiles[settle_profile - 1].fastMs = ms;
     }
+    else{
+        settle_profiles[settle_profile - 1].slowMs = ms;
+    }
+    setSettleProfile(settle_profile);
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
@@ -788,230 +1444,886 @@ void panoramiclapse(float degPerPic, unsigned long msDelay, int repeat){
         printi(F("Not enough keyframes\n"));
         return; //check there are posions to move to
     }
-    for(int i = 0; i < repeat; i++){
-        for(int index = 0; index < keyframe_elements - 1; index++){
-            panoramiclapseInterpolation(panStepsToDegrees(keyframe_array[index].panStepCount), tiltStepsToDegrees(keyframe_array[index].tiltStepCount), sliderStepsToMillimetres(keyframe_array[index].sliderStepCount),
-            panStepsToDegrees(keyframe_array[index + 1].panStepCount), tiltStepsToDegrees(keyframe_array[index + 1].tiltStepCount), sliderStepsToMillimetres(keyframe_array[index + 1].sliderStepCount), degPerPic, msDelay);
+    if(degPerPic == 0 || repeat < 1) return;
+    if(msDelay > SHUTTER_DELAY){
+        msDelay = msDelay - SHUTTER_DELAY;
+    }
+    startJob(JOB_PANORAMICLAPSE);
+    job.repeat = repeat;
+    job.degPerPic = degPerPic;
+    job.msDelay = msDelay;
+    job.keyframeIndex = -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void nextPanoramiclapseFrame(void){ //Moves to the next frame between keyframes job.keyframeIndex and job.keyframeIndex + 1
+    while(job.keyframeIndex < 0 || job.frameIndex > job.frameCount){ //Start the next segment with at least one increment
+        job.keyframeIndex++;
+        if(job.keyframeIndex >= keyframe_elements - 1){
+            job.keyframeIndex = 0;
+            job.repeatIndex++;
+        }
+        if(job.repeatIndex >= job.repeat){
+            endJob();
+            return;
         }
+        float panAngle = panStepsToDegrees(keyframe_array[job.keyframeIndex + 1].stepCount[AXIS_PAN] - keyframe_array[job.keyframeIndex].stepCount[AXIS_PAN]);
+        float tiltAngle = tiltStepsToDegrees(keyframe_array[job.keyframeIndex + 1].stepCount[AXIS_TILT] - keyframe_array[job.keyframeIndex].stepCount[AXIS_TILT]);
+        float largestAngle = (abs(panAngle) > abs(tiltAngle)) ? panAngle : tiltAngle;
+        job.frameCount = abs(largestAngle) / job.degPerPic;
+        job.frameIndex = (job.frameCount == 0) ? 1 : 0; //Segments without a full increment are skipped
+    }
+    KeyframeElement &start = keyframe_array[job.keyframeIndex];
+    KeyframeElement &stop = keyframe_array[job.keyframeIndex + 1];
+    float fraction = (float)job.frameIndex / job.frameCount;
+    float panStart = panStepsToDegrees(start.stepCount[AXIS_PAN]);
+    float tiltStart = tiltStepsToDegrees(start.stepCount[AXIS_TILT]);
+    float panAngle = panStepsToDegrees(start.stepCount[AXIS_PAN] + (stop.stepCount[AXIS_PAN] - start.stepCount[AXIS_PAN]) * fraction);
+    float tiltAngle = tiltStepsToDegrees(start.stepCount[AXIS_TILT] + (stop.stepCount[AXIS_TILT] - start.stepCount[AXIS_TILT]) * fraction);
+    float startPupil = nodalOffset(panStart, tiltStart); //The entrance pupil moves in a straight line between where it was at the two keyframes
+    float stopPupil = nodalOffset(panStepsToDegrees(stop.stepCount[AXIS_PAN]), tiltStepsToDegrees(stop.stepCount[AXIS_TILT]));
+    float sliderPos = sliderStepsToMillimetres((long)(start.stepCount[AXIS_SLIDER] + (stop.stepCount[AXIS_SLIDER] - start.stepCount[AXIS_SLIDER]) * fraction));
+    setTargetPositions(panAngle, tiltAngle, sliderPos + startPupil + (stopPupil - startPupil) * fraction - nodalOffset(panAngle, tiltAngle));
+    job.frameIndex++;
+    job.phase = PHASE_MOVING;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Plans a grid panorama covering the area between the first two keyframes (the centres of opposite corner frames).
+//The number of rows and columns comes from the lens field of view and the requested overlap. The frames are shot in a serpentine order and the sweep
+//direction (along the rows or down the columns) is picked using the real axis speeds so the least time is spent moving between frames.
+bool planPanorama(PanoramaPlan &plan, unsigned long msDelay){
+    if(keyframe_elements < 2){
+        printi(F("Not enough keyframes\n"));
+        return false;
+    }
+    float overlapScale = 1 - boundFloat(panorama_overlap_percent, 0, 90) / 100.0;
+    float panStep = lens_hfov_degrees * overlapScale; //Largest angle between frame centres that still gives the requested overlap
+    float tiltStep = lens_vfov_degrees * overlapScale;
+    if(!(panStep > 0) || !(tiltStep > 0)){ //Written so NaN fails too
+        printi(F("Invalid FOV\n"));
+        return false;
+    }
+    plan.panStart = panStepsToDegrees(keyframe_array[0].stepCount[AXIS_PAN]);
+    plan.tiltStart = tiltStepsToDegrees(keyframe_array[0].stepCount[AXIS_TILT]);
+    float panSpan = panStepsToDegrees(keyframe_array[1].stepCount[AXIS_PAN]) - plan.panStart;
+    float tiltSpan = tiltStepsToDegrees(keyframe_array[1].stepCount[AXIS_TILT]) - plan.tiltStart;
+    plan.columns = ceil(abs(panSpan) / panStep) + 1;
+    plan.rows = ceil(abs(tiltSpan) / tiltStep) + 1;
+    plan.panIncrement = (plan.columns > 1) ? panSpan / (plan.columns - 1) : 0; //Spread the frames evenly so the overlap is never less than requested
+    plan.tiltIncrement = (plan.rows > 1) ? tiltSpan / (plan.rows - 1) : 0;
+
+    float panSpeed = panStepsToDegrees(stepper_pan.maxSpeed()); //degrees/second
+    float tiltSpeed = tiltStepsToDegrees(stepper_tilt.maxSpeed());
+    if(panSpeed <= 0 || tiltSpeed <= 0){
+        printi(F("Invalid speed\n"));
+        return false;
     }
+    float panMoveTime = abs(plan.panIncrement) / panSpeed; //seconds to move one column
+    float tiltMoveTime = abs(plan.tiltIncrement) / tiltSpeed; //seconds to move one row
+    float rowMajorTime = (plan.rows * (plan.columns - 1) * panMoveTime) + ((plan.rows - 1) * tiltMoveTime);
+    float columnMajorTime = (plan.columns * (plan.rows - 1) * tiltMoveTime) + ((plan.columns - 1) * panMoveTime);
+    plan.columnMajor = columnMajorTime < rowMajorTime;
+
+    float moveTime = plan.columnMajor ? columnMajorTime : rowMajorTime;
+    float startTime = max(abs(plan.panStart - panStepsToDegrees(stepper_pan.currentPosition())) / panSpeed, abs(plan.tiltStart - tiltStepsToDegrees(stepper_tilt.currentPosition())) / tiltSpeed);
+    unsigned long frameMs = (msDelay > SHUTTER_DELAY) ? msDelay : SHUTTER_DELAY; //Time spent stationary for each frame
+    plan.estimatedMs = ((moveTime + startTime) * 1000) + ((unsigned long)plan.columns * plan.rows * frameMs);
+    return true;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void timelapse(unsigned int numberOfPictures, unsigned long msDelay){
+void panoramaFramePosition(const PanoramaPlan &plan, unsigned int frame, float &panAngle, float &tiltAngle){
+    unsigned int sweepLength = plan.columnMajor ? plan.rows : plan.columns; //Number of frames in each sweep of the serpentine
+    unsigned int sweep = frame / sweepLength;
+    unsigned int position = frame % sweepLength;
+    if(sweep % 2 == 1){ //Every other sweep runs backwards so there is no long move back to the start of the sweep
+        position = sweepLength - 1 - position;
+    }
+    unsigned int column = plan.columnMajor ? sweep : position;
+    unsigned int row = plan.columnMajor ? position : sweep;
+    panAngle = plan.panStart + (plan.panIncrement * column);
+    tiltAngle = plan.tiltStart + (plan.tiltIncrement * row);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Slider position that keeps the entrance pupil at the same point along the slider as it was at panStart/tiltStart. The pupil is nodal_offset_mm in front
+//of the tilt axis so it swings around as the camera pans and tilts. Only the component along the slider can be corrected.
+float nodalSliderPosition(float sliderStart, float panStart, float tiltStart, float panAngle, float tiltAngle){
+    return sliderStart + nodalOffset(panStart, tiltStart) - nodalOffset(panAngle, tiltAngle);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float nodalOffset(float panAngle, float tiltAngle){ //Distance along the slider from the tilt axis to the entrance pupil
+    return nodal_offset_mm * cos(degToRads(tiltAngle)) * cos(degToRads(panAngle));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void panoramaGrid(unsigned long msDelay){
+    if(!planPanorama(panorama_plan, msDelay)){
+        return;
+    }
+    printi(F("Grid panorama\n"));
+    printi(F("Columns: "), panorama_plan.columns, F("\t"));
+    printi(F("Rows: "), panorama_plan.rows, F("\n"));
+    printi(F("Estimated time: "), panorama_plan.estimatedMs / 1000, F("s\n"));
     if(msDelay > SHUTTER_DELAY){
         msDelay = msDelay - SHUTTER_DELAY;
     }
-    
-    if(numberOfPictures > 1){
-        numberOfPictures = numberOfPictures - 1;
+    panorama_plan.sliderStart = sliderStepsToMillimetres(stepper_slider.currentPosition());
+    checkBatteryRuntime(panorama_plan.estimatedMs);
+    startJob(JOB_PANORAMA_GRID);
+    job.msDelay = msDelay;
+    job.totalFrames = panorama_plan.columns * panorama_plan.rows;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void nextPanoramaGridFrame(void){
+    if(job.frameIndex >= job.totalFrames){
+        endJob();
+        return;
     }
-    
-    unsigned long halfDelay = msDelay / 2;
-   
-    float panAngle = 0;
-    float tiltAngle = 0;
-    float sliderTravel = 0;
-    
-    if(keyframe_elements >= 2){ 
-        panAngle = panStepsToDegrees(keyframe_array[1].panStepCount) - panStepsToDegrees(keyframe_array[0].panStepCount);
-        tiltAngle = tiltStepsToDegrees(keyframe_array[1].tiltStepCount) - tiltStepsToDegrees(keyframe_array[0].tiltStepCount);
-        sliderTravel = sliderStepsToMillimetres(keyframe_array[1].sliderStepCount) - sliderStepsToMillimetres(keyframe_array[0].sliderStepCount);
+    float panAngle, tiltAngle;
+    panoramaFramePosition(panorama_plan, job.frameIndex, panAngle, tiltAngle);
+    setTargetPositions(panAngle, tiltAngle, nodalSliderPosition(panorama_plan.sliderStart, panorama_plan.panStart, panorama_plan.tiltStart, panAngle, tiltAngle));
+    job.frameIndex++;
+    job.phase = PHASE_MOVING;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long easeFraction(long fraction, byte easing){ //Fixed point (FRACTION_BITS) easing curves. Integer only so it is cheap to call for every frame.
+    const long one = 1L << FRACTION_BITS;
+    switch(easing){
+        case EASING_IN:
+            return (fraction * fraction) >> FRACTION_BITS;
+        case EASING_OUT:
+            return (fraction * (2 * one - fraction)) >> FRACTION_BITS;
+        case EASING_IN_OUT:{ //Smoothstep: 3x^2 - 2x^3
+            long squared = (fraction * fraction) >> FRACTION_BITS;
+            return (squared * (3 * one - 2 * fraction)) >> FRACTION_BITS;
+        }
     }
-    
-    float sliderInc = sliderTravel / numberOfPictures;
-    float panInc = panAngle / numberOfPictures;
-    float tiltInc = tiltAngle / numberOfPictures;
+    return fraction;
+}
 
-    setTargetPositions(panStepsToDegrees(keyframe_array[0].panStepCount), tiltStepsToDegrees(keyframe_array[0].tiltStepCount), sliderStepsToMillimetres(keyframe_array[0].sliderStepCount));
-    multi_stepper.runSpeedToPosition();//blocking move to the next position
-    
-    for(int i = 0; i <= numberOfPictures; i++){
-        setTargetPositions(panStepsToDegrees(keyframe_array[0].panStepCount) + (panInc * i), tiltStepsToDegrees(keyframe_array[0].tiltStepCount) + (tiltInc * i), sliderStepsToMillimetres(keyframe_array[0].sliderStepCount) + (sliderInc * i));
-        multi_stepper.runSpeedToPosition();//blocking move to the next position
-        delay(halfDelay);
-        triggerCameraShutter();//capture the picture
-        delay(halfDelay);
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Works out how many of the pictures are taken in each keyframe segment before the timelapse starts. Keyframe delays are held for msDelay / msInterval
+//pictures and the remaining pictures are shared between the segments in proportion to how long each takes at its saved speeds.
+bool compileTimelapse(unsigned int numberOfPictures, unsigned long msInterval){
+    if(msInterval == 0){
+        msInterval = 1;
+    }
+    long movingFrames = (long)numberOfPictures - 1; //The first picture is taken at keyframe 0
+    for(int index = 0; index < keyframe_elements; index++){
+        movingFrames -= keyframe_array[index].msDelay / msInterval;
+    }
+    float totalTime = 0;
+    for(int index = 0; index < keyframe_elements - 1; index++){
+        totalTime += segmentTime(index);
     }
+    if(movingFrames < keyframe_elements - 1 || totalTime <= 0){
+        printi(F("Not enough pics for the keyframes\n"));
+        return false;
+    }
+    float elapsedTime = 0;
+    long allocatedFrames = 0;
+    for(int index = 0; index < keyframe_elements - 1; index++){ //Rounds the running total so the segment frames always add up to movingFrames
+        elapsedTime += segmentTime(index);
+        long frames = (long)(movingFrames * (elapsedTime / totalTime) + 0.5) - allocatedFrames;
+        timelapse_segment_frames[index] = frames;
+        allocatedFrames += frames;
+    }
+    return true;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
-//From the first two keyframes the intercept of where the camera is directed is calculated.
-//The first kayframe's x pan and tilt positions are used to calculate a 3D vector. The second keyframe's x and pan position are used to calculate a vertical plane. (It wuld be almost impossible for 2 3D vectors to intercept due to floating point precision issues.)
-//The intercept of the vectorand plane are then calculated to give the X, Y, Z coordinates of the point the camera was pointed at in both keyframes. (The second keyframe will ignore the tilt value and calculate it based on the first keyframes vector.)
-bool calculateTargetCoordinate(void){ 
-    float m1, c1, m2, c2;
-    
-    LinePoints line0;
-    line0.x0 = sliderStepsToMillimetres(keyframe_array[0].sliderStepCount);
-    line0.y0 = 0;
-    line0.x1 = line0.x0 + cos(degToRads(panStepsToDegrees(keyframe_array[0].panStepCount)));
-    line0.y1 = sin(degToRads(panStepsToDegrees(keyframe_array[0].panStepCount)));
-    
-    LinePoints line1;
-    line1.x0 = sliderStepsToMillimetres(keyframe_array[1].sliderStepCount);
-    line1.y0 = 0;
-    line1.x1 = line1.x0 + cos(degToRads(panStepsToDegrees(keyframe_array[1].panStepCount)));
-    line1.y1 = sin(degToRads(panStepsToDegrees(keyframe_array[1].panStepCount)));
+
+void timelapse(unsigned int numberOfPictures, unsigned long msDelay){
+    if(numberOfPictures == 0){
+        return;
+    }
+    unsigned long msInterval = (msDelay > 0) ? msDelay : 1;
+    checkBatteryRuntime((unsigned long)numberOfPictures * msInterval);
+    if(msDelay > SHUTTER_DELAY){
+        msDelay = msDelay - SHUTTER_DELAY;
+    }
     
-    if((line0.x1 - line0.x0) != 0){
-        m1 = (line0.y1 - line0.y0) / (line0.x1 - line0.x0);
-        c1 = line0.y1 - m1 * line0.x1;
+    if(keyframe_elements >= 2 && !compileTimelapse(numberOfPictures, msInterval)){
+        return;
     }
-
-    if((line1.x1 - line1.x0) != 0){
-        m2 = (line1.y1 - line1.y0) / (line1.x1 - line1.x0);
-        c2 = line1.y1 - m2 * line1.x1;
+    startJob(JOB_TIMELAPSE);
+    job.msDelay = msDelay;
+    job.msInterval = msInterval;
+    job.totalFrames = numberOfPictures;
+    job.keyframeIndex = -1;
+    if(keyframe_elements < 2){ //Not enough keyframes to move between so all the pictures are taken from the same position
+        job.holdFrames = numberOfPictures - 1;
     }
+    else{
+        job.holdFrames = keyframe_array[0].msDelay / msInterval;
+    }
+    if(keyframe_elements >= 1){ //First picture at keyframe 0
+        for(int i = 0; i < AXIS_COUNT; i++){
+            target_position[i] = keyframe_array[0].stepCount[i];
+        }
+        multi_stepper.moveTo(target_position);
+        last_move_speed = moveSpeed();
+    }
+    job.phase = PHASE_MOVING;
+}
 
-    if((line0.x1 - line0.x0) == 0){
-        intercept.x = line0.x0;
-        intercept.y = m2 * intercept.x + c2;    
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Works out the position of the next picture. The pictures held at a keyframe are taken first, then the frames compileTimelapse() allocated to the
+//segment that starts at job.keyframeIndex.
+void nextTimelapseFrame(void){
+    if(job.framesTaken >= job.totalFrames){
+        endJob();
+        return;
     }
-    else if((line1.x1 - line1.x0) == 0){
-        intercept.x = line1.x0;
-        intercept.y = m1 * intercept.x + c1;
+    if(job.holdFrames > 0){ //Another picture from the same position
+        job.holdFrames--;
+        job.phase = PHASE_MOVING;
+        return;
     }
-    else{
-        if(m1 == m2){ //If the angle of the slope of both lines are the same they are parallel and cannot intercept.
-            printi(F("Positions do not intersect."));
-            return false;
+    while(job.frameIndex >= job.frameCount){ //Segment finished
+        job.keyframeIndex++;
+        if(job.keyframeIndex >= keyframe_elements - 1){
+            endJob();
+            return;
+        }
+        job.frameIndex = 0;
+        job.frameCount = timelapse_segment_frames[job.keyframeIndex];
+        if(job.frameCount == 0){
+            job.holdFrames = keyframe_array[job.keyframeIndex + 1].msDelay / job.msInterval;
+            if(job.holdFrames > 0){
+                nextTimelapseFrame();
+                return;
+            }
         }
-        intercept.x = (c2 - c1) / (m1 - m2);
-        intercept.y = m1 * intercept.x + c1;
     }
-    intercept.z = tan(degToRads(tiltStepsToDegrees(keyframe_array[0].tiltStepCount))) * sqrt(pow(intercept.x - sliderStepsToMillimetres(keyframe_array[0].sliderStepCount), 2) + pow(intercept.y, 2));
-    if(((panStepsToDegrees(keyframe_array[0].panStepCount) > 0 && panStepsToDegrees(keyframe_array[1].panStepCount) > 0) && intercept.y < 0)
-    || ((panStepsToDegrees(keyframe_array[0].panStepCount) < 0 && panStepsToDegrees(keyframe_array[1].panStepCount) < 0) && intercept.y > 0) || intercept.y == 0){ //Checks that the intercept point is in the direction the camera was pointing and not on the opposite side behind the camera.
-        printi(F("Invalid intercept.\n"));
-        return false;
+    KeyframeElement &start = keyframe_array[job.keyframeIndex];
+    KeyframeElement &stop = keyframe_array[job.keyframeIndex + 1];
+    job.frameIndex++;
+    long fraction = easeFraction(((long)job.frameIndex << FRACTION_BITS) / job.frameCount, stop.easing);
+    for(int i = 0; i < AXIS_COUNT; i++){
+        target_position[i] = start.stepCount[i] + (((stop.stepCount[i] - start.stepCount[i]) * fraction) >> FRACTION_BITS);
     }
-    return true;
+    multi_stepper.moveTo(target_position);
+    last_move_speed = moveSpeed();
+    if(job.frameIndex == job.frameCount){ //Arriving at the next keyframe so its delay is held for the pictures after this one
+        job.holdFrames = stop.msDelay / job.msInterval;
+    }
+    job.phase = PHASE_MOVING;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void interpolateTargetPoint(FloatCoordinate targetPoint, int repeat){ //The first two keyframes are interpolated between while keeping the camera pointing at previously calculated intercept point.
-    if(keyframe_elements < 2){ 
-        printi(F("Not enough keyframes recorded\n"));
-        return; //check there are posions to move to
+void setEasing(int easing){
+    if(current_keyframe_index < 0 || easing < EASING_LINEAR || easing > EASING_OUT){
+        printi(F("Invalid easing\n"));
+        return;
+    }
+    keyframe_array[current_keyframe_index].easing = easing;
+    printi(F("Easing "), easing, F(""));
+    printi(F(" set at index: "), current_keyframe_index);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float segmentTime(int index){ //Seconds to move from keyframe index to index + 1 at the speeds saved with keyframe index + 1.
+    float time = 0;
+    for(int i = 0; i < AXIS_COUNT; i++){
+        if(keyframe_array[index + 1].speed[i] > 0){
+            time = max(time, abs(keyframe_array[index + 1].stepCount[i] - keyframe_array[index].stepCount[i]) / keyframe_array[index + 1].speed[i]);
+        }
     }
+    return time;
+}
 
-    float sliderStartPos = sliderStepsToMillimetres(keyframe_array[0].sliderStepCount); //slider start position
-    float sliderEndPos = sliderStepsToMillimetres(keyframe_array[1].sliderStepCount);
-    float panAngle = 0;
-    float tiltAngle = 0;
-    float x = targetPoint.x - sliderStepsToMillimetres(keyframe_array[0].sliderStepCount);
-    float ySqared = pow(targetPoint.y, 2);    
-    float sliderTravel = sliderStepsToMillimetres(keyframe_array[1].sliderStepCount) - sliderStepsToMillimetres(keyframe_array[0].sliderStepCount);
-    int numberOfIncrements = abs(sliderTravel);
-    float increment = sliderTravel / numberOfIncrements;//size of interpolation increments in mm
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Moves through all the keyframes without stopping, taking a picture every msInterval. The total duration is split between the keyframe segments in
+//proportion to how long each segment takes at its saved speeds. For each picture the step count of the segment's master axis (the axis with the most
+//steps to move) is worked out before it is needed and the shutter is fired by the step that reaches it (AxisStepper::step()), so the pictures are
+//evenly spaced along the path whatever else the loop is doing. Keyframe delays are ignored. The exposure must be short enough that the motion does not blur the pictures.
+void continuousTimelapse(unsigned int numberOfPictures, unsigned long msInterval){
+    if(keyframe_elements < 2){ 
+        printi(F("Not enough keyframes\n"));
+        return;
+    }
+    if(numberOfPictures < 2 || msInterval <= SHUTTER_DELAY){
+        printi(F("Invalid timelapse\n"));
+        return;
+    }
+    float totalWeight = 0;
+    for(int index = 0; index < keyframe_elements - 1; index++){
+        totalWeight += segmentTime(index);
+    }
+    if(totalWeight <= 0){
+        printi(F("Keyframes do not move\n"));
+        return;
+    }
+    float msPerWeight = ((float)(numberOfPictures - 1) * msInterval) / totalWeight;
     
-    for(int j = 0; (j < repeat || (repeat == 0 && j == 0)); j++){
-        for(int i = 0; i <= numberOfIncrements; i++){
-            x = targetPoint.x - (sliderStartPos + increment * i);
-            panAngle = radsToDeg(atan2(targetPoint.y, x));
-            tiltAngle = radsToDeg(atan2(targetPoint.z, sqrt(pow(x, 2) + ySqared)));
-            setTargetPositions(panAngle, tiltAngle, sliderStartPos + increment * i);
-            multi_stepper.runSpeedToPosition();//blocking move to the next position
+    for(int index = 0; index < keyframe_elements - 1; index++){ //Check the speeds needed can be reached before starting
+        float segmentSeconds = segmentTime(index) * msPerWeight / 1000.0;
+        if(segmentSeconds <= 0) continue;
+        for(int i = 0; i < AXIS_COUNT; i++){
+            if(abs(keyframe_array[index + 1].stepCount[i] - keyframe_array[index].stepCount[i]) / segmentSeconds > axisMaxSpeed(i)){
+                printi(F("Too fast for the max speeds\n"));
+                return;
+            }
         }
-        x = targetPoint.x - sliderEndPos;
-        panAngle = radsToDeg(atan2(targetPoint.y, x));
-        tiltAngle = radsToDeg(atan2(targetPoint.z, sqrt(pow(x, 2) + ySqared)));
-        setTargetPositions(panAngle, tiltAngle, sliderEndPos);
-        multi_stepper.runSpeedToPosition();//blocking move to the next position
+    }
 
-        for(int i = numberOfIncrements; (i >= 0 && repeat > 0); i--){
-            x = targetPoint.x - (sliderStartPos + increment * i);
-            panAngle = radsToDeg(atan2(targetPoint.y, x));
-            tiltAngle = radsToDeg(atan2(targetPoint.z, sqrt(pow(x, 2) + ySqared)));
-            setTargetPositions(panAngle, tiltAngle, sliderStartPos + increment * i);
-            multi_stepper.runSpeedToPosition();//blocking move to the next position
+    checkBatteryRuntime((unsigned long)(numberOfPictures - 1) * msInterval);
+    startJob(JOB_CONTINUOUS_TIMELAPSE);
+    job.msInterval = msInterval;
+    job.totalFrames = numberOfPictures;
+    job.keyframeIndex = -1;
+    continuous.msPerWeight = msPerWeight;
+    continuous.segmentStartMs = 0;
+    continuous.segmentMs = 0;
+    startKeyframeMove(0);
+    job.phase = PHASE_KEYFRAME_MOVE;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Starts the move through the next keyframe segment. The first picture is taken at keyframe 0 and the last at the final keyframe.
+void nextContinuousSegment(void){
+    if(job.keyframeIndex >= keyframe_elements - 1){ //The last picture has been taken
+        endJob();
+        return;
+    }
+    if(job.keyframeIndex < 0){
+        startCameraShutter();
+        job.framesTaken = 1;
+    }
+    continuous.segmentStartMs += continuous.segmentMs;
+    job.keyframeIndex++;
+    if(job.keyframeIndex >= keyframe_elements - 1){
+        job.settleMs = 0;
+        job.msDelay = 0;
+        startJobWait(0, false);
+        job.phase = (job.framesTaken < job.totalFrames) ? PHASE_SETTLE : PHASE_NEXT;
+        return;
+    }
+    int index = job.keyframeIndex;
+    continuous.segmentMs = segmentTime(index) * continuous.msPerWeight;
+    if(continuous.segmentMs <= 0){
+        return;
+    }
+    continuous.masterDelta = 0;
+    for(int i = 0; i < AXIS_COUNT; i++){
+        long delta = keyframe_array[index + 1].stepCount[i] - keyframe_array[index].stepCount[i];
+        if(i == 0 || abs(delta) > abs(continuous.masterDelta)){
+            continuous.masterAxis = i;
+            continuous.masterStart = keyframe_array[index].stepCount[i];
+            continuous.masterDelta = delta;
         }
-        if(repeat > 0){
-            setTargetPositions(panAngle, tiltAngle, sliderStartPos);
-            multi_stepper.runSpeedToPosition();//blocking move to the next position 
-        }     
+        axes[i]->setMaxSpeed(max(abs(delta) * 1000.0 / continuous.segmentMs, 1.0)); //Speeds that make every axis take the segment duration
+        target_position[i] = keyframe_array[index + 1].stepCount[i];
     }
+    multi_stepper.moveTo(target_position);
+    nextContinuousTrigger();
+    job.phase = PHASE_CONTINUOUS;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void toggleAcceleration(void){
-    if(acceleration_enable_state == 0){
-        acceleration_enable_state = 1;
-        printi(F("Accel enabled.\n"));
+void nextContinuousTrigger(void){ //Arms the master axis with the step count at which the next picture is taken
+    float nextFrameMs = (float)job.framesTaken * job.msInterval - continuous.segmentStartMs; //Time of the next picture from the start of this segment
+    if(nextFrameMs < continuous.segmentMs){
+        axes[continuous.masterAxis]->armTrigger(continuous.masterStart + (long)(continuous.masterDelta * (nextFrameMs / continuous.segmentMs)));
     }
     else{
-        acceleration_enable_state = 0;
-        printi(F("Accel disabled.\n"));
+        axes[continuous.masterAxis]->disarmTrigger();
     }
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void scaleKeyframeSpeed(float scaleFactor){
-    if(scaleFactor <= 0){//Make sure a valid speed factor was entered
-        printi(F("Invalid factor\n"));
-        return; 
+bool serviceContinuousSegment(void){ //Returns true once the segment has been moved through
+    if(axes[continuous.masterAxis]->triggered()){ //The shutter pin was raised by the step that reached the trigger
+        shutter_start_ms = millis();
+        shutter_active = true;
+        job.framesTaken++;
+        nextContinuousTrigger();
     }
-    
-    for(int row = 0; row < keyframe_elements; row++){
-        keyframe_array[row].panSpeed *= scaleFactor;
-        keyframe_array[row].tiltSpeed *= scaleFactor;
-        keyframe_array[row].sliderSpeed *= scaleFactor;
+    return !multiStepperRunning();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void restoreMaxSpeeds(void){ //After a job that set its own speeds
+    for(int i = 0; i < AXIS_COUNT; i++){
+        axes[i]->setMaxSpeed(axisMaxSpeed(i));
     }
-    printi(F("Keyframe speed scaled by "), scaleFactor, 3, F("\n"));
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-void serialData(void){
-    char instruction = Serial.read();
-    if(instruction == INSTRUCTION_BYTES_SLIDER_PAN_TILT_SPEED){
-        int count = 0;
-        while(Serial.available() < 6){//Wait for 6 bytes to be available. Breaks after ~20ms if bytes are not received.
-                delayMicroseconds(200); 
-                count++;
-                if(count > 100){
-                    serialFlush();//Clear the serial buffer
-                    break;   
-                }
-            }
-            int sliderStepSpeed = (Serial.read() << 8) + Serial.read(); 
-            int panStepSpeed = (Serial.read() << 8) + Serial.read(); 
-            int tiltStepSpeed = (Serial.read() << 8) + Serial.read(); 
+void keyframeRay(int index, FloatCoordinate &origin, FloatCoordinate &direction){ //Position of the entrance pupil and the unit vector the camera points along at a keyframe
+    float panRads = degToRads(panStepsToDegrees(keyframe_array[index].stepCount[AXIS_PAN]));
+    float tiltRads = degToRads(tiltStepsToDegrees(keyframe_array[index].stepCount[AXIS_TILT]));
+    direction.x = cos(tiltRads) * cos(panRads);
+    direction.y = cos(tiltRads) * sin(panRads);
+    direction.z = sin(tiltRads);
+    origin.x = sliderStepsToMillimetres(keyframe_array[index].stepCount[AXIS_SLIDER]) + nodal_offset_mm * direction.x; //The ray starts at the lens entrance pupil
+    origin.y = nodal_offset_mm * direction.y;
+    origin.z = tilt_axis_height_mm + nodal_offset_mm * direction.z;
+}
 
-            stepper_slider.setSpeed(sliderStepSpeed);
-            stepper_pan.setSpeed(panStepSpeed);
-            stepper_tilt.setSpeed(tiltStepSpeed);
-            stepper_slider.runSpeed();
-            stepper_pan.runSpeed();
-            stepper_tilt.runSpeed();
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Every recorded keyframe gives a 3D ray from the camera position on the slider in the direction it was pointing. The target is the point with the least
+//squared distance to all the rays, found by solving sum(I - d*d^T) * p = sum((I - d*d^T) * o) for p. Rays the solution lies behind are dropped and the
+//point is solved again. The RMS distance from the point to the rays that were used is saved in intercept_residual.
+bool calculateTargetCoordinate(void){ 
+    bool used[KEYFRAME_ARRAY_LENGTH];
+    int usedCount = keyframe_elements;
+    FloatCoordinate origin, direction;
+    for(int i = 0; i < keyframe_elements; i++){
+        used[i] = true;
     }
     
-    delay(2); //wait to make sure all data in the serial message has arived 
-    memset(&stringText[0], 0, sizeof(stringText)); //clear the array
-    while(Serial.available()){//set elemetns of stringText to the serial values sent
-        char digit = Serial.read(); //read in a char
-        strncat(stringText, &digit, 1); //add digit to the end of the array
-    }
-    serialFlush();//Clear any excess data in the serial buffer
-    int serialCommandValueInt = atoi(stringText); //converts stringText to an int
-    float serialCommandValueFloat = atof(stringText); //converts stringText to a float
-    if(instruction == '+'){//The Bluetooth module sends a message starting with "+CONNECTING" which should be discarded.
-        delay(100); //wait to make sure all data in the serial message has arived 
-        serialFlush();//Clear any excess data in the serial buffer
-        return;
-    }
-    switch(instruction){        
-        case INSTRUCTION_SCALE_SPEED:{
-            scaleKeyframeSpeed(serialCommandValueFloat);
+    while(true){
+        if(usedCount < 2){
+            printi(F("Not enough keyframes in front of the camera\n"));
+            return false;
         }
-        break;
-        case INSTRUCTION_PAN_ACCEL_INCREMENT_DELAY:{
-            pan_accel_increment_us = (serialCommandValueInt >= 0) ? serialCommandValueInt : 0;
-            printi(F("Pan accel delay: "), pan_accel_increment_us, F("us\n"));
+        float a[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+        float b[3] = {0, 0, 0};
+        for(int i = 0; i < keyframe_elements; i++){
+            if(!used[i]) continue;
+            keyframeRay(i, origin, direction);
+            float d[3] = {direction.x, direction.y, direction.z};
+            float o[3] = {origin.x, origin.y, origin.z};
+            for(int row = 0; row < 3; row++){
+                for(int col = 0; col < 3; col++){
+                    float m = ((row == col) ? 1.0 : 0.0) - d[row] * d[col];
+                    a[row][col] += m;
+                    b[row] += m * o[col];
+                }
+            }
+        }
+        float det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+        if(!(abs(det) >= 1e-6 * usedCount)){ //All the rays are (close to) parallel so there is no single closest point. Written so NaN fails too
+            printi(F("Positions do not intersect.\n"));
+            return false;
+        }
+        intercept.x = (b[0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) - a[0][1] * (b[1] * a[2][2] - a[1][2] * b[2]) + a[0][2] * (b[1] * a[2][1] - a[1][1] * b[2])) / det; //Cramer's rule
+        intercept.y = (a[0][0] * (b[1] * a[2][2] - a[1][2] * b[2]) - b[0] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) + a[0][2] * (a[1][0] * b[2] - b[1] * a[2][0])) / det;
+        intercept.z = (a[0][0] * (a[1][1] * b[2] - b[1] * a[2][1]) - a[0][1] * (a[1][0] * b[2] - b[1] * a[2][0]) + b[0] * (a[1][0] * a[2][1] - a[1][1] * a[2][0])) / det;
+        if(!isfinite(intercept.x) || !isfinite(intercept.y) || !isfinite(intercept.z)){
+            printi(F("Positions do not intersect.\n"));
+            return false;
+        }
+        
+        bool rejected = false;
+        float squaredError = 0;
+        for(int i = 0; i < keyframe_elements; i++){
+            if(!used[i]) continue;
+            keyframeRay(i, origin, direction);
+            float vx = intercept.x - origin.x;
+            float vy = intercept.y - origin.y;
+            float vz = intercept.z - origin.z;
+            float along = vx * direction.x + vy * direction.y + vz * direction.z; //Distance along the ray to the closest point
+            if(along <= 0){ //The target would be behind the camera
+                used[i] = false;
+                usedCount--;
+                rejected = true;
+                continue;
+            }
+            vx -= along * direction.x;
+            vy -= along * direction.y;
+            vz -= along * direction.z;
+            squaredError += vx * vx + vy * vy + vz * vz;
+        }
+        if(!rejected){
+            intercept_residual = sqrt(squaredError / usedCount);
+            intercept_rays = usedCount;
+            return true;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+//Pan and tilt angles that point the camera at targetPoint from sliderPos. The entrance pupil sits on the optical axis which passes through the tilt axis, so
+//aiming the line from the tilt axis at the target also aims the lens at it whatever the nodal offset is.
+void targetAngles(FloatCoordinate targetPoint, float sliderPos, float &panAngle, float &tiltAngle){
+    float x = targetPoint.x - sliderPos;
+    panAngle = radsToDeg(atan2(targetPoint.y, x));
+    tiltAngle = radsToDeg(atan2(targetPoint.z - tilt_axis_height_mm, sqrt(x * x + targetPoint.y * targetPoint.y)));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Orbits are run as a job. The slider moves through the keyframes at their saved slider speeds while the pan and tilt track the target, holding at each
+//keyframe for its delay. With a repeat count it goes back through them and starts again.
+void interpolateTargetPoint(FloatCoordinate targetPoint, int repeat){
+    if(keyframe_elements < 2){ 
+        printi(F("Not enough keyframes recorded\n"));
+        return; //check there are posions to move to
+    }
+    float panAngle, tiltAngle;
+    stepper_pan.setMaxSpeed(panDegreesToSteps(pan_max_speed)); //Pan and tilt speeds are limited to the max speeds while tracking
+    stepper_tilt.setMaxSpeed(tiltDegreesToSteps(tilt_max_speed));
+    startJob(JOB_ORBIT);
+    job.repeat = repeat;
+    orbit.target = targetPoint;
+    orbit.direction = 1;
+    targetAngles(targetPoint, sliderStepsToMillimetres(keyframe_array[0].stepCount[AXIS_SLIDER]), panAngle, tiltAngle);
+    setTargetPositions(panAngle, tiltAngle, sliderStepsToMillimetres(keyframe_array[0].stepCount[AXIS_SLIDER])); //Move to the start position
+    job.phase = PHASE_REPOSITION;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void nextOrbitKeyframe(void){ //Forwards through the keyframes then, if there is a repeat count, back to the first and round again
+    int index = job.keyframeIndex + orbit.direction;
+    if(index >= keyframe_elements){
+        if(job.repeat == 0){
+            endJob();
+            return;
+        }
+        orbit.direction = -1;
+        index = keyframe_elements - 2;
+    }
+    else if(index < 0){
+        job.repeatIndex++;
+        if(job.repeatIndex >= job.repeat){
+            endJob();
+            return;
+        }
+        orbit.direction = 1;
+        index = 1;
+    }
+    startOrbitMove(index);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void startOrbitMove(int index){
+    job.keyframeIndex = index;
+    orbit.sliderStart = stepper_slider.currentPosition();
+    for(int i = AXIS_SLIDER + 1; i < AXIS_COUNT; i++){
+        orbit.lensStart[i] = axes[i]->currentPosition();
+    }
+    long sliderTarget = keyframe_array[index].stepCount[AXIS_SLIDER];
+    orbit.sliderSpeed = (keyframe_array[index].speed[AXIS_SLIDER] > 0) ? keyframe_array[index].speed[AXIS_SLIDER] : sliderMillimetresToSteps(slider_max_speed);
+    if(sliderTarget < orbit.sliderStart){
+        orbit.sliderSpeed = -orbit.sliderSpeed;
+    }
+    stepper_slider.setMaxSpeed(sliderMillimetresToSteps(slider_max_speed)); //Allows the feed override to go faster than the keyframe speed
+    stepper_slider.moveTo(sliderTarget);
+    orbit.lastControlMs = millis() - ORBIT_CONTROL_PERIOD_MS; //Sets the speeds on the next pass
+    orbit.phase = ORBIT_TRACK;
+    job.phase = PHASE_ORBIT;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Every ORBIT_CONTROL_PERIOD_MS the pan and tilt angles are worked out for where the slider will be at the end of the next period and their speeds are set
+//so they arrive there at the same time. The lens axes move in proportion to the slider so they reach the keyframe's focus and zoom with it. Each axis is
+//given a target a period past that point so a late update doesn't stop it and a stop has room to ramp down.
+void updateOrbitSpeeds(void){
+    const float period = ORBIT_CONTROL_PERIOD_MS / 1000.0;
+    long sliderTarget = keyframe_array[job.keyframeIndex].stepCount[AXIS_SLIDER];
+    float panAngle, tiltAngle;
+    orbit.lastControlMs = millis();
+    updateFeedOverride();
+    stepper_slider.setSpeed(orbit.sliderSpeed * feed_override); //Limited to the max slider speed
+    float speed = stepper_slider.speed();
+    long nextSliderPos = stepper_slider.currentPosition() + (long)(speed * period);
+    if((speed > 0 && nextSliderPos > sliderTarget) || (speed < 0 && nextSliderPos < sliderTarget)){
+        nextSliderPos = sliderTarget;
+    }
+    targetAngles(orbit.target, sliderStepsToMillimetres(nextSliderPos), panAngle, tiltAngle);
+    long next[AXIS_COUNT];
+    next[AXIS_PAN] = panDegreesToSteps(panAngle);
+    next[AXIS_TILT] = tiltDegreesToSteps(tiltAngle);
+    float progress = (float)(nextSliderPos - orbit.sliderStart) / (sliderTarget - orbit.sliderStart); //Only called while the slider has somewhere to go
+    for(int i = AXIS_SLIDER + 1; i < AXIS_COUNT; i++){
+        next[i] = orbit.lensStart[i] + (long)((keyframe_array[job.keyframeIndex].stepCount[i] - orbit.lensStart[i]) * progress);
+    }
+    for(int i = 0; i < AXIS_COUNT; i++){
+        if(i == AXIS_SLIDER){
+            continue;
+        }
+        long current = axes[i]->currentPosition();
+        axes[i]->moveTo(2 * next[i] - current);
+        axes[i]->setSpeed((next[i] - current) / period); //moveTo() recalculates the speed so it has to be set afterwards
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool serviceOrbit(void){ //Returns true once the keyframe has been reached and its delay has been held
+    switch(orbit.phase){
+        case ORBIT_TRACK:{
+            if(stepper_slider.distanceToGo() != 0){
+                if(millis() - orbit.lastControlMs >= ORBIT_CONTROL_PERIOD_MS){
+                    updateOrbitSpeeds();
+                }
+                break;
+            }
+            float panAngle, tiltAngle;
+            float sliderMm = sliderStepsToMillimetres(keyframe_array[job.keyframeIndex].stepCount[AXIS_SLIDER]);
+            targetAngles(orbit.target, sliderMm, panAngle, tiltAngle); //Correct any error left from the last period
+            setTargetPositions(panAngle, tiltAngle, sliderMm);
+#if AXIS_COUNT > 3
+            for(int i = AXIS_SLIDER + 1; i < AXIS_COUNT; i++){
+                target_position[i] = keyframe_array[job.keyframeIndex].stepCount[i];
+            }
+            multi_stepper.moveTo(target_position);
+#endif
+            orbit.phase = ORBIT_CORRECT;
+        }
+        break;
+        case ORBIT_CORRECT:{
+            if(!multiStepperRunning()){
+                startJobWait(keyframe_array[job.keyframeIndex].msDelay, true);
+                orbit.phase = ORBIT_HOLD;
+            }
+        }
+        break;
+        case ORBIT_HOLD:{
+            return jobWaitDone();
+        }
+    }
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void toggleAcceleration(void){
+    if(acceleration_enable_state == 0){
+        acceleration_enable_state = 1;
+        printi(F("Accel enabled.\n"));
+    }
+    else{
+        acceleration_enable_state = 0;
+        printi(F("Accel disabled.\n"));
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void scaleKeyframeSpeed(float scaleFactor){
+    if(scaleFactor <= 0){//Make sure a valid speed factor was entered
+        printi(F("Invalid factor\n"));
+        return; 
+    }
+    
+    for(int row = 0; row < keyframe_elements; row++){
+        for(int i = 0; i < AXIS_COUNT; i++){
+            keyframe_array[row].speed[i] *= scaleFactor;
+        }
+    }
+    printi(F("Keyframe speed scaled by "), scaleFactor, 3, F("\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Unlike scaleKeyframeSpeed() the feed override doesn't change the keyframes. It scales the speeds of keyframe moves and orbits while they are running
+//and is eased in at FEED_OVERRIDE_RATE so the speed can be changed smoothly to follow the action.
+void setFeedOverride(float percent){
+    feed_override_target = boundFloat(percent, FEED_OVERRIDE_MIN, FEED_OVERRIDE_MAX) / 100.0;
+    printi(F("Feed override: "), feed_override_target * 100, 0, F("%\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool updateFeedOverride(void){ //Moves feed_override towards its target. Returns true if it changed.
+    unsigned long nowMs = millis();
+    float maxChange = (nowMs - feed_override_ms) * (FEED_OVERRIDE_RATE / 100000.0);
+    feed_override_ms = nowMs;
+    if(feed_override == feed_override_target){
+        return false;
+    }
+    if(feed_override_target > feed_override){
+        feed_override = min(feed_override + maxChange, feed_override_target);
+    }
+    else{
+        feed_override = max(feed_override - maxChange, feed_override_target);
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void applyFeedOverride(bool newMove){ //Scales the speeds multi_stepper.moveTo() set for the keyframe move. All the axes are scaled together so they still arrive together.
+    if(newMove){ //Called straight after moveTo() so these are the unscaled speeds
+        for(int i = 0; i < AXIS_COUNT; i++){
+            keyframe_move.speed[i] = axes[i]->speed();
+        }
+    }
+    keyframe_move.feedScale = feedScale();
+    for(int i = 0; i < AXIS_COUNT; i++){
+        setFeedSpeed(*axes[i], keyframe_move.speed[i] * keyframe_move.feedScale);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float feedScale(void){ //feed_override limited so no axis of the keyframe move goes over its max speed
+    float scale = feed_override;
+    for(int i = 0; i < AXIS_COUNT; i++){
+        float maxSpeed = axisMaxSpeed(i);
+        if(abs(keyframe_move.speed[i]) * scale > maxSpeed){
+            scale = maxSpeed / abs(keyframe_move.speed[i]);
+        }
+    }
+    return scale;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void setFeedSpeed(AccelStepper &stepper, float speed){ //setSpeed() is limited to maxSpeed() so it is raised for overrides over 100%
+    if(abs(speed) > stepper.maxSpeed()){
+        stepper.setMaxSpeed(abs(speed));
+    }
+    stepper.setSpeed(speed);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void setKeyframeMaxSpeeds(int index){
+    for(int i = 0; i < AXIS_COUNT; i++){
+        axes[i]->setMaxSpeed(keyframe_array[index].speed[i]);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int16_t readSerialInt16(void){ //Big endian. The bytes are read in separate statements because the order of the reads in one expression is unspecified.
+    byte high = Serial.read();
+    byte low = Serial.read();
+    return (int16_t)((high << 8) | low);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool waitSerialBytes(int count){ //Waits up to ~20ms for count bytes. The serial buffer is cleared if they don't all arrive.
+    for(int i = 0; Serial.available() < count; i++){
+        if(i > 100){
+            serialFlush();
+            return false;
+        }
+        delayMicroseconds(200);
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#ifdef SEGMENT_STREAM
+void readSegments(void){ //Queues the segments in a binary segment packet and replies with the slots left so the host knows how many more it can send
+    if(waitSerialBytes(1)){
+        byte count = Serial.read();
+        if(count <= SEGMENT_FRAME_MAX && waitSerialBytes(count * SEGMENT_AXES * 2)){
+            for(byte i = 0; i < count; i++){
+                int16_t steps[SEGMENT_AXES];
+                for(int axis = 0; axis < SEGMENT_AXES; axis++){
+                    steps[axis] = readSerialInt16();
+                }
+                if(job.type != JOB_SEGMENTS){ //segments shares its RAM with the other jobs
+                    continue;
+                }
+                if(job.state != JOB_RUNNING || segments.ended || segments.count >= SEGMENT_BUFFER_LENGTH){
+                    segments.dropped++;
+                    continue;
+                }
+                byte slot = (segments.head + segments.count) % SEGMENT_BUFFER_LENGTH;
+                memcpy(segments.steps[slot], steps, sizeof(steps));
+                segments.count++;
+            }
+        }
+        else{
+            serialFlush();
+        }
+    }
+    Serial.write(SEGMENT_CREDIT);
+    Serial.write((job.type == JOB_SEGMENTS && !segments.ended) ? SEGMENT_BUFFER_LENGTH - segments.count : 0);
+}
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void serialData(void){
+    char instruction = Serial.read();
+#ifdef SEGMENT_STREAM
+    if(instruction == INSTRUCTION_BYTES_SEGMENTS){
+        readSegments();
+        return;
+    }
+#endif
+    if(instruction == INSTRUCTION_BYTES_SLIDER_PAN_TILT_SPEED){
+        int count = 0;
+        while(Serial.available() < 6){//Wait for 6 bytes to be available. Breaks after ~20ms if bytes are not received.
+                delayMicroseconds(200); 
+                count++;
+                if(count > 100){
+                    serialFlush();//Clear the serial buffer
+                    break;   
+                }
+            }
+            int sliderStepSpeed = readSerialInt16(); 
+            int panStepSpeed = readSerialInt16(); 
+            int tiltStepSpeed = readSerialInt16(); 
+
+            if(job.state != JOB_IDLE){ //Jogging would fight the job
+                if(jog_ack){
+                    Serial.write(JOG_NAK);
+                }
+                return;
+            }
+            stepper_slider.setSpeed(sliderStepSpeed);
+            stepper_pan.setSpeed(panStepSpeed);
+            stepper_tilt.setSpeed(tiltStepSpeed);
+            stepper_slider.runSpeed();
+            stepper_pan.runSpeed();
+            stepper_tilt.runSpeed();
+            last_jog_ms = millis();
+            jog_active = (sliderStepSpeed != 0 || panStepSpeed != 0 || tiltStepSpeed != 0);
+            if(jog_ack){
+                Serial.write(JOG_ACK);
+            }
+    }
+    
+    delay(2); //wait to make sure all data in the serial message has arived 
+    memset(&stringText[0], 0, sizeof(stringText)); //clear the array
+    while(Serial.available()){//set elemetns of stringText to the serial values sent
+        char digit = Serial.read(); //read in a char
+        strncat(stringText, &digit, 1); //add digit to the end of the array
+    }
+    serialFlush();//Clear any excess data in the serial buffer
+    int serialCommandValueInt = atoi(stringText); //converts stringText to an int
+    float serialCommandValueFloat = atof(stringText); //converts stringText to a float
+    if(instruction == '+'){//The Bluetooth module sends a message starting with "+CONNECTING" which should be discarded.
+        delay(100); //wait to make sure all data in the serial message has arived 
+        serialFlush();//Clear any excess data in the serial buffer
+        return;
+    }
+    if(job.state != JOB_IDLE && !jobAllowsInstruction(instruction)){
+        printi(F("Job running\n"));
+        if(instruction_ack){
+            Serial.write(INSTRUCTION_NAK);
+            Serial.write(instruction);
+        }
+        return;
+    }
+    switch(instruction){        
+        case INSTRUCTION_SCALE_SPEED:{
+            scaleKeyframeSpeed(serialCommandValueFloat);
+        }
+        break;
+        case INSTRUCTION_PAN_ACCEL_INCREMENT_DELAY:{
+            pan_accel_increment_us = (serialCommandValueInt >= 0) ? serialCommandValueInt : 0;
+            printi(F("Pan accel delay: "), pan_accel_increment_us, F("us\n"));
         }
         break;
         case INSTRUCTION_TILT_ACCEL_INCREMENT_DELAY:{
@@ -1045,14 +2357,83 @@ void serialData(void){
         case INSTRUCTION_PANORAMICLAPSE:{
             printi(F("Panorama\n"));
             panoramiclapse(degrees_per_picture, delay_ms_between_pictures, 1);
-            printi(F("Finished\n"));
+        }
+        break;
+        case INSTRUCTION_LENS_HFOV:{
+            lens_hfov_degrees = boundFloat(serialCommandValueFloat, 1, 179);
+            printi(F("Lens HFOV: "), lens_hfov_degrees, 3, F("º\n"));
+        }
+        break;
+        case INSTRUCTION_LENS_VFOV:{
+            lens_vfov_degrees = boundFloat(serialCommandValueFloat, 1, 179);
+            printi(F("Lens VFOV: "), lens_vfov_degrees, 3, F("º\n"));
+        }
+        break;
+        case INSTRUCTION_PANORAMA_OVERLAP:{
+            panorama_overlap_percent = boundFloat(serialCommandValueFloat, 0, 90);
+            printi(F("Pano overlap: "), panorama_overlap_percent, 3, F("%\n"));
+        }
+        break;
+        case INSTRUCTION_PANORAMA_ESTIMATE:{
+            PanoramaPlan plan;
+            if(planPanorama(plan, delay_ms_between_pictures)){
+                printi(F("Columns: "), plan.columns, F("\t"));
+                printi(F("Rows: "), plan.rows, F("\t"));
+                printi(F("Frames: "), plan.columns * plan.rows, F("\n"));
+                if(plan.columnMajor){
+                    printi(F("Column sweeps\n"));
+                }
+                else{
+                    printi(F("Row sweeps\n"));
+                }
+                printi(F("Estimated time: "), plan.estimatedMs / 1000, F("s\n"));
+            }
+        }
+        break;
+        case INSTRUCTION_PANORAMA_GRID:{
+            panoramaGrid(delay_ms_between_pictures);
+        }
+        break;
+        case INSTRUCTION_SETTLE_PROFILE:{
+            setSettleProfile(serialCommandValueInt);
+        }
+        break;
+        case INSTRUCTION_SETTLE_CALIBRATION:{
+            calibrateSettleTime();
+        }
+        break;
+        case INSTRUCTION_SETTLE_SLOW_FRAME:{
+            setSettleCalibrationFrame(serialCommandValueInt, false);
+        }
+        break;
+        case INSTRUCTION_SETTLE_FAST_FRAME:{
+            setSettleCalibrationFrame(serialCommandValueInt, true);
         }
         break;
         case INSTRUCTION_TIMELAPSE:{
             printi(F("Timelapse with "), serialCommandValueInt, F(" pics\n"));
             printi(F(""), delay_ms_between_pictures, F("ms between pics\n"));
             timelapse(serialCommandValueInt, delay_ms_between_pictures);
-            printi(F("Finished\n"));
+        }
+        break;
+        case INSTRUCTION_CONTINUOUS_TIMELAPSE:{
+            printi(F("Continuous timelapse with "), serialCommandValueInt, F(" pics\n"));
+            printi(F(""), delay_ms_between_pictures, F("ms between pics\n"));
+            continuousTimelapse(serialCommandValueInt, delay_ms_between_pictures);
+        }
+        break;
+        case INSTRUCTION_SET_EASING:{
+            setEasing(serialCommandValueInt);
+        }
+        break;
+        case INSTRUCTION_NODAL_OFFSET:{
+            nodal_offset_mm = boundFloat(serialCommandValueFloat, -NODAL_LIMIT_MM, NODAL_LIMIT_MM);
+            printi(F("Nodal offset: "), nodal_offset_mm, 3, F("mm\n"));
+        }
+        break;
+        case INSTRUCTION_TILT_AXIS_HEIGHT:{
+            tilt_axis_height_mm = boundFloat(serialCommandValueFloat, -NODAL_LIMIT_MM, NODAL_LIMIT_MM);
+            printi(F("Tilt axis height: "), tilt_axis_height_mm, 3, F("mm\n"));
         }
         break;
         case INSTRUCTION_TRIGGER_SHUTTER:{
@@ -1061,16 +2442,7 @@ void serialData(void){
         break;
         case INSTRUCTION_AUTO_HOME:{
             printi(F("Homing\n"));
-            if(findHome()){
-                printi(F("Complete\n"));
-            }
-            else{
-                stepper_pan.setCurrentPosition(0);
-                stepper_tilt.setCurrentPosition(0);
-                stepper_slider.setCurrentPosition(0);
-                setTargetPositions(0, 0, 0);
-                printi(F("Error homing\n"));
-            }
+            findHome();
         }
         break;
         case INSTRUCTION_SET_HOMING:{
@@ -1088,15 +2460,15 @@ void serialData(void){
         }
         break;
          case INSTRUCTION_INVERT_SLIDER:{
-            invertSliderDirection(serialCommandValueInt);
+            invertDirection(stepper_slider, invert_slider, F("Slider"), serialCommandValueInt);
         }
         break;
         case INSTRUCTION_INVERT_TILT:{
-            invertTiltDirection(serialCommandValueInt);
+            invertDirection(stepper_tilt, invert_tilt, F("Tilt"), serialCommandValueInt);
         }
         break;
         case INSTRUCTION_INVERT_PAN:{
-            invertPanDirection(serialCommandValueInt);
+            invertDirection(stepper_pan, invert_pan, F("Pan"), serialCommandValueInt);
         }
         break;
         case INSTRUCTION_SAVE_TO_EEPROM:{
@@ -1148,29 +2520,160 @@ void serialData(void){
             executeMoves(serialCommandValueInt);
         }
         break;      
-        case INSTRUCTION_DEBUG_STATUS:{
-            debugReport();
+        case INSTRUCTION_IDLE_DISABLE_DELAY:{
+            idle_disable_ms = (serialCommandValueFloat > 0) ? serialCommandValueFloat : 0;
+            printi(F("Idle disable delay: "), idle_disable_ms, F("ms\n"));
         }
         break;
-        case INSTRUCTION_PAN_DEGREES:{
-            panDegrees(serialCommandValueFloat);
+        case INSTRUCTION_IDLE_HOLD_MASK:{
+            idle_hold_mask = serialCommandValueInt & HOLD_ALL;
+            printi(F("Idle hold mask: "), idle_hold_mask);
         }
-        break;  
-        case INSTRUCTION_TILT_DEGREES:{
-            tiltDegrees(serialCommandValueFloat);
+        break;
+        case INSTRUCTION_JOB_STOP:{
+            stopJob();
         }
-        break; 
-        case INSTRUCTION_ENABLE:{
-            enableSteppers();
+        break;
+        case INSTRUCTION_JOB_PAUSE:{
+            pauseJob();
         }
-        break; 
-        case INSTRUCTION_STEP_MODE:{
-            setStepMode(serialCommandValueInt);
+        break;
+        case INSTRUCTION_JOB_PROGRESS:{
+            jobProgress();
         }
-        break; 
-        case INSTRUCTION_SET_PAN_SPEED:{
-            printi(F("Max pan speed: "), serialCommandValueFloat, 1, "º/s.\n");
-            pan_max_speed = serialCommandValueFloat;
+        break;
+        case INSTRUCTION_FEED_OVERRIDE:{
+            setFeedOverride(serialCommandValueFloat);
+        }
+        break;
+        case INSTRUCTION_LOG_MODE:{
+            setLogMode(serialCommandValueInt);
+        }
+        break;
+        case INSTRUCTION_TRACE_DUMP:{
+            dumpTrace(serialCommandValueInt);
+        }
+        break;
+        case INSTRUCTION_JOG_ACK:{
+            jog_ack = (serialCommandValueInt & 1) != 0;
+            instruction_ack = (serialCommandValueInt & 2) != 0;
+            printi(F("Jog ack: "), jog_ack, F("\t"));
+            printi(F("Instruction ack: "), instruction_ack, F("\n"));
+        }
+        break;
+        case INSTRUCTION_JOG_TIMEOUT:{
+            jog_timeout_ms = (serialCommandValueInt > 0) ? serialCommandValueInt : 0;
+            printi(F("Jog timeout: "), jog_timeout_ms, F("ms\n"));
+        }
+        break;
+#ifdef SEGMENT_STREAM
+        case INSTRUCTION_SEGMENTS:{
+            if(serialCommandValueInt > 0){
+                startSegments(serialCommandValueInt);
+            }
+            else{
+                endSegments();
+            }
+        }
+        break;
+#endif
+#ifdef MOVE_CAPTURE
+        case INSTRUCTION_CAPTURE:{
+            if(serialCommandValueInt > 0){
+                startCapture(serialCommandValueInt);
+            }
+            else{
+                endCapture();
+            }
+        }
+        break;
+#endif
+        case INSTRUCTION_FOCUS_DEGREES:{
+            lensDegrees(AXIS_FOCUS, serialCommandValueFloat);
+        }
+        break;
+        case INSTRUCTION_ZOOM_DEGREES:{
+            lensDegrees(AXIS_ZOOM, serialCommandValueFloat);
+        }
+        break;
+        case INSTRUCTION_SET_FOCUS_SPEED:{
+            setLensMaxSpeed(AXIS_FOCUS, serialCommandValueFloat);
+        }
+        break;
+        case INSTRUCTION_SET_ZOOM_SPEED:{
+            setLensMaxSpeed(AXIS_ZOOM, serialCommandValueFloat);
+        }
+        break;
+        case INSTRUCTION_INVERT_FOCUS:{
+            invertLens(AXIS_FOCUS, serialCommandValueInt);
+        }
+        break;
+        case INSTRUCTION_INVERT_ZOOM:{
+            invertLens(AXIS_ZOOM, serialCommandValueInt);
+        }
+        break;
+#ifdef AXIS_BENCHMARK
+        case INSTRUCTION_AXIS_BENCHMARK:{
+            benchmarkAxes();
+        }
+        break;
+#endif
+#if !defined(SEGMENT_STREAM) || !defined(MOVE_CAPTURE) || !defined(AXIS_BENCHMARK)
+#ifndef SEGMENT_STREAM
+        case INSTRUCTION_SEGMENTS:
+#endif
+#ifndef MOVE_CAPTURE
+        case INSTRUCTION_CAPTURE:
+#endif
+#ifndef AXIS_BENCHMARK
+        case INSTRUCTION_AXIS_BENCHMARK:
+#endif
+        {
+            printi(F("Not in this build\n")); //The optional features are switched on in panTiltMount.h
+        }
+        break;
+#endif
+        case INSTRUCTION_SCHEDULER_REPORT:{
+            schedulerReport();
+        }
+        break;
+        case INSTRUCTION_TELEMETRY_PERIOD:{
+            if(serialCommandValueInt < 0){ //A single line now, e.g. for a host polling the status
+                printTelemetry();
+                break;
+            }
+            telemetry_period_ms = (serialCommandValueInt > 0) ? serialCommandValueInt : 0;
+            tasks[TASK_TELEMETRY].periodUs = (telemetry_period_ms > 0) ? telemetry_period_ms * 1000 : 1000000;
+            printi(F("Telemetry period: "), telemetry_period_ms, F("ms\n"));
+        }
+        break;
+        case INSTRUCTION_BATTERY_STATUS:{
+            printBatteryStatus();
+        }
+        break;
+        case INSTRUCTION_DEBUG_STATUS:{
+            debugReport();
+        }
+        break;
+        case INSTRUCTION_PAN_DEGREES:{
+            panDegrees(serialCommandValueFloat);
+        }
+        break;  
+        case INSTRUCTION_TILT_DEGREES:{
+            tiltDegrees(serialCommandValueFloat);
+        }
+        break; 
+        case INSTRUCTION_ENABLE:{
+            enableSteppers();
+        }
+        break; 
+        case INSTRUCTION_STEP_MODE:{
+            setStepMode(serialCommandValueInt);
+        }
+        break; 
+        case INSTRUCTION_SET_PAN_SPEED:{
+            printi(F("Max pan speed: "), serialCommandValueFloat, 1, "º/s.\n");
+            pan_max_speed = serialCommandValueFloat;
             stepper_pan.setMaxSpeed(panDegreesToSteps(pan_max_speed));
         }
         break; 
@@ -1188,9 +2691,11 @@ void serialData(void){
         break;
         case INSTRUCTION_CALCULATE_TARGET_POINT:{            
             if(calculateTargetCoordinate()){
-                printi("Target:\tx: ", intercept.x, 3, "\t");
-                printi("y: ", intercept.y, 3, "\t");
-                printi("z: ", intercept.z, 3, "mm\n");
+                printi(F("Target:\tx: "), intercept.x, 3, F("\t"));
+                printi(F("y: "), intercept.y, 3, F("\t"));
+                printi(F("z: "), intercept.z, 3, F("mm\n"));
+                printi(F("Residual: "), intercept_residual, 3, F("mm\t"));
+                printi(F("Rays: "), intercept_rays, F("\n"));
             }
         }
         break;  
@@ -1201,14 +2706,709 @@ void serialData(void){
         }
         break;  
     }
+    if(instruction_ack && instruction != INSTRUCTION_BYTES_SLIDER_PAN_TILT_SPEED){ //After anything the instruction printed
+        Serial.write(INSTRUCTION_ACK);
+        Serial.write(instruction);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void stepTask(void){
+    multi_stepper.run();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void serialTask(void){
+    if(Serial.available()) timedSerialData();
+    checkJogTimeout();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void checkJogTimeout(void){ //Stops the mount if the host stops sending jog packets (keepalives) while it is jogging
+    if(!jog_active){
+        return;
+    }
+    if(job.state != JOB_IDLE){ //The job has taken over the steppers
+        jog_active = false;
+        return;
+    }
+    if(jog_timeout_ms == 0 || millis() - last_jog_ms < jog_timeout_ms){
+        return;
+    }
+    stepper_slider.setSpeed(0);
+    stepper_pan.setSpeed(0);
+    stepper_tilt.setSpeed(0);
+    jog_active = false;
+    printi(F("Jog timed out\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void batteryTask(void){ //The sampling and filtering is done by the ADC interrupt. This stops any job and parks the mount if the battery goes low.
+    if(!batteryLowStop() || job.state == JOB_IDLE || job.state == JOB_STOPPING || job.type == JOB_PARKING){
+        return;
+    }
+    stopJob();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void telemetryTask(void){
+    if(telemetry_period_ms == 0){
+        return;
+    }
+    printTelemetry();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Captures whatever moves the mount, usually the joystick, as the steps each axis moved in every period. They're the same deltas a segment stream
+//carries so the host can save a capture and play it back with JOB_SEGMENTS to the step. The frames are sent from the positions the last frame was
+//sent at so a late frame never loses or repeats a step, and a short frame is sent when every delta fits in a byte.
+void captureTask(void){
+#ifdef MOVE_CAPTURE
+    if(capture.periodMs == 0){
+        return;
+    }
+    int16_t steps[SEGMENT_AXES];
+    bool fitsByte = true;
+    for(int i = 0; i < SEGMENT_AXES; i++){
+        long position = axes[i]->currentPosition();
+        long delta = constrain(position - capture.lastSteps[i], -32768L, 32767L);
+        capture.lastSteps[i] += delta;
+        steps[i] = delta;
+        if(delta < -128 || delta > 127){
+            fitsByte = false;
+        }
+    }
+    Serial.write(fitsByte ? CAPTURE_FRAME_SHORT : CAPTURE_FRAME);
+    for(int i = 0; i < SEGMENT_AXES; i++){
+        if(fitsByte){
+            Serial.write((byte)(int8_t)steps[i]);
+        }
+        else{
+            Serial.write(highByte(steps[i]));
+            Serial.write(lowByte(steps[i]));
+        }
+    }
+    capture.frames++;
+#endif
+}
+
+#ifdef MOVE_CAPTURE
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void startCapture(int periodMs){
+    if(periodMs < CAPTURE_MIN_PERIOD_MS){
+        periodMs = CAPTURE_MIN_PERIOD_MS;
+    }
+    for(int i = 0; i < SEGMENT_AXES; i++){
+        capture.lastSteps[i] = axes[i]->currentPosition();
+    }
+    capture.periodMs = periodMs;
+    capture.frames = 0;
+    tasks[TASK_CAPTURE].periodUs = periodMs * 1000UL;
+    tasks[TASK_CAPTURE].lastReleaseUs = micros(); //The first frame covers the first whole period
+    printi(F("Capture: "), periodMs, F("ms\t"));
+    printi(F("Step mode: "), step_mode, F("\t"));
+    printi(F("Start: "), capture.lastSteps[AXIS_PAN], F(" "));
+    printi(capture.lastSteps[AXIS_TILT], F(" "), capture.lastSteps[AXIS_SLIDER], F("\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void endCapture(void){
+    if(capture.periodMs == 0){
+        printi(F("No capture\n"));
+        return;
+    }
+    captureTask(); //The steps since the last frame so the capture ends where the mount is
+    capture.periodMs = 0;
+    tasks[TASK_CAPTURE].periodUs = 1000000;
+    printi(F("Capture frames: "), capture.frames, F("\n"));
+}
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void printTelemetry(void){ //One line of the live position and battery voltage
+    printi(F("Pan: "), panStepsToDegrees(stepper_pan.currentPosition()), 3, F("º\t"));
+    printi(F("Tilt: "), tiltStepsToDegrees(stepper_tilt.currentPosition()), 3, F("º\t"));
+    printi(F("Slider: "), sliderStepsToMillimetres(stepper_slider.currentPosition()), 3, F("mm\t"));
+#ifdef FOCUS_AXIS
+    printi(F("Focus: "), lensStepsToDegrees(AXIS_FOCUS, stepper_focus.currentPosition()), 3, F("º\t"));
+#endif
+#ifdef ZOOM_AXIS
+    printi(F("Zoom: "), lensStepsToDegrees(AXIS_ZOOM, stepper_zoom.currentPosition()), 3, F("º\t"));
+#endif
+    printi(F("Battery: "), getBatteryVoltage(), 3, F("V\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void jobTask(void){ //Runs the current job one phase at a time. Nothing in here waits for a move or a delay to finish.
+    updateCameraShutter();
+    switch(job.state){
+        case JOB_IDLE:
+        case JOB_PAUSED:
+            return;
+        case JOB_PAUSING:
+            if(serviceJobWait(true) && rampDown()){
+                job.state = JOB_PAUSED;
+                printi(F("Paused\n"));
+            }
+            return;
+        case JOB_STOPPING:
+            if(serviceJobWait(true) && rampDown()){
+                endJob();
+            }
+            return;
+    }
+    switch(job.phase){
+        case PHASE_NEXT:{
+            if(batteryLowStop()){
+                endJob();
+                return;
+            }
+            switch(job.type){
+                case JOB_EXECUTE_MOVES: nextExecuteMove(); break;
+                case JOB_PANORAMICLAPSE: nextPanoramiclapseFrame(); break;
+                case JOB_TIMELAPSE: nextTimelapseFrame(); break;
+                case JOB_PANORAMA_GRID: nextPanoramaGridFrame(); break;
+                case JOB_SETTLE_CALIBRATION: nextSettleCalibrationFrame(); break;
+                case JOB_CONTINUOUS_TIMELAPSE: nextContinuousSegment(); break;
+                case JOB_ORBIT: nextOrbitKeyframe(); break;
+            }
+        }
+        break;
+        case PHASE_KEYFRAME_MOVE:{
+            if(serviceKeyframeMove()){
+                job.phase = PHASE_NEXT;
+            }
+        }
+        break;
+        case PHASE_MOVING:{
+            if(!multiStepperRunning()){
+                job.settleMs = (settle_profile >= 1 && settle_profile <= SETTLE_PROFILE_COUNT) ? settleTime() : job.msDelay / 2;
+                startJobWait(job.settleMs, false);
+                job.phase = PHASE_SETTLE;
+            }
+        }
+        break;
+        case PHASE_SETTLE:{
+            if(jobWaitDone() && !shutter_active){
+                startCameraShutter();
+                job.framesTaken++;
+                job.phase = PHASE_SHUTTER;
+            }
+        }
+        break;
+        case PHASE_SHUTTER:{
+            if(!shutter_active){
+                startJobWait((job.msDelay > job.settleMs) ? job.msDelay - job.settleMs : 0, true);
+                job.phase = PHASE_WAIT;
+            }
+        }
+        break;
+        case PHASE_WAIT:{
+            if(jobWaitDone()){
+                job.phase = PHASE_NEXT;
+            }
+        }
+        break;
+        case PHASE_HOMING:{
+            if(serviceHoming()){
+                job.state = JOB_IDLE;
+                job.type = JOB_NONE;
+            }
+        }
+        break;
+#ifdef SEGMENT_STREAM
+        case PHASE_SEGMENTS:{
+            if(serviceSegments()){
+                endJob();
+            }
+        }
+        break;
+#endif
+        case PHASE_REPOSITION:{
+            if(!multiStepperRunning()){
+                job.phase = PHASE_NEXT;
+            }
+        }
+        break;
+        case PHASE_CONTINUOUS:{
+            if(serviceContinuousSegment()){
+                job.phase = PHASE_NEXT;
+            }
+        }
+        break;
+        case PHASE_ORBIT:{
+            if(serviceOrbit()){
+                job.phase = PHASE_NEXT;
+            }
+        }
+        break;
+        case PHASE_PARKING:{
+            if(!multiStepperRunning()){
+                digitalWrite(PIN_ENABLE, HIGH); //Disable the stepper drivers
+                enable_state = false;
+                printi(F("Parked\n"));
+                job.state = JOB_IDLE;
+                job.type = JOB_NONE;
+            }
+        }
+        break;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void startJob(byte type){
+    job.type = type;
+    job.state = JOB_RUNNING;
+    job.phase = PHASE_NEXT;
+    job.repeat = 1;
+    job.repeatIndex = 0;
+    job.keyframeIndex = 0;
+    job.frameIndex = 0;
+    job.frameCount = 0;
+    job.holdFrames = 0;
+    job.framesTaken = 0;
+    job.totalFrames = 0;
+    job_wait.stage = WAIT_AWAKE;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void endJob(void){ //A stop wakes the drivers before getting here so they're never left idled
+    if(job.type == JOB_CONTINUOUS_TIMELAPSE){
+        axes[continuous.masterAxis]->disarmTrigger();
+    }
+    if(job.type == JOB_SETTLE_CALIBRATION || job.type == JOB_CONTINUOUS_TIMELAPSE || job.type == JOB_ORBIT){
+        restoreMaxSpeeds();
+    }
+    if(job.type == JOB_HOMING){
+        printi(F("Homing stopped\n"));
+    }
+    else{
+        printi(F("Finished\n"));
+    }
+    job.state = JOB_IDLE;
+    job.type = JOB_NONE;
+    if(park_pending){ //Stopped because the battery is low
+        startParking();
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void stopJob(void){
+    if(job.state == JOB_IDLE){
+        printi(F("No job\n"));
+        return;
+    }
+    for(int i = 0; i < AXIS_COUNT; i++){
+        job.stopSpeeds[i] = axes[i]->speed();
+    }
+    if(job.phase == PHASE_ORBIT && orbit.phase == ORBIT_TRACK){ //The tracking axes only have targets a period or two ahead so they're given room to ramp down with the slider
+        for(int i = 0; i < AXIS_COUNT; i++){
+            if(i != AXIS_SLIDER){
+                axes[i]->moveTo(axes[i]->currentPosition() + (long)(job.stopSpeeds[i] * JOB_STOP_MS / 2000.0));
+                axes[i]->setSpeed(job.stopSpeeds[i]);
+            }
+        }
+    }
+    job.stopStartMs = millis();
+    job.lastControlMs = 0;
+    job.state = JOB_STOPPING;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void pauseJob(void){ //Toggles between pausing and resuming the job
+    if(job.state == JOB_PAUSED){ //Resume
+        if(job.phase == PHASE_KEYFRAME_MOVE && (keyframe_move.phase == MOVE_RAMP || keyframe_move.phase == MOVE_CRUISE)){
+            setKeyframeMaxSpeeds(keyframe_move.index);
+            multi_stepper.moveTo(target_position); //Carry on to the keyframe
+            applyFeedOverride(true);
+            keyframe_move.phase = MOVE_CRUISE;
+        }
+        else if(job.phase == PHASE_ORBIT && orbit.phase == ORBIT_TRACK){
+            stepper_slider.moveTo(keyframe_array[job.keyframeIndex].stepCount[AXIS_SLIDER]); //Carry on tracking from wherever it stopped
+            orbit.lastControlMs = millis() - ORBIT_CONTROL_PERIOD_MS;
+        }
+        else{
+            multi_stepper.moveTo(target_position); //Carry on to the target the job was moving to
+        }
+        job_wait.startMs = millis(); //Any hold or delay that was interrupted is restarted
+        job.state = JOB_RUNNING;
+        printi(F("Resumed\n"));
+        return;
+    }
+    if(job.state != JOB_RUNNING || job.type == JOB_HOMING || job.type == JOB_SEGMENTS || job.type == JOB_SETTLE_CALIBRATION ||
+        job.type == JOB_CONTINUOUS_TIMELAPSE || job.type == JOB_PARKING){
+        printi(F("Can't pause\n"));
+        return;
+    }
+    stopJob();
+    job.state = JOB_PAUSING;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Ramps the speeds down to zero over JOB_STOP_MS. All the axes are scaled together so the mount stays on the path it was following. Returns true once
+//stopped with the stepper targets set to where they stopped. target_position is left as it was so the move can be resumed.
+bool rampDown(void){
+    unsigned long elapsedMs = millis() - job.stopStartMs;
+    if(elapsedMs >= JOB_STOP_MS || !multiStepperRunning()){
+        for(int i = 0; i < AXIS_COUNT; i++){
+            axes[i]->moveTo(axes[i]->currentPosition());
+            axes[i]->setSpeed(0);
+        }
+        return true;
+    }
+    if(millis() - job.lastControlMs < JOB_CONTROL_PERIOD_MS){
+        return false;
+    }
+    job.lastControlMs = millis();
+    float scale = 1 - ((float)elapsedMs / JOB_STOP_MS);
+    for(int i = 0; i < AXIS_COUNT; i++){
+        axes[i]->setSpeed(job.stopSpeeds[i] * scale);
+    }
+    return false;
+}
+
+#ifdef SEGMENT_STREAM
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Segment streams are trajectories compiled on the host (pan_tilt_trajectory). Each segment is the number of steps each axis moves in one period and
+//they're played back to back without any planning here. The targets are accumulated so rounding never builds up and the speeds are worked out from
+//where each axis actually is so one that fell behind catches up during the next period.
+void startSegments(int periodMs){
+    if(job.state != JOB_IDLE){
+        printi(F("Job running\n"));
+        return;
+    }
+    for(int i = 0; i < SEGMENT_AXES; i++){ //Stop any jog
+        axes[i]->moveTo(axes[i]->currentPosition());
+        axes[i]->setSpeed(0);
+    }
+    jog_active = false;
+    segments.head = 0;
+    segments.count = 0;
+    segments.periodMs = periodMs;
+    segments.playing = false;
+    segments.ended = false;
+    segments.starved = false;
+    segments.played = 0;
+    segments.underruns = 0;
+    segments.dropped = 0;
+    startJob(JOB_SEGMENTS);
+    job.phase = PHASE_SEGMENTS;
+    printi(F("Segments: "), periodMs, F("ms\t"));
+    printi(F("Step mode: "), step_mode, F("\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void endSegments(void){ //The segments already buffered are still played
+    if(job.type != JOB_SEGMENTS){
+        printi(F("No segments\n"));
+        return;
+    }
+    segments.ended = true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool serviceSegments(void){ //Returns true once the stream has ended and the last segment has been played
+    if(batteryLowStop()){
+        stopJob();
+        return false;
+    }
+    if(!segments.playing){
+        if(segments.count < SEGMENT_BUFFER_LENGTH && !segments.ended){ //Prefilling
+            return false;
+        }
+        segments.playing = true;
+        segments.nextMs = millis();
+    }
+    if((long)(millis() - segments.nextMs) < 0){
+        return false;
+    }
+    if(segments.count == 0){
+        if(segments.ended){
+            if(multiStepperRunning()){
+                return false;
+            }
+            printi(F("Segments played: "), segments.played, F("\t"));
+            printi(F("Underruns: "), segments.underruns, F("\t"));
+            printi(F("Dropped: "), segments.dropped, F("\n"));
+            return true;
+        }
+        if(!segments.starved){
+            segments.starved = true;
+            segments.underruns++;
+        }
+        segments.nextMs = millis(); //Play the next one as soon as it arrives
+        return false;
+    }
+    segments.starved = false;
+    for(int i = 0; i < SEGMENT_AXES; i++){
+        long target = axes[i]->targetPosition() + segments.steps[segments.head][i];
+        axes[i]->moveTo(target);
+        axes[i]->setSpeed((target - axes[i]->currentPosition()) * 1000.0 / segments.periodMs); //moveTo() sets its own speed so this comes after
+    }
+    segments.head = (segments.head + 1) % SEGMENT_BUFFER_LENGTH;
+    segments.count--;
+    segments.played++;
+    job.framesTaken = segments.played;
+    segments.nextMs += segments.periodMs;
+    return false;
+}
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void jobProgress(void){
+    if(job.state == JOB_IDLE){
+        printi(F("No job\n"));
+        return;
+    }
+    printi(progmemText(job_names[job.type]), F("\t"));
+    printi(F("State: "), job.state, F("\t"));
+    printi(F("Repeat: "), job.repeatIndex, F("\t"));
+    printi(F("Keyframe: "), job.keyframeIndex, F("\t"));
+    printi(F("Frame: "), job.framesTaken, F(""));
+    if(job.totalFrames > 0){
+        printi(F("/"), job.totalFrames, F(""));
+    }
+    printi(F("\n"));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool multiStepperRunning(void){
+    for(int i = 0; i < AXIS_COUNT; i++){
+        if(axes[i]->distanceToGo() != 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Waits for the jobs. Long waits disable the drivers at the start and wake them IDLE_WAKE_MS before the end. The moves onto and off the
+//full steps are run by stepTask() like any other move.
+void startJobWait(unsigned long ms, bool allowIdle){
+    job_wait.startMs = millis();
+    job_wait.ms = ms;
+    job_wait.stage = WAIT_AWAKE;
+    if(allowIdle && canIdleDrivers(ms)){
+        long positions[AXIS_COUNT];
+        for(int i = 0; i < AXIS_COUNT; i++){
+            job_wait.holdPositions[i] = axes[i]->currentPosition();
+        }
+        fullStepPositions(positions);
+        multi_stepper.moveTo(positions);
+        job_wait.stage = WAIT_FULL_STEP;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool jobWaitDone(void){
+    unsigned long elapsedMs = millis() - job_wait.startMs;
+    if(!serviceJobWait(elapsedMs + IDLE_WAKE_MS >= job_wait.ms)){
+        return false;
+    }
+    return elapsedMs >= job_wait.ms;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Moves the idle drivers on one stage. Once wake is set they're brought back to where the wait started. Returns true when they're enabled and there.
+bool serviceJobWait(bool wake){
+    switch(job_wait.stage){
+        case WAIT_FULL_STEP:{
+            if(multiStepperRunning()){
+                return false;
+            }
+            if(wake){ //Woken before it got to disable them
+                multi_stepper.moveTo(job_wait.holdPositions);
+                job_wait.stage = WAIT_RETURN;
+                return false;
+            }
+            digitalWrite(PIN_ENABLE, HIGH); //Disable the stepper drivers
+            job_wait.stageMs = millis();
+            job_wait.stage = WAIT_IDLE;
+        }
+        return false;
+        case WAIT_IDLE:{
+            if(!wake){
+                return false;
+            }
+            idle_total_ms += millis() - job_wait.stageMs;
+            digitalWrite(PIN_ENABLE, LOW); //Enable the stepper drivers
+            job_wait.stageMs = millis();
+            job_wait.stage = WAIT_WAKING;
+        }
+        return false;
+        case WAIT_WAKING:{
+            if(millis() - job_wait.stageMs < IDLE_WAKE_MS){
+                return false;
+            }
+            multi_stepper.moveTo(job_wait.holdPositions);
+            job_wait.stage = WAIT_RETURN;
+        }
+        return false;
+        case WAIT_RETURN:{
+            if(multiStepperRunning()){
+                return false;
+            }
+            job_wait.stage = WAIT_AWAKE;
+        }
+        return true;
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool jobAllowsInstruction(char instruction){ //Instructions that don't move the mount or change the keyframes can be used while a job is running
+    switch(instruction){
+        case INSTRUCTION_JOB_STOP:
+        case INSTRUCTION_JOB_PAUSE:
+        case INSTRUCTION_JOB_PROGRESS:
+        case INSTRUCTION_FEED_OVERRIDE:
+        case INSTRUCTION_DEBUG_STATUS:
+        case INSTRUCTION_BATTERY_STATUS:
+        case INSTRUCTION_SCHEDULER_REPORT:
+        case INSTRUCTION_TELEMETRY_PERIOD:
+        case INSTRUCTION_LOG_MODE:
+        case INSTRUCTION_TRACE_DUMP:
+        case INSTRUCTION_JOG_ACK:
+        case INSTRUCTION_JOG_TIMEOUT:
+        case INSTRUCTION_SEGMENTS: //Only the end of a stream. Starting one is refused while another job is running
+        case INSTRUCTION_CAPTURE:
+            return true;
+    }
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void runTask(int index, unsigned long nowUs){
+    Task &task = tasks[index];
+    unsigned long releaseUs = task.lastReleaseUs + task.periodUs;
+    if(nowUs - releaseUs > pgm_read_dword(&task_timings[index].deadlineUs)){ //Started later than its deadline
+        task.missedDeadlines++;
+    }
+    ((void (*)(void))pgm_read_ptr(&task_timings[index].run))();
+    unsigned long runUs = micros() - nowUs;
+    if(runUs > pgm_read_dword(&task_timings[index].budgetUs)){
+        task.overruns++;
+    }
+    if(runUs > task.maxUs){
+        task.maxUs = runUs;
+    }
+    if(task.periodUs == 0){
+        task.lastReleaseUs = micros();
+    }
+    else{
+        task.lastReleaseUs = releaseUs;
+        if(micros() - task.lastReleaseUs >= task.periodUs){ //Fallen more than a period behind so skip the missed releases
+            task.lastReleaseUs = micros();
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Fixed priority cooperative scheduler. The step task runs on every pass and then the highest priority task that has been released runs. Only one other
+//task runs per pass so the steppers are serviced between each of them. Tasks must return quickly and not block.
+void runScheduler(void){
+    unsigned long nowUs = micros();
+    traceLoopPass(nowUs - tasks[TASK_STEP].lastReleaseUs); //Time since the step task last finished
+    runTask(TASK_STEP, nowUs);
+    nowUs = micros();
+    for(int i = TASK_STEP + 1; i < TASK_COUNT; i++){
+        if(tasks[i].periodUs == 0 || nowUs - tasks[i].lastReleaseUs >= tasks[i].periodUs){
+            runTask(i, nowUs);
+            return;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void schedulerReport(void){ //Prints and resets the task counters
+    for(int i = 0; i < TASK_COUNT; i++){
+        printi(progmemText(task_names[i]), F("\t"));
+        printi(F("Overruns: "), tasks[i].overruns, F("\t"));
+        printi(F("Missed: "), tasks[i].missedDeadlines, F("\t"));
+        printi(F("Max: "), tasks[i].maxUs, F("us\n"));
+        tasks[i].overruns = 0;
+        tasks[i].missedDeadlines = 0;
+        tasks[i].maxUs = 0;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Sends the trace as one binary frame (see panTiltTrace.h). A value of 1 clears the counters and the step intervals afterwards.
+void dumpTrace(int clear){
+#ifdef STEP_TRACE
+    unsigned int length = 4 + 6 * 4 + TASK_COUNT * 8;
+    for(int i = 0; i < AXIS_COUNT; i++){
+        length += 1 + axes[i]->trace().filled * 2;
+    }
+    traceFrameStart(length);
+    traceByte(STEP_TRACE_TICK_US);
+    traceByte(AXIS_COUNT);
+    traceByte(TASK_COUNT);
+    traceByte(STEP_TRACE_LENGTH);
+    traceUint32(loop_trace.passes);
+    traceUint32(loop_trace.totalUs);
+    traceUint32(loop_trace.maxUs);
+    traceUint32(loop_trace.serialCalls);
+    traceUint32(loop_trace.serialTotalUs);
+    traceUint32(loop_trace.serialMaxUs);
+    for(int i = 0; i < TASK_COUNT; i++){
+        traceUint16(tasks[i].missedDeadlines);
+        traceUint16(tasks[i].overruns);
+        traceUint32(tasks[i].maxUs);
+    }
+    for(int i = 0; i < AXIS_COUNT; i++){
+        StepTrace &trace = axes[i]->trace();
+        traceByte(trace.filled);
+        for(byte j = 0; j < trace.filled; j++){ //Oldest first
+            traceUint16(trace.intervals[(trace.head - trace.filled + j) & (STEP_TRACE_LENGTH - 1)]);
+        }
+        if(clear == 1){
+            trace.filled = 0;
+        }
+    }
+    traceFrameEnd();
+    if(clear == 1){
+        clearTrace();
+    }
+#else
+    printi(F("Trace not built\n"));
+#endif
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void timedSerialData(void){ //serialData() with its run time added to the trace
+    unsigned long startUs = micros();
+    serialData();
+    traceSerial(micros() - startUs);
 }
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
 void mainLoop(void){
     while(1){
-        if(Serial.available()) serialData();
-        multi_stepper.run();
+        runScheduler();
     }
 }
 
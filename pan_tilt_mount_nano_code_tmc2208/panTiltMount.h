@@ -1,6 +1,8 @@
 #ifndef PANTILTMOUNT_H
 #define PANTILTMOUNT_H
 
+#include <Arduino.h>
+
 /*------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
 #define BAUD_RATE 57600
@@ -19,6 +21,46 @@
 #define PIN_DIRECTION_TILT 5
 #define PIN_STEP_PAN 8
 #define PIN_DIRECTION_PAN 7
+#define PIN_STEP_FOCUS 9
+#define PIN_DIRECTION_FOCUS 13
+#define PIN_STEP_ZOOM A0
+#define PIN_DIRECTION_ZOOM A2
+#define PIN_NONE 255 //Used for axes without a Hall sensor
+
+//TODO: Uncomment for each lens motor that is fitted. The extra drivers share PIN_ENABLE, PIN_MS1 and PIN_MS2 with the others.
+//#define FOCUS_AXIS
+//#define ZOOM_AXIS
+
+//TODO: Uncomment the optional features you use. They're left out by default to keep the flash and RAM for the keyframes and the stack.
+//#define SEGMENT_STREAM //Playing trajectories compiled on the host with pan_tilt_trajectory. Its buffer is the largest job state
+//#define MOVE_CAPTURE //Sending the moves to the host as they happen for pan_tilt_joystick --record
+//#define AXIS_BENCHMARK //INSTRUCTION_AXIS_BENCHMARK
+
+#define AXIS_PAN 0 //Index of each axis in the axis table, target_position and the keyframes
+#define AXIS_TILT 1
+#define AXIS_SLIDER 2
+#ifdef FOCUS_AXIS
+    #define AXIS_FOCUS 3
+    #ifdef ZOOM_AXIS
+        #define AXIS_ZOOM 4
+        #define AXIS_COUNT 5
+    #else
+        #define AXIS_COUNT 4
+    #endif
+#else
+    #ifdef ZOOM_AXIS
+        #define AXIS_ZOOM 3
+        #define AXIS_COUNT 4
+    #else
+        #define AXIS_COUNT 3
+    #endif
+#endif
+#ifndef AXIS_FOCUS
+    #define AXIS_FOCUS AXIS_COUNT //Not fitted. The lens instructions check the axis is below AXIS_COUNT.
+#endif
+#ifndef AXIS_ZOOM
+    #define AXIS_ZOOM AXIS_COUNT
+#endif
 
 #define HALF_STEP 2
 #define QUARTER_STEP 4
@@ -26,18 +68,141 @@
 #define SIXTEENTH_STEP 16
 
 #define SLIDER_PULLEY_TEETH 36.0
-#define PAN_GEAR_RATIO 8.4705882352941176470588235294118 //144/17 teeth
-//Used with the belt driven tilt axis.
-#define TILT_GEAR_RATIO 7.6875 //123/16 teeth
-//Used with herringbone gears
-//#define TILT_GEAR_RATIO 3.047619047619047619047619047619 //64/21 teeth
+//The gear ratios are part of the axis types in panTiltAxis.h. The tilt gearing (belt or herringbone) is picked with the TiltStepper typedef.
 
 #define MAX_STRING_LENGTH 10
-#define KEYFRAME_ARRAY_LENGTH 35
+#define KEYFRAME_ARRAY_LENGTH ((AXIS_COUNT > 3) ? 12 : 35) //27 bytes each with 3 axes and 43 with the lens axes, whose steppers also need the RAM
+#define LENS_ACCEL_INCREMENT_US 3000 //Acceleration ramp increment used for the lens axes
+#define LENS_MAX_SPEED 3600 //degrees/second. Highest lens ring speed accepted from the EEPROM
+#define AXIS_BENCHMARK_MS 1000 //Time spent stepping for each number of axes in the benchmark
+#define AXIS_BENCHMARK_STEP_RATE 20000 //steps/second. Higher than the loop can reach so it measures the max step rate
 
 #define SHUTTER_DELAY 200
 
+//TODO: Calibrate the values for your battery
+#define BATTERY_VOLTS_PER_COUNT (12.6 / 1007.0) //1007 = 12.6V
+#define BATTERY_FILTER_SHIFT 8 //IIR filter time constant of 2^8 samples. The ADC samples at ~976Hz (Timer0 overflow) so this is ~0.26s
+#define BATTERY_CELLS 3
+#define BATTERY_CAPACITY_MAH 1000
+#define BATTERY_INTERNAL_RESISTANCE 0.15 //ohms. Used to estimate the resting voltage from the voltage under load
+#define BATTERY_IDLE_CURRENT_MA 60 //Arduino, Bluetooth module and drivers with the motors disabled
+#define BATTERY_ENABLED_CURRENT_MA 900 //Extra current drawn by the three motors when the drivers are enabled
+#define BATTERY_CUTOFF_VOLTAGE 9.5 //Jobs are stopped and the mount is parked below this voltage
+#define BATTERY_PRESENT_VOLTAGE 5.0 //Below this the mount is assumed to be powered over USB without a battery
+#define BATTERY_LOW_CONFIRM_MS 2000 //Time the voltage must stay below the cut off before stopping so a dip caused by the motors is ignored
+
+#define IDLE_WAKE_MS 20 //Time given to the drivers to power up before moving after being idled
+#define HOLD_PAN 1 //idle_hold_mask bits for the axes that need holding torque
+#define HOLD_TILT 2
+#define HOLD_SLIDER 4
+#define HOLD_FOCUS 8 //Lens motors that would slip without torque, e.g. a zoom that creeps under its own weight
+#define HOLD_ZOOM 16
+#define HOLD_ALL (HOLD_PAN | HOLD_TILT | HOLD_SLIDER | HOLD_FOCUS | HOLD_ZOOM)
+
+#define TASK_COUNT 6 //Scheduler tasks in priority order
+#define TASK_STEP 0
+#define TASK_SERIAL 1
+#define TASK_BATTERY 2
+#define TASK_CAPTURE 3
+#define TASK_TELEMETRY 4
+#define TASK_JOB 5
+
+#define JOB_NONE 0 //Job types
+#define JOB_EXECUTE_MOVES 1
+#define JOB_PANORAMICLAPSE 2
+#define JOB_TIMELAPSE 3
+#define JOB_HOMING 4
+#define JOB_ORBIT 5
+#define JOB_SEGMENTS 6 //Playing a step segment stream compiled by the host
+#define JOB_PANORAMA_GRID 7
+#define JOB_SETTLE_CALIBRATION 8
+#define JOB_CONTINUOUS_TIMELAPSE 9
+#define JOB_PARKING 10 //Levelling the camera before disabling the drivers when the battery is low
+
+#define JOB_IDLE 0 //Job states
+#define JOB_RUNNING 1
+#define JOB_PAUSING 2 //Decelerating before pausing
+#define JOB_PAUSED 3
+#define JOB_STOPPING 4 //Decelerating before stopping
+
+#define PHASE_NEXT 0 //Job phases. PHASE_NEXT works out the next keyframe or frame for the job type.
+#define PHASE_KEYFRAME_MOVE 1
+#define PHASE_MOVING 2
+#define PHASE_SETTLE 3
+#define PHASE_SHUTTER 4
+#define PHASE_WAIT 5
+#define PHASE_HOMING 6
+#define PHASE_SEGMENTS 7
+#define PHASE_REPOSITION 8 //Moving without taking a picture at the end
+#define PHASE_CONTINUOUS 9 //Moving through a continuous timelapse segment
+#define PHASE_PARKING 10
+#define PHASE_ORBIT 11 //Moving the slider to a keyframe while the pan and tilt track the target
+
+#define MOVE_RAMP 0 //Keyframe move phases
+#define MOVE_CRUISE 1
+#define MOVE_HOLD 2
+#define MOVE_DONE 3
+
+#define ORBIT_TRACK 0 //Orbit phases
+#define ORBIT_CORRECT 1 //Taking out any error left from the last control period once the slider has arrived
+#define ORBIT_HOLD 2
+
+#define WAIT_AWAKE 0 //Job wait stages. Only long waits go through the others, which idle the drivers
+#define WAIT_FULL_STEP 1 //Moving onto the nearest full steps before disabling the drivers
+#define WAIT_IDLE 2
+#define WAIT_WAKING 3 //Enabled again and giving the drivers IDLE_WAKE_MS to power up
+#define WAIT_RETURN 4 //Moving back off the full steps to where the wait started
+
+#define HOMING_SLIDER_OFF_HALL 0
+#define HOMING_SLIDER_SEEK 1
+#define HOMING_OFF_HALL 2
+#define HOMING_SEEK_NEAR 3 //Searching -45º either side of the start position
+#define HOMING_SEEK_FULL 4 //Searching a full rotation
+#define HOMING_OFFSET 5
+
+#define JOB_STOP_MS 300 //Time taken to decelerate to a stop when a job is paused or stopped
+#define JOB_CONTROL_PERIOD_MS 10 //How often the speeds are updated while decelerating
+
+#define FEED_OVERRIDE_MIN 10 //percent
+#define FEED_OVERRIDE_MAX 200
+#define FEED_OVERRIDE_RATE 100 //Largest change in percent per second so the speeds never jump
+
+#define EASING_LINEAR 0
+#define EASING_IN_OUT 1
+#define EASING_IN 2
+#define EASING_OUT 3
+
+#define FRACTION_BITS 12 //Fixed point fractions used by the timelapse schedule. 1.0 = 1 << FRACTION_BITS
+
+#define ORBIT_CONTROL_PERIOD_MS 20 //How often the pan and tilt speeds are updated while orbiting a target
+#define NODAL_LIMIT_MM 1000 //Largest nodal offset or tilt axis height accepted from the EEPROM
+
+#define SEGMENT_BUFFER_LENGTH 16 //Segments buffered ahead of playback. Playback starts once it's full so the host has a period per slot to catch up
+#define SEGMENT_AXES 3 //Pan, tilt and slider. The lens axes hold still while segments play
+#define SEGMENT_FRAME_MAX 4 //Most segments in one binary packet
+
+#define CAPTURE_MIN_PERIOD_MS 10 //A short frame every 10ms uses under a tenth of the serial bandwidth
+
+#define SETTLE_PROFILE_COUNT 3
+#define SETTLE_CALIBRATION_FRAMES 10 //Frames shot for each calibration series
+#define SETTLE_CALIBRATION_STEP_MS 100 //Settle time added for each calibration frame
+#define SETTLE_CALIBRATION_MAX_MS ((SETTLE_CALIBRATION_FRAMES - 1) * SETTLE_CALIBRATION_STEP_MS) //Longest settle time a calibration can set
+#define SETTLE_CALIBRATION_SLOW_FRACTION 0.25 //Fraction of the max speeds used for the slow calibration series
+#define SETTLE_CALIBRATION_PAN_DEGREES 10 //Move away and back before each calibration frame
+#define SETTLE_CALIBRATION_TILT_DEGREES 5
+#define SETTLE_CALIBRATION_GAP_MS 500 //Wait after each calibration frame
+#define SETTLE_SPEED_LIMIT 3600 //degrees/second. Highest calibration rate accepted from the EEPROM
+
+#define JOG_ACK 0x06 //ASCII ACK. Sent after a binary jog packet has set the speeds when jog acks are on
+#define JOG_NAK 0x15 //ASCII NAK. Sent instead when the packet was ignored because a job is running
+#define INSTRUCTION_ACK 0x11 //Sent followed by the instruction character after each ASCII instruction when instruction acks are on
+#define INSTRUCTION_NAK 0x12 //Sent instead when the instruction was refused because a job is running
+#define SEGMENT_CREDIT 0x14 //Sent followed by the number of free segment slots after each binary segment packet. A packet of 0 segments just asks for them
+#define CAPTURE_FRAME_SHORT 0x16 //Capture frame with the pan, tilt and slider steps moved in the period as int8 when they all fit
+#define CAPTURE_FRAME 0x17 //Capture frame with them as big endian int16
+
 #define INSTRUCTION_BYTES_SLIDER_PAN_TILT_SPEED 4
+#define INSTRUCTION_BYTES_SEGMENTS 5 //The instruction byte, a count then that many pan, tilt and slider step deltas as big endian int16
 #define INSTRUCTION_STEP_MODE 'm'
 #define INSTRUCTION_PAN_DEGREES 'p'
 #define INSTRUCTION_TILT_DEGREES 't'
@@ -77,6 +242,41 @@
 #define INSTRUCTION_TILT_ACCEL_INCREMENT_DELAY 'Q'
 #define INSTRUCTION_SLIDER_ACCEL_INCREMENT_DELAY 'w'
 #define INSTRUCTION_SCALE_SPEED 'W'
+#define INSTRUCTION_LENS_HFOV 'f'
+#define INSTRUCTION_LENS_VFOV 'F'
+#define INSTRUCTION_PANORAMA_OVERLAP 'v'
+#define INSTRUCTION_PANORAMA_GRID 'G'
+#define INSTRUCTION_PANORAMA_ESTIMATE 'g'
+#define INSTRUCTION_SETTLE_PROFILE 'y'
+#define INSTRUCTION_SETTLE_CALIBRATION 'Y'
+#define INSTRUCTION_SETTLE_SLOW_FRAME 'k'
+#define INSTRUCTION_SETTLE_FAST_FRAME 'K'
+#define INSTRUCTION_CONTINUOUS_TIMELAPSE 'J'
+#define INSTRUCTION_SET_EASING 'n'
+#define INSTRUCTION_NODAL_OFFSET 'N'
+#define INSTRUCTION_TILT_AXIS_HEIGHT 'h'
+#define INSTRUCTION_BATTERY_STATUS 'V'
+#define INSTRUCTION_IDLE_DISABLE_DELAY 'u'
+#define INSTRUCTION_IDLE_HOLD_MASK 'M'
+#define INSTRUCTION_SCHEDULER_REPORT 'r'
+#define INSTRUCTION_TELEMETRY_PERIOD '='
+#define INSTRUCTION_JOB_STOP '!'
+#define INSTRUCTION_JOB_PAUSE 'P'
+#define INSTRUCTION_JOB_PROGRESS '?'
+#define INSTRUCTION_FEED_OVERRIDE '%'
+#define INSTRUCTION_FOCUS_DEGREES '('
+#define INSTRUCTION_ZOOM_DEGREES ')'
+#define INSTRUCTION_SET_FOCUS_SPEED '{'
+#define INSTRUCTION_SET_ZOOM_SPEED '}'
+#define INSTRUCTION_AXIS_BENCHMARK '^'
+#define INSTRUCTION_INVERT_FOCUS '|'
+#define INSTRUCTION_INVERT_ZOOM '~'
+#define INSTRUCTION_LOG_MODE '$'
+#define INSTRUCTION_TRACE_DUMP '&'
+#define INSTRUCTION_JOG_ACK '*' //1 = jog acks, 2 = instruction acks, 3 = both
+#define INSTRUCTION_JOG_TIMEOUT 'z'
+#define INSTRUCTION_SEGMENTS '/' //Starts a segment stream with the given period in ms. 0 marks the end of the stream
+#define INSTRUCTION_CAPTURE ',' //Sends a capture frame with the steps moved every given period in ms. 0 stops
 
 #define EEPROM_ADDRESS_HOMING_MODE 0
 #define EEPROM_ADDRESS_PAN_MAX_SPEED 17
@@ -95,19 +295,119 @@
 #define EEPROM_ADDRESS_PAN_ACCEL_INCREMENT_DELAY 80
 #define EEPROM_ADDRESS_TILT_ACCEL_INCREMENT_DELAY 82
 #define EEPROM_ADDRESS_SLIDER_ACCEL_INCREMENT_DELAY 84
+#define EEPROM_ADDRESS_LENS_HFOV 86
+#define EEPROM_ADDRESS_LENS_VFOV 90
+#define EEPROM_ADDRESS_PANORAMA_OVERLAP 94
+#define EEPROM_ADDRESS_SETTLE_PROFILE 98
+#define EEPROM_ADDRESS_SETTLE_PROFILES 99 //SETTLE_PROFILE_COUNT * sizeof(SettleProfile) bytes
+#define EEPROM_ADDRESS_NODAL_OFFSET 111
+#define EEPROM_ADDRESS_TILT_AXIS_HEIGHT 115
+#define EEPROM_ADDRESS_IDLE_DISABLE_DELAY 119
+#define EEPROM_ADDRESS_IDLE_HOLD_MASK 123
+#define EEPROM_ADDRESS_FOCUS_MAX_SPEED 124
+#define EEPROM_ADDRESS_INVERT_FOCUS 128
+#define EEPROM_ADDRESS_ZOOM_MAX_SPEED 129
+#define EEPROM_ADDRESS_INVERT_ZOOM 133
+#define EEPROM_ADDRESS_SETTLE_SPEEDS 134 //SETTLE_PROFILE_COUNT floats
 
 #define VERSION_NUMBER "Version: 3.11.2\n"
 
 /*------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
 struct KeyframeElement {
-    long panStepCount = 0;
-    float panSpeed = 0;
-    long tiltStepCount = 0;
-    float tiltSpeed = 0;
-    long sliderStepCount = 0;
-    float sliderSpeed = 0;
+    long stepCount[AXIS_COUNT] = {}; //Indexed by AXIS_PAN, AXIS_TILT, ...
+    float speed[AXIS_COUNT] = {}; //steps/second
     int msDelay = 0;
+    byte easing = EASING_LINEAR; //Easing of the timelapse segment that ends at this keyframe
+};
+
+struct SettleProfile {
+    unsigned int slowMs = 0; //Settle time needed after stopping from SETTLE_CALIBRATION_SLOW_FRACTION of the rate in settle_speeds
+    unsigned int fastMs = 0; //Settle time needed after stopping from the rate in settle_speeds
+};
+
+struct TaskTiming { //The fixed part of each task, kept in PROGMEM
+    void (*run)(void);
+    unsigned long budgetUs; //Run time allowed before it counts as an overrun
+    unsigned long deadlineUs; //Time allowed from release to starting before it counts as a missed deadline
+};
+
+struct Task {
+    unsigned long periodUs; //0 = released on every pass of the scheduler
+    unsigned long lastReleaseUs; //For tasks released on every pass this is when it last finished
+    unsigned int overruns;
+    unsigned int missedDeadlines;
+    unsigned long maxUs; //Longest run time
+};
+
+struct JobWait {
+    unsigned long startMs;
+    unsigned long ms;
+    byte stage; //WAIT_AWAKE unless the drivers are being idled for the wait
+    unsigned long stageMs; //When the drivers were disabled or enabled again
+    long holdPositions[AXIS_COUNT]; //Positions to return to when the drivers are enabled again
+};
+
+struct KeyframeMove {
+    int index;
+    byte phase = MOVE_DONE;
+    float initialSpeed[AXIS_COUNT];
+    float deltaSpeed[AXIS_COUNT];
+    float inc[AXIS_COUNT]; //Fraction of the acceleration ramp completed
+    unsigned long lastUs[AXIS_COUNT];
+    float speed[AXIS_COUNT]; //Speeds set by multi_stepper.moveTo() before the feed override is applied
+    float feedScale = 1; //Scale last applied to the speeds
+};
+
+struct HomingState {
+    byte phase;
+    bool panHomeFlag;
+    bool tiltHomeFlag;
+    bool sliderHomeFlag;
+    int panHomingDir;
+    int tiltHomingDir;
+    float sliderPos;
+};
+
+struct Job {
+    byte type = JOB_NONE;
+    byte state = JOB_IDLE;
+    byte phase = PHASE_NEXT;
+    int repeat;
+    int repeatIndex;
+    int keyframeIndex; //Keyframe being moved to (executeMoves) or the start of the segment being shot
+    unsigned int frameIndex; //Frame within the segment
+    unsigned int frameCount; //Frames in the segment
+    unsigned int holdFrames; //Frames still to be taken at the current keyframe (timelapse)
+    unsigned int framesTaken;
+    unsigned int totalFrames; //0 if not known before starting
+    float degPerPic;
+    unsigned long msDelay; //Time spent stationary for each frame after the shutter delay
+    unsigned long msInterval;
+    unsigned long settleMs;
+    float stopSpeeds[AXIS_COUNT]; //Speeds when the deceleration to a stop started
+    unsigned long stopStartMs;
+    unsigned long lastControlMs;
+};
+
+struct SegmentStream {
+    int16_t steps[SEGMENT_BUFFER_LENGTH][SEGMENT_AXES]; //Steps moved by each axis during one period
+    byte head; //Next segment to play
+    byte count;
+    unsigned int periodMs;
+    unsigned long nextMs; //When the next segment is due
+    bool playing; //false while prefilling
+    bool ended; //The host has sent the last segment
+    bool starved; //Waiting for a segment that was due
+    unsigned int played;
+    unsigned int underruns;
+    unsigned int dropped; //Segments received with the buffer full or no stream running
+};
+
+struct Capture {
+    unsigned int periodMs; //0 = not capturing
+    long lastSteps[SEGMENT_AXES]; //Positions the last frame was sent at
+    unsigned long frames;
 };
 
 struct FloatCoordinate {
@@ -116,27 +416,101 @@ struct FloatCoordinate {
     float z;
 };
 
-struct LinePoints {
-    float x0;
-    float y0;
-    float x1;
-    float y1;
+struct PanoramaPlan {
+    float panStart; //Centre of the first frame (keyframe 0)
+    float tiltStart;
+    float panIncrement; //Signed angle between neighbouring frame centres
+    float tiltIncrement;
+    unsigned int columns;
+    unsigned int rows;
+    bool columnMajor; //true if the serpentine sweeps up and down the columns instead of along the rows
+    unsigned long estimatedMs;
+    float sliderStart; //Slider position the nodal offset correction is measured from
+};
+
+struct OrbitState {
+    FloatCoordinate target;
+    byte phase;
+    int direction; //1 forwards through the keyframes, -1 on the way back
+    long sliderStart;
+    long lensStart[AXIS_COUNT];
+    float sliderSpeed; //steps/second towards the keyframe before the feed override
+    unsigned long lastControlMs;
+};
+
+struct ContinuousTimelapse {
+    float msPerWeight; //Timelapse time per second of segmentTime()
+    float segmentStartMs; //Time of the start of the current segment from the first picture
+    float segmentMs;
+    byte masterAxis; //Axis with the most steps to move in the segment
+    long masterStart;
+    long masterDelta;
 };
 
 /*------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
+class AccelStepper;
+class FastStepper;
+
 void initPanTilt(void);
 void serialFlush(void);
 void enableSteppers(void);
 void setStepMode(int);
+int16_t readSerialInt16(void);
+bool waitSerialBytes(int);
+void readSegments(void);
 void serialData(void);
+void stepTask(void);
+void serialTask(void);
+void checkJogTimeout(void);
+void batteryTask(void);
+void captureTask(void);
+void startCapture(int);
+void endCapture(void);
+void telemetryTask(void);
+void printTelemetry(void);
+void jobTask(void);
+void runTask(int, unsigned long);
+void runScheduler(void);
+void schedulerReport(void);
+void dumpTrace(int);
+void timedSerialData(void);
 void mainLoop(void);
 void panDegrees(float);
 void tiltDegrees(float);
 void debugReport(void);
-bool findHome(void);
+void findHome(void);
+bool serviceHoming(void);
+void finishHoming(bool);
+void startJob(byte);
+void endJob(void);
+void stopJob(void);
+void pauseJob(void);
+void jobProgress(void);
+bool rampDown(void);
+void startSegments(int);
+void endSegments(void);
+bool serviceSegments(void);
+bool multiStepperRunning(void);
+void startJobWait(unsigned long, bool);
+bool jobWaitDone(void);
+bool serviceJobWait(bool);
+bool jobAllowsInstruction(char);
+void nextExecuteMove(void);
+void nextPanoramiclapseFrame(void);
+void nextTimelapseFrame(void);
+void initBatteryMonitor(void);
 float getBatteryVoltage(void);
 float getBatteryPercentage(void);
+float getBatteryCurrent(void);
+float getBatteryRuntime(void);
+void printBatteryStatus(void);
+void checkBatteryRuntime(unsigned long);
+bool batteryLowStop(void);
+void parkSteppers(void);
+void startParking(void);
+void fullStepPositions(long*);
+bool canIdleDrivers(unsigned long);
 float boundFloat(float, float, float);
 float panDegreesToSteps(float);
 float tiltDegreesToSteps(float);
@@ -148,6 +522,9 @@ int addPosition(void);
 void clearKeyframes(void);
 void executeMoves(int);
 void moveToIndex(int);
+bool startKeyframeMove(int);
+bool keyframeRampDone(void);
+bool serviceKeyframeMove(void);
 void gotoFirstKeyframe(void);
 void gotoLastKeyframe(void);
 void editKeyframe(void);
@@ -157,22 +534,67 @@ void printKeyframeElements(void);
 void saveEEPROM(void);
 void printEEPROM(void);
 void setEEPROMVariables(void);
-void invertPanDirection(bool);
-void invertTiltDirection(bool);
-int setTargetPositions(float, float, float);
+void loadEEPROMFloat(int, float&, float, float);
+void invertDirection(FastStepper&, byte&, const __FlashStringHelper*, bool);
+void moveAxisTo(int, long);
+float axisMaxSpeed(int);
+int axisAccelIncrement(int);
+float lensDegreesToSteps(int, float);
+float lensStepsToDegrees(int, long);
+void lensDegrees(int, float);
+void setLensMaxSpeed(int, float);
+void invertLens(int, bool);
+bool isLensAxis(int);
+void benchmarkAxes(void);
+void setLogMode(int);
+void setTargetPositions(float, float, float);
 void toggleAutoHoming(void);
 void triggerCameraShutter(void);
-void panoramiclapseInterpolation(float, float, float, float, float, float, float, unsigned long);
 void panoramiclapse(float, unsigned long, int);
 long sliderMillimetresToSteps(float);
 float sliderStepsToMillimetres(long);
 void sliderMoveTo(float);
-void invertSliderDirection(bool);
 void timelapse(unsigned int, unsigned long);
+void keyframeRay(int, FloatCoordinate&, FloatCoordinate&);
 bool calculateTargetCoordinate(void);
-void interpolateTargetPoint(FloatCoordinate);
+void targetAngles(FloatCoordinate, float, float&, float&);
+void interpolateTargetPoint(FloatCoordinate, int);
+void nextOrbitKeyframe(void);
+void startOrbitMove(int);
+void updateOrbitSpeeds(void);
+bool serviceOrbit(void);
 void toggleAcceleration(void);
 void scaleKeyframeSpeed(float);
+void setFeedOverride(float);
+bool updateFeedOverride(void);
+void applyFeedOverride(bool);
+float feedScale(void);
+void setFeedSpeed(AccelStepper&, float);
+void setKeyframeMaxSpeeds(int);
+bool planPanorama(PanoramaPlan&, unsigned long);
+void panoramaFramePosition(const PanoramaPlan&, unsigned int, float&, float&);
+void panoramaGrid(unsigned long);
+void nextPanoramaGridFrame(void);
+float nodalSliderPosition(float, float, float, float, float);
+float nodalOffset(float, float);
+float moveSpeed(void);
+unsigned long settleTime(void);
+void setSettleProfile(int);
+void calibrateSettleTime(void);
+void nextSettleCalibrationFrame(void);
+void settleCalibrationMove(int);
+void setSettleCalibrationFrame(int, bool);
+void startCameraShutter(void);
+void updateCameraShutter(void);
+float segmentTime(int);
+void continuousTimelapse(unsigned int, unsigned long);
+void nextContinuousSegment(void);
+void nextContinuousTrigger(void);
+bool serviceContinuousSegment(void);
+void restoreMaxSpeeds(void);
+long easeFraction(long, byte);
+bool compileTimelapse(unsigned int, unsigned long);
+void setEasing(int);
 
 /*------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
@@ -0,0 +1,62 @@
+#include "panTiltTrace.h"
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#ifdef STEP_TRACE
+LoopTrace loop_trace;
+#endif
+byte trace_checksum = 0;
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void initTrace(void){ //Timer1 counts freely at 4us a tick. Arduino's init() leaves it in 8 bit PWM mode which counts up and down.
+#ifdef STEP_TRACE
+    TCCR1A = 0; //Normal mode with the output compare pins disconnected so D9 and D10 stay ordinary outputs
+    TCCR1B = _BV(CS11) | _BV(CS10); //Prescaler of 64
+#endif
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void clearTrace(void){
+#ifdef STEP_TRACE
+    memset(&loop_trace, 0, sizeof(loop_trace));
+#endif
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void traceFrameStart(unsigned int length){
+    Serial.write(TRACE_FRAME_START);
+    Serial.write(TRACE_FRAME_VERSION);
+    Serial.write(lowByte(length));
+    Serial.write(highByte(length));
+    trace_checksum = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void traceByte(byte value){
+    trace_checksum += value;
+    Serial.write(value);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void traceUint16(uint16_t value){ //Little endian
+    traceByte(lowByte(value));
+    traceByte(highByte(value));
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void traceUint32(uint32_t value){
+    traceUint16(value & 0xFFFF);
+    traceUint16(value >> 16);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void traceFrameEnd(void){
+    Serial.write(trace_checksum);
+}
@@ -0,0 +1,97 @@
+#ifndef PANTILTTRACE_H
+#define PANTILTTRACE_H
+
+#include <Arduino.h>
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Hot path instrumentation for diagnosing stutter after a shoot. Every axis keeps the intervals between its last STEP_TRACE_LENGTH steps in a ring buffer.
+//They are timed with Timer1 running freely at 4us a tick so recording a step is a register read, a subtraction and a store. The scheduler adds the time
+//between passes of the step task and serialData() adds its run time. INSTRUCTION_TRACE_DUMP sends it all with the scheduler's counters as one frame:
+//
+//  TRACE_FRAME_START, TRACE_FRAME_VERSION, payload length (uint16), payload, checksum (sum of the payload bytes)
+//
+//  Payload: tick us, axis count, task count, intervals per axis, loop passes, loop total us, loop max us, serial calls, serial total us, serial max us (uint32),
+//           then for each task missed deadlines, overruns (uint16) and max us (uint32),
+//           then for each axis the number of intervals followed by the intervals in ticks (uint16) oldest first
+//
+//All values are little endian. The host decoder (pan_tilt_mount_log_decoder/pan_tilt_log.py) prints it.
+
+//#define STEP_TRACE //TODO: Uncomment to diagnose stutter. Uses STEP_TRACE_LENGTH * 2 + 4 bytes per axis and 24 bytes for the counters, which the
+                   //Nano can't spare with the keyframe array at its default size. Reduce KEYFRAME_ARRAY_LENGTH to make room.
+
+#define STEP_TRACE_LENGTH 16 //Intervals kept per axis. Must be a power of 2.
+#define STEP_TRACE_TICK_US 4 //Timer1 with a prescaler of 64. Intervals over 262ms wrap.
+#define TRACE_FRAME_START 0x1D //ASCII group separator. Never sent in the text messages.
+#define TRACE_FRAME_VERSION 1
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+struct StepTrace {
+    uint16_t intervals[STEP_TRACE_LENGTH]; //Timer1 ticks
+    uint16_t lastTick;
+    byte head; //Where the next interval goes
+    byte filled; //Number of intervals recorded up to STEP_TRACE_LENGTH
+};
+
+struct LoopTrace {
+    unsigned long passes;
+    unsigned long totalUs; //Time the step task waited between passes
+    unsigned long maxUs;
+    unsigned long serialCalls;
+    unsigned long serialTotalUs;
+    unsigned long serialMaxUs;
+};
+
+#ifdef STEP_TRACE
+extern LoopTrace loop_trace;
+#endif
+
+void initTrace(void);
+void clearTrace(void);
+void traceFrameStart(unsigned int length);
+void traceByte(byte value);
+void traceUint16(uint16_t value);
+void traceUint32(uint32_t value);
+void traceFrameEnd(void);
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+inline void traceStep(StepTrace &trace){ //Called by AxisStepper::step() for every step
+    uint16_t tick = TCNT1;
+    trace.intervals[trace.head] = tick - trace.lastTick;
+    trace.lastTick = tick;
+    trace.head = (trace.head + 1) & (STEP_TRACE_LENGTH - 1);
+    if(trace.filled < STEP_TRACE_LENGTH){
+        trace.filled++;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+inline void traceLoopPass(unsigned long us){
+#ifdef STEP_TRACE
+    loop_trace.passes++;
+    loop_trace.totalUs += us;
+    if(us > loop_trace.maxUs){
+        loop_trace.maxUs = us;
+    }
+#else
+    (void)us;
+#endif
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+inline void traceSerial(unsigned long us){
+#ifdef STEP_TRACE
+    loop_trace.serialCalls++;
+    loop_trace.serialTotalUs += us;
+    if(us > loop_trace.serialMaxUs){
+        loop_trace.serialMaxUs = us;
+    }
+#else
+    (void)us;
+#endif
+}
+
+#endif
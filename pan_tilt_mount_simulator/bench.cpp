@@ -0,0 +1,193 @@
+#include "bench.h"
+#include "simulator.h"
+#include <Arduino.h>
+#include "panTiltMount.h"
+#include <stdio.h>
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#define BENCH_AXIS_COUNT 5
+#define BENCH_STEP_MODE_COUNT 4 //Half, quarter, eighth and sixteenth
+
+extern Task tasks[TASK_COUNT];
+static const char *const bench_task_names[TASK_COUNT] = {"step", "serial", "battery", "capture", "telemetry", "job"}; //TASK_ order. The firmware's table is const so it isn't visible here.
+
+struct BenchAxis {
+    uint64_t lastStepUs = 0;
+    uint64_t lastIntervalUs = 0; //0 at the start of a move
+    unsigned long steps = 0;
+};
+
+static BenchAxis bench_axes[BENCH_AXIS_COUNT];
+static BenchHistogram bench_jitter[BENCH_STEP_MODE_COUNT]; //Change in the interval between consecutive steps of an axis
+static BenchHistogram bench_loop; //Time between the ends of consecutive runs of the step task
+static unsigned long bench_loop_last = 0;
+static bool bench_loop_started = false;
+static unsigned long bench_window_steps = 0;
+static uint64_t bench_window_start_us = 0;
+static unsigned long bench_peak_window_steps = 0;
+static uint64_t bench_moving_us = 0; //Time with a step less than BENCH_STEP_GAP_US ago
+static uint64_t bench_last_step_us = 0;
+static unsigned long bench_steps = 0;
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void BenchHistogram::add(uint64_t us){
+    count++;
+    total += us;
+    if(us > max){
+        max = us;
+    }
+    int bucket = 0;
+    while(bucket < BENCH_HISTOGRAM_BUCKETS - 1 && us >= (1ULL << bucket)){
+        bucket++;
+    }
+    buckets[bucket]++;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Clears the statistics so a scenario can leave out the moves that set it up. The firmware's task counters are cleared too.
+
+void benchReset(void){
+    for(int i = 0; i < BENCH_AXIS_COUNT; i++){
+        bench_axes[i] = BenchAxis();
+    }
+    for(int i = 0; i < BENCH_STEP_MODE_COUNT; i++){
+        bench_jitter[i] = BenchHistogram();
+    }
+    bench_loop = BenchHistogram();
+    bench_loop_started = false;
+    bench_window_steps = 0;
+    bench_window_start_us = 0;
+    bench_peak_window_steps = 0;
+    bench_moving_us = 0;
+    bench_last_step_us = 0;
+    bench_steps = 0;
+    for(int i = 0; i < TASK_COUNT; i++){
+        tasks[i].overruns = 0;
+        tasks[i].missedDeadlines = 0;
+        tasks[i].maxUs = 0;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static int stepModeIndex(uint8_t stepMode){
+    switch(stepMode){
+        case HALF_STEP: return 0;
+        case QUARTER_STEP: return 1;
+        case EIGHTH_STEP: return 2;
+        default: return 3;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void benchStep(size_t axis, uint8_t stepMode, uint64_t us){
+    if(axis >= BENCH_AXIS_COUNT){
+        return;
+    }
+    BenchAxis &bench = bench_axes[axis];
+    if(bench.steps > 0 && us - bench.lastStepUs < BENCH_STEP_GAP_US){
+        uint64_t interval = us - bench.lastStepUs;
+        if(bench.lastIntervalUs > 0){
+            uint64_t change = (interval > bench.lastIntervalUs) ? interval - bench.lastIntervalUs : bench.lastIntervalUs - interval;
+            bench_jitter[stepModeIndex(stepMode)].add(change);
+        }
+        bench.lastIntervalUs = interval;
+    }
+    else{
+        bench.lastIntervalUs = 0;
+    }
+    bench.lastStepUs = us;
+    bench.steps++;
+
+    if(bench_steps > 0 && us - bench_last_step_us < BENCH_STEP_GAP_US){
+        bench_moving_us += us - bench_last_step_us;
+    }
+    bench_last_step_us = us;
+    bench_steps++;
+
+    if(us - bench_window_start_us >= BENCH_RATE_WINDOW_US){
+        bench_window_start_us = us;
+        bench_window_steps = 0;
+    }
+    bench_window_steps++;
+    if(bench_window_steps > bench_peak_window_steps){
+        bench_peak_window_steps = bench_window_steps;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Called on every clock read. runTask() sets lastReleaseUs of the step task to micros() each time it finishes so a change marks the end of a pass.
+
+void benchPoll(uint64_t us){
+    (void)us;
+    unsigned long finished = tasks[TASK_STEP].lastReleaseUs;
+    if(finished == bench_loop_last){
+        return;
+    }
+    if(bench_loop_started){
+        bench_loop.add(finished - bench_loop_last);
+    }
+    bench_loop_started = true;
+    bench_loop_last = finished;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void writeHistogram(FILE *file, const BenchHistogram &histogram){
+    fprintf(file, "{\"count\": %lu, \"mean_us\": %.3f, \"max_us\": %llu, \"buckets\": [", histogram.count,
+        histogram.count ? (double)histogram.total / histogram.count : 0.0, (unsigned long long)histogram.max);
+    for(int i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++){
+        fprintf(file, "%s%lu", i ? ", " : "", histogram.buckets[i]);
+    }
+    fprintf(file, "]}");
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void benchWrite(const char *path){
+    FILE *file = fopen(path, "w");
+    if(file == nullptr){
+        perror(path);
+        return;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"virtual_ms\": %.3f,\n", simTimeUs() / 1000.0);
+    fprintf(file, "  \"cost_model\": {\"clock_cost_us\": %lu, \"pin_cost_us\": %lu, \"baud\": %lu},\n", sim_config.clockCostUs, sim_config.pinCostUs,
+        (unsigned long)BAUD_RATE);
+    fprintf(file, "  \"histogram_buckets_us\": [");
+    for(int i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++){
+        fprintf(file, "%s%llu", i ? ", " : "", i ? (1ULL << (i - 1)) : 0ULL); //Lower bound of each bucket
+    }
+    fprintf(file, "],\n");
+    fprintf(file, "  \"loop\": ");
+    writeHistogram(file, bench_loop);
+    fprintf(file, ",\n  \"tasks\": {");
+    for(int i = 0; i < TASK_COUNT; i++){
+        fprintf(file, "%s\n    \"%s\": {\"max_us\": %lu, \"overruns\": %u, \"missed_deadlines\": %u}", i ? "," : "", bench_task_names[i], tasks[i].maxUs,
+            tasks[i].overruns, tasks[i].missedDeadlines);
+    }
+    fprintf(file, "\n  },\n");
+    double movingS = bench_moving_us / 1000000.0;
+    fprintf(file, "  \"steps\": {\"total\": %lu, \"moving_s\": %.3f, \"mean_rate\": %.1f, \"peak_rate\": %.1f, \"axes\": [", bench_steps, movingS,
+        movingS > 0 ? bench_steps / movingS : 0.0, bench_peak_window_steps * (1000000.0 / BENCH_RATE_WINDOW_US));
+    for(int i = 0; i < BENCH_AXIS_COUNT; i++){
+        fprintf(file, "%s%lu", i ? ", " : "", bench_axes[i].steps);
+    }
+    fprintf(file, "]},\n");
+    fprintf(file, "  \"jitter\": {");
+    static const int modes[BENCH_STEP_MODE_COUNT] = {HALF_STEP, QUARTER_STEP, EIGHTH_STEP, SIXTEENTH_STEP};
+    bool first = true;
+    for(int i = 0; i < BENCH_STEP_MODE_COUNT; i++){
+        if(bench_jitter[i].count == 0){
+            continue;
+        }
+        fprintf(file, "%s\n    \"%d\": ", first ? "" : ",", modes[i]);
+        writeHistogram(file, bench_jitter[i]);
+        first = false;
+    }
+    fprintf(file, "\n  }\n}\n");
+    fclose(file);
+}
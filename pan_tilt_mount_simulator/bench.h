@@ -0,0 +1,29 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Timing statistics for --bench. All times are in virtual microseconds so they depend on the cost model in SimConfig. They are for comparing builds of
+//the firmware with each other, not for predicting the real numbers (the on-device trace gives those).
+
+#define BENCH_HISTOGRAM_BUCKETS 16 //Powers of 2: [0, 1), [1, 2), [2, 4) ... [8192, 16384), >= 16384us
+#define BENCH_RATE_WINDOW_US 100000 //Window the peak step rate is counted over
+#define BENCH_STEP_GAP_US 50000 //Steps further apart than this are a new move and aren't counted in the jitter
+
+struct BenchHistogram {
+    unsigned long count = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+    unsigned long buckets[BENCH_HISTOGRAM_BUCKETS] = {};
+
+    void add(uint64_t us);
+};
+
+void benchReset(void);
+void benchStep(size_t axis, uint8_t stepMode, uint64_t us);
+void benchPoll(uint64_t us);
+void benchWrite(const char *path);
+
+#endif
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+#
+# Step rate and jitter benchmark for the firmware's main loop, run in the host simulator.
+#
+# Every scenario in scenarios/bench is run in each step mode on a freshly configured EEPROM and the simulator's --bench statistics are collected into
+# one JSON report:
+#
+#   {"cost_model": {...}, "histogram_buckets_us": [...], "runs": {"<scenario>": {"<step mode>": {"loop": ..., "tasks": ..., "steps": ..., "jitter": ...}}}}
+#
+# loop is the time between passes of the scheduler's step task, steps.peak_rate the most steps made by all the axes in 100ms and jitter the change in
+# the interval between consecutive steps of an axis. The times are virtual so they are for comparing builds with each other. Pass --baseline with an
+# earlier report to print the differences.
+#
+#   ./bench.py --output build/bench.json
+#   ./bench.py --baseline old.json --scenarios moves,max_rate --modes 16
+#
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+STEP_MODES = [2, 4, 8, 16]
+
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+def run_sim(sim, script, eeprom, extra=()):
+    """Runs the simulator on a script and returns the --bench report."""
+    with tempfile.NamedTemporaryFile(suffix=".json", delete=False) as report_file:
+        report_path = report_file.name
+    try:
+        result = subprocess.run([sim, "--quiet", "--eeprom", eeprom, "--bench", report_path] + list(extra), input=script.encode(), stdout=subprocess.DEVNULL,
+            stderr=subprocess.PIPE)
+        if result.returncode != 0:
+            sys.exit("Simulator failed:\n" + result.stderr.decode())
+        with open(report_path) as report_file:
+            return json.load(report_file)
+    finally:
+        os.unlink(report_path)
+
+
+def percentile(histogram, bounds, fraction):
+    """Lower bound of the bucket the given fraction of the samples are below."""
+    limit = histogram["count"] * fraction
+    seen = 0
+    for bound, count in zip(bounds, histogram["buckets"]):
+        seen += count
+        if count and seen >= limit:
+            return bound
+    return 0
+
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+COLUMNS = [ #Heading, width and how to get the value from a run
+    ("loop max us", 12, lambda run, bounds: run["loop"]["max_us"]),
+    ("loop mean us", 12, lambda run, bounds: run["loop"]["mean_us"]),
+    ("peak steps/s", 12, lambda run, bounds: run["steps"]["peak_rate"]),
+    ("mean steps/s", 12, lambda run, bounds: run["steps"]["mean_rate"]),
+    ("jitter p99 us", 13, lambda run, bounds: max([percentile(h, bounds, 0.99) for h in run["jitter"].values()] or [0])),
+    ("jitter max us", 13, lambda run, bounds: max([h["max_us"] for h in run["jitter"].values()] or [0])),
+]
+
+
+def print_table(report, baseline):
+    bounds = report["histogram_buckets_us"]
+    print("%-12s %4s " % ("scenario", "mode") + " ".join("%*s" % (width, heading) for heading, width, _ in COLUMNS))
+    for scenario, modes in report["runs"].items():
+        for mode, run in modes.items():
+            cells = []
+            for heading, width, value in COLUMNS:
+                text = "%.1f" % value(run, bounds)
+                base = baseline.get("runs", {}).get(scenario, {}).get(mode) if baseline else None
+                if base is not None:
+                    text += " (%+.1f)" % (value(run, bounds) - value(base, baseline["histogram_buckets_us"]))
+                cells.append("%*s" % (width, text))
+            print("%-12s %4s " % (scenario, mode) + " ".join(cells))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmarks the firmware's step generation in the host simulator.")
+    parser.add_argument("--sim", default=os.path.join(HERE, "build", "pan_tilt_sim"), help="Simulator binary (build it with make)")
+    parser.add_argument("--scenarios", help="Comma separated scenario names from scenarios/bench (default all)")
+    parser.add_argument("--modes", default=",".join(str(mode) for mode in STEP_MODES), help="Comma separated step modes (default 2,4,8,16)")
+    parser.add_argument("--output", help="Write the JSON report here")
+    parser.add_argument("--baseline", help="Earlier report to compare with")
+    parser.add_argument("--clock-cost-us", help="Passed to the simulator")
+    parser.add_argument("--pin-cost-us", help="Passed to the simulator")
+    args = parser.parse_args()
+
+    scenario_dir = os.path.join(HERE, "scenarios", "bench")
+    names = args.scenarios.split(",") if args.scenarios else sorted(name[:-4] for name in os.listdir(scenario_dir) if name.endswith(".txt"))
+    modes = [int(mode) for mode in args.modes.split(",")]
+    extra = []
+    if args.clock_cost_us:
+        extra += ["--clock-cost-us", args.clock_cost_us]
+    if args.pin_cost_us:
+        extra += ["--pin-cost-us", args.pin_cost_us]
+
+    with open(os.path.join(HERE, "scenarios", "configure.txt")) as configure_file:
+        configure = configure_file.read()
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as baseline_file:
+            baseline = json.load(baseline_file)
+
+    report = {"runs": {}}
+    work = tempfile.mkdtemp()
+    try:
+        configured = os.path.join(work, "configured.eeprom")
+        run_sim(args.sim, configure, configured, extra)
+        for name in names:
+            with open(os.path.join(scenario_dir, name + ".txt")) as scenario_file:
+                scenario = scenario_file.read()
+            for mode in modes:
+                eeprom = os.path.join(work, "run.eeprom")
+                shutil.copy(configured, eeprom) #Every run starts from the same settings
+                run = run_sim(args.sim, "m%d\n" % mode + scenario, eeprom, extra)
+                report["cost_model"] = run.pop("cost_model")
+                report["histogram_buckets_us"] = run.pop("histogram_buckets_us")
+                report["runs"].setdefault(name, {})[str(mode)] = run
+                sys.stderr.write("%s %d done\n" % (name, mode))
+    finally:
+        shutil.rmtree(work)
+
+    print_table(report, baseline)
+    if args.output:
+        with open(args.output, "w") as output_file:
+            json.dump(report, output_file, indent=2)
+
+
+if __name__ == "__main__":
+    main()
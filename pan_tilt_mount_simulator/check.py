@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+#
+# Regression checks for the firmware, run in the host simulator.
+#
+# Every scenario in scenarios/check is run on a freshly configured EEPROM (scenarios/configure.txt). A run fails if any axis lost a step or had its
+# driver disabled between full steps, or if one of the scenario's expectations isn't met. Expectations are comments in the scenario:
+#
+#   // expect position AXIS UNITS [TOLERANCE]    Final position in degrees or mm from the power on position, as in the simulator's summary
+#   // expect line TEXT                          A line of the serial output. The lines must appear in the order they are listed
+#   // expect shutter COUNT                      Number of times the shutter was triggered
+#
+#   ./check.py
+#   ./check.py --scenarios moves,timelapse --verbose
+#
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SCENARIO_DIR = os.path.join(HERE, "scenarios", "check")
+DEFAULT_TOLERANCE = 0.02 #About a sixteenth step on tilt
+PIN_SHUTTER = 15 #PIN_SHUTTER_TRIGGER in panTiltMount.h
+
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+def run_sim(sim, script, eeprom, trace=None):
+    """Runs the simulator on a script and returns its serial output and summary as {axis: (units, lost, offstep)}."""
+    command = [sim, "--eeprom", eeprom]
+    if trace:
+        command += ["--trace", trace]
+    result = subprocess.run(command, input=script.encode(), stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        sys.exit("Simulator failed:\n" + result.stderr.decode())
+    summary = {}
+    for match in re.finditer(r"^\[sim\] (\w+) +-?\d+ +(-?[\d.]+) +\d+ +(\d+) +(\d+)$", result.stderr.decode(), re.MULTILINE):
+        summary[match.group(1)] = (float(match.group(2)), int(match.group(3)), int(match.group(4)))
+    output = result.stdout.decode("utf-8", errors="replace").replace("\r", "").split("\n")
+    return output, summary
+
+
+def count_shutter(trace):
+    pattern = re.compile(r"^\d+ pin %d 1$" % PIN_SHUTTER)
+    with open(trace) as trace_file:
+        return sum(1 for line in trace_file if pattern.match(line.strip()))
+
+
+def parse_expectations(script):
+    expectations = []
+    for line in script.split("\n"):
+        match = re.match(r"//\s*expect\s+(\w+)\s+(.*?)\s*$", line)
+        if match:
+            expectations.append((match.group(1), match.group(2)))
+    return expectations
+
+#----------------------------------------------------------------------------------------------------------------------------------------------------
+
+def check_scenario(sim, name, script, configured, work, verbose):
+    """Returns a list of the failures."""
+    expectations = parse_expectations(script)
+    eeprom = os.path.join(work, "run.eeprom")
+    shutil.copy(configured, eeprom) #Every run starts from the same settings
+    trace = os.path.join(work, "run.trace") if any(kind == "shutter" for kind, _ in expectations) else None
+    output, summary = run_sim(sim, script, eeprom, trace)
+    if verbose:
+        print("\n".join(output))
+    failures = []
+    if not summary:
+        return ["No summary from the simulator"]
+    for axis, (units, lost, offstep) in summary.items():
+        if lost:
+            failures.append("%s lost %d steps" % (axis, lost))
+        if offstep:
+            failures.append("%s was disabled between full steps %d times" % (axis, offstep))
+    line_index = 0
+    for kind, value in expectations:
+        if kind == "position":
+            fields = value.split()
+            axis, target = fields[0], float(fields[1])
+            tolerance = float(fields[2]) if len(fields) > 2 else DEFAULT_TOLERANCE
+            if axis not in summary:
+                failures.append("No axis called %s" % axis)
+            elif abs(summary[axis][0] - target) > tolerance:
+                failures.append("%s ended at %.3f instead of %.3f" % (axis, summary[axis][0], target))
+        elif kind == "line":
+            while line_index < len(output) and output[line_index] != value:
+                line_index += 1
+            if line_index >= len(output):
+                failures.append("Missing line (or out of order): %s" % value)
+                line_index = 0
+            else:
+                line_index += 1
+        elif kind == "shutter":
+            count = count_shutter(trace)
+            if count != int(value):
+                failures.append("Shutter triggered %d times instead of %s" % (count, value))
+        else:
+            failures.append("Unknown expectation: %s" % kind)
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Runs the firmware's regression checks in the host simulator.")
+    parser.add_argument("--sim", default=os.path.join(HERE, "build", "pan_tilt_sim"), help="Simulator binary (build it with make)")
+    parser.add_argument("--scenarios", help="Comma separated scenario names from scenarios/check (default all)")
+    parser.add_argument("--verbose", action="store_true", help="Print the serial output of each run")
+    args = parser.parse_args()
+
+    names = sorted(name[:-4] for name in os.listdir(SCENARIO_DIR) if name.endswith(".txt"))
+    if args.scenarios:
+        names = args.scenarios.split(",")
+    with open(os.path.join(HERE, "scenarios", "configure.txt")) as configure_file:
+        configure = configure_file.read()
+
+    failed = 0
+    work = tempfile.mkdtemp()
+    try:
+        configured = os.path.join(work, "configured.eeprom")
+        run_sim(args.sim, configure, configured)
+        for name in names:
+            with open(os.path.join(SCENARIO_DIR, name + ".txt")) as scenario_file:
+                failures = check_scenario(args.sim, name, scenario_file.read(), configured, work, args.verbose)
+            print("%-20s %s" % (name, "FAIL" if failures else "ok"))
+            for failure in failures:
+                print("    " + failure)
+            failed += bool(failures)
+    finally:
+        shutil.rmtree(work)
+    print("%d of %d scenarios passed" % (len(names) - failed, len(names)))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,290 @@
+#include "AccelStepper.h"
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+AccelStepper::AccelStepper(uint8_t interface, uint8_t pin1, uint8_t pin2, uint8_t pin3, uint8_t pin4, bool enable){
+    (void)pin3;
+    (void)pin4;
+    (void)enable;
+    _interface = interface;
+    _pin[0] = pin1;
+    _pin[1] = pin2;
+    _pinInverted[0] = false;
+    _pinInverted[1] = false;
+    _currentPos = 0;
+    _targetPos = 0;
+    _speed = 0.0;
+    _maxSpeed = 1.0;
+    _acceleration = 0.0;
+    _stepInterval = 0;
+    _lastStepTime = 0;
+    _minPulseWidth = 1;
+    _n = 0;
+    _c0 = 0.0;
+    _cn = 0.0;
+    _cmin = 1.0;
+    _direction = DIRECTION_CCW;
+    setAcceleration(1);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::moveTo(long absolute){
+    if(_targetPos != absolute){
+        _targetPos = absolute;
+        computeNewSpeed();
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::move(long relative){
+    moveTo(_currentPos + relative);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+boolean AccelStepper::runSpeed(void){ //Steps once if a step is due
+    if(!_stepInterval){
+        return false;
+    }
+    unsigned long time = micros();
+    if(time - _lastStepTime >= _stepInterval){
+        if(_direction == DIRECTION_CW){
+            _currentPos += 1;
+        }
+        else{
+            _currentPos -= 1;
+        }
+        step(_currentPos);
+        _lastStepTime = time;
+        return true;
+    }
+    return false;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long AccelStepper::distanceToGo(void){
+    return _targetPos - _currentPos;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long AccelStepper::targetPosition(void){
+    return _targetPos;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+long AccelStepper::currentPosition(void){
+    return _currentPos;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::setCurrentPosition(long position){
+    _targetPos = _currentPos = position;
+    _n = 0;
+    _stepInterval = 0;
+    _speed = 0.0;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//The step interval for the next step of an acceleration or deceleration ramp. _n is the step number of the ramp, negative while decelerating.
+void AccelStepper::computeNewSpeed(void){
+    long distanceTo = distanceToGo();
+    long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration));
+
+    if(distanceTo == 0 && stepsToStop <= 1){ //At the target and slow enough to stop
+        _stepInterval = 0;
+        _speed = 0.0;
+        _n = 0;
+        return;
+    }
+
+    if(distanceTo > 0){
+        if(_n > 0){
+            if((stepsToStop >= distanceTo) || _direction == DIRECTION_CCW){
+                _n = -stepsToStop; //Start decelerating
+            }
+        }
+        else if(_n < 0){
+            if((stepsToStop < distanceTo) && _direction == DIRECTION_CW){
+                _n = -_n; //Start accelerating
+            }
+        }
+    }
+    else if(distanceTo < 0){
+        if(_n > 0){
+            if((stepsToStop >= -distanceTo) || _direction == DIRECTION_CW){
+                _n = -stepsToStop;
+            }
+        }
+        else if(_n < 0){
+            if((stepsToStop < -distanceTo) && _direction == DIRECTION_CCW){
+                _n = -_n;
+            }
+        }
+    }
+
+    if(_n == 0){ //First step from stopped
+        _cn = _c0;
+        _direction = (distanceTo > 0) ? DIRECTION_CW : DIRECTION_CCW;
+    }
+    else{
+        _cn = _cn - ((2.0 * _cn) / ((4.0 * _n) + 1));
+        _cn = max(_cn, _cmin);
+    }
+    _n++;
+    _stepInterval = _cn;
+    _speed = 1000000.0 / _cn;
+    if(_direction == DIRECTION_CCW){
+        _speed = -_speed;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+boolean AccelStepper::run(void){
+    if(runSpeed()){
+        computeNewSpeed();
+    }
+    return _speed != 0.0 || distanceToGo() != 0;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::setMaxSpeed(float speed){
+    if(speed < 0.0){
+        speed = -speed;
+    }
+    if(_maxSpeed != speed){
+        _maxSpeed = speed;
+        _cmin = 1000000.0 / speed;
+        if(_n > 0){ //Recompute the ramp if accelerating or cruising
+            _n = (long)((_speed * _speed) / (2.0 * _acceleration));
+            computeNewSpeed();
+        }
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float AccelStepper::maxSpeed(void){
+    return _maxSpeed;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::setAcceleration(float acceleration){
+    if(acceleration == 0.0){
+        return;
+    }
+    if(acceleration < 0.0){
+        acceleration = -acceleration;
+    }
+    if(_acceleration != acceleration){
+        _n = _n * (_acceleration / acceleration);
+        _c0 = 0.676 * sqrt(2.0 / acceleration) * 1000000.0; //Equation 15 with the correction from equation 7
+        _acceleration = acceleration;
+        computeNewSpeed();
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::setSpeed(float speed){
+    if(speed == _speed){
+        return;
+    }
+    speed = constrain(speed, -_maxSpeed, _maxSpeed);
+    if(speed == 0.0){
+        _stepInterval = 0;
+    }
+    else{
+        _stepInterval = fabs(1000000.0 / speed);
+        _direction = (speed > 0.0) ? DIRECTION_CW : DIRECTION_CCW;
+    }
+    _speed = speed;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float AccelStepper::speed(void){
+    return _speed;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::step(long step){
+    switch(_interface){
+        case DRIVER:
+            step1(step);
+            break;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::step1(long step){ //Step and direction driver
+    (void)step;
+    digitalWrite(_pin[1], _direction ^ _pinInverted[1]);
+    digitalWrite(_pin[0], HIGH ^ _pinInverted[0]);
+    delayMicroseconds(_minPulseWidth);
+    digitalWrite(_pin[0], LOW ^ _pinInverted[0]);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::setMinPulseWidth(unsigned int minWidth){
+    _minPulseWidth = minWidth;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::setPinsInverted(bool directionInvert, bool stepInvert, bool enableInvert){
+    (void)enableInvert;
+    _pinInverted[0] = stepInvert;
+    _pinInverted[1] = directionInvert;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::runToPosition(void){
+    while(run()){
+        yield();
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+boolean AccelStepper::runSpeedToPosition(void){
+    if(_targetPos == _currentPos){
+        return false;
+    }
+    _direction = (_targetPos > _currentPos) ? DIRECTION_CW : DIRECTION_CCW;
+    return runSpeed();
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::runToNewPosition(long position){
+    moveTo(position);
+    runToPosition();
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void AccelStepper::stop(void){
+    if(_speed != 0.0){
+        long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)) + 1;
+        move((_speed > 0) ? stepsToStop : -stepsToStop);
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool AccelStepper::isRunning(void){
+    return !(_speed == 0.0 && _targetPos == _currentPos);
+}
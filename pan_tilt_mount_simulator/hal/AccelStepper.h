@@ -0,0 +1,75 @@
+#ifndef ACCELSTEPPER_H
+#define ACCELSTEPPER_H
+
+#include <Arduino.h>
+
+//Host version of the AccelStepper API the firmware uses. The speed and acceleration calculations follow the library (David Austin's equations) so
+//moves take the same number of steps at the same times. Build with ACCELSTEPPER_DIR set to use the real library instead.
+
+class AccelStepper {
+public:
+    typedef enum {
+        FUNCTION = 0,
+        DRIVER = 1,
+        FULL2WIRE = 2,
+        FULL3WIRE = 3,
+        FULL4WIRE = 4,
+        HALF3WIRE = 6,
+        HALF4WIRE = 8
+    } MotorInterfaceType;
+
+    AccelStepper(uint8_t interface = FULL4WIRE, uint8_t pin1 = 2, uint8_t pin2 = 3, uint8_t pin3 = 4, uint8_t pin4 = 5, bool enable = true);
+    virtual ~AccelStepper(){}
+
+    void moveTo(long absolute);
+    void move(long relative);
+    boolean run(void);
+    boolean runSpeed(void);
+    void setMaxSpeed(float speed);
+    float maxSpeed(void);
+    void setAcceleration(float acceleration);
+    void setSpeed(float speed);
+    float speed(void);
+    long distanceToGo(void);
+    long targetPosition(void);
+    long currentPosition(void);
+    void setCurrentPosition(long position);
+    void runToPosition(void);
+    boolean runSpeedToPosition(void);
+    void runToNewPosition(long position);
+    void stop(void);
+    void setMinPulseWidth(unsigned int minWidth);
+    void setPinsInverted(bool directionInvert = false, bool stepInvert = false, bool enableInvert = false);
+    bool isRunning(void);
+
+protected:
+    typedef enum {
+        DIRECTION_CCW = 0,
+        DIRECTION_CW = 1
+    } Direction;
+
+    void computeNewSpeed(void);
+    virtual void step(long step);
+    void step1(long step);
+
+    boolean _direction;
+
+private:
+    uint8_t _interface;
+    uint8_t _pin[2];
+    bool _pinInverted[2];
+    long _currentPos;
+    long _targetPos;
+    float _speed;
+    float _maxSpeed;
+    float _acceleration;
+    unsigned long _stepInterval;
+    unsigned long _lastStepTime;
+    unsigned int _minPulseWidth;
+    long _n;
+    float _c0;
+    float _cn;
+    float _cmin;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "Arduino.h"
+#include "../simulator.h"
+#include <stdio.h>
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+SimPort PORTB(8, 6);
+SimPort PORTC(14, 6);
+SimPort PORTD(0, 8);
+SimPinRegister PINB(PORTB);
+SimPinRegister PINC(PORTC);
+SimPinRegister PIND(PORTD);
+
+volatile uint8_t ADMUX = 0;
+volatile uint8_t ADCSRA = 0;
+volatile uint8_t ADCSRB = 0;
+volatile uint8_t DIDR0 = 0;
+volatile uint16_t ADC = 0;
+
+volatile uint8_t TCCR1A = 0;
+volatile uint8_t TCCR1B = 0;
+SimTimer1 TCNT1;
+
+HardwareSerial Serial;
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+unsigned long micros(void){
+    simClockRead();
+    return (unsigned long)simTimeUs();
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+unsigned long millis(void){
+    simClockRead();
+    return (unsigned long)(simTimeUs() / 1000);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void delay(unsigned long ms){
+    simAdvance((uint64_t)ms * 1000);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void delayMicroseconds(unsigned int us){
+    simAdvance(us);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void yield(void){
+    simClockRead();
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void pinMode(uint8_t pin, uint8_t mode){
+    simPinMode(pin, mode);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void digitalWrite(uint8_t pin, uint8_t value){
+    simAdvance(sim_config.pinCostUs);
+    simPinWrite(pin, value != LOW);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int digitalRead(uint8_t pin){
+    simAdvance(sim_config.pinCostUs);
+    return simPinRead(pin) ? HIGH : LOW;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int analogRead(uint8_t pin){
+    simAdvance(112); //A conversion takes 13 ADC clocks at 125kHz
+    return simAnalogRead(pin);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void noInterrupts(void){
+    simSetInterrupts(false);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void interrupts(void){
+    simSetInterrupts(true);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+SimPort::operator uint8_t() const {
+    uint8_t value = 0;
+    for(uint8_t i = 0; i < _pinCount; i++){
+        if(simPinRead(_firstPin + i)){
+            value |= 1 << i;
+        }
+    }
+    return value;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+SimPort &SimPort::operator=(uint8_t value){
+    uint8_t previous = *this;
+    for(uint8_t i = 0; i < _pinCount; i++){
+        if(((previous ^ value) >> i) & 1){ //Only the pins that change are written so inputs with pull ups aren't disturbed
+            simPinWrite(_firstPin + i, (value >> i) & 1);
+        }
+    }
+    return *this;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+SimTimer1::operator uint16_t() const {
+    static const uint16_t prescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0}; //Clock select 6 and 7 are the external clock pin
+    uint16_t prescaler = prescalers[TCCR1B & 7];
+    if(prescaler == 0){
+        return 0;
+    }
+    return (uint16_t)(simTimeUs() * 16 / prescaler); //16MHz
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void HardwareSerial::begin(unsigned long baud){
+    (void)baud;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int HardwareSerial::available(void){
+    return simSerialAvailable();
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int HardwareSerial::read(void){
+    return simSerialRead();
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int HardwareSerial::peek(void){
+    return simSerialPeek();
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+size_t HardwareSerial::write(uint8_t value){
+    simSerialWrite(&value, 1);
+    return 1;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size){
+    simSerialWrite(buffer, size);
+    return size;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+size_t HardwareSerial::print(long value, int base){
+    char text[24];
+    if(base == HEX){
+        snprintf(text, sizeof(text), "%lX", (unsigned long)value);
+    }
+    else{
+        snprintf(text, sizeof(text), "%ld", value);
+    }
+    return write(text);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+size_t HardwareSerial::print(unsigned long value, int base){
+    char text[24];
+    snprintf(text, sizeof(text), (base == HEX) ? "%lX" : "%lu", value);
+    return write(text);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+size_t HardwareSerial::print(double value, int digits){ //Same special cases as the Arduino core
+    if(isnan(value)) return write("nan");
+    if(isinf(value)) return write("inf");
+    if(value > 4294967040.0 || value < -4294967040.0) return write("ovf");
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return write(text);
+}
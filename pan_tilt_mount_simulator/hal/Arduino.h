@@ -0,0 +1,198 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+//Host replacement for the parts of the Arduino core and the ATmega328P registers the firmware uses. Time is virtual and the pins, ports and serial
+//port are connected to the simulated mount in simulator.cpp.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+#include "binary.h"
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+
+static const uint8_t A0 = 14;
+static const uint8_t A1 = 15;
+static const uint8_t A2 = 16;
+static const uint8_t A3 = 17;
+static const uint8_t A4 = 18;
+static const uint8_t A5 = 19;
+static const uint8_t A6 = 20;
+static const uint8_t A7 = 21;
+
+#define NUM_DIGITAL_PINS 20
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Flash strings are ordinary strings on the host
+
+class __FlashStringHelper;
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define pgm_read_byte(address) pgmRead<uint8_t>(address)
+#define pgm_read_word(address) pgmRead<uint16_t>(address)
+#define pgm_read_dword(address) pgmRead<uint32_t>(address)
+#define pgm_read_float(address) pgmRead<float>(address)
+#define pgm_read_ptr(address) pgmRead<const void*>(address)
+
+template<class T>
+inline T pgmRead(const void *address){ T value; memcpy(&value, address, sizeof(T)); return value; }
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#define _BV(bit) (1 << (bit))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+template<class T, class U>
+inline typename std::common_type<T, U>::type min(T a, U b){ return (a < b) ? a : b; }
+
+template<class T, class U>
+inline typename std::common_type<T, U>::type max(T a, U b){ return (a > b) ? a : b; }
+
+template<class T, class L, class H>
+inline T constrain(T value, L low, H high){ return (value < low) ? low : ((value > high) ? high : value); }
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+void noInterrupts(void);
+void interrupts(void);
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Port registers. Writes go through the pins so the simulator sees every step edge made by FastPin.
+
+class SimPort {
+public:
+    explicit SimPort(uint8_t firstPin, uint8_t pinCount) : _firstPin(firstPin), _pinCount(pinCount) {}
+    operator uint8_t() const;
+    SimPort &operator=(uint8_t value);
+    SimPort &operator|=(int mask){ return *this = (uint8_t)(*this | mask); } //int so ~mask works like it does on the 8 bit register
+    SimPort &operator&=(int mask){ return *this = (uint8_t)(*this & mask); }
+
+private:
+    uint8_t _firstPin;
+    uint8_t _pinCount;
+};
+
+class SimPinRegister {
+public:
+    explicit SimPinRegister(const SimPort &port) : _port(port) {}
+    operator uint8_t() const { return _port; }
+
+private:
+    const SimPort &_port;
+};
+
+extern SimPort PORTB; //D8-D13
+extern SimPort PORTC; //A0-A5
+extern SimPort PORTD; //D0-D7
+extern SimPinRegister PINB;
+extern SimPinRegister PINC;
+extern SimPinRegister PIND;
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//ADC registers used by the battery monitor. The simulator raises ADC_vect on every Timer0 overflow when the auto trigger interrupt is enabled.
+
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t DIDR0;
+extern volatile uint16_t ADC;
+
+#define REFS0 6
+#define ADEN 7
+#define ADATE 5
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define ADTS2 2
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Timer1 counts from the virtual clock at the rate set by the clock select bits in TCCR1B. Only normal mode is modelled.
+
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+
+class SimTimer1 {
+public:
+    operator uint16_t() const;
+};
+
+extern SimTimer1 TCNT1;
+
+#define CS10 0
+#define CS11 1
+#define CS12 2
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#define ISR(vector) void vector(void)
+void ADC_vect(void) __attribute__((weak));
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    void end(void){}
+    int available(void);
+    int read(void);
+    int peek(void);
+    void flush(void){}
+    size_t write(uint8_t value);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text){ return write((const uint8_t*)text, strlen(text)); }
+    size_t print(const char *text){ return write(text); }
+    size_t print(const __FlashStringHelper *text){ return write((const char*)text); }
+    size_t print(char value){ return write((uint8_t)value); }
+    size_t print(unsigned char value, int base = DEC){ return print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC){ return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC){ return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    template<class T>
+    size_t println(T value){ size_t n = print(value); return n + write('\n'); }
+    size_t println(void){ return write('\n'); }
+    operator bool(void){ return true; }
+};
+
+extern HardwareSerial Serial;
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void setup(void);
+void loop(void);
+
+#endif
@@ -0,0 +1,90 @@
+#include "EEPROM.h"
+#include "../simulator.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+EEPROMClass EEPROM;
+
+static std::map<int, std::vector<uint8_t>> eeprom_values; //Address to the bytes last written there
+static bool eeprom_loaded = false;
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//File format: one value per line as the address in decimal and the bytes in hex, e.g. "12 0000a040"
+
+static void eepromLoad(void){
+    eeprom_loaded = true;
+    FILE *file = fopen(sim_config.eepromPath, "r");
+    if(file == nullptr){
+        return;
+    }
+    int address;
+    char hex[64];
+    while(fscanf(file, "%d %63s", &address, hex) == 2){
+        std::vector<uint8_t> bytes;
+        for(size_t i = 0; hex[i] && hex[i + 1]; i += 2){
+            unsigned int value;
+            sscanf(&hex[i], "%2x", &value);
+            bytes.push_back(value);
+        }
+        eeprom_values[address] = bytes;
+    }
+    fclose(file);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void eepromSave(void){
+    FILE *file = fopen(sim_config.eepromPath, "w");
+    if(file == nullptr){
+        perror(sim_config.eepromPath);
+        return;
+    }
+    for(const auto &value : eeprom_values){
+        fprintf(file, "%d ", value.first);
+        for(uint8_t b : value.second){
+            fprintf(file, "%02x", b);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void EEPROMClass::readBlock(int address, uint8_t *data, size_t size){
+    if(!eeprom_loaded){
+        eepromLoad();
+    }
+    auto value = eeprom_values.find(address);
+    for(size_t i = 0; i < size; i++){
+        data[i] = (value != eeprom_values.end() && i < value->second.size()) ? value->second[i] : 0xFF;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void EEPROMClass::writeBlock(int address, const uint8_t *data, size_t size){
+    if(!eeprom_loaded){
+        eepromLoad();
+    }
+    eeprom_values[address] = std::vector<uint8_t>(data, data + size);
+    eepromSave(); //Written through so nothing is lost if the simulator is killed
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+uint8_t EEPROMClass::read(int address){
+    uint8_t value;
+    readBlock(address, &value, 1);
+    return value;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void EEPROMClass::write(int address, uint8_t value){
+    writeBlock(address, &value, 1);
+}
@@ -0,0 +1,35 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <Arduino.h>
+
+//Host EEPROM saved to a file. Values are kept by address rather than as one byte image because int and long are bigger on the host than on the AVR
+//and would overwrite the neighbouring values in the firmware's address map. A blank address reads as 0xFF like a new chip.
+
+class EEPROMClass {
+public:
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value){ write(address, value); }
+    uint16_t length(void){ return 1024; }
+
+    template<class T>
+    T &get(int address, T &value){
+        readBlock(address, (uint8_t*)&value, sizeof(T));
+        return value;
+    }
+
+    template<class T>
+    const T &put(int address, const T &value){
+        writeBlock(address, (const uint8_t*)&value, sizeof(T));
+        return value;
+    }
+
+private:
+    void readBlock(int address, uint8_t *data, size_t size);
+    void writeBlock(int address, const uint8_t *data, size_t size);
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,19 @@
+#include "Iibrary.h"
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float mapNumber(float x, float inMin, float inMax, float outMin, float outMax){
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float degToRads(float degrees){
+    return degrees * M_PI / 180.0;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+float radsToDeg(float radians){
+    return radians * 180.0 / M_PI;
+}
@@ -0,0 +1,69 @@
+#ifndef IIBRARY_H
+#define IIBRARY_H
+
+#include <Arduino.h>
+
+//Host version of the Iibrary functions the firmware uses (https://github.com/isaac879/Iibrary). printi() prints its arguments in order. A float followed
+//by an int is printed with that many decimal places and a newline is added when the last argument isn't a string. The log decoder follows the same rules.
+
+float mapNumber(float x, float inMin, float inMax, float outMin, float outMax);
+float degToRads(float degrees);
+float radsToDeg(float radians);
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+template<class T>
+struct IibraryIsText {
+    enum { value = 0 };
+};
+
+template<> struct IibraryIsText<const __FlashStringHelper*> { enum { value = 1 }; };
+template<> struct IibraryIsText<const char*> { enum { value = 1 }; };
+template<> struct IibraryIsText<char*> { enum { value = 1 }; };
+
+template<class... Args>
+struct IibraryEndsLine {
+    enum { value = 0 };
+};
+
+template<class T>
+struct IibraryEndsLine<T> {
+    enum { value = !IibraryIsText<T>::value };
+};
+
+template<class T, class... Args>
+struct IibraryEndsLine<T, Args...> {
+    enum { value = IibraryEndsLine<Args...>::value };
+};
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+inline void printiParts(void){}
+
+template<class T, class... Args>
+void printiParts(T value, Args... args){
+    Serial.print(value);
+    printiParts(args...);
+}
+
+template<class... Args>
+void printiParts(float value, int decimals, Args... args){
+    Serial.print(value, decimals);
+    printiParts(args...);
+}
+
+template<class... Args>
+void printiParts(double value, int decimals, Args... args){
+    Serial.print(value, decimals);
+    printiParts(args...);
+}
+
+template<class... Args>
+void printi(Args... args){
+    printiParts(args...);
+    if(IibraryEndsLine<Args...>::value){
+        Serial.print('\n');
+    }
+}
+
+#endif
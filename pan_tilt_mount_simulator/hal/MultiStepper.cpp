@@ -0,0 +1,58 @@
+#include "MultiStepper.h"
+#include "AccelStepper.h"
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+MultiStepper::MultiStepper(void) : _num_steppers(0) {}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+boolean MultiStepper::addStepper(AccelStepper &stepper){
+    if(_num_steppers >= MULTISTEPPER_MAX_STEPPERS){
+        return false;
+    }
+    _steppers[_num_steppers++] = &stepper;
+    return true;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void MultiStepper::moveTo(long absolute[]){
+    float longestTime = 0.0; //Time the slowest stepper takes at its max speed
+    for(uint8_t i = 0; i < _num_steppers; i++){
+        long thisDistance = absolute[i] - _steppers[i]->currentPosition();
+        float thisTime = labs(thisDistance) / _steppers[i]->maxSpeed();
+        if(thisTime > longestTime){
+            longestTime = thisTime;
+        }
+    }
+    if(longestTime > 0.0){
+        for(uint8_t i = 0; i < _num_steppers; i++){
+            long thisDistance = absolute[i] - _steppers[i]->currentPosition();
+            float thisSpeed = thisDistance / longestTime;
+            _steppers[i]->moveTo(absolute[i]); //New target position which resets the speed
+            _steppers[i]->setSpeed(thisSpeed);
+        }
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+boolean MultiStepper::run(void){
+    boolean running = false;
+    for(uint8_t i = 0; i < _num_steppers; i++){
+        if(_steppers[i]->distanceToGo() != 0){
+            _steppers[i]->runSpeed();
+            running = true;
+        }
+    }
+    return running;
+}
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void MultiStepper::runSpeedToPosition(void){
+    while(run()){
+        yield();
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef MULTISTEPPER_H
+#define MULTISTEPPER_H
+
+#include <Arduino.h>
+
+#define MULTISTEPPER_MAX_STEPPERS 10
+
+class AccelStepper;
+
+//Host version of AccelStepper's MultiStepper. Moves every stepper at a constant speed so they all arrive at the same time.
+
+class MultiStepper {
+public:
+    MultiStepper(void);
+    boolean addStepper(AccelStepper &stepper);
+    void moveTo(long absolute[]);
+    boolean run(void);
+    void runSpeedToPosition(void);
+
+private:
+    AccelStepper *_steppers[MULTISTEPPER_MAX_STEPPERS];
+    uint8_t _num_steppers;
+};
+
+#endif
@@ -0,0 +1,643 @@
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------
+ *
+ * Host simulator for the pan tilt mount firmware. The sketch is compiled unchanged against the HAL in hal/ and runs against a simulated mount:
+ *
+ *  - Time is virtual. Reading the clock costs --clock-cost-us so a loop that polls micros() moves time forward like the real one does.
+ *  - The step and direction pins drive one simulated motor per axis. Position is counted in 1/16 steps from the MS1/MS2 pins so a wrong step mode
+ *    shows up as a position error. Steps made while the drivers are disabled are counted but don't move the motor, and so is every time the drivers
+ *    are disabled with a motor between full steps.
+ *  - The Hall sensor pins read low when their axis is over the magnet (--hall).
+ *  - The battery monitor interrupt runs every Timer0 overflow with the voltage from --battery.
+ *  - Serial input is a script of instructions (--script or stdin) released one line at a time, or a pseudo terminal in real time (--pty) for the
+ *    Xbox controller app and other host tools.
+ *
+ * Script lines are sent as they are, without the newline. Lines starting with "//" are comments and these directives are run by the simulator:
+ *
+ *  .wait MS                Wait MS milliseconds of virtual time
+ *  .idle                   Wait until no job is running and the motors have stopped
+ *  .jog SLIDER PAN TILT    Send a binary jog packet with the step speeds
+ *  .reset                  Clear the --bench statistics so they only cover what follows
+ *
+ *--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+#include "simulator.h"
+#include "bench.h"
+#include <Arduino.h>
+#include "panTiltMount.h"
+#include "panTiltAxis.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+struct SimAxis {
+    const char *name;
+    uint8_t stepPin;
+    uint8_t directionPin;
+    uint8_t hallPin;
+    float stepsPerUnit; //Sixteenth steps per degree or mm
+    float hallCentre; //Degrees or mm from the power on position
+    float hallWidth;
+    long position; //Sixteenth steps from the power on position
+    unsigned long steps;
+    unsigned long lostSteps; //Made while the drivers were disabled
+    unsigned long offStepIdles; //Times the drivers were disabled with the motor between full steps, which makes it jump to the nearest detent
+};
+
+SimConfig sim_config;
+
+extern Job job;
+
+static SimAxis sim_axes[] = {
+    {"pan", PIN_STEP_PAN, PIN_DIRECTION_PAN, PIN_PAN_HALL, PanStepper::stepsPerUnit(SIXTEENTH_STEP), 30, 3, 0, 0, 0, 0},
+    {"tilt", PIN_STEP_TILT, PIN_DIRECTION_TILT, PIN_TILT_HALL, TiltStepper::stepsPerUnit(SIXTEENTH_STEP), -20, 3, 0, 0, 0, 0},
+    {"slider", PIN_STEP_SLIDER, PIN_DIRECTION_SLIDER, PIN_SLIDER_HALL, SliderStepper::stepsPerUnit(SIXTEENTH_STEP), -200, 2, 0, 0, 0, 0},
+    {"focus", PIN_STEP_FOCUS, PIN_DIRECTION_FOCUS, PIN_NONE, FocusStepper::stepsPerUnit(SIXTEENTH_STEP), 0, 0, 0, 0, 0, 0},
+    {"zoom", PIN_STEP_ZOOM, PIN_DIRECTION_ZOOM, PIN_NONE, ZoomStepper::stepsPerUnit(SIXTEENTH_STEP), 0, 0, 0, 0, 0, 0}
+};
+
+#define SIM_AXIS_COUNT (sizeof(sim_axes) / sizeof(sim_axes[0]))
+
+static uint64_t sim_time_us = 0;
+static uint64_t next_overflow_us = SIM_TIMER0_OVERFLOW_US;
+static uint64_t last_step_us = 0;
+static uint64_t wall_start_us = 0;
+static bool interrupts_enabled = true;
+static bool adc_pending = false;
+static bool in_isr = false;
+
+static uint8_t pin_modes[SIM_PIN_COUNT];
+static bool pin_levels[SIM_PIN_COUNT];
+
+static FILE *trace_file = nullptr;
+
+static std::deque<std::string> script_lines;
+static std::deque<uint8_t> serial_rx; //Bytes the firmware can read
+static bool script_done = false;
+static bool line_consumed = true;
+static uint64_t line_consumed_us = 0;
+static uint64_t wait_until_us = 0;
+static bool wait_for_idle = false;
+static uint64_t idle_since_us = 0;
+static int pty_fd = -1;
+static double tx_empty_us = 0; //When the last byte written will have been sent
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static uint64_t wallTimeUs(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void simExit(const char *reason){
+    fprintf(stderr, "\n[sim] %s at %.3fs\n", reason, sim_time_us / 1000000.0);
+    exit(0); //The summary is printed by the atexit() handler
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void simSummary(void){
+    if(trace_file != nullptr){
+        fclose(trace_file);
+        trace_file = nullptr;
+    }
+    if(sim_config.benchPath != nullptr){
+        benchWrite(sim_config.benchPath);
+    }
+    fprintf(stderr, "[sim] %-8s %12s %12s %12s %8s %8s\n", "axis", "position", "units", "steps", "lost", "offstep");
+    for(size_t i = 0; i < SIM_AXIS_COUNT; i++){
+        const SimAxis &axis = sim_axes[i];
+        fprintf(stderr, "[sim] %-8s %12ld %12.3f %12lu %8lu %8lu\n", axis.name, axis.position, axis.position / axis.stepsPerUnit, axis.steps, axis.lostSteps,
+            axis.offStepIdles);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void traceLine(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+static void traceLine(const char *format, ...){
+    if(trace_file == nullptr){
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(trace_file, format, args);
+    va_end(args);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void runAdcInterrupt(void){
+    if(!(ADCSRA & _BV(ADIE)) || ADC_vect == nullptr){
+        return;
+    }
+    if(!interrupts_enabled || in_isr){
+        adc_pending = true; //Runs when interrupts are enabled again like the AVR's interrupt flag
+        return;
+    }
+    adc_pending = false;
+    ADC = (uint16_t)constrain(sim_config.batteryVolts / BATTERY_VOLTS_PER_COUNT, 0.0f, 1023.0f);
+    in_isr = true;
+    ADC_vect();
+    in_isr = false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool mountIdle(void){
+    return job.state == JOB_IDLE && sim_time_us - last_step_us >= (uint64_t)SIM_IDLE_QUIET_MS * 1000;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void queueJog(const char *arguments){
+    long speeds[3] = {0, 0, 0};
+    sscanf(arguments, "%ld %ld %ld", &speeds[0], &speeds[1], &speeds[2]);
+    serial_rx.push_back(INSTRUCTION_BYTES_SLIDER_PAN_TILT_SPEED);
+    for(int i = 0; i < 3; i++){
+        uint16_t value = (uint16_t)(int16_t)speeds[i];
+        serial_rx.push_back(highByte(value));
+        serial_rx.push_back(lowByte(value));
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//Releases the next script line once the firmware has read the last one and the gap has passed. Commands have no terminator so they must not arrive
+//together.
+
+static void serviceScript(void){
+    if(!serial_rx.empty()){
+        return;
+    }
+    if(!line_consumed){
+        line_consumed = true;
+        line_consumed_us = sim_time_us;
+    }
+    if(sim_time_us < wait_until_us){
+        return;
+    }
+    if(wait_for_idle){
+        if(!mountIdle()){
+            return;
+        }
+        wait_for_idle = false;
+    }
+    while(!script_lines.empty()){
+        if(sim_time_us - line_consumed_us < (uint64_t)sim_config.lineGapMs * 1000){
+            return;
+        }
+        std::string line = script_lines.front();
+        script_lines.pop_front();
+        if(line.compare(0, 6, ".wait ") == 0){
+            wait_until_us = sim_time_us + (uint64_t)(atof(line.c_str() + 6) * 1000);
+            return;
+        }
+        if(line == ".idle"){
+            wait_for_idle = true;
+            return;
+        }
+        if(line == ".reset"){
+            benchReset();
+            continue;
+        }
+        if(line.compare(0, 5, ".jog ") == 0){
+            queueJog(line.c_str() + 5);
+        }
+        else if(line[0] == '.'){
+            fprintf(stderr, "[sim] Unknown directive: %s\n", line.c_str());
+            continue;
+        }
+        else{
+            serial_rx.insert(serial_rx.end(), line.begin(), line.end());
+        }
+        if(sim_config.echo){
+            printf("> %s\n", line.c_str());
+        }
+        line_consumed = false;
+        return;
+    }
+    if(!script_done){
+        script_done = true;
+        idle_since_us = sim_time_us;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void servicePty(void){
+    uint8_t buffer[64];
+    ssize_t count = read(pty_fd, buffer, sizeof(buffer));
+    if(count > 0){
+        serial_rx.insert(serial_rx.end(), buffer, buffer + count);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void serviceExit(void){
+    if(sim_config.durationMs && sim_time_us >= (uint64_t)sim_config.durationMs * 1000){
+        simExit("Duration reached");
+    }
+    if(!script_done || sim_config.pty){
+        return;
+    }
+    if(!mountIdle() || !serial_rx.empty()){
+        idle_since_us = sim_time_us;
+    }
+    else if(sim_time_us - idle_since_us >= (uint64_t)sim_config.idleExitMs * 1000){
+        simExit("Script finished");
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void setTime(uint64_t us){
+    while(next_overflow_us <= us){
+        sim_time_us = next_overflow_us;
+        next_overflow_us += SIM_TIMER0_OVERFLOW_US;
+        runAdcInterrupt();
+    }
+    sim_time_us = us;
+    benchPoll(us);
+    if(in_isr){
+        return;
+    }
+    if(sim_config.pty){
+        servicePty();
+    }
+    else{
+        serviceScript();
+    }
+    serviceExit();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+uint64_t simTimeUs(void){
+    return sim_time_us;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void simAdvance(uint64_t us){
+    if(sim_config.pty){ //Real time so the host tools see the real timing
+        uint64_t target = sim_time_us + us;
+        while(wallTimeUs() - wall_start_us < target){
+            setTime(wallTimeUs() - wall_start_us);
+        }
+        setTime(target);
+        return;
+    }
+    setTime(sim_time_us + us);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void simClockRead(void){
+    if(sim_config.pty){
+        setTime(max(sim_time_us, wallTimeUs() - wall_start_us));
+        return;
+    }
+    setTime(sim_time_us + sim_config.clockCostUs);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void simSetInterrupts(bool enabled){
+    interrupts_enabled = enabled;
+    if(enabled && adc_pending){
+        runAdcInterrupt();
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void simPinMode(uint8_t pin, uint8_t mode){
+    if(pin >= SIM_PIN_COUNT){
+        return;
+    }
+    pin_modes[pin] = mode;
+    if(mode == INPUT_PULLUP){
+        pin_levels[pin] = HIGH;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static uint8_t stepMode(void){ //From the MS1 and MS2 pins of the TMC2208
+    bool ms1 = pin_levels[PIN_MS1];
+    bool ms2 = pin_levels[PIN_MS2];
+    if(ms1 && !ms2) return HALF_STEP;
+    if(!ms1 && ms2) return QUARTER_STEP;
+    if(!ms1 && !ms2) return EIGHTH_STEP;
+    return SIXTEENTH_STEP;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void motorStep(SimAxis &axis, size_t index){
+    bool forward = pin_levels[axis.directionPin];
+    benchStep(index, stepMode(), sim_time_us);
+    axis.steps++;
+    last_step_us = sim_time_us;
+    if(pin_levels[PIN_ENABLE] != LOW){
+        axis.lostSteps++;
+        return;
+    }
+    long sixteenths = SIXTEENTH_STEP / stepMode();
+    axis.position += forward ? sixteenths : -sixteenths;
+    traceLine("%llu step %zu %d %ld\n", (unsigned long long)sim_time_us, index, forward, axis.position);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void simPinWrite(uint8_t pin, bool level){
+    if(pin >= SIM_PIN_COUNT || pin_levels[pin] == level){
+        return;
+    }
+    pin_levels[pin] = level;
+    if(pin == PIN_ENABLE && level == HIGH){
+        for(size_t i = 0; i < SIM_AXIS_COUNT; i++){
+            if(sim_axes[i].position % SIXTEENTH_STEP != 0){ //The drivers power up on a full step so the position is also the microstep phase
+                sim_axes[i].offStepIdles++;
+            }
+        }
+    }
+    if(pin == PIN_ENABLE || pin == PIN_SHUTTER_TRIGGER){
+        traceLine("%llu pin %u %d\n", (unsigned long long)sim_time_us, pin, level);
+        return;
+    }
+    if(!level){
+        return;
+    }
+    for(size_t i = 0; i < SIM_AXIS_COUNT; i++){
+        if(sim_axes[i].stepPin == pin){
+            motorStep(sim_axes[i], i);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+bool simPinRead(uint8_t pin){
+    if(pin >= SIM_PIN_COUNT){
+        return LOW;
+    }
+    if(pin_modes[pin] != OUTPUT){
+        for(size_t i = 0; i < SIM_AXIS_COUNT; i++){
+            const SimAxis &axis = sim_axes[i];
+            if(axis.hallPin == pin && axis.hallWidth > 0){
+                return fabs(axis.position / axis.stepsPerUnit - axis.hallCentre) > axis.hallWidth / 2; //Pulled low over the magnet
+            }
+        }
+    }
+    return pin_levels[pin];
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+uint16_t simAnalogRead(uint8_t pin){
+    if(pin == PIN_INPUT_VOLTAGE){
+        return (uint16_t)constrain(sim_config.batteryVolts / BATTERY_VOLTS_PER_COUNT, 0.0f, 1023.0f);
+    }
+    return simPinRead(pin) ? 1023 : 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int simSerialAvailable(void){
+    return serial_rx.size();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int simSerialRead(void){
+    if(serial_rx.empty()){
+        return -1;
+    }
+    uint8_t value = serial_rx.front();
+    serial_rx.pop_front();
+    return value;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int simSerialPeek(void){
+    return serial_rx.empty() ? -1 : serial_rx.front();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void simSerialWrite(const uint8_t *data, size_t size){
+    const double byteUs = 10 * 1000000.0 / BAUD_RATE; //Start, 8 data and stop bits
+    for(size_t i = 0; i < size; i++){ //Waits for space in the transmit buffer like HardwareSerial does
+        tx_empty_us = max(tx_empty_us, (double)sim_time_us);
+        if(tx_empty_us - sim_time_us > (SIM_SERIAL_TX_BUFFER - 1) * byteUs){
+            simAdvance((uint64_t)ceil(tx_empty_us - sim_time_us - (SIM_SERIAL_TX_BUFFER - 1) * byteUs));
+        }
+        tx_empty_us += byteUs;
+    }
+    if(sim_config.echo){
+        fwrite(data, 1, size, stdout);
+    }
+    if(pty_fd >= 0){
+        while(size > 0){
+            ssize_t written = write(pty_fd, data, size);
+            if(written < 0){
+                if(errno == EAGAIN){ //Nothing has the terminal open. Drop the output like the Bluetooth module does when disconnected.
+                    break;
+                }
+                perror("[sim] pty");
+                break;
+            }
+            data += written;
+            size -= written;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void usage(const char *name){
+    fprintf(stderr,
+        "Usage: %s [options] [script]\n"
+        "  --script FILE        Instructions to send, one per line (default stdin)\n"
+        "  --pty                Serial on a pseudo terminal in real time instead of a script\n"
+        "  --trace FILE         Write every step and pin change with its time in us\n"
+        "  --eeprom FILE        EEPROM file (default %s)\n"
+        "  --quiet              Don't copy the serial output to stdout\n"
+        "  --clock-cost-us N    Virtual time used by each micros()/millis() call (default %d)\n"
+        "  --pin-cost-us N      Virtual time used by each digitalWrite()/digitalRead() call (default %d)\n"
+        "  --bench FILE         Write timing statistics as JSON on exit\n"
+        "  --line-gap-ms N      Gap between script lines (default %d)\n"
+        "  --idle-exit-ms N     Exit once idle for this long after the script (default %d)\n"
+        "  --duration-ms N      Stop after this much virtual time\n"
+        "  --battery VOLTS      Battery voltage (default %.1f)\n"
+        "  --hall AXIS=CENTRE:WIDTH  Hall sensor position in degrees or mm from the power on position\n",
+        name, sim_config.eepromPath, SIM_DEFAULT_CLOCK_COST_US, SIM_DEFAULT_PIN_COST_US, SIM_DEFAULT_LINE_GAP_MS, SIM_DEFAULT_IDLE_EXIT_MS, SIM_DEFAULT_BATTERY_VOLTS);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static bool parseHall(const char *option){
+    char name[16];
+    float centre, width;
+    if(sscanf(option, "%15[^=]=%f:%f", name, &centre, &width) != 3){
+        return false;
+    }
+    for(size_t i = 0; i < SIM_AXIS_COUNT; i++){
+        if(strcmp(sim_axes[i].name, name) == 0 && sim_axes[i].hallPin != PIN_NONE){
+            sim_axes[i].hallCentre = centre;
+            sim_axes[i].hallWidth = width;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int simParseOptions(int argc, char **argv){
+    for(int i = 1; i < argc; i++){
+        const char *option = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool hasValue = true;
+        if(strcmp(option, "--pty") == 0){
+            sim_config.pty = true;
+            hasValue = false;
+        }
+        else if(strcmp(option, "--quiet") == 0){
+            sim_config.echo = false;
+            hasValue = false;
+        }
+        else if(option[0] != '-'){
+            sim_config.scriptPath = option;
+            hasValue = false;
+        }
+        else if(value == nullptr){
+            usage(argv[0]);
+            return -1;
+        }
+        else if(strcmp(option, "--script") == 0) sim_config.scriptPath = value;
+        else if(strcmp(option, "--trace") == 0) sim_config.tracePath = value;
+        else if(strcmp(option, "--eeprom") == 0) sim_config.eepromPath = value;
+        else if(strcmp(option, "--bench") == 0) sim_config.benchPath = value;
+        else if(strcmp(option, "--clock-cost-us") == 0) sim_config.clockCostUs = strtoul(value, nullptr, 10);
+        else if(strcmp(option, "--pin-cost-us") == 0) sim_config.pinCostUs = strtoul(value, nullptr, 10);
+        else if(strcmp(option, "--line-gap-ms") == 0) sim_config.lineGapMs = strtoul(value, nullptr, 10);
+        else if(strcmp(option, "--idle-exit-ms") == 0) sim_config.idleExitMs = strtoul(value, nullptr, 10);
+        else if(strcmp(option, "--duration-ms") == 0) sim_config.durationMs = strtoul(value, nullptr, 10);
+        else if(strcmp(option, "--battery") == 0) sim_config.batteryVolts = atof(value);
+        else if(strcmp(option, "--hall") == 0){
+            if(!parseHall(value)){
+                fprintf(stderr, "Bad --hall %s. Expected pan, tilt or slider=CENTRE:WIDTH\n", value);
+                return -1;
+            }
+        }
+        else{
+            usage(argv[0]);
+            return -1;
+        }
+        if(hasValue){
+            i++;
+        }
+    }
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void loadScript(void){
+    FILE *file = stdin;
+    if(sim_config.scriptPath != nullptr){
+        file = fopen(sim_config.scriptPath, "r");
+        if(file == nullptr){
+            perror(sim_config.scriptPath);
+            exit(1);
+        }
+    }
+    char buffer[256];
+    while(fgets(buffer, sizeof(buffer), file) != nullptr){
+        std::string line(buffer);
+        while(!line.empty() && (line.back() == '\n' || line.back() == '\r' || line.back() == ' ')){
+            line.pop_back();
+        }
+        if(line.empty() || line.compare(0, 2, "//") == 0){
+            continue;
+        }
+        script_lines.push_back(line);
+    }
+    if(file != stdin){
+        fclose(file);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void openPty(void){
+    pty_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(pty_fd < 0 || grantpt(pty_fd) < 0 || unlockpt(pty_fd) < 0){
+        perror("[sim] posix_openpt");
+        exit(1);
+    }
+    const char *name = ptsname(pty_fd);
+    int slave = open(name, O_RDWR | O_NOCTTY); //Kept open so the master doesn't see a hang up between clients
+    struct termios settings;
+    tcgetattr(slave, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(slave, TCSANOW, &settings);
+    fcntl(pty_fd, F_SETFL, fcntl(pty_fd, F_GETFL) | O_NONBLOCK);
+    fprintf(stderr, "[sim] Serial port: %s\n", name);
+    wall_start_us = wallTimeUs();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void simInit(void){
+    setvbuf(stdout, nullptr, _IOLBF, 0); //Keeps the firmware output in order with the simulator's messages on stderr
+    if(sim_config.tracePath != nullptr){
+        trace_file = fopen(sim_config.tracePath, "w");
+        if(trace_file == nullptr){
+            perror(sim_config.tracePath);
+            exit(1);
+        }
+    }
+    if(sim_config.pty){
+        openPty();
+    }
+    else{
+        loadScript();
+    }
+    for(uint8_t pin = 0; pin < SIM_PIN_COUNT; pin++){
+        pin_modes[pin] = INPUT;
+        pin_levels[pin] = LOW;
+    }
+    atexit(simSummary);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main(int argc, char **argv){
+    if(simParseOptions(argc, argv) < 0){
+        return 2;
+    }
+    simInit();
+    setup();
+    while(1){
+        loop();
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+//The simulated mount the HAL in hal/ is connected to. Time is virtual: it only moves forward when the firmware reads the clock (each read costs
+//clock_cost_us to model the loop around it) or waits. The step and direction pins drive simulated motors with Hall sensors at configurable positions.
+
+#define SIM_PIN_COUNT 22
+#define SIM_TIMER0_OVERFLOW_US 1024 //16MHz / 64 prescaler / 256
+#define SIM_DEFAULT_CLOCK_COST_US 4
+#define SIM_DEFAULT_PIN_COST_US 4 //digitalWrite() and digitalRead() look the pin up in tables
+#define SIM_SERIAL_TX_BUFFER 64 //Serial.write() blocks when the transmit buffer is full
+#define SIM_DEFAULT_LINE_GAP_MS 20
+#define SIM_DEFAULT_IDLE_EXIT_MS 1000
+#define SIM_DEFAULT_BATTERY_VOLTS 12.0
+#define SIM_IDLE_QUIET_MS 200 //No steps for this long and no job running counts as idle
+
+struct SimConfig {
+    const char *scriptPath = nullptr; //Lines sent to the firmware one at a time. stdin if not set.
+    const char *tracePath = nullptr; //Every step edge and shutter/enable change with its virtual timestamp
+    const char *eepromPath = "pan_tilt_sim.eeprom";
+    const char *benchPath = nullptr; //Timing statistics written as JSON on exit
+    bool pty = false; //Serial on a pseudo terminal in real time instead of the script
+    bool echo = true; //Copy the firmware's serial output to stdout
+    unsigned long clockCostUs = SIM_DEFAULT_CLOCK_COST_US;
+    unsigned long pinCostUs = SIM_DEFAULT_PIN_COST_US;
+    unsigned long lineGapMs = SIM_DEFAULT_LINE_GAP_MS;
+    unsigned long idleExitMs = SIM_DEFAULT_IDLE_EXIT_MS;
+    unsigned long durationMs = 0; //0 = until the script is finished and the mount is idle
+    float batteryVolts = SIM_DEFAULT_BATTERY_VOLTS;
+};
+
+extern SimConfig sim_config;
+
+/*------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+uint64_t simTimeUs(void);
+void simAdvance(uint64_t us);
+void simClockRead(void);
+void simSetInterrupts(bool enabled);
+
+void simPinMode(uint8_t pin, uint8_t mode);
+void simPinWrite(uint8_t pin, bool level);
+bool simPinRead(uint8_t pin);
+uint16_t simAnalogRead(uint8_t pin);
+
+int simSerialAvailable(void);
+int simSerialRead(void);
+int simSerialPeek(void);
+void simSerialWrite(const uint8_t *data, size_t size);
+
+int simParseOptions(int argc, char **argv);
+void simInit(void);
+
+#endif